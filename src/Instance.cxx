@@ -8,6 +8,8 @@
 #include "StateFile.hxx"
 #include "Stats.hxx"
 #include "client/List.hxx"
+#include "client/Threads.hxx"
+#include "client/BackgroundCommandPool.hxx"
 #include "input/cache/Manager.hxx"
 #include "output/Control.hxx"
 
@@ -48,6 +50,12 @@ Instance::~Instance() noexcept
 		sticker_cleanup.reset();
 #endif
 
+	/* close all clients before the database, because their
+	   background commands may still be accessing it */
+	client_list.reset();
+	client_threads.reset();
+	background_command_pool.reset();
+
 #ifdef ENABLE_DATABASE
 	delete update;
 
@@ -39,6 +39,8 @@ class InotifyUpdate;
 #include <list>
 
 class ClientList;
+class ClientThreads;
+class BackgroundCommandPool;
 struct Partition;
 class AudioOutputControl;
 class StateFile;
@@ -122,6 +124,23 @@ struct Instance final
 	std::unique_ptr<RemoteTagCache> remote_tag_cache;
 #endif
 
+	/**
+	 * Worker threads for expensive database queries; nullptr if
+	 * they are executed in the main thread.  This is declared
+	 * before #client_list, because the clients must be
+	 * destroyed (and their background commands cancelled)
+	 * first.
+	 */
+	std::unique_ptr<BackgroundCommandPool> background_command_pool;
+
+	/**
+	 * Threads which perform the socket I/O of clients; nullptr
+	 * if this is done in the main thread.  This is declared
+	 * before #client_list, because the clients must be
+	 * destroyed first.
+	 */
+	std::unique_ptr<ClientThreads> client_threads;
+
 	std::unique_ptr<ClientList> client_list;
 
 	AllOutputs outputs;
@@ -13,6 +13,8 @@
 #include "Listen.hxx"
 #include "client/Config.hxx"
 #include "client/List.hxx"
+#include "client/Threads.hxx"
+#include "client/BackgroundCommandPool.hxx"
 #include "command/AllCommands.hxx"
 #include "Partition.hxx"
 #include "tag/Config.hxx"
@@ -30,6 +32,7 @@
 #include "zeroconf/Glue.hxx"
 #include "decoder/DecoderList.hxx"
 #include "pcm/Convert.hxx"
+#include "memory/AudioMemory.hxx"
 #include "unix/SignalHandlers.hxx"
 #include "thread/Slack.hxx"
 #include "net/Init.hxx"
@@ -58,6 +61,7 @@
 #include "db/update/Service.hxx"
 #include "db/Configured.hxx"
 #include "db/DatabasePlugin.hxx"
+#include "db/Interface.hxx"
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
 #include "storage/Configured.hxx"
 #include "storage/CompositeStorage.hxx"
@@ -231,6 +235,28 @@ InitDatabaseAndStorage(Instance &instance, const ConfigData &config)
 	return create_db;
 }
 
+/**
+ * Start the worker threads which execute expensive database queries
+ * (option "query_threads"), unless the database plugin is not
+ * thread-safe.
+ */
+static void
+InitQueryThreads(Instance &instance, const ConfigData &config)
+{
+	if (instance.database == nullptr ||
+	    !instance.database->GetPlugin().IsConcurrent())
+		return;
+
+	const unsigned n_threads =
+		config.GetUnsigned(ConfigOption::QUERY_THREADS, 2);
+	if (n_threads == 0)
+		/* execute all queries in the main thread */
+		return;
+
+	instance.background_command_pool =
+		std::make_unique<BackgroundCommandPool>(n_threads);
+}
+
 #endif
 
 #ifdef ENABLE_SQLITE
@@ -271,6 +297,11 @@ initialize_decoder_and_player(Instance &instance,
 			      const ConfigData &config,
 			      const PartitionConfig &partition_config)
 {
+	/* this must be enabled before the partition allocates its
+	   MusicBuffer */
+	if (config.GetBool(ConfigOption::MLOCK_AUDIO_MEMORY, false))
+		EnableAudioMemoryLock();
+
 	instance.partitions.emplace_back(instance,
 					 "default",
 					 partition_config);
@@ -353,6 +384,13 @@ MainConfigured(const CommandLineOptions &options,
 		raw_config.GetPositive(ConfigOption::MAX_CONN, 100);
 	instance.client_list = std::make_unique<ClientList>(max_clients);
 
+	if (const unsigned n_client_threads =
+	    raw_config.GetUnsigned(ConfigOption::CLIENT_THREADS, 0);
+	    n_client_threads > 0)
+		instance.client_threads =
+			std::make_unique<ClientThreads>(instance.event_loop,
+							n_client_threads);
+
 	const auto *input_cache_config = raw_config.GetBlock(ConfigBlockOption::INPUT_CACHE);
 	if (input_cache_config != nullptr) {
 		const InputCacheConfig c(*input_cache_config);
@@ -387,6 +425,7 @@ MainConfigured(const CommandLineOptions &options,
 
 #ifdef ENABLE_DATABASE
 	const bool create_db = InitDatabaseAndStorage(instance, raw_config);
+	InitQueryThreads(instance, raw_config);
 #endif
 
 #ifdef ENABLE_SQLITE
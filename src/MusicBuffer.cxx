@@ -3,20 +3,76 @@
 
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "memory/AudioMemory.hxx"
 
+#include <algorithm>
 #include <cassert>
 
-MusicBuffer::MusicBuffer(unsigned num_chunks)
-	:buffer(num_chunks)
+/**
+ * Adapt() chooses the chunk size so the buffer has at least this
+ * number of chunks.
+ */
+static constexpr unsigned MIN_CHUNKS = 64;
+
+MusicBufferCounters music_buffer_counters;
+
+MusicBuffer::MusicBuffer(std::size_t nbytes,
+			 std::chrono::milliseconds _chunk_time)
+	:buffer(nbytes, CHUNK_SIZE),
+	 chunk_time(_chunk_time)
 {
 	buffer.SetName("MusicBuffer");
+	buffer.SetRetryCounter(music_buffer_counters.retries);
+
+	/* if "mlock_audio_memory" is enabled, the buffer is locked
+	   (and thus populated) for its whole lifetime, instead of
+	   populating it only while playing */
+	locked = LockAudioMemory(buffer.GetMemory());
+}
+
+MusicBuffer::~MusicBuffer() noexcept
+{
+	if (locked)
+		UnlockAudioMemory(buffer.GetMemory());
+}
+
+void
+MusicBuffer::Adapt(const AudioFormat audio_format) noexcept
+{
+	assert(audio_format.IsValid());
+
+	if (chunk_time <= std::chrono::milliseconds::zero())
+		return;
+
+	const std::size_t max_size =
+		std::max(buffer.GetMemorySize() / MIN_CHUNKS / CHUNK_SIZE,
+			 std::size_t{1}) * CHUNK_SIZE;
+
+	/* round up to a multiple of CHUNK_SIZE, which is a
+	   multiple of the alignment of MusicChunk */
+	std::size_t size = sizeof(MusicChunk) +
+		audio_format.TimeToSize(chunk_time);
+	size = (size + CHUNK_SIZE - 1) / CHUNK_SIZE * CHUNK_SIZE;
+	size = std::clamp(size, CHUNK_SIZE, max_size);
+
+	if (size == buffer.GetSliceSize() || !buffer.empty())
+		return;
+
+	buffer.SetSliceSize(size);
 }
 
 MusicChunkPtr
 MusicBuffer::Allocate() noexcept
 {
-	const std::lock_guard protect{mutex};
-	return {buffer.Allocate(), MusicChunkDeleter(*this)};
+	auto *chunk = buffer.Allocate(GetChunkCapacity());
+	if (chunk == nullptr) [[unlikely]] {
+		music_buffer_counters.exhausted.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	music_buffer_counters.allocated.fetch_add(1, std::memory_order_relaxed);
+	return {chunk, MusicChunkDeleter(*this)};
 }
 
 void
@@ -24,15 +80,11 @@ MusicBuffer::Return(MusicChunk *chunk) noexcept
 {
 	assert(chunk != nullptr);
 
-	/* these attributes need to be cleared before locking the
-	   mutex, because they might recursively call this method,
-	   causing a deadlock */
-	chunk->next.reset();
-	chunk->other.reset();
-
-	const std::lock_guard protect{mutex};
+	/* chunks are unlinked by MusicPipe::Shift() */
+	assert(chunk->next.load(std::memory_order_relaxed) == nullptr);
 
-	assert(!chunk->other || !chunk->other->other);
+	/* this may recursively call this method */
+	chunk->other.reset();
 
 	buffer.Free(chunk);
 }
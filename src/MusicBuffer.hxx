@@ -5,33 +5,84 @@
 
 #include "MusicChunk.hxx"
 #include "MusicChunkPtr.hxx"
-#include "memory/SliceBuffer.hxx"
-#include "thread/Mutex.hxx"
+#include "memory/AtomicSliceBuffer.hxx"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+struct AudioFormat;
+
+/**
+ * Counters for diagnosing contention on #MusicBuffer instances.
+ */
+struct MusicBufferCounters {
+	/**
+	 * The number of chunks allocated.
+	 */
+	std::atomic_uint_least64_t allocated{0};
+
+	/**
+	 * The number of times an allocation failed because the
+	 * buffer was full.
+	 */
+	std::atomic_uint_least64_t exhausted{0};
+
+	/**
+	 * The number of times an allocation or a deallocation had to
+	 * be retried because another thread modified the buffer at
+	 * the same time.
+	 */
+	std::atomic_uint_least64_t retries{0};
+};
+
+extern MusicBufferCounters music_buffer_counters;
 
 /**
- * An allocator for #MusicChunk objects.
+ * An allocator for #MusicChunk objects.  It is lock-free; all
+ * methods may be called from any thread, unless documented
+ * otherwise.
+ *
+ * The size of the chunks depends on the audio format (see Adapt()):
+ * formats with a high bit rate get larger chunks, so the player and
+ * output threads do not need to wake up as often.
  */
 class MusicBuffer {
-	/** a mutex which protects #buffer */
-	mutable Mutex mutex;
+	AtomicSliceBuffer<MusicChunk> buffer;
 
-	SliceBuffer<MusicChunk> buffer;
+	/**
+	 * The desired playback duration of one chunk; zero means
+	 * all chunks have #CHUNK_SIZE bytes.
+	 */
+	const std::chrono::milliseconds chunk_time;
+
+	/**
+	 * Was the memory locked with LockAudioMemory()?
+	 */
+	bool locked = false;
 
 public:
 	/**
 	 * Creates a new #MusicBuffer object.
 	 *
-	 * @param num_chunks the number of #MusicChunk reserved in
-	 * this buffer
+	 * @param nbytes the total size of the buffer in bytes
+	 * @param _chunk_time the desired playback duration of one
+	 * chunk (see Adapt())
 	 */
-	explicit MusicBuffer(unsigned num_chunks);
+	explicit MusicBuffer(std::size_t nbytes,
+			     std::chrono::milliseconds _chunk_time=std::chrono::milliseconds::zero());
+
+	~MusicBuffer() noexcept;
+
+	MusicBuffer(const MusicBuffer &) = delete;
+	MusicBuffer &operator=(const MusicBuffer &) = delete;
 
 #ifndef NDEBUG
 	/**
 	 * Check whether the buffer is empty.
 	 *
-	 * This call is not protected with the #mutex, and may only be
-	 * used while this object is inaccessible to other threads.
+	 * This may only be used while this object is inaccessible to
+	 * other threads.
 	 */
 	bool IsEmptyUnsafe() const {
 		return buffer.empty();
@@ -39,31 +90,53 @@ public:
 #endif
 
 	bool IsFull() const noexcept {
-		const std::lock_guard protect{mutex};
 		return buffer.IsFull();
 	}
 
 	/**
-	 * Returns the total number of reserved chunks in this buffer.  This
-	 * is the same value which was passed to the constructor.
+	 * Returns the total number of chunks in this buffer.  This
+	 * value changes when Adapt() chooses a different chunk size.
 	 */
 	[[gnu::pure]]
 	unsigned GetSize() const noexcept {
 		return buffer.GetCapacity();
 	}
 
+	/**
+	 * Returns the number of data bytes in each chunk (i.e. the
+	 * MusicChunk::capacity of new chunks).
+	 */
+	[[gnu::pure]]
+	std::size_t GetChunkCapacity() const noexcept {
+		return buffer.GetSliceSize() - sizeof(MusicChunk);
+	}
+
+	/**
+	 * Choose the chunk size for the given audio format.  This
+	 * only has an effect if no chunk is allocated currently,
+	 * e.g. not while the player is still playing the previous
+	 * song.
+	 *
+	 * This must be called by the (only) thread which calls
+	 * Allocate(), usually the decoder thread.
+	 */
+	void Adapt(AudioFormat audio_format) noexcept;
+
 	void PopulateMemory() noexcept {
-		buffer.PopulateMemory();
+		if (!locked)
+			buffer.PopulateMemory();
 	}
 
 	/**
-	 * Give all memory allocations back to the kernel.
+	 * Give all memory allocations back to the kernel (unless
+	 * the memory is locked).
 	 *
-	 * This call is not protected with the #mutex, and may only be
-	 * used while this object is inaccessible to other threads.
+	 * This may only be used while this object is inaccessible to
+	 * other threads.
 	 */
 	void DiscardMemory() noexcept {
-		buffer.DiscardMemory();
+		if (!locked)
+			buffer.DiscardMemory();
 	}
 
 	/**
@@ -12,11 +12,17 @@
 #endif
 
 #include <array>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <span>
 
+/**
+ * The default and minimum size of a #MusicChunk including its data
+ * buffer.  #MusicBuffer may choose larger chunks for audio formats
+ * with a high bit rate.
+ */
 static constexpr size_t CHUNK_SIZE = 4096;
 
 struct AudioFormat;
@@ -27,8 +33,13 @@ struct MusicChunk;
  * Meta information for #MusicChunk.
  */
 struct MusicChunkInfo {
-	/** the next chunk in a linked list */
-	MusicChunkPtr next;
+	/**
+	 * The next chunk in a #MusicPipe.  This is not an owning
+	 * pointer; the chunks are owned by the #MusicPipe.  It is
+	 * written by the MusicPipe::Push() caller while other threads
+	 * may read it.
+	 */
+	std::atomic<MusicChunk *> next{nullptr};
 
 	/**
 	 * An optional chunk which should be mixed into this chunk.
@@ -49,7 +60,7 @@ struct MusicChunkInfo {
 	float mix_ratio;
 
 	/** number of bytes stored in this chunk */
-	uint16_t length = 0;
+	uint32_t length = 0;
 
 	/** current bit rate of the source file */
 	uint16_t bit_rate;
@@ -97,10 +108,24 @@ struct MusicChunkInfo {
 /**
  * A chunk of music data.  Its format is defined by the
  * MusicPipe::Push() caller.
+ *
+ * The data (probably PCM) is stored in the #capacity bytes
+ * following this object; they are allocated by #MusicBuffer.
  */
 struct MusicChunk : MusicChunkInfo {
-	/** the data (probably PCM) */
-	std::byte data[CHUNK_SIZE - sizeof(MusicChunkInfo)];
+	/** the size of the data buffer in bytes */
+	const uint32_t capacity;
+
+	explicit MusicChunk(uint32_t _capacity) noexcept
+		:capacity(_capacity) {}
+
+	std::byte *GetBuffer() noexcept {
+		return reinterpret_cast<std::byte *>(this + 1);
+	}
+
+	const std::byte *GetBuffer() const noexcept {
+		return reinterpret_cast<const std::byte *>(this + 1);
+	}
 
 	/**
 	 * Prepares appending to the music chunk.  Returns a buffer
@@ -129,8 +154,8 @@ struct MusicChunk : MusicChunkInfo {
 	bool Expand(AudioFormat af, size_t length) noexcept;
 
 	std::span<const std::byte> ReadData() const noexcept {
-		return {data, length};
+		return {GetBuffer(), length};
 	}
 };
 
-static_assert(sizeof(MusicChunk) == CHUNK_SIZE, "Wrong size");
+static_assert(sizeof(MusicChunk) < CHUNK_SIZE, "Wrong size");
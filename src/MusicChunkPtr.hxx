@@ -17,6 +17,8 @@ public:
 	explicit MusicChunkDeleter(MusicBuffer &_buffer):buffer(&_buffer) {}
 
 	void operator()(MusicChunk *chunk) noexcept;
+
+	constexpr bool operator==(const MusicChunkDeleter &) const noexcept = default;
 };
 
 using MusicChunkPtr = std::unique_ptr<MusicChunk, MusicChunkDeleter>;
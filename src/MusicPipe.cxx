@@ -5,15 +5,17 @@
 #include "MusicChunk.hxx"
 
 #include <cassert>
+#include <thread>
+
+MusicPipeCounters music_pipe_counters;
 
 #ifndef NDEBUG
 
 bool
 MusicPipe::Contains(const MusicChunk *chunk) const noexcept
 {
-	const std::lock_guard protect{mutex};
-
-	for (const MusicChunk *i = head.get(); i != nullptr; i = i->next.get())
+	for (const MusicChunk *i = Peek(); i != nullptr;
+	     i = i->next.load(std::memory_order_acquire))
 		if (i == chunk)
 			return true;
 
@@ -25,32 +27,45 @@ MusicPipe::Contains(const MusicChunk *chunk) const noexcept
 MusicChunkPtr
 MusicPipe::Shift() noexcept
 {
-	const std::lock_guard protect{mutex};
-
-	auto chunk = std::move(head);
-	if (chunk != nullptr) {
-		assert(!chunk->IsEmpty());
-
-		head = std::move(chunk->next);
-		--size;
+	MusicChunk *chunk = head.load(std::memory_order_acquire);
+	if (chunk == nullptr)
+		return nullptr;
 
-		if (head == nullptr) {
-			assert(size == 0);
-			assert(tail_r == &chunk->next);
-
-			tail_r = &head;
-		} else {
-			assert(size > 0);
-			assert(tail_r != &chunk->next);
+	assert(!chunk->IsEmpty());
+	assert(have_deleter);
+
+	MusicChunk *next = chunk->next.load(std::memory_order_acquire);
+	if (next == nullptr) {
+		/* this seems to be the last chunk; clear the "head"
+		   before detaching it from the "tail", because once
+		   the "tail" is cleared, Push() assigns a new
+		   "head" */
+		head.store(nullptr, std::memory_order_relaxed);
+
+		MusicChunk *expected = chunk;
+		if (!tail.compare_exchange_strong(expected, nullptr,
+						  std::memory_order_acq_rel,
+						  std::memory_order_acquire)) {
+			/* Push() has just replaced the "tail", but
+			   has not yet linked the new chunk; this
+			   window is only two instructions long */
+			music_pipe_counters.shift_waits.fetch_add(1, std::memory_order_relaxed);
+
+			while ((next = chunk->next.load(std::memory_order_acquire)) == nullptr)
+				std::this_thread::yield();
+
+			head.store(next, std::memory_order_release);
 		}
+	} else
+		head.store(next, std::memory_order_release);
 
-#ifndef NDEBUG
-		if (size == 0)
-			audio_format.Clear();
-#endif
-	}
+	chunk->next.store(nullptr, std::memory_order_relaxed);
 
-	return chunk;
+	[[maybe_unused]] const unsigned old_size =
+		size.fetch_sub(1, std::memory_order_release);
+	assert(old_size > 0);
+
+	return {chunk, deleter};
 }
 
 void
@@ -64,21 +79,39 @@ MusicPipe::Push(MusicChunkPtr chunk) noexcept
 {
 	assert(!chunk->IsEmpty());
 	assert(chunk->length == 0 || chunk->audio_format.IsValid());
+	assert(chunk->next.load(std::memory_order_relaxed) == nullptr);
 
-	const std::lock_guard protect{mutex};
+	if (!have_deleter) {
+		/* this is published to the consumer by the
+		   "release" operations below */
+		deleter = chunk.get_deleter();
+		have_deleter = true;
+	} else
+		assert(chunk.get_deleter() == deleter);
 
-	assert(size > 0 || !audio_format.IsDefined());
-	assert(!audio_format.IsDefined() ||
-	       chunk->CheckFormat(audio_format));
+	MusicChunk *const new_tail = chunk.release();
+
+	MusicChunk *const old_tail =
+		tail.exchange(new_tail, std::memory_order_acq_rel);
 
 #ifndef NDEBUG
-	if (!audio_format.IsDefined() && chunk->length > 0)
-		audio_format = chunk->audio_format;
+	if (old_tail == nullptr)
+		audio_format.Clear();
+
+	assert(!audio_format.IsDefined() ||
+	       new_tail->CheckFormat(audio_format));
+
+	if (!audio_format.IsDefined() && new_tail->length > 0)
+		audio_format = new_tail->audio_format;
 #endif
 
-	chunk->next.reset();
-	*tail_r = std::move(chunk);
-	tail_r = &(*tail_r)->next;
+	if (old_tail == nullptr)
+		/* the pipe was empty */
+		head.store(new_tail, std::memory_order_release);
+	else
+		old_tail->next.store(new_tail, std::memory_order_release);
+
+	size.fetch_add(1, std::memory_order_release);
 
-	++size;
+	music_pipe_counters.pushed.fetch_add(1, std::memory_order_relaxed);
 }
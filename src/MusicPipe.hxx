@@ -5,38 +5,86 @@
 #define MPD_PIPE_H
 
 #include "MusicChunkPtr.hxx"
-#include "thread/Mutex.hxx"
 
 #ifndef NDEBUG
 #include "pcm/AudioFormat.hxx"
 #endif
 
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Counters for diagnosing contention on #MusicPipe instances.
+ */
+struct MusicPipeCounters {
+	/**
+	 * The number of chunks pushed to a #MusicPipe.
+	 */
+	std::atomic_uint_least64_t pushed{0};
+
+	/**
+	 * The number of times MusicPipe::Shift() had to wait for a
+	 * concurrent MusicPipe::Push() call to link its chunk.
+	 */
+	std::atomic_uint_least64_t shift_waits{0};
+};
+
+extern MusicPipeCounters music_pipe_counters;
+
 /**
  * A queue of #MusicChunk objects.  One party appends chunks at the
  * tail, and the other consumes them from the head.
+ *
+ * This is a lock-free single-producer/single-consumer queue: Push()
+ * may be called by one thread while another thread calls Shift().
+ * Peek(), GetSize() and walking the #MusicChunk::next links are
+ * allowed from any thread, but the chunk may be removed by Shift()
+ * at any time, unless the caller has some other means of
+ * synchronization with the consumer.
  */
 class MusicPipe {
-	/** the first chunk */
-	MusicChunkPtr head;
+	/**
+	 * The first chunk.  It is modified by Shift() and by Push()
+	 * if the pipe is empty.
+	 */
+	std::atomic<MusicChunk *> head{nullptr};
 
-	/** a pointer to the tail of the chunk */
-	MusicChunkPtr *tail_r = &head;
+	/**
+	 * The last chunk.  Push() replaces it, and Shift() clears it
+	 * when it removes the last chunk.
+	 */
+	std::atomic<MusicChunk *> tail{nullptr};
 
 	/** the current number of chunks */
-	unsigned size = 0;
+	std::atomic_uint size{0};
 
-	/** a mutex which protects #head and #tail_r */
-	mutable Mutex mutex;
+	/**
+	 * The deleter of all chunks in this pipe; it is copied from
+	 * the first MusicChunkPtr passed to Push().  All chunks must
+	 * be allocated from the same #MusicBuffer.
+	 */
+	MusicChunkDeleter deleter;
+
+	bool have_deleter = false;
 
 #ifndef NDEBUG
+	/**
+	 * The audio format of the chunks pushed since the pipe was
+	 * empty.  Only accessed by the producer.
+	 */
 	AudioFormat audio_format = AudioFormat::Undefined();
 #endif
 
 public:
+	MusicPipe() noexcept = default;
+
 	~MusicPipe() noexcept {
 		Clear();
 	}
 
+	MusicPipe(const MusicPipe &) = delete;
+	MusicPipe &operator=(const MusicPipe &) = delete;
+
 #ifndef NDEBUG
 	/**
 	 * Checks if the audio format if the chunk is equal to the specified
@@ -44,7 +92,7 @@ public:
 	 */
 	[[gnu::pure]]
 	bool CheckFormat(AudioFormat other) const noexcept {
-		return !audio_format.IsDefined() ||
+		return IsEmpty() || !audio_format.IsDefined() ||
 			audio_format == other;
 	}
 
@@ -61,32 +109,39 @@ public:
 	 */
 	[[gnu::pure]]
 	const MusicChunk *Peek() const noexcept {
-		const std::lock_guard protect{mutex};
-		return head.get();
+		return head.load(std::memory_order_acquire);
 	}
 
 	/**
 	 * Removes the first chunk from the head, and returns it.
+	 *
+	 * This must only be called by the consumer.
 	 */
 	MusicChunkPtr Shift() noexcept;
 
 	/**
 	 * Clears the whole pipe and returns the chunks to the buffer.
+	 *
+	 * This may be called by the producer or by the consumer, but
+	 * only while the other one does not access the pipe.
 	 */
 	void Clear() noexcept;
 
 	/**
 	 * Pushes a chunk to the tail of the pipe.
+	 *
+	 * This must only be called by the producer.
 	 */
 	void Push(MusicChunkPtr chunk) noexcept;
 
 	/**
-	 * Returns the number of chunks currently in this pipe.
+	 * Returns the number of chunks currently in this pipe.  If
+	 * the consumer sees a non-zero value, then Shift() is
+	 * guaranteed to return a chunk.
 	 */
 	[[gnu::pure]]
 	unsigned GetSize() const noexcept {
-		const std::lock_guard protect{mutex};
-		return size;
+		return size.load(std::memory_order_acquire);
 	}
 
 	[[gnu::pure]]
@@ -5,6 +5,7 @@
 #include "pcm/AudioParser.hxx"
 #include "db/plugins/simple/Song.hxx"
 #include "song/DetachedSong.hxx"
+#include "song/Analysis.hxx"
 #include "TagSave.hxx"
 #include "lib/fmt/AudioFormatFormatter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
@@ -24,6 +25,9 @@
 #define SONG_MTIME "mtime"
 #define SONG_ADDED "added"
 #define SONG_END "song_end"
+#define SONG_ANALYSIS "Analysis"
+#define SONG_ANALYSIS_MIXRAMP_START "AnalysisMixRampStart"
+#define SONG_ANALYSIS_MIXRAMP_END "AnalysisMixRampEnd"
 
 static void
 range_save(BufferedOutputStream &os, unsigned start_ms, unsigned end_ms)
@@ -34,6 +38,45 @@ range_save(BufferedOutputStream &os, unsigned start_ms, unsigned end_ms)
 		os.Fmt("Range: {}-\n", start_ms);
 }
 
+/**
+ * Write the #SongAnalysis.  The "Analysis" line is always written,
+ * because the existence of the object is meaningful; the gain
+ * values of an undefined #ReplayGainTuple are written as-is.
+ */
+static void
+analysis_save(BufferedOutputStream &os, const SongAnalysis &analysis)
+{
+	const auto &rg = analysis.replay_gain;
+	os.Fmt(SONG_ANALYSIS ": {} {} {} {}\n",
+	       rg.track.gain, rg.track.peak,
+	       rg.album.gain, rg.album.peak);
+
+	if (const char *start = analysis.mix_ramp.GetStart())
+		os.Fmt(SONG_ANALYSIS_MIXRAMP_START ": {}\n", start);
+
+	if (const char *end = analysis.mix_ramp.GetEnd())
+		os.Fmt(SONG_ANALYSIS_MIXRAMP_END ": {}\n", end);
+}
+
+static void
+analysis_parse(SongAnalysis &analysis, const char *value)
+{
+	auto &rg = analysis.replay_gain;
+	float *const dest[] = {
+		&rg.track.gain, &rg.track.peak,
+		&rg.album.gain, &rg.album.peak,
+	};
+
+	for (float *f : dest) {
+		char *endptr;
+		*f = ParseFloat(value, &endptr);
+		if (endptr == value)
+			throw FmtRuntimeError("Malformed analysis: {:?}",
+					      value);
+		value = endptr;
+	}
+}
+
 void
 song_save(BufferedOutputStream &os, const Song &song)
 {
@@ -52,6 +95,9 @@ song_save(BufferedOutputStream &os, const Song &song)
 	if (song.in_playlist)
 		os.Write("InPlaylist: yes\n");
 
+	if (song.analysis != nullptr)
+		analysis_save(os, *song.analysis);
+
 	if (!IsNegative(song.mtime))
 		os.Fmt(SONG_MTIME ": {}\n",
 		       std::chrono::system_clock::to_time_t(song.mtime));
@@ -88,6 +134,7 @@ song_load(LineReader &file, const char *uri,
 	DetachedSong song(uri);
 
 	TagBuilder tag;
+	std::shared_ptr<SongAnalysis> analysis;
 
 	char *line;
 	while ((line = file.ReadLine()) != nullptr &&
@@ -133,11 +180,24 @@ song_load(LineReader &file, const char *uri,
 		} else if (StringIsEqual(line, "InPlaylist")) {
 			if (in_playlist_r != nullptr)
 				*in_playlist_r = StringIsEqual(value, "yes");
+		} else if (StringIsEqual(line, SONG_ANALYSIS)) {
+			if (analysis == nullptr)
+				analysis = std::make_shared<SongAnalysis>();
+			analysis_parse(*analysis, value);
+		} else if (StringIsEqual(line, SONG_ANALYSIS_MIXRAMP_START)) {
+			if (analysis == nullptr)
+				analysis = std::make_shared<SongAnalysis>();
+			analysis->mix_ramp.SetStart(value);
+		} else if (StringIsEqual(line, SONG_ANALYSIS_MIXRAMP_END)) {
+			if (analysis == nullptr)
+				analysis = std::make_shared<SongAnalysis>();
+			analysis->mix_ramp.SetEnd(value);
 		} else {
 			throw FmtRuntimeError("unknown line in db: {}", line);
 		}
 	}
 
 	song.SetTag(tag.Commit());
+	song.SetAnalysis(std::move(analysis));
 	return song;
 }
@@ -3,6 +3,8 @@
 
 #include "Stats.hxx"
 #include "player/Control.hxx"
+#include "client/Client.hxx"
+#include "client/List.hxx"
 #include "client/Response.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
@@ -10,6 +12,12 @@
 #include "db/Selection.hxx"
 #include "db/Interface.hxx"
 #include "db/Stats.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicPipe.hxx"
+#include "client/BackgroundCommandPool.hxx"
+#include "client/Threads.hxx"
+#include "memory/AudioMemory.hxx"
+#include "thread/Stats.hxx"
 #include "Log.hxx"
 #include "time/ChronoUtil.hxx"
 
@@ -95,6 +103,10 @@ db_stats_print(Response &r, const Database &db)
 	if (!IsNegative(update_stamp))
 		r.Fmt("db_update: {}\n",
 		      std::chrono::system_clock::to_time_t(update_stamp));
+
+	db.VisitStats([&r](std::string_view name, uint_least64_t value){
+		r.Fmt("{}: {}\n", name, value);
+	});
 }
 
 #endif
@@ -113,9 +125,75 @@ stats_print(Response &r, const Partition &partition)
 	      std::chrono::duration_cast<std::chrono::seconds>(uptime).count(),
 	      std::lround(partition.pc.GetTotalPlayTime().count()));
 
+	const auto &pc = music_pipe_counters;
+	const auto &bc = music_buffer_counters;
+	r.Fmt("pipe_chunks: {}\n"
+	      "pipe_shift_waits: {}\n"
+	      "buffer_chunks: {}\n"
+	      "buffer_exhausted: {}\n"
+	      "buffer_retries: {}\n",
+	      pc.pushed.load(std::memory_order_relaxed),
+	      pc.shift_waits.load(std::memory_order_relaxed),
+	      bc.allocated.load(std::memory_order_relaxed),
+	      bc.exhausted.load(std::memory_order_relaxed),
+	      bc.retries.load(std::memory_order_relaxed));
+
+	const auto &os = r.GetClient().GetOutputStats();
+	r.Fmt("output_bytes: {}\n"
+	      "output_copied: {}\n"
+	      "output_referenced: {}\n"
+	      "output_writes: {}\n",
+	      os.sent, os.copied, os.referenced, os.writes);
+
+	const auto &is = partition.instance.client_list->idle_stats;
+	r.Fmt("idle_wakeups: {}\n"
+	      "idle_coalesced: {}\n",
+	      is.wakeups, is.coalesced);
+
+	if (auto *pool = partition.instance.background_command_pool.get()) {
+		const auto ps = pool->GetStats();
+		r.Fmt("query_jobs: {}\n"
+		      "query_queue: {}\n"
+		      "query_queue_max: {}\n",
+		      ps.submitted, ps.queued, ps.max_queued);
+	}
+
 #ifdef ENABLE_DATABASE
 	const Database *db = partition.instance.GetDatabase();
 	if (db != nullptr)
 		db_stats_print(r, *db);
 #endif
 }
+
+void
+thread_stats_print(Response &r)
+{
+	const auto &amc = audio_memory_counters;
+	r.Fmt("audio_memory_locked: {}\n"
+	      "audio_memory_lock_failures: {}\n",
+	      amc.locked.load(std::memory_order_relaxed),
+	      amc.lock_failures.load(std::memory_order_relaxed));
+
+	ThreadStats::ForEach([&r](const ThreadStats &ts){
+		r.Fmt("thread: {}\n"
+		      "minor_faults: {}\n"
+		      "major_faults: {}\n",
+		      ts.GetName(),
+		      ts.GetMinorFaults(),
+		      ts.GetMajorFaults());
+	});
+
+	if (const auto *ct = r.GetClient().GetInstance().client_threads.get()) {
+		unsigned i = 0;
+		for (const auto &s : ct->GetStats())
+			r.Fmt("thread: client:{}\n"
+			      "connections: {}\n"
+			      "wakeups: {}\n"
+			      "bytes_in: {}\n"
+			      "bytes_out: {}\n"
+			      "cpu_time_ms: {}\n",
+			      i++, s.connections, s.wakeups,
+			      s.bytes_in, s.bytes_out,
+			      std::chrono::duration_cast<std::chrono::milliseconds>(s.cpu_time).count());
+	}
+}
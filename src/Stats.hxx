@@ -13,4 +13,12 @@ stats_invalidate();
 void
 stats_print(Response &r, const Partition &partition);
 
+/**
+ * Print the state of the "mlock_audio_memory" feature and the page
+ * fault counters of all threads which are registered in
+ * #ThreadStats.
+ */
+void
+thread_stats_print(Response &r);
+
 #endif
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "BackgroundCommandPool.hxx"
+#include "thread/Name.hxx"
+
+#include <algorithm>
+#include <cassert>
+
+BackgroundCommandPool::BackgroundCommandPool(unsigned n_threads)
+{
+	assert(n_threads > 0);
+
+	try {
+		for (unsigned i = 0; i < n_threads; ++i)
+			threads.emplace_front(BIND_THIS_METHOD(Run)).Start();
+	} catch (...) {
+		/* stop the threads which were already started */
+		Stop();
+		throw;
+	}
+}
+
+BackgroundCommandPool::~BackgroundCommandPool() noexcept
+{
+	Stop();
+}
+
+void
+BackgroundCommandPool::Stop() noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		quit = true;
+	}
+
+	cond.notify_all();
+
+	for (auto &thread : threads)
+		if (thread.IsDefined())
+			thread.Join();
+
+	threads.clear();
+}
+
+BackgroundCommandPool::Stats
+BackgroundCommandPool::GetStats() noexcept
+{
+	const std::scoped_lock lock{mutex};
+	return {queue.size(), max_queued, n_submitted};
+}
+
+void
+BackgroundCommandPool::Submit(Job &job) noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		assert(!quit);
+		assert(job.state == Job::State::NONE);
+
+		job.state = Job::State::QUEUED;
+		queue.push_back(job);
+
+		max_queued = std::max(max_queued, queue.size());
+		++n_submitted;
+	}
+
+	cond.notify_one();
+}
+
+void
+BackgroundCommandPool::Cancel(Job &job) noexcept
+{
+	std::unique_lock lock{mutex};
+
+	switch (job.state) {
+	case Job::State::NONE:
+	case Job::State::DONE:
+		break;
+
+	case Job::State::QUEUED:
+		queue.erase(queue.iterator_to(job));
+		job.state = Job::State::NONE;
+		break;
+
+	case Job::State::RUNNING:
+		done_cond.wait(lock, [&job]{
+			return job.state == Job::State::DONE;
+		});
+		break;
+	}
+}
+
+inline void
+BackgroundCommandPool::Run() noexcept
+{
+	SetThreadName("query");
+
+	std::unique_lock lock{mutex};
+
+	while (true) {
+		if (queue.empty()) {
+			if (quit)
+				break;
+
+			cond.wait(lock);
+			continue;
+		}
+
+		auto &job = queue.pop_front();
+		job.state = Job::State::RUNNING;
+
+		lock.unlock();
+		job.Execute();
+		lock.lock();
+
+		job.state = Job::State::DONE;
+
+		/* notify the job while holding the lock; after that,
+		   it may be deleted at any time, and this thread must
+		   not touch it anymore */
+		job.OnExecuted();
+
+		done_cond.notify_all();
+	}
+}
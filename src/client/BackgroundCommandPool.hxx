@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <cstdint>
+#include <forward_list>
+
+/**
+ * A fixed number of worker threads which execute
+ * #PoolBackgroundCommand instances, e.g. large database queries
+ * which would otherwise block the main loop.
+ */
+class BackgroundCommandPool final {
+public:
+	/**
+	 * A job which can be executed by the pool.  This is the
+	 * base class of #PoolBackgroundCommand.
+	 */
+	class Job : public IntrusiveListHook<> {
+		friend class BackgroundCommandPool;
+
+		/**
+		 * Protected by BackgroundCommandPool::mutex.
+		 */
+		enum class State : uint_least8_t {
+			NONE,
+			QUEUED,
+			RUNNING,
+			DONE,
+		} state = State::NONE;
+
+	protected:
+		/**
+		 * Called by the pool in a worker thread.
+		 */
+		virtual void Execute() noexcept = 0;
+
+		/**
+		 * Called by the worker thread after Execute() has
+		 * returned, while holding the pool's mutex.  After
+		 * that, the pool does not touch this object anymore,
+		 * and it may be deleted at any time.  This must not
+		 * block.
+		 */
+		virtual void OnExecuted() noexcept = 0;
+	};
+
+private:
+	Mutex mutex;
+
+	/**
+	 * Signalled when a command was submitted or when the pool
+	 * shall quit.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled when a command has finished execution.
+	 */
+	Cond done_cond;
+
+	IntrusiveList<Job, IntrusiveListBaseHookTraits<Job>,
+		      IntrusiveListOptions{.constant_time_size = true}> queue;
+
+	/**
+	 * The highest number of commands which were waiting in the
+	 * #queue at the same time.
+	 */
+	std::size_t max_queued = 0;
+
+	/**
+	 * The total number of commands which were submitted.
+	 */
+	uint_least64_t n_submitted = 0;
+
+	bool quit = false;
+
+	std::forward_list<Thread> threads;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param n_threads the number of worker threads to be
+	 * started
+	 */
+	explicit BackgroundCommandPool(unsigned n_threads);
+
+	~BackgroundCommandPool() noexcept;
+
+	BackgroundCommandPool(const BackgroundCommandPool &) = delete;
+	BackgroundCommandPool &operator=(const BackgroundCommandPool &) = delete;
+
+	struct Stats {
+		/**
+		 * The number of commands waiting for a thread.
+		 */
+		std::size_t queued;
+
+		/**
+		 * See #max_queued.
+		 */
+		std::size_t max_queued;
+
+		/**
+		 * See #n_submitted.
+		 */
+		uint_least64_t submitted;
+	};
+
+	Stats GetStats() noexcept;
+
+	/**
+	 * Enqueue a job.  When it has finished, its OnExecuted()
+	 * method will be called in the worker thread.
+	 */
+	void Submit(Job &job) noexcept;
+
+	/**
+	 * Remove the job from the queue; if a worker thread is
+	 * currently executing it, wait until it has finished.
+	 */
+	void Cancel(Job &job) noexcept;
+
+private:
+	void Stop() noexcept;
+
+	void Run() noexcept;
+};
@@ -11,8 +11,8 @@
 
 Client::~Client() noexcept
 {
-	if (FullyBufferedSocket::IsDefined())
-		FullyBufferedSocket::Close();
+	if (socket->IsDefined())
+		socket->Close();
 
 	if (background_command) {
 		background_command->Cancel();
@@ -41,7 +41,7 @@ Client::OnBackgroundCommandFinished() noexcept
 
 	/* just in case OnSocketInput() has returned
 	   InputResult::PAUSE meanwhile */
-	ResumeInput();
+	socket->ResumeInput();
 
 	timeout_event.Schedule(client_timeout);
 }
@@ -6,14 +6,15 @@
 #include "IClient.hxx"
 #include "Message.hxx"
 #include "ProtocolFeature.hxx"
+#include "Socket.hxx"
 #include "client/StringNormalization.hxx"
 #include "command/CommandResult.hxx"
 #include "command/CommandListBuilder.hxx"
 #include "db/Features.hxx" // for ENABLE_DATABASE
 #include "input/LastInputStream.hxx"
 #include "tag/Mask.hxx"
-#include "event/FullyBufferedSocket.hxx"
 #include "event/CoarseTimerEvent.hxx"
+#include "event/FineTimerEvent.hxx"
 #include "util/IntrusiveList.hxx"
 
 #include <cstddef>
@@ -36,7 +37,7 @@ class Storage;
 class BackgroundCommand;
 
 class Client final
-	: public IClient, FullyBufferedSocket
+	: public IClient, ClientSocketHandler
 {
 	friend struct ClientPerPartitionListHook;
 	friend class ClientList;
@@ -45,8 +46,21 @@ class Client final
 
 	IntrusiveListHook<> list_siblings, partition_siblings;
 
+	/**
+	 * The connection; it is never nullptr.  After it has been
+	 * closed, this object remains until it gets deleted by
+	 * OnTimeout().
+	 */
+	const std::unique_ptr<ClientSocket> socket;
+
 	CoarseTimerEvent timeout_event;
 
+	/**
+	 * Delays the "idle" response by #idle_debounce to collect
+	 * more events.
+	 */
+	FineTimerEvent idle_debounce_event;
+
 	Partition *partition;
 
 	unsigned permission;
@@ -59,6 +73,12 @@ class Client final
 	/** is this client waiting for an "idle" response? */
 	bool idle_waiting = false;
 
+	/**
+	 * Is a command list being executed?  Commands cannot be
+	 * deferred to a #BackgroundCommand meanwhile.
+	 */
+	bool in_command_list = false;
+
 	/** idle flags pending on this client, to be sent as soon as
 	    the client enters "idle" */
 	unsigned idle_flags = 0;
@@ -66,6 +86,12 @@ class Client final
 	/** idle flags that the client wants to receive */
 	unsigned idle_subscriptions;
 
+	/**
+	 * The "debounce" duration of the current "idle" command; zero
+	 * means the response is sent immediately.
+	 */
+	Event::Duration idle_debounce{};
+
 public:
 	// TODO: make this attribute "private"
 	/**
@@ -133,12 +159,25 @@ public:
 
 	~Client() noexcept;
 
-	using FullyBufferedSocket::GetEventLoop;
-	using FullyBufferedSocket::GetOutputMaxSize;
+	/**
+	 * Returns the main #EventLoop, even if the socket is handled
+	 * by a client I/O thread.
+	 */
+	auto &GetEventLoop() const noexcept {
+		return timeout_event.GetEventLoop();
+	}
+
+	std::size_t GetOutputMaxSize() const noexcept {
+		return socket->GetOutputMaxSize();
+	}
+
+	ClientSocket::OutputStats GetOutputStats() const noexcept {
+		return socket->GetOutputStats();
+	}
 
 	[[gnu::pure]]
 	bool IsExpired() const noexcept {
-		return !FullyBufferedSocket::IsDefined();
+		return !socket->IsDefined();
 	}
 
 	void Close() noexcept;
@@ -157,6 +196,15 @@ public:
 		return Write("OK\n");
 	}
 
+	bool VFmt(fmt::string_view format_str, fmt::format_args args) noexcept;
+
+	/**
+	 * Send a block of memory without copying it to the output
+	 * buffer; the #owner keeps it alive until it has been sent.
+	 */
+	bool WriteReference(std::span<const std::byte> data,
+			    std::shared_ptr<const void> owner) noexcept;
+
 	/**
 	 * Is this client running on the same machine, connected with
 	 * a local (UNIX domain) socket?
@@ -224,7 +272,32 @@ public:
 	 */
 	void IdleNotify() noexcept;
 	void IdleAdd(unsigned flags) noexcept;
-	bool IdleWait(unsigned flags) noexcept;
+
+	/**
+	 * Enter "idle" mode.
+	 *
+	 * @param debounce if positive, then the response is delayed
+	 * by this duration after the first event, and all events
+	 * which occur meanwhile are reported in the same response
+	 * @return true if the response was sent immediately
+	 */
+	bool IdleWait(unsigned flags,
+		      Event::Duration debounce=Event::Duration::zero()) noexcept;
+
+	/**
+	 * Handle the "noidle" command: leave "idle" mode, reporting
+	 * the events which were held back by "debounce".
+	 */
+	void IdleCancel() noexcept;
+
+	/**
+	 * May the current command be deferred to a
+	 * #BackgroundCommand?  This is not possible inside a command
+	 * list, because the remaining commands would be discarded.
+	 */
+	bool CanRunInBackground() const noexcept {
+		return !in_command_list;
+	}
 
 	/**
 	 * Called by a command handler to defer execution to a
@@ -309,13 +382,16 @@ private:
 
 	CommandResult ProcessLine(char *line) noexcept;
 
-	/* virtual methods from class BufferedSocket */
+	/* virtual methods from class ClientSocketHandler */
 	InputResult OnSocketInput(std::span<std::byte> src) noexcept override;
 	void OnSocketError(std::exception_ptr ep) noexcept override;
 	void OnSocketClosed() noexcept override;
 
 	/* callback for TimerEvent */
 	void OnTimeout() noexcept;
+
+	/* callback for #idle_debounce_event */
+	void OnIdleDebounce() noexcept;
 };
 
 struct ClientPerPartitionListHook
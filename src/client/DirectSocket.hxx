@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Socket.hxx"
+
+/**
+ * A #ClientSocket which is handled by the main thread.
+ */
+class DirectClientSocket final : public ClientSocket, FullyBufferedSocket {
+	ClientSocketHandler &handler;
+
+public:
+	DirectClientSocket(SocketDescriptor _fd, EventLoop &_loop,
+			   std::size_t normal_size, std::size_t peak_size,
+			   ClientSocketHandler &_handler) noexcept
+		:FullyBufferedSocket(_fd, _loop, normal_size, peak_size),
+		 handler(_handler) {}
+
+	~DirectClientSocket() noexcept override {
+		if (FullyBufferedSocket::IsDefined())
+			FullyBufferedSocket::Close();
+	}
+
+	/* virtual methods from class ClientSocket */
+	bool IsDefined() const noexcept override {
+		return FullyBufferedSocket::IsDefined();
+	}
+
+	void Close() noexcept override {
+		FullyBufferedSocket::Close();
+	}
+
+	std::size_t GetOutputMaxSize() const noexcept override {
+		return FullyBufferedSocket::GetOutputMaxSize();
+	}
+
+	ClientSocket::OutputStats GetOutputStats() const noexcept override {
+		return FullyBufferedSocket::GetOutputStats();
+	}
+
+	bool Write(const void *data, std::size_t length) noexcept override {
+		return FullyBufferedSocket::Write(data, length);
+	}
+
+	bool VFmt(fmt::string_view format_str,
+		  fmt::format_args args) noexcept override {
+		return FullyBufferedSocket::VFmt(format_str, args);
+	}
+
+	bool WriteReference(std::span<const std::byte> data,
+			    std::shared_ptr<const void> owner) noexcept override {
+		return FullyBufferedSocket::WriteReference(data,
+							   std::move(owner));
+	}
+
+	bool Flush() noexcept override {
+		return FullyBufferedSocket::Flush();
+	}
+
+	void ConsumeInput(std::size_t nbytes) noexcept override {
+		FullyBufferedSocket::ConsumeInput(nbytes);
+	}
+
+	bool ResumeInput() noexcept override {
+		return FullyBufferedSocket::ResumeInput();
+	}
+
+private:
+	/* virtual methods from class BufferedSocket */
+	InputResult OnSocketInput(std::span<std::byte> src) noexcept override {
+		return handler.OnSocketInput(src);
+	}
+
+	void OnSocketError(std::exception_ptr ep) noexcept override {
+		handler.OnSocketError(std::move(ep));
+	}
+
+	void OnSocketClosed() noexcept override {
+		handler.OnSocketClosed();
+	}
+};
@@ -17,7 +17,8 @@ Client::SetExpired() noexcept
 		background_command.reset();
 	}
 
-	FullyBufferedSocket::Close();
+	socket->Close();
+	idle_debounce_event.Cancel();
 	timeout_event.Schedule(Event::Duration::zero());
 }
 
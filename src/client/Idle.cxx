@@ -3,7 +3,10 @@
 
 #include "Client.hxx"
 #include "Config.hxx"
+#include "List.hxx"
 #include "Response.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
 #include "protocol/IdleFlags.hxx"
 
 #include <fmt/format.h>
@@ -32,6 +35,9 @@ Client::IdleNotify() noexcept
 	assert(flags != 0);
 
 	idle_waiting = false;
+	idle_debounce_event.Cancel();
+
+	++partition->instance.client_list->idle_stats.wakeups;
 
 	Response r(*this, 0);
 	WriteIdleResponse(r, flags);
@@ -46,24 +52,69 @@ Client::IdleAdd(unsigned flags) noexcept
 		return;
 
 	idle_flags |= flags;
-	if (idle_waiting && (idle_flags & idle_subscriptions))
+	if (!idle_waiting || (flags & idle_subscriptions) == 0)
+		/* if there were subscribed events already, a
+		   response has been sent or scheduled already */
+		return;
+
+	if (idle_debounce <= Event::Duration::zero()) {
 		IdleNotify();
+	} else if (idle_debounce_event.IsPending()) {
+		/* a response is already scheduled; it will include
+		   this event */
+		++partition->instance.client_list->idle_stats.coalesced;
+	} else {
+		idle_debounce_event.Schedule(idle_debounce);
+	}
 }
 
 bool
-Client::IdleWait(unsigned flags) noexcept
+Client::IdleWait(unsigned flags, Event::Duration debounce) noexcept
 {
 	assert(!idle_waiting);
+	assert(!idle_debounce_event.IsPending());
 
 	idle_waiting = true;
 	idle_subscriptions = flags;
+	idle_debounce = debounce;
 
-	if (idle_flags & idle_subscriptions) {
+	if ((idle_flags & idle_subscriptions) &&
+	    debounce <= Event::Duration::zero()) {
 		IdleNotify();
 		return true;
-	} else {
-		/* disable timeouts while in "idle" */
-		timeout_event.Cancel();
-		return false;
 	}
+
+	/* disable timeouts while in "idle" */
+	timeout_event.Cancel();
+
+	if (idle_flags & idle_subscriptions)
+		/* events have occurred already; collect more of
+		   them before responding */
+		idle_debounce_event.Schedule(debounce);
+
+	return false;
+}
+
+void
+Client::IdleCancel() noexcept
+{
+	assert(idle_waiting);
+
+	if (idle_debounce_event.IsPending()) {
+		/* report the events which were held back */
+		IdleNotify();
+		return;
+	}
+
+	/* send empty idle response and leave idle mode */
+	idle_waiting = false;
+	WriteOK();
+}
+
+void
+Client::OnIdleDebounce() noexcept
+{
+	assert(idle_waiting);
+
+	IdleNotify();
 }
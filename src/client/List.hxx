@@ -6,6 +6,8 @@
 #include "Client.hxx"
 #include "util/IntrusiveList.hxx"
 
+#include <cstdint>
+
 class ClientList {
 	using List = IntrusiveList<
 		Client,
@@ -17,6 +19,24 @@ class ClientList {
 	List list;
 
 public:
+	struct IdleStats {
+		/**
+		 * The number of "idle" responses which were sent.
+		 */
+		uint_least64_t wakeups = 0;
+
+		/**
+		 * The number of events which were merged into a
+		 * pending "idle" response delayed by "debounce".
+		 */
+		uint_least64_t coalesced = 0;
+	};
+
+	/**
+	 * Only accessed in the main thread.
+	 */
+	IdleStats idle_stats;
+
 	explicit ClientList(unsigned _max_size) noexcept
 		:max_size(_max_size) {}
 
@@ -5,6 +5,8 @@
 #include "Config.hxx"
 #include "Domain.hxx"
 #include "List.hxx"
+#include "DirectSocket.hxx"
+#include "Threads.hxx"
 #include "BackgroundCommand.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
@@ -25,14 +27,32 @@ using std::string_view_literals::operator""sv;
 
 static constexpr auto GREETING = "OK MPD " PROTOCOL_VERSION "\n"sv;
 
+static std::unique_ptr<ClientSocket>
+MakeSocket(EventLoop &loop, Instance &instance, UniqueSocketDescriptor fd,
+	   ClientSocketHandler &handler) noexcept
+{
+	static constexpr std::size_t normal_size = 16384;
+
+	if (instance.client_threads)
+		return instance.client_threads->Connect(std::move(fd),
+							normal_size,
+							client_max_output_buffer_size,
+							handler);
+
+	return std::make_unique<DirectClientSocket>(fd.Release(), loop,
+						    normal_size,
+						    client_max_output_buffer_size,
+						    handler);
+}
+
 Client::Client(EventLoop &_loop, Partition &_partition,
 	       UniqueSocketDescriptor _fd,
 	       int _uid, unsigned _permission,
 	       std::string &&_name) noexcept
-	:FullyBufferedSocket(_fd.Release(), _loop,
-			     16384, client_max_output_buffer_size),
-	 name(std::move(_name)),
+	:name(std::move(_name)),
+	 socket(MakeSocket(_loop, _partition.instance, std::move(_fd), *this)),
 	 timeout_event(_loop, BIND_THIS_METHOD(OnTimeout)),
+	 idle_debounce_event(_loop, BIND_THIS_METHOD(OnIdleDebounce)),
 	 partition(&_partition),
 	 permission(_permission),
 	 uid(_uid),
@@ -89,9 +109,14 @@ Client::Close() noexcept
 	partition->instance.client_list->Remove(*this);
 	partition->clients.erase(partition->clients.iterator_to(*this));
 
-	if (FullyBufferedSocket::IsDefined())
-		FullyBufferedSocket::Close();
+	if (socket->IsDefined())
+		socket->Close();
 
 	FmtInfo(client_domain, "[{}] disconnected", name);
+
+	const auto &os = GetOutputStats();
+	FmtDebug(client_domain,
+		 "[{}] sent {} bytes in {} writes ({} copied, {} referenced)",
+		 name, os.sent, os.writes, os.copied, os.referenced);
 	delete this;
 }
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "PoolBackgroundCommand.hxx"
+#include "BackgroundCommandPool.hxx"
+#include "Client.hxx"
+#include "Config.hxx"
+#include "command/CommandError.hxx"
+#include "util/SpanCast.hxx"
+
+#include <cassert>
+#include <stdexcept>
+
+PoolBackgroundCommand::PoolBackgroundCommand(BackgroundCommandPool &_pool,
+					     Client &_client,
+					     const Response &r) noexcept
+	:pool(_pool),
+	 defer_output(_client.GetEventLoop(), BIND_THIS_METHOD(DeferredOutput)),
+	 defer_finish(_client.GetEventLoop(), BIND_THIS_METHOD(DeferredFinish)),
+	 client(_client), command(r.GetCommand()),
+	 stream(std::make_shared<ResponseStream>(MAX_PENDING, client_timeout))
+{
+}
+
+PoolBackgroundCommand::~PoolBackgroundCommand() noexcept = default;
+
+void
+PoolBackgroundCommand::Start() noexcept
+{
+	pool.Submit(*this);
+}
+
+void
+PoolBackgroundCommand::Execute() noexcept
+{
+	assert(!error);
+	assert(data.empty());
+
+	Response r(client, *this);
+
+	try {
+		Run(r);
+	} catch (...) {
+		error = std::current_exception();
+	}
+}
+
+void
+PoolBackgroundCommand::OnExecuted() noexcept
+{
+	defer_finish.Schedule();
+}
+
+void
+PoolBackgroundCommand::Flush()
+{
+	if (stream->IsCancelled())
+		throw std::runtime_error("Cancelled");
+
+	if (data.size() < BLOCK_SIZE)
+		return;
+
+	const bool must_wait = stream->Push(std::move(data));
+	data.clear();
+
+	defer_output.Schedule();
+
+	if (must_wait)
+		stream->Wait();
+}
+
+bool
+PoolBackgroundCommand::SendBlocks() noexcept
+{
+	for (auto &block : stream->TakeBlocks()) {
+		const auto b = block->GetData();
+		if (!client.WriteReference(b, std::move(block)))
+			/* the client has failed and has deleted this
+			   object */
+			return false;
+	}
+
+	return true;
+}
+
+void
+PoolBackgroundCommand::DeferredOutput() noexcept
+{
+	SendBlocks();
+}
+
+void
+PoolBackgroundCommand::DeferredFinish() noexcept
+{
+	if (!error) {
+		try {
+			Finish();
+		} catch (...) {
+			error = std::current_exception();
+		}
+	}
+
+	/* send the blocks which were submitted before the command
+	   finished; DeferredOutput() may not have run yet */
+	if (!SendBlocks())
+		return;
+
+	/* move everything to the stack, because a write error
+	   makes the Client cancel and delete this object */
+	Client &c = client;
+	const auto e = std::move(error);
+
+	/* the output is sent directly from this string, without
+	   copying it to the client's output buffer */
+	const auto o = std::make_shared<const std::string>(std::move(data));
+
+	/* send the response */
+	Response response(c, 0);
+	response.SetCommand(command);
+
+	if (e) {
+		PrintError(response, e);
+	} else if (c.WriteReference(AsBytes(*o), o)) {
+		c.WriteOK();
+	}
+
+	/* delete this object */
+	if (!c.IsExpired())
+		c.OnBackgroundCommandFinished();
+}
+
+void
+PoolBackgroundCommand::Cancel() noexcept
+{
+	/* wake up the worker thread if it waits in Flush() */
+	stream->Cancel();
+
+	pool.Cancel(*this);
+
+	/* cancel the InjectEvents, just in case the command has
+	   meanwhile finished execution */
+	defer_output.Cancel();
+	defer_finish.Cancel();
+}
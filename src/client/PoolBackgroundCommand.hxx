@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "BackgroundCommand.hxx"
+#include "BackgroundCommandPool.hxx"
+#include "ResponseStream.hxx"
+#include "Response.hxx"
+#include "event/InjectEvent.hxx"
+
+#include <exception>
+#include <memory>
+#include <string>
+
+class Client;
+
+/**
+ * A #BackgroundCommand which is executed by a
+ * #BackgroundCommandPool thread.  Unlike #ThreadBackgroundCommand,
+ * the response is generated in the worker thread (into a buffer).
+ *
+ * Large responses are streamed: each time Response::Flush() is
+ * called and the buffer is large enough, it is passed to the client
+ * as a block; the worker thread waits while the client has too many
+ * unsent blocks, which bounds the memory used by the response.  The
+ * rest is sent when the command has finished.
+ *
+ * While waiting, the worker thread releases the database lock; if
+ * the database gets modified meanwhile, the command fails.
+ */
+class PoolBackgroundCommand
+	: public BackgroundCommand, BackgroundCommandPool::Job, ResponseBuffer
+{
+	/**
+	 * Response::Flush() passes the buffer to the client only if
+	 * it is at least this large.
+	 */
+	static constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+
+	/**
+	 * The worker thread waits while more than this number of
+	 * bytes were passed to the client, but not yet sent.
+	 */
+	static constexpr std::size_t MAX_PENDING = 4 * BLOCK_SIZE;
+
+	BackgroundCommandPool &pool;
+
+	InjectEvent defer_output, defer_finish;
+
+	Client &client;
+
+	/**
+	 * The name of the command; used to generate error messages.
+	 */
+	const char *const command;
+
+	/**
+	 * Shared between the worker thread, the main thread and the
+	 * blocks which were passed to the client (which may outlive
+	 * this object).
+	 */
+	const std::shared_ptr<ResponseStream> stream;
+
+	/**
+	 * The error thrown by Run() or Finish().
+	 */
+	std::exception_ptr error;
+
+public:
+	/**
+	 * @param r the #Response of the command handler; its command
+	 * name is copied for error messages
+	 */
+	PoolBackgroundCommand(BackgroundCommandPool &_pool,
+			      Client &_client, const Response &r) noexcept;
+
+	~PoolBackgroundCommand() noexcept override;
+
+	/**
+	 * Submit this command to the pool.
+	 */
+	void Start() noexcept;
+
+	void Cancel() noexcept final;
+
+private:
+	/**
+	 * Pass all blocks submitted by Flush() to the client.
+	 *
+	 * @return false if the client has failed (and this object
+	 * has been deleted)
+	 */
+	bool SendBlocks() noexcept;
+
+	void DeferredOutput() noexcept;
+	void DeferredFinish() noexcept;
+
+	/* virtual methods from class BackgroundCommandPool::Job */
+	void Execute() noexcept override;
+	void OnExecuted() noexcept override;
+
+	/* virtual methods from class ResponseBuffer */
+	void Flush() override;
+
+protected:
+	Client &GetClient() const noexcept {
+		return client;
+	}
+
+	/**
+	 * Execute the command.  This runs in a worker thread and
+	 * must not modify any state which is owned by the main
+	 * thread.  Its #Response collects the output in a buffer.
+	 *
+	 * If this method throws, the exception will be converted
+	 * to a MPD response.
+	 */
+	virtual void Run(Response &r) = 0;
+
+	/**
+	 * Called in the client's #EventLoop thread after Run() has
+	 * succeeded, before the response gets sent.  This may be
+	 * used to apply the result, e.g. to modify the queue.
+	 *
+	 * Throws on error.
+	 */
+	virtual void Finish() {}
+};
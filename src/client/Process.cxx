@@ -6,6 +6,7 @@
 #include "Domain.hxx"
 #include "command/AllCommands.hxx"
 #include "Log.hxx"
+#include "util/ScopeExit.hxx"
 #include "util/StringAPI.hxx"
 #include "util/CharUtil.hxx"
 
@@ -19,6 +20,9 @@ Client::ProcessCommandList(bool list_ok,
 {
 	unsigned n = 0;
 
+	in_command_list = true;
+	AtScopeExit(this) { in_command_list = false; };
+
 	for (auto &&i : list) {
 		char *cmd = &*i.begin();
 
@@ -66,11 +70,8 @@ Client::ProcessLine(char *line) noexcept
 	}
 
 	if (StringIsEqual(line, "noidle")) {
-		if (idle_waiting) {
-			/* send empty idle response and leave idle mode */
-			idle_waiting = false;
-			WriteOK();
-		}
+		if (idle_waiting)
+			IdleCancel();
 
 		/* do nothing if the client wasn't idling: the client
 		   has already received the full idle response from
@@ -9,7 +9,7 @@
 
 #include <cstring>
 
-BufferedSocket::InputResult
+Client::InputResult
 Client::OnSocketInput(std::span<std::byte> src) noexcept
 {
 	if (background_command)
@@ -22,7 +22,7 @@ Client::OnSocketInput(std::span<std::byte> src) noexcept
 
 	timeout_event.Schedule(client_timeout);
 
-	BufferedSocket::ConsumeInput(newline + 1 - p);
+	socket->ConsumeInput(newline + 1 - p);
 
 	/* skip whitespace at the end of the line */
 	char *end = StripRight(p, newline);
@@ -44,7 +44,7 @@ Client::OnSocketInput(std::span<std::byte> src) noexcept
 		return InputResult::CLOSED;
 
 	case CommandResult::FINISH:
-		if (Flush())
+		if (socket->Flush())
 			Close();
 		return InputResult::CLOSED;
 
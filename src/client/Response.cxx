@@ -6,6 +6,8 @@
 
 #include <fmt/format.h>
 
+#include <cstring>
+
 TagMask
 Response::GetTagMask() const noexcept
 {
@@ -15,21 +17,39 @@ Response::GetTagMask() const noexcept
 bool
 Response::Write(const void *data, size_t length) noexcept
 {
+	if (buffer != nullptr) {
+		/* allow exceeding the limit once, so the client's
+		   Write() call fails and reports the overflow when
+		   this buffer gets sent */
+		if (buffer->data.size() > client.GetOutputMaxSize())
+			return false;
+
+		buffer->data.append((const char *)data, length);
+		return true;
+	}
+
 	return client.Write(data, length);
 }
 
 bool
 Response::Write(const char *data) noexcept
 {
-	return client.Write(data);
+	return Write(data, std::strlen(data));
 }
 
 bool
 Response::VFmt(fmt::string_view format_str, fmt::format_args args) noexcept
 {
-	fmt::memory_buffer buffer;
-	fmt::vformat_to(std::back_inserter(buffer), format_str, args);
-	return Write(buffer.data(), buffer.size());
+	if (buffer != nullptr) {
+		if (buffer->data.size() > client.GetOutputMaxSize())
+			return false;
+
+		fmt::vformat_to(std::back_inserter(buffer->data),
+				format_str, args);
+		return true;
+	}
+
+	return client.VFmt(format_str, args);
 }
 
 bool
@@ -43,6 +63,21 @@ Response::WriteBinary(std::span<const std::byte> payload) noexcept
 		Write("\n");
 }
 
+bool
+Response::WriteBinary(std::span<const std::byte> payload,
+		      std::shared_ptr<const void> owner) noexcept
+{
+	if (buffer != nullptr)
+		return WriteBinary(payload);
+
+	assert(payload.size() <= client.binary_limit);
+
+	return
+		Fmt("binary: {}\n", payload.size()) &&
+		client.WriteReference(payload, std::move(owner)) &&
+		Write("\n");
+}
+
 void
 Response::Error(enum ack code, const char *msg) noexcept
 {
@@ -8,11 +8,34 @@
 #include <fmt/core.h>
 
 #include <cstddef>
+#include <memory>
 #include <span>
+#include <string>
 
 class Client;
 class TagMask;
 
+/**
+ * Collects the response of a command which is executed in another
+ * thread (see #PoolBackgroundCommand).
+ */
+class ResponseBuffer {
+public:
+	std::string data;
+
+	/**
+	 * Called by Response::Flush().  An implementation may pass
+	 * #data to the client and block until the client has
+	 * received it.
+	 *
+	 * Throws if the command shall be aborted.
+	 */
+	virtual void Flush() {}
+
+protected:
+	~ResponseBuffer() noexcept = default;
+};
+
 class Response {
 	Client &client;
 
@@ -27,10 +50,27 @@ class Response {
 	 */
 	const char *command = "";
 
+	/**
+	 * If not nullptr, then the response is collected in this
+	 * buffer instead of being written to the client.  This
+	 * allows generating a response in another thread (see
+	 * #PoolBackgroundCommand).
+	 */
+	ResponseBuffer *const buffer = nullptr;
+
 public:
 	Response(Client &_client, unsigned _list_index) noexcept
 		:client(_client), list_index(_list_index) {}
 
+	/**
+	 * Construct a #Response which writes to the given buffer.
+	 * Unless Flush() empties it, the buffer is limited to the
+	 * client's maximum output buffer size; if that is exceeded,
+	 * Write() fails.
+	 */
+	Response(Client &_client, ResponseBuffer &_buffer) noexcept
+		:client(_client), list_index(0), buffer(&_buffer) {}
+
 	Response(const Response &) = delete;
 	Response &operator=(const Response &) = delete;
 
@@ -55,9 +95,29 @@ public:
 		command = _command;
 	}
 
+	const char *GetCommand() const noexcept {
+		return command;
+	}
+
 	bool Write(const void *data, size_t length) noexcept;
 	bool Write(const char *data) noexcept;
 
+	/**
+	 * Called between two items of a response which may be large
+	 * (e.g. after each song).  If the response is generated in
+	 * another thread, this passes the data generated so far to
+	 * the client, waiting until the client has received enough
+	 * of it; this keeps the memory usage of large responses
+	 * bounded.
+	 *
+	 * Throws if the command shall be aborted (e.g. because the
+	 * client has disconnected).
+	 */
+	void Flush() {
+		if (buffer != nullptr)
+			buffer->Flush();
+	}
+
 	bool VFmt(fmt::string_view format_str, fmt::format_args args) noexcept;
 
 	template<typename S, typename... Args>
@@ -74,6 +134,14 @@ public:
 	 */
 	bool WriteBinary(std::span<const std::byte> payload) noexcept;
 
+	/**
+	 * Like WriteBinary(std::span), but the payload is sent
+	 * without copying it to the output buffer (if it is large
+	 * enough); the #owner keeps it alive until then.
+	 */
+	bool WriteBinary(std::span<const std::byte> payload,
+			 std::shared_ptr<const void> owner) noexcept;
+
 	void Error(enum ack code, const char *msg) noexcept;
 
 	void VFmtError(enum ack code,
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ResponseStream.hxx"
+#include "db/DatabaseLock.hxx"
+
+#include <cassert>
+#include <stdexcept>
+
+ResponseStream::Block::~Block() noexcept
+{
+	{
+		const std::scoped_lock lock{stream->mutex};
+		assert(stream->pending >= data.size());
+		stream->pending -= data.size();
+	}
+
+	stream->cond.notify_all();
+}
+
+bool
+ResponseStream::Push(std::string &&data) noexcept
+{
+	const std::scoped_lock lock{mutex};
+	pending += data.size();
+	blocks.emplace_back(std::move(data));
+	return pending > max_pending;
+}
+
+void
+ResponseStream::WaitForClient()
+{
+	std::unique_lock lock{mutex};
+
+	/* the timeout applies to each stall: it starts over whenever
+	   the client has received something, so a client which reads
+	   slowly but steadily can receive a large response */
+	std::size_t last_pending = pending;
+	auto deadline = std::chrono::steady_clock::now() + stall_timeout;
+
+	while (!cancelled && pending > max_pending) {
+		auto now = std::chrono::steady_clock::now();
+
+		if (pending < last_pending) {
+			last_pending = pending;
+			deadline = now + stall_timeout;
+		} else if (now >= deadline)
+			throw std::runtime_error("Client is too slow");
+
+		cond.wait_for(lock, deadline - now);
+	}
+
+	if (cancelled)
+		throw std::runtime_error("Cancelled");
+}
+
+void
+ResponseStream::Wait()
+{
+	if (!holding_db_shared_lock()) {
+		WaitForClient();
+		return;
+	}
+
+	/* we were called by a database visitor; release the lock
+	   while waiting, so a slow client does not block database
+	   updates */
+	const auto generation = db_generation();
+
+	{
+		const ScopeDatabaseSharedUnlock unlock;
+		WaitForClient();
+	}
+
+	/* the visitor can only continue if the database has not been
+	   modified meanwhile */
+	if (db_generation() != generation)
+		throw std::runtime_error("Database was modified");
+}
+
+std::vector<std::shared_ptr<const ResponseStream::Block>>
+ResponseStream::TakeBlocks()
+{
+	std::vector<std::string> src;
+
+	{
+		const std::scoped_lock lock{mutex};
+		src.swap(blocks);
+	}
+
+	std::vector<std::shared_ptr<const Block>> result;
+	result.reserve(src.size());
+
+	for (auto &i : src)
+		result.emplace_back(std::make_shared<const Block>(std::move(i),
+								  shared_from_this()));
+
+	return result;
+}
+
+void
+ResponseStream::Cancel() noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		cancelled.store(true, std::memory_order_relaxed);
+	}
+
+	cond.notify_all();
+}
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "util/SpanCast.hxx"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * Flow control for a response which is generated by a worker thread
+ * and sent by the client's #EventLoop thread in blocks (see
+ * #PoolBackgroundCommand).
+ *
+ * The worker thread submits blocks with Push() and waits with Wait()
+ * while too many bytes have not yet been sent.  The #EventLoop
+ * thread obtains them with TakeBlocks() and passes them to the
+ * client by reference; each #Block wakes up the worker thread when
+ * it is destroyed, i.e. after it has been sent or when the client
+ * has been closed.
+ *
+ * Instances must be managed by std::shared_ptr, because the blocks
+ * may outlive the command.
+ */
+class ResponseStream final
+	: public std::enable_shared_from_this<ResponseStream>
+{
+	Mutex mutex;
+
+	/**
+	 * Signalled when a block has been sent or when the command
+	 * was cancelled.
+	 */
+	Cond cond;
+
+	/**
+	 * Blocks submitted by the worker thread which have not yet
+	 * been obtained by TakeBlocks().
+	 */
+	std::vector<std::string> blocks;
+
+	/**
+	 * The number of bytes submitted by the worker thread which
+	 * have not yet been sent to the client.
+	 */
+	std::size_t pending = 0;
+
+	/**
+	 * Set by the #EventLoop thread; may be read without holding
+	 * the #mutex.
+	 */
+	std::atomic_bool cancelled{false};
+
+	/**
+	 * Wait() returns when no more than this number of bytes is
+	 * pending.
+	 */
+	const std::size_t max_pending;
+
+	/**
+	 * Wait() fails if the client has not received anything for
+	 * this duration.
+	 */
+	const std::chrono::steady_clock::duration stall_timeout;
+
+public:
+	/**
+	 * A block passed to Client::WriteReference().
+	 */
+	class Block {
+		const std::string data;
+
+		const std::shared_ptr<ResponseStream> stream;
+
+	public:
+		Block(std::string &&_data,
+		      std::shared_ptr<ResponseStream> _stream) noexcept
+			:data(std::move(_data)), stream(std::move(_stream)) {}
+
+		~Block() noexcept;
+
+		Block(const Block &) = delete;
+		Block &operator=(const Block &) = delete;
+
+		std::span<const std::byte> GetData() const noexcept {
+			return AsBytes(data);
+		}
+	};
+
+	ResponseStream(std::size_t _max_pending,
+		       std::chrono::steady_clock::duration _stall_timeout) noexcept
+		:max_pending(_max_pending), stall_timeout(_stall_timeout) {}
+
+	bool IsCancelled() const noexcept {
+		return cancelled.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Submit a block (called by the worker thread).  The caller
+	 * is responsible for waking up the #EventLoop thread, which
+	 * shall then call TakeBlocks().
+	 *
+	 * @return true if the caller shall call Wait() now
+	 */
+	bool Push(std::string &&data) noexcept;
+
+	/**
+	 * Wait until no more than the configured number of bytes is
+	 * pending (called by the worker thread).
+	 *
+	 * If the caller holds the database lock in shared mode (i.e.
+	 * it was called by a database visitor), the lock is released
+	 * while waiting, so a slow client does not block database
+	 * updates.
+	 *
+	 * Throws if the command was cancelled, if the client has not
+	 * received anything for the configured stall timeout, or if
+	 * the database was modified while the lock was released.
+	 */
+	void Wait();
+
+	/**
+	 * Obtain all blocks which were submitted by Push() (called by
+	 * the #EventLoop thread).
+	 */
+	std::vector<std::shared_ptr<const Block>> TakeBlocks();
+
+	/**
+	 * Wake up the worker thread and make all further Wait()
+	 * calls fail (called by the #EventLoop thread).
+	 */
+	void Cancel() noexcept;
+
+private:
+	void WaitForClient();
+};
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "event/FullyBufferedSocket.hxx"
+
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <span>
+
+/**
+ * Receives events from a #ClientSocket.  All methods are called in
+ * the main thread.
+ */
+class ClientSocketHandler {
+public:
+	using InputResult = BufferedSocket::InputResult;
+
+	/**
+	 * Data has been received on the socket.  This works like
+	 * BufferedSocket::OnSocketInput().
+	 */
+	virtual InputResult OnSocketInput(std::span<std::byte> src) noexcept = 0;
+
+	virtual void OnSocketError(std::exception_ptr ep) noexcept = 0;
+	virtual void OnSocketClosed() noexcept = 0;
+
+protected:
+	~ClientSocketHandler() noexcept = default;
+};
+
+/**
+ * The connection of a #Client.  Its methods mirror those of
+ * #FullyBufferedSocket and may only be called in the main thread;
+ * the socket itself may be handled by another thread (see
+ * #ClientThreads).
+ */
+class ClientSocket {
+public:
+	using OutputStats = FullyBufferedSocket::OutputStats;
+
+	virtual ~ClientSocket() noexcept = default;
+
+	virtual bool IsDefined() const noexcept = 0;
+	virtual void Close() noexcept = 0;
+
+	virtual std::size_t GetOutputMaxSize() const noexcept = 0;
+	virtual OutputStats GetOutputStats() const noexcept = 0;
+
+	/**
+	 * @return false if the socket has been closed
+	 */
+	virtual bool Write(const void *data, std::size_t length) noexcept = 0;
+
+	/**
+	 * @return false if the socket has been closed
+	 */
+	virtual bool VFmt(fmt::string_view format_str,
+			  fmt::format_args args) noexcept = 0;
+
+	/**
+	 * @see FullyBufferedSocket::WriteReference()
+	 *
+	 * @return false if the socket has been closed
+	 */
+	virtual bool WriteReference(std::span<const std::byte> data,
+				    std::shared_ptr<const void> owner) noexcept = 0;
+
+	/**
+	 * Send pending output as soon as possible.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	virtual bool Flush() noexcept = 0;
+
+	/**
+	 * Consume data from the input buffer.  May only be called
+	 * from inside ClientSocketHandler::OnSocketInput().
+	 */
+	virtual void ConsumeInput(std::size_t nbytes) noexcept = 0;
+
+	/**
+	 * Resume reading after ClientSocketHandler::OnSocketInput()
+	 * has returned InputResult::PAUSE.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	virtual bool ResumeInput() noexcept = 0;
+};
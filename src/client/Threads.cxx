@@ -0,0 +1,882 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Threads.hxx"
+#include "Socket.hxx"
+#include "event/Call.hxx"
+#include "event/IdleEvent.hxx"
+#include "event/Thread.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "util/IntrusiveList.hxx"
+#include "util/StaticFifoBuffer.hxx"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+#include <time.h>
+
+/**
+ * The I/O thread stops reading from the socket while this number of
+ * bytes is waiting to be processed by the main thread.
+ */
+static constexpr std::size_t MAX_CHANNEL_INPUT = 16384;
+
+/**
+ * A block of output passed from the main thread to the I/O thread.
+ */
+struct ClientThreads::Segment {
+	std::span<const std::byte> data;
+
+	/**
+	 * Keeps #data alive.
+	 */
+	std::shared_ptr<const void> owner;
+};
+
+/**
+ * The link between a #Socket (main thread) and a #Connection (I/O
+ * thread).  Unless noted otherwise, all fields are protected by
+ * #mutex.
+ */
+struct ClientThreads::Channel {
+	IOThread &thread;
+
+	Mutex mutex;
+
+	/* I/O thread -> main thread */
+
+	/**
+	 * Data received from the socket which has not yet been
+	 * fetched by the main thread.
+	 */
+	std::string input;
+
+	/**
+	 * The socket has failed; the I/O thread has closed it.
+	 */
+	std::exception_ptr error;
+
+	/**
+	 * The peer has closed the connection; the I/O thread has
+	 * closed the socket.
+	 */
+	bool hangup = false;
+
+	/**
+	 * Has the I/O thread stopped reading because #input is full?
+	 */
+	bool read_paused = false;
+
+	/**
+	 * Is this channel in ClientThreads::ready?
+	 */
+	bool queued_main = false;
+
+	/**
+	 * A snapshot of the socket's output statistics.
+	 */
+	ClientSocket::OutputStats output_stats;
+
+	/* main thread -> I/O thread */
+
+	std::vector<Segment> output;
+
+	/**
+	 * The main thread asks the I/O thread to resume reading
+	 * (after #read_paused was set).
+	 */
+	bool resume_read = false;
+
+	/**
+	 * The main thread has closed the #Socket; the I/O thread
+	 * shall send the remaining output and then close the
+	 * connection.
+	 */
+	bool close = false;
+
+	/**
+	 * Is this channel in IOThread::ready?
+	 */
+	bool queued_io = false;
+
+	/**
+	 * Only accessed in the main thread.
+	 */
+	Socket *socket = nullptr;
+
+	/**
+	 * Only accessed in the I/O thread.
+	 */
+	Connection *connection = nullptr;
+
+	explicit Channel(IOThread &_thread) noexcept
+		:thread(_thread) {}
+};
+
+class ClientThreads::IOThread final {
+	ClientThreads &threads;
+
+	EventThread thread;
+
+	InjectEvent inject_event;
+
+	Mutex mutex;
+
+	struct NewConnection {
+		UniqueSocketDescriptor fd;
+		std::shared_ptr<Channel> channel;
+		std::size_t normal_size, peak_size;
+	};
+
+	/**
+	 * Connections which were accepted by the main thread and
+	 * shall be set up by this thread.  Protected by #mutex.
+	 */
+	std::vector<NewConnection> new_connections;
+
+	/**
+	 * Channels which have data or events for this thread.
+	 * Protected by #mutex.
+	 */
+	std::vector<std::shared_ptr<Channel>> ready;
+
+	/**
+	 * Only accessed in this thread.
+	 */
+	IntrusiveList<Connection> connections;
+
+public:
+	std::atomic_uint n_connections{0};
+	std::atomic<uint_least64_t> n_wakeups{0}, bytes_in{0}, bytes_out{0};
+
+	/**
+	 * The CPU time in microseconds consumed by this thread,
+	 * sampled after each wakeup.
+	 */
+	std::atomic<uint_least64_t> cpu_time{0};
+
+	explicit IOThread(ClientThreads &_threads) noexcept
+		:threads(_threads),
+		 inject_event(thread.GetEventLoop(), BIND_THIS_METHOD(OnInject)) {}
+
+	~IOThread() noexcept;
+
+	ClientThreads &GetThreads() const noexcept {
+		return threads;
+	}
+
+	EventLoop &GetEventLoop() noexcept {
+		return thread.GetEventLoop();
+	}
+
+	void Start() {
+		thread.Start();
+	}
+
+	/**
+	 * Called by the main thread.
+	 */
+	void AddConnection(UniqueSocketDescriptor &&fd,
+			   std::shared_ptr<Channel> channel,
+			   std::size_t normal_size,
+			   std::size_t peak_size) noexcept;
+
+	/**
+	 * Wake up this thread to handle events on the given
+	 * #Channel.  The caller must hold the channel's mutex.
+	 */
+	void Enqueue(const std::shared_ptr<Channel> &channel) noexcept;
+
+private:
+	void SampleCpuTime() noexcept;
+
+	/**
+	 * Callback for #inject_event.
+	 */
+	void OnInject() noexcept;
+};
+
+/**
+ * The I/O thread side of a connection.
+ */
+class ClientThreads::Connection final
+	: public AutoUnlinkIntrusiveListHook, FullyBufferedSocket
+{
+	IOThread &thread;
+
+	const std::shared_ptr<Channel> channel;
+
+public:
+	Connection(IOThread &_thread, std::shared_ptr<Channel> _channel,
+		   SocketDescriptor _fd,
+		   std::size_t normal_size, std::size_t peak_size) noexcept
+		:FullyBufferedSocket(_fd, _thread.GetEventLoop(),
+				     normal_size, peak_size),
+		 thread(_thread), channel(std::move(_channel))
+	{
+		channel->connection = this;
+	}
+
+	~Connection() noexcept {
+		if (IsDefined())
+			Close();
+
+		channel->connection = nullptr;
+		--thread.n_connections;
+	}
+
+	/**
+	 * The main thread has submitted data or events.
+	 */
+	void OnChannelReady() noexcept;
+
+private:
+	void NotifyError(std::exception_ptr ep, bool hangup) noexcept;
+
+	/* virtual methods from class BufferedSocket */
+	InputResult OnSocketInput(std::span<std::byte> src) noexcept override;
+	void OnSocketError(std::exception_ptr ep) noexcept override;
+	void OnSocketClosed() noexcept override;
+};
+
+/**
+ * The main thread side of a connection.
+ */
+class ClientThreads::Socket final : public ClientSocket {
+	using InputResult = ClientSocketHandler::InputResult;
+
+	const std::shared_ptr<Channel> channel;
+
+	ClientSocketHandler &handler;
+
+	/**
+	 * Passes #output to the I/O thread after all events of this
+	 * main loop iteration have been handled.
+	 */
+	IdleEvent commit_event;
+
+	const std::size_t max_output_size;
+
+	StaticFifoBuffer<std::byte, 8192> input;
+
+	/**
+	 * Output which was copied (by Write() and VFmt()) and which
+	 * has not yet been moved to #output.
+	 */
+	std::string text;
+
+	/**
+	 * Output which has not yet been passed to the I/O thread.
+	 */
+	std::vector<Segment> output;
+
+	/**
+	 * The total size of #text and #output.
+	 */
+	std::size_t output_size = 0;
+
+	bool closed = false;
+
+	/**
+	 * Has ClientSocketHandler::OnSocketInput() returned
+	 * InputResult::PAUSE?
+	 */
+	bool input_paused = false;
+
+public:
+	Socket(EventLoop &main_loop, std::shared_ptr<Channel> _channel,
+	       std::size_t _max_output_size,
+	       ClientSocketHandler &_handler) noexcept
+		:channel(std::move(_channel)),
+		 handler(_handler),
+		 commit_event(main_loop, BIND_THIS_METHOD(Commit)),
+		 max_output_size(_max_output_size)
+	{
+		channel->socket = this;
+	}
+
+	~Socket() noexcept override {
+		if (!closed)
+			Close();
+
+		channel->socket = nullptr;
+	}
+
+	/**
+	 * The I/O thread has submitted data or events.
+	 */
+	void OnChannelReady() noexcept;
+
+	/* virtual methods from class ClientSocket */
+	bool IsDefined() const noexcept override {
+		return !closed;
+	}
+
+	void Close() noexcept override;
+
+	std::size_t GetOutputMaxSize() const noexcept override {
+		return max_output_size;
+	}
+
+	OutputStats GetOutputStats() const noexcept override {
+		const std::scoped_lock lock{channel->mutex};
+		return channel->output_stats;
+	}
+
+	bool Write(const void *data, std::size_t length) noexcept override;
+	bool VFmt(fmt::string_view format_str,
+		  fmt::format_args args) noexcept override;
+	bool WriteReference(std::span<const std::byte> data,
+			    std::shared_ptr<const void> owner) noexcept override;
+
+	bool Flush() noexcept override {
+		assert(!closed);
+
+		Commit();
+		return true;
+	}
+
+	void ConsumeInput(std::size_t nbytes) noexcept override {
+		input.Consume(nbytes);
+	}
+
+	bool ResumeInput() noexcept override {
+		assert(!closed);
+
+		input_paused = false;
+		return ProcessInput();
+	}
+
+private:
+	void OnOutputFull() noexcept {
+		handler.OnSocketError(std::make_exception_ptr(std::runtime_error("Output buffer is full")));
+	}
+
+	/**
+	 * Move #text to #output.
+	 */
+	void SealText() noexcept;
+
+	/**
+	 * Pass #output to the I/O thread.
+	 */
+	void Commit() noexcept;
+
+	/**
+	 * Move data from Channel::input to #input.
+	 *
+	 * @return the number of bytes which were moved
+	 */
+	std::size_t FetchInput() noexcept;
+
+	/**
+	 * Pass #input to the handler.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	bool ProcessInput() noexcept;
+
+	/**
+	 * Check whether the I/O thread has reported an error or a
+	 * hangup, and pass it to the handler.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	bool CheckClosed() noexcept;
+};
+
+void
+ClientThreads::Socket::Close() noexcept
+{
+	assert(!closed);
+
+	closed = true;
+	commit_event.Cancel();
+	text.clear();
+	output.clear();
+	output_size = 0;
+
+	const std::scoped_lock lock{channel->mutex};
+	channel->close = true;
+	channel->thread.Enqueue(channel);
+}
+
+bool
+ClientThreads::Socket::Write(const void *data, std::size_t length) noexcept
+{
+	assert(!closed);
+
+	if (length == 0)
+		return true;
+
+	if (output_size + length > max_output_size) {
+		OnOutputFull();
+		return false;
+	}
+
+	text.append(static_cast<const char *>(data), length);
+	output_size += length;
+	commit_event.Schedule();
+	return true;
+}
+
+bool
+ClientThreads::Socket::VFmt(fmt::string_view format_str,
+			    fmt::format_args args) noexcept
+{
+	assert(!closed);
+
+	const std::size_t old_size = text.size();
+	fmt::vformat_to(std::back_inserter(text), format_str, args);
+
+	const std::size_t length = text.size() - old_size;
+	if (output_size + length > max_output_size) {
+		text.resize(old_size);
+		OnOutputFull();
+		return false;
+	}
+
+	output_size += length;
+	commit_event.Schedule();
+	return true;
+}
+
+bool
+ClientThreads::Socket::WriteReference(std::span<const std::byte> data,
+				      std::shared_ptr<const void> owner) noexcept
+{
+	assert(!closed);
+
+	if (data.size() < FullyBufferedSocket::MIN_REFERENCE_SIZE)
+		return Write(data.data(), data.size());
+
+	if (output_size + data.size() > max_output_size) {
+		OnOutputFull();
+		return false;
+	}
+
+	SealText();
+	output.push_back({data, std::move(owner)});
+	output_size += data.size();
+	commit_event.Schedule();
+	return true;
+}
+
+inline void
+ClientThreads::Socket::SealText() noexcept
+{
+	if (text.empty())
+		return;
+
+	auto s = std::make_shared<const std::string>(std::move(text));
+	text.clear();
+
+	const auto data = std::as_bytes(std::span{*s});
+	output.push_back({data, std::move(s)});
+}
+
+void
+ClientThreads::Socket::Commit() noexcept
+{
+	commit_event.Cancel();
+
+	SealText();
+	if (output.empty())
+		return;
+
+	{
+		const std::scoped_lock lock{channel->mutex};
+		std::move(output.begin(), output.end(),
+			  std::back_inserter(channel->output));
+		channel->thread.Enqueue(channel);
+	}
+
+	output.clear();
+	output_size = 0;
+}
+
+std::size_t
+ClientThreads::Socket::FetchInput() noexcept
+{
+	const auto w = input.Write();
+
+	const std::scoped_lock lock{channel->mutex};
+	const std::size_t n = std::min(w.size(), channel->input.size());
+	if (n == 0)
+		return 0;
+
+	std::copy_n(reinterpret_cast<const std::byte *>(channel->input.data()),
+		    n, w.data());
+	input.Append(n);
+	channel->input.erase(0, n);
+
+	if (channel->read_paused) {
+		channel->read_paused = false;
+		channel->resume_read = true;
+		channel->thread.Enqueue(channel);
+	}
+
+	return n;
+}
+
+bool
+ClientThreads::Socket::ProcessInput() noexcept
+{
+	assert(!closed);
+	assert(!input_paused);
+
+	FetchInput();
+
+	while (true) {
+		const auto buffer = input.Read();
+		if (buffer.empty()) {
+			if (FetchInput() > 0)
+				continue;
+
+			break;
+		}
+
+		switch (handler.OnSocketInput(buffer)) {
+		case InputResult::MORE:
+			if (input.IsFull()) {
+				handler.OnSocketError(std::make_exception_ptr(std::runtime_error("Input buffer is full")));
+				return false;
+			}
+
+			if (FetchInput() > 0)
+				continue;
+
+			return CheckClosed();
+
+		case InputResult::PAUSE:
+			input_paused = true;
+			return CheckClosed();
+
+		case InputResult::AGAIN:
+			continue;
+
+		case InputResult::CLOSED:
+			return false;
+		}
+	}
+
+	return CheckClosed();
+}
+
+bool
+ClientThreads::Socket::CheckClosed() noexcept
+{
+	std::exception_ptr error;
+
+	{
+		const std::scoped_lock lock{channel->mutex};
+
+		if (!input_paused && !channel->input.empty())
+			/* more data has arrived meanwhile; the I/O
+			   thread has already notified us */
+			return true;
+
+		if (!channel->error && !channel->hangup)
+			return true;
+
+		error = channel->error;
+	}
+
+	if (error)
+		handler.OnSocketError(std::move(error));
+	else
+		handler.OnSocketClosed();
+	return false;
+}
+
+void
+ClientThreads::Socket::OnChannelReady() noexcept
+{
+	if (closed)
+		return;
+
+	if (input_paused)
+		CheckClosed();
+	else
+		ProcessInput();
+}
+
+inline void
+ClientThreads::Connection::NotifyError(std::exception_ptr ep,
+				       bool hangup) noexcept
+{
+	/* close the socket right away, but keep this object until
+	   the main thread has seen the error */
+	const auto stats = GetOutputStats();
+	Close();
+
+	const std::scoped_lock lock{channel->mutex};
+	channel->error = std::move(ep);
+	channel->hangup = hangup;
+	channel->output_stats = stats;
+	thread.GetThreads().EnqueueMain(channel);
+}
+
+void
+ClientThreads::Connection::OnSocketError(std::exception_ptr ep) noexcept
+{
+	NotifyError(std::move(ep), false);
+}
+
+void
+ClientThreads::Connection::OnSocketClosed() noexcept
+{
+	NotifyError({}, true);
+}
+
+BufferedSocket::InputResult
+ClientThreads::Connection::OnSocketInput(std::span<std::byte> src) noexcept
+{
+	std::size_t n;
+
+	{
+		const std::scoped_lock lock{channel->mutex};
+
+		assert(channel->input.size() <= MAX_CHANNEL_INPUT);
+		n = std::min(src.size(),
+			     MAX_CHANNEL_INPUT - channel->input.size());
+		if (n < src.size())
+			channel->read_paused = true;
+
+		if (n > 0) {
+			channel->input.append(reinterpret_cast<const char *>(src.data()),
+					      n);
+			channel->output_stats = GetOutputStats();
+			thread.GetThreads().EnqueueMain(channel);
+		}
+	}
+
+	thread.bytes_in.fetch_add(n, std::memory_order_relaxed);
+	ConsumeInput(n);
+
+	return n < src.size()
+		? InputResult::PAUSE
+		: InputResult::MORE;
+}
+
+void
+ClientThreads::Connection::OnChannelReady() noexcept
+{
+	std::vector<Segment> segments;
+	bool resume_read, close;
+
+	{
+		const std::scoped_lock lock{channel->mutex};
+		channel->queued_io = false;
+		segments.swap(channel->output);
+		resume_read = std::exchange(channel->resume_read, false);
+		close = channel->close;
+		channel->output_stats = GetOutputStats();
+	}
+
+	for (auto &i : segments) {
+		if (!IsDefined())
+			break;
+
+		thread.bytes_out.fetch_add(i.data.size(),
+					   std::memory_order_relaxed);
+		WriteReference(i.data, std::move(i.owner));
+	}
+
+	if (close) {
+		/* the main thread has closed the connection; send
+		   what can be sent right now and then dispose this
+		   object */
+		if (IsDefined())
+			Flush();
+
+		delete this;
+		return;
+	}
+
+	if (resume_read && IsDefined())
+		ResumeInput();
+}
+
+ClientThreads::IOThread::~IOThread() noexcept
+{
+	BlockingCall(GetEventLoop(), [this](){
+		inject_event.Cancel();
+		connections.clear_and_dispose(DeleteDisposer{});
+		new_connections.clear();
+		ready.clear();
+	});
+
+	thread.Stop();
+}
+
+void
+ClientThreads::IOThread::AddConnection(UniqueSocketDescriptor &&fd,
+				       std::shared_ptr<Channel> channel,
+				       std::size_t normal_size,
+				       std::size_t peak_size) noexcept
+{
+	/* counted right away, so Connect() does not assign all
+	   connections accepted in one batch to the same thread */
+	++n_connections;
+
+	const std::scoped_lock lock{mutex};
+	new_connections.push_back({std::move(fd), std::move(channel),
+				   normal_size, peak_size});
+	inject_event.Schedule();
+}
+
+void
+ClientThreads::IOThread::Enqueue(const std::shared_ptr<Channel> &channel) noexcept
+{
+	if (channel->queued_io)
+		return;
+
+	channel->queued_io = true;
+
+	const std::scoped_lock lock{mutex};
+	ready.push_back(channel);
+	inject_event.Schedule();
+}
+
+inline void
+ClientThreads::IOThread::SampleCpuTime() noexcept
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+		cpu_time.store(uint_least64_t(ts.tv_sec) * 1000000 +
+			       ts.tv_nsec / 1000,
+			       std::memory_order_relaxed);
+#endif
+}
+
+void
+ClientThreads::IOThread::OnInject() noexcept
+{
+	std::vector<NewConnection> n;
+	std::vector<std::shared_ptr<Channel>> r;
+
+	{
+		const std::scoped_lock lock{mutex};
+		n.swap(new_connections);
+		r.swap(ready);
+	}
+
+	n_wakeups.fetch_add(1, std::memory_order_relaxed);
+
+	/* the BufferedSocket constructor registers the socket in
+	   this thread's EventLoop, therefore the Connection objects
+	   are created here */
+	for (auto &i : n) {
+		auto *c = new Connection(*this, std::move(i.channel),
+					 i.fd.Release(),
+					 i.normal_size, i.peak_size);
+		connections.push_back(*c);
+	}
+
+	for (const auto &channel : r)
+		if (channel->connection != nullptr)
+			channel->connection->OnChannelReady();
+
+	SampleCpuTime();
+}
+
+ClientThreads::ClientThreads(EventLoop &_main_loop, unsigned n_threads)
+	:main_loop(_main_loop),
+	 inject_event(main_loop, BIND_THIS_METHOD(OnInject))
+{
+	assert(n_threads > 0);
+
+	threads.reserve(n_threads);
+	for (unsigned i = 0; i < n_threads; ++i)
+		threads.emplace_back(std::make_unique<IOThread>(*this))->Start();
+}
+
+ClientThreads::~ClientThreads() noexcept
+{
+	/* this closes the remaining connections (whose Socket was
+	   destroyed in the main thread, but whose close request has
+	   not yet been handled by the I/O thread) */
+	threads.clear();
+
+	ready.clear();
+}
+
+std::unique_ptr<ClientSocket>
+ClientThreads::Connect(UniqueSocketDescriptor fd,
+		       std::size_t normal_size, std::size_t peak_size,
+		       ClientSocketHandler &handler) noexcept
+{
+	auto &thread = **std::min_element(threads.begin(), threads.end(),
+					  [](const auto &a, const auto &b){
+						  return a->n_connections < b->n_connections;
+					  });
+
+	auto channel = std::make_shared<Channel>(thread);
+	auto socket = std::make_unique<Socket>(main_loop, channel, peak_size,
+					       handler);
+	thread.AddConnection(std::move(fd), std::move(channel),
+			     normal_size, peak_size);
+	return socket;
+}
+
+void
+ClientThreads::EnqueueMain(const std::shared_ptr<Channel> &channel) noexcept
+{
+	if (channel->queued_main)
+		return;
+
+	channel->queued_main = true;
+
+	const std::scoped_lock lock{mutex};
+	ready.push_back(channel);
+	inject_event.Schedule();
+}
+
+void
+ClientThreads::OnInject() noexcept
+{
+	std::vector<std::shared_ptr<Channel>> r;
+
+	{
+		const std::scoped_lock lock{mutex};
+		r.swap(ready);
+	}
+
+	for (const auto &channel : r) {
+		{
+			const std::scoped_lock lock{channel->mutex};
+			channel->queued_main = false;
+		}
+
+		/* the Socket may have been destroyed meanwhile by
+		   the handler of another channel */
+		if (channel->socket != nullptr)
+			channel->socket->OnChannelReady();
+	}
+}
+
+std::vector<ClientThreads::Stats>
+ClientThreads::GetStats() const noexcept
+{
+	std::vector<Stats> result;
+	result.reserve(threads.size());
+
+	for (const auto &i : threads)
+		result.push_back({
+			i->n_connections.load(std::memory_order_relaxed),
+			i->n_wakeups.load(std::memory_order_relaxed),
+			i->bytes_in.load(std::memory_order_relaxed),
+			i->bytes_out.load(std::memory_order_relaxed),
+			std::chrono::microseconds(i->cpu_time.load(std::memory_order_relaxed)),
+		});
+
+	return result;
+}
@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "event/InjectEvent.hxx"
+#include "thread/Mutex.hxx"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class EventLoop;
+class UniqueSocketDescriptor;
+class ClientSocket;
+class ClientSocketHandler;
+
+/**
+ * Threads which perform the socket I/O of clients: they receive
+ * commands, send responses and account for slow clients, so the
+ * main thread does not spend its time in system calls when there
+ * are many busy clients.
+ *
+ * Commands are still executed in the main thread: each I/O thread
+ * passes the received data to the main thread, and the main thread
+ * passes the responses back, in batches (one wakeup per event loop
+ * iteration).
+ */
+class ClientThreads final {
+	EventLoop &main_loop;
+
+	struct Segment;
+	struct Channel;
+	class Socket;
+	class Connection;
+	class IOThread;
+
+	std::vector<std::unique_ptr<IOThread>> threads;
+
+	Mutex mutex;
+
+	/**
+	 * Channels which have data or events for the main thread.
+	 * Protected by #mutex.
+	 */
+	std::vector<std::shared_ptr<Channel>> ready;
+
+	InjectEvent inject_event;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param n_threads the number of I/O threads to be started
+	 */
+	ClientThreads(EventLoop &_main_loop, unsigned n_threads);
+
+	/**
+	 * Closes all remaining connections and stops the threads.
+	 * All #ClientSocket instances must have been destroyed
+	 * already.
+	 */
+	~ClientThreads() noexcept;
+
+	ClientThreads(const ClientThreads &) = delete;
+	ClientThreads &operator=(const ClientThreads &) = delete;
+
+	/**
+	 * Assign a new connection to the least busy I/O thread.  Must
+	 * be called in the main thread.
+	 *
+	 * @param handler receives events in the main thread
+	 */
+	std::unique_ptr<ClientSocket> Connect(UniqueSocketDescriptor fd,
+					      std::size_t normal_size,
+					      std::size_t peak_size,
+					      ClientSocketHandler &handler) noexcept;
+
+	struct Stats {
+		/**
+		 * The number of connections handled by this thread.
+		 */
+		unsigned connections;
+
+		/**
+		 * The number of times this thread was woken up by the
+		 * main thread.
+		 */
+		uint_least64_t wakeups;
+
+		/**
+		 * The number of bytes received from and passed to the
+		 * clients.
+		 */
+		uint_least64_t bytes_in, bytes_out;
+
+		/**
+		 * The CPU time consumed by this thread.
+		 */
+		std::chrono::microseconds cpu_time;
+	};
+
+	/**
+	 * Obtain statistics about each I/O thread.
+	 */
+	std::vector<Stats> GetStats() const noexcept;
+
+private:
+	/**
+	 * Wake up the main thread to handle events on the given
+	 * #Channel.  The caller must hold the channel's mutex.
+	 */
+	void EnqueueMain(const std::shared_ptr<Channel> &channel) noexcept;
+
+	/**
+	 * Callback for #inject_event.
+	 */
+	void OnInject() noexcept;
+};
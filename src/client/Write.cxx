@@ -9,5 +9,19 @@ bool
 Client::Write(const void *data, size_t length) noexcept
 {
 	/* if the client is going to be closed, do nothing */
-	return !IsExpired() && FullyBufferedSocket::Write(data, length);
+	return !IsExpired() && socket->Write(data, length);
+}
+
+bool
+Client::VFmt(fmt::string_view format_str, fmt::format_args args) noexcept
+{
+	return !IsExpired() && socket->VFmt(format_str, args);
+}
+
+bool
+Client::WriteReference(std::span<const std::byte> data,
+		       std::shared_ptr<const void> owner) noexcept
+{
+	return !IsExpired() &&
+		socket->WriteReference(data, std::move(owner));
 }
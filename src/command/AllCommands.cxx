@@ -200,6 +200,7 @@ static constexpr struct command commands[] = {
 	{ "swap", PERMISSION_PLAYER, 2, 2, handle_swap },
 	{ "swapid", PERMISSION_PLAYER, 2, 2, handle_swapid },
 	{ "tagtypes", PERMISSION_NONE, 0, -1, handle_tagtypes },
+	{ "threadstats", PERMISSION_READ, 0, 0, handle_threadstats },
 	{ "toggleoutput", PERMISSION_ADMIN, 1, 1, handle_toggleoutput },
 #ifdef ENABLE_DATABASE
 	{ "unmount", PERMISSION_ADMIN, 1, 1, handle_unmount },
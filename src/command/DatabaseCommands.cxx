@@ -5,7 +5,9 @@
 #include "PositionArg.hxx"
 #include "Request.hxx"
 #include "Partition.hxx"
+#include "Instance.hxx"
 #include "client/StringNormalization.hxx"
+#include "client/PoolBackgroundCommand.hxx"
 #include "db/DatabaseQueue.hxx"
 #include "db/DatabasePlaylist.hxx"
 #include "db/DatabasePrint.hxx"
@@ -19,17 +21,118 @@
 #include "util/Exception.hxx"
 #include "util/StringAPI.hxx"
 #include "util/ASCII.hxx"
+#include "song/DetachedSong.hxx"
 #include "song/Filter.hxx"
 
 #include <fmt/format.h>
 
 #include <memory>
+#include <string>
+#include <type_traits>
 #include <vector>
 
 #include <limits.h> // for UINT_MAX
 
 using std::string_view_literals::operator""sv;
 
+namespace {
+
+/**
+ * A #PoolBackgroundCommand which executes a read-only database
+ * query in a worker thread.
+ */
+template<typename F>
+class QueryCommand final : public PoolBackgroundCommand {
+	F f;
+
+public:
+	QueryCommand(BackgroundCommandPool &_pool, Client &_client,
+		     const Response &r, F &&_f) noexcept
+		:PoolBackgroundCommand(_pool, _client, r), f(std::move(_f)) {}
+
+protected:
+	void Run(Response &r) override {
+		f(r);
+	}
+};
+
+/**
+ * Implementation of "findadd" and "searchadd" in a worker thread:
+ * the songs are collected by Run() and then added to the queue by
+ * Finish() in the main thread.
+ */
+class MatchAddCommand final : public PoolBackgroundCommand {
+	Partition &partition;
+
+	const std::unique_ptr<SongFilter> filter;
+	const DatabaseSelection selection;
+
+	/**
+	 * The queue position where the new songs shall be inserted;
+	 * UINT_MAX to append them.
+	 */
+	const unsigned position;
+
+	/**
+	 * The maximum number of songs which may be added (plus one,
+	 * to trigger the "Playlist is too large" error).
+	 */
+	const std::size_t max_songs;
+
+	std::vector<DetachedSong> songs;
+
+public:
+	MatchAddCommand(BackgroundCommandPool &_pool, Client &_client,
+			const Response &r,
+			std::unique_ptr<SongFilter> &&_filter,
+			const DatabaseSelection &_selection,
+			unsigned _position) noexcept
+		:PoolBackgroundCommand(_pool, _client, r),
+		 partition(_client.GetPartition()),
+		 filter(std::move(_filter)),
+		 selection(_selection),
+		 position(_position),
+		 max_songs(partition.playlist.queue.max_length + 1) {}
+
+protected:
+	void Run(Response &) override {
+		songs = CollectFromDatabase(partition.instance.GetDatabaseOrThrow(),
+					    partition.instance.storage,
+					    selection, max_songs);
+	}
+
+	void Finish() override;
+};
+
+}
+
+/**
+ * Execute a read-only database query in a #BackgroundCommandPool
+ * thread, so it does not block the main loop.  If that is not
+ * possible (no pool or inside a command list), the query is
+ * executed right away.
+ *
+ * @param f a function which writes the result to the given
+ * #Response; it must not access anything owned by the main thread
+ * except for the #Database
+ */
+template<typename F>
+static CommandResult
+RunQuery(Client &client, Response &r, F &&f)
+{
+	auto *pool = client.GetInstance().background_command_pool.get();
+	if (pool == nullptr || !client.CanRunInBackground()) {
+		f(r);
+		return CommandResult::OK;
+	}
+
+	auto cmd = std::make_unique<QueryCommand<std::decay_t<F>>>(*pool, client, r,
+								   std::forward<F>(f));
+	cmd->Start();
+	client.SetBackgroundCommand(std::move(cmd));
+	return CommandResult::BACKGROUND;
+}
+
 CommandResult
 handle_listfiles_db(Client &client, Response &r, const std::string_view uri)
 {
@@ -142,12 +245,15 @@ ParseDatabaseSelection(Request args, bool fold_case, bool strip_diacritics, Song
 static CommandResult
 handle_match(Client &client, Request args, Response &r, bool fold_case, bool strip_diacritics)
 {
-	SongFilter filter;
-	const auto selection = ParseDatabaseSelection(args, fold_case, strip_diacritics, filter);
-
-	db_selection_print(r, client.GetPartition(),
-			   selection, true, false);
-	return CommandResult::OK;
+	auto filter = std::make_unique<SongFilter>();
+	const auto selection = ParseDatabaseSelection(args, fold_case, strip_diacritics, *filter);
+
+	return RunQuery(client, r, [&partition=client.GetPartition(),
+				    filter=std::move(filter),
+				    selection](Response &r2){
+		db_selection_print(r2, partition,
+				   selection, true, false);
+	});
 }
 
 CommandResult
@@ -163,45 +269,83 @@ handle_search(Client &client, Request args, Response &r)
 	return handle_match(client, args, r, true, strip_diacritics);
 }
 
+/**
+ * Move the songs which were appended to the queue after
+ * #queue_length to the given position.
+ */
+static void
+MoveAddedSongs(Partition &partition, unsigned queue_length,
+	       unsigned position) noexcept
+{
+	if (position >= queue_length)
+		return;
+
+	const auto new_queue_length =
+		partition.playlist.queue.GetLength();
+	const RangeArg range{queue_length, new_queue_length};
+
+	try {
+		partition.MoveRange(range, position);
+	} catch (...) {
+		/* ignore - shall we handle it? */
+	}
+}
+
+void
+MatchAddCommand::Finish()
+{
+	/* the queue may have been modified while Run() was
+	   executed */
+	const auto queue_length = partition.playlist.queue.GetLength();
+
+	AppendToQueue(partition, std::move(songs));
+	MoveAddedSongs(partition, queue_length,
+		       std::min(position, queue_length));
+}
+
 static CommandResult
-handle_match_add(Client &client, Request args, bool fold_case, bool strip_diacritics)
+handle_match_add(Client &client, Request args, Response &r,
+		 bool fold_case, bool strip_diacritics)
 {
 	auto &partition = client.GetPartition();
 	const auto queue_length = partition.playlist.queue.GetLength();
 	const unsigned position =
 		ParseInsertPosition(args, partition.playlist);
 
-	SongFilter filter;
-	const auto selection = ParseDatabaseSelection(args, fold_case, strip_diacritics, filter);
-
-	AddFromDatabase(partition, selection);
-
-	if (position < queue_length) {
-		const auto new_queue_length =
-			partition.playlist.queue.GetLength();
-		const RangeArg range{queue_length, new_queue_length};
-
-		try {
-			partition.MoveRange(range, position);
-		} catch (...) {
-			/* ignore - shall we handle it? */
-		}
+	auto filter = std::make_unique<SongFilter>();
+	const auto selection = ParseDatabaseSelection(args, fold_case, strip_diacritics, *filter);
+
+	if (auto *pool = client.GetInstance().background_command_pool.get();
+	    pool != nullptr && client.CanRunInBackground()) {
+		/* if no position was specified, append to the end of
+		   the queue as it is when the query finishes */
+		auto cmd = std::make_unique<MatchAddCommand>(*pool, client, r,
+							     std::move(filter),
+							     selection,
+							     position < queue_length
+							     ? position
+							     : UINT_MAX);
+		cmd->Start();
+		client.SetBackgroundCommand(std::move(cmd));
+		return CommandResult::BACKGROUND;
 	}
 
+	AddFromDatabase(partition, selection);
+	MoveAddedSongs(partition, queue_length, position);
 	return CommandResult::OK;
 }
 
 CommandResult
-handle_findadd(Client &client, Request args, Response &)
+handle_findadd(Client &client, Request args, Response &r)
 {
-	return handle_match_add(client, args, false, false);
+	return handle_match_add(client, args, r, false, false);
 }
 
 CommandResult
-handle_searchadd(Client &client, Request args, Response &)
+handle_searchadd(Client &client, Request args, Response &r)
 {
 	auto strip_diacritics = client.StringNormalizationEnabled(SN_STRIP_DIACRITICS);
-	return handle_match_add(client, args, true,  strip_diacritics);
+	return handle_match_add(client, args, r, true,  strip_diacritics);
 }
 
 CommandResult
@@ -244,21 +388,24 @@ handle_count_internal(Client &client, Request args, Response &r, bool fold_case,
 		args.pop_back();
 	}
 
-	SongFilter filter;
+	auto filter = std::make_unique<SongFilter>();
 	if (!args.empty()) {
 		try {
-			filter.Parse(args, fold_case, strip_diacritics);
+			filter->Parse(args, fold_case, strip_diacritics);
 		} catch (...) {
 			r.Error(ACK_ERROR_ARG,
 				GetFullMessage(std::current_exception()).c_str());
 			return CommandResult::ERROR;
 		}
 
-		filter.Optimize();
+		filter->Optimize();
 	}
 
-	PrintSongCount(r, client.GetPartition(), ""sv, &filter, group);
-	return CommandResult::OK;
+	return RunQuery(client, r, [&partition=client.GetPartition(),
+				    filter=std::move(filter),
+				    group](Response &r2){
+		PrintSongCount(r2, partition, ""sv, filter.get(), group);
+	});
 }
 
 CommandResult
@@ -277,13 +424,16 @@ handle_searchcount(Client &client, Request args, Response &r)
 CommandResult
 handle_listall(Client &client, Request args, Response &r)
 {
-	/* default is root directory */
-	const auto uri = args.GetOptional(0, "");
-
-	db_selection_print(r, client.GetPartition(),
-			   DatabaseSelection(uri, true),
-			   false, false);
-	return CommandResult::OK;
+	/* default is root directory; copy it, because the
+	   Request may be gone when the query runs */
+	std::string uri{args.GetOptional(0, "")};
+
+	return RunQuery(client, r, [&partition=client.GetPartition(),
+				    uri=std::move(uri)](Response &r2){
+		db_selection_print(r2, partition,
+				   DatabaseSelection(uri, true),
+				   false, false);
+	});
 }
 
 static CommandResult
@@ -303,8 +453,10 @@ handle_list_file(Client &client, Request args, Response &r)
 		filter->Optimize();
 	}
 
-	PrintSongUris(r, client.GetPartition(), filter.get());
-	return CommandResult::OK;
+	return RunQuery(client, r, [&partition=client.GetPartition(),
+				    filter=std::move(filter)](Response &r2){
+		PrintSongUris(r2, partition, filter.get());
+	});
 }
 
 CommandResult
@@ -386,21 +538,28 @@ handle_list(Client &client, Request args, Response &r)
 		filter->Optimize();
 	}
 
-	PrintUniqueTags(r, client.GetPartition(),
-			{&tag_types.front(), tag_types.size()},
-			filter.get(),
-			window);
-	return CommandResult::OK;
+	return RunQuery(client, r, [&partition=client.GetPartition(),
+				    tag_types=std::move(tag_types),
+				    filter=std::move(filter),
+				    window](Response &r2){
+		PrintUniqueTags(r2, partition,
+				{&tag_types.front(), tag_types.size()},
+				filter.get(),
+				window);
+	});
 }
 
 CommandResult
 handle_listallinfo(Client &client, Request args, Response &r)
 {
-	/* default is root directory */
-	const auto uri = args.GetOptional(0, "");
-
-	db_selection_print(r, client.GetPartition(),
-			   DatabaseSelection(uri, true),
-			   true, false);
-	return CommandResult::OK;
+	/* default is root directory; copy it, because the
+	   Request may be gone when the query runs */
+	std::string uri{args.GetOptional(0, "")};
+
+	return RunQuery(client, r, [&partition=client.GetPartition(),
+				    uri=std::move(uri)](Response &r2){
+		db_selection_print(r2, partition,
+				   DatabaseSelection(uri, true),
+				   true, false);
+	});
 }
@@ -34,6 +34,7 @@
 #include <algorithm>
 #include <cassert>
 #include <array>
+#include <memory>
 
 using std::string_view_literals::operator""sv;
 
@@ -189,7 +190,10 @@ read_stream_art(Response &r, const std::string_view art_directory,
 		std::min<offset_type>(art_file_size - offset,
 				      r.GetClient().binary_limit);
 
-	auto buffer = std::make_unique_for_overwrite<std::byte[]>(buffer_size);
+	/* shared with the client's output queue, which sends it
+	   without copying */
+	std::shared_ptr<std::byte[]> buffer =
+		std::make_unique_for_overwrite<std::byte[]>(buffer_size);
 
 	std::size_t read_size = 0;
 	if (buffer_size > 0) {
@@ -216,7 +220,7 @@ read_stream_art(Response &r, const std::string_view art_directory,
 				    PathTraitsUTF8::GetBase(is->GetUriView())),
 	      art_file_size);
 
-	r.WriteBinary({buffer.get(), read_size});
+	r.WriteBinary({buffer.get(), read_size}, std::move(buffer));
 
 	return CommandResult::OK;
 }
@@ -362,6 +362,14 @@ handle_stats(Client &client, [[maybe_unused]] Request args, Response &r)
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_threadstats([[maybe_unused]] Client &client,
+		   [[maybe_unused]] Request args, Response &r)
+{
+	thread_stats_print(r);
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_config(Client &client, [[maybe_unused]] Request args, Response &r)
 {
@@ -391,8 +399,11 @@ handle_config(Client &client, [[maybe_unused]] Request args, Response &r)
 CommandResult
 handle_idle(Client &client, Request args, Response &r)
 {
+	std::span<const char *const> names = args;
+	const Event::Duration debounce = idle_parse_debounce(names);
+
 	unsigned flags = 0;
-	for (const char *i : args) {
+	for (const char *i : names) {
 		unsigned event = idle_parse_name(i);
 		if (event == 0) {
 			r.FmtError(ACK_ERROR_ARG,
@@ -409,7 +420,7 @@ handle_idle(Client &client, Request args, Response &r)
 		flags = ~0;
 
 	/* enable "idle" mode on this client */
-	client.IdleWait(flags);
+	client.IdleWait(flags, debounce);
 
 	return CommandResult::IDLE;
 }
@@ -42,6 +42,7 @@ enum class ConfigOption {
 	VOLUME_NORMALIZATION,
 	SAMPLERATE_CONVERTER,
 	AUDIO_BUFFER_SIZE,
+	AUDIO_CHUNK_TIME,
 	BUFFER_BEFORE_PLAY,
 	HTTP_PROXY_HOST,
 	HTTP_PROXY_PORT,
@@ -49,6 +50,7 @@ enum class ConfigOption {
 	HTTP_PROXY_PASSWORD,
 	CONN_TIMEOUT,
 	MAX_CONN,
+	CLIENT_THREADS,
 	MAX_PLAYLIST_LENGTH,
 	MAX_COMMAND_LIST_SIZE,
 	MAX_OUTPUT_BUFFER_SIZE,
@@ -59,11 +61,17 @@ enum class ConfigOption {
 	GAPLESS_MP3_PLAYBACK,
 	AUTO_UPDATE,
 	AUTO_UPDATE_DEPTH,
+	UPDATE_THREADS,
+	QUERY_THREADS,
+	SCAN_CACHE_FILE,
+	UPDATE_ANALYSIS,
 
 	MIXRAMP_ANALYZER,
 
 	INHIBIT_IDLE,
 
+	MLOCK_AUDIO_MEMORY,
+
 	MAX
 };
 
@@ -14,8 +14,8 @@ static constexpr
 size_t MIN_BUFFER_SIZE = std::max(CHUNK_SIZE * 32,
 				  64 * KILOBYTE);
 
-static unsigned
-GetBufferChunks(const ConfigData &config)
+static size_t
+GetBufferSize(const ConfigData &config)
 {
 	size_t buffer_size = PlayerConfig::DEFAULT_BUFFER_SIZE;
 	if (auto *param = config.GetParam(ConfigOption::AUDIO_BUFFER_SIZE)) {
@@ -40,11 +40,13 @@ GetBufferChunks(const ConfigData &config)
 		throw FmtRuntimeError("buffer size {:?} is too big",
 				      buffer_size);
 
-	return buffer_chunks;
+	return buffer_size;
 }
 
 PlayerConfig::PlayerConfig(const ConfigData &config)
-	:buffer_chunks(GetBufferChunks(config)),
+	:buffer_size(GetBufferSize(config)),
+	 chunk_time(config.GetUnsigned(ConfigOption::AUDIO_CHUNK_TIME,
+				       DEFAULT_CHUNK_TIME.count())),
 	 audio_format(config.With(ConfigOption::AUDIO_OUTPUT_FORMAT, [](const char *s){
 		 if (s == nullptr)
 			 return AudioFormat::Undefined();
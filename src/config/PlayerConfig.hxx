@@ -6,6 +6,8 @@
 #include "pcm/AudioFormat.hxx"
 #include "ReplayGainConfig.hxx"
 
+#include <chrono>
+
 struct ConfigData;
 
 static constexpr size_t KILOBYTE = 1024;
@@ -14,7 +16,19 @@ static constexpr size_t MEGABYTE = 1024 * KILOBYTE;
 struct PlayerConfig {
 	static constexpr size_t DEFAULT_BUFFER_SIZE = 8 * MEGABYTE;
 
-	unsigned buffer_chunks = DEFAULT_BUFFER_SIZE;
+	static constexpr std::chrono::milliseconds DEFAULT_CHUNK_TIME{20};
+
+	/**
+	 * The size of the #MusicBuffer in bytes.
+	 */
+	size_t buffer_size = DEFAULT_BUFFER_SIZE;
+
+	/**
+	 * The "audio_chunk_time" setting: the desired playback
+	 * duration of one #MusicChunk.  Zero means all chunks have
+	 * the same size.
+	 */
+	std::chrono::milliseconds chunk_time = DEFAULT_CHUNK_TIME;
 
 	/**
 	 * The "audio_output_format" setting.
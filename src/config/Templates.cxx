@@ -40,6 +40,7 @@ const ConfigTemplate config_param_templates[] = {
 	{ "volume_normalization" },
 	{ "samplerate_converter" },
 	{ "audio_buffer_size" },
+	{ "audio_chunk_time" },
 	{ "buffer_before_play", false, true },
 	{ "http_proxy_host", false, true },
 	{ "http_proxy_port", false, true },
@@ -47,6 +48,7 @@ const ConfigTemplate config_param_templates[] = {
 	{ "http_proxy_password", false, true },
 	{ "connection_timeout" },
 	{ "max_connections" },
+	{ "client_threads" },
 	{ "max_playlist_length" },
 	{ "max_command_list_size" },
 	{ "max_output_buffer_size" },
@@ -57,8 +59,13 @@ const ConfigTemplate config_param_templates[] = {
 	{ "gapless_mp3_playback", false, true },
 	{ "auto_update" },
 	{ "auto_update_depth" },
+	{ "update_threads" },
+	{ "query_threads" },
+	{ "scan_cache_file" },
+	{ "update_analysis" },
 	{ "mixramp_analyzer" },
 	{ "inhibit_idle" },
+	{ "mlock_audio_memory" },
 };
 
 static constexpr unsigned n_config_param_templates =
@@ -3,8 +3,40 @@
 
 #include "DatabaseLock.hxx"
 
-Mutex db_mutex;
+#include <chrono>
 
-#ifndef NDEBUG
-ThreadId db_mutex_holder;
-#endif
+SharedMutex db_mutex;
+
+DatabaseLockCounters db_lock_counters;
+
+std::atomic_uint_least64_t db_modification_counter{0};
+
+thread_local DatabaseLockMode db_lock_mode = DatabaseLockMode::NONE;
+
+template<typename F>
+static void
+WaitForLock(std::atomic_uint_least64_t &contended, F &&lock) noexcept
+{
+	contended.fetch_add(1, std::memory_order_relaxed);
+
+	const auto start = std::chrono::steady_clock::now();
+	lock();
+	const auto duration = std::chrono::steady_clock::now() - start;
+
+	db_lock_counters.wait_us.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(duration).count(),
+					   std::memory_order_relaxed);
+}
+
+void
+db_lock_contended() noexcept
+{
+	WaitForLock(db_lock_counters.exclusive_contended,
+		    []{ db_mutex.lock(); });
+}
+
+void
+db_lock_shared_contended() noexcept
+{
+	WaitForLock(db_lock_counters.shared_contended,
+		    []{ db_mutex.lock_shared(); });
+}
@@ -5,66 +5,201 @@
  *
  * Support for locking data structures from the database, for safe
  * multi-threading.
+ *
+ * The lock can be obtained in "shared" mode by threads which only
+ * read the database (e.g. for a database query), and in "exclusive"
+ * mode by the update thread for modifying it.
  */
 
 #ifndef MPD_DB_LOCK_HXX
 #define MPD_DB_LOCK_HXX
 
-#include "thread/Mutex.hxx"
+#include "thread/SharedMutex.hxx"
 
+#include <atomic>
 #include <cassert>
+#include <cstdint>
 
-extern Mutex db_mutex;
+extern SharedMutex db_mutex;
 
-#ifndef NDEBUG
+/**
+ * Counters for diagnosing contention on the #db_mutex.
+ */
+struct DatabaseLockCounters {
+	/**
+	 * The number of times the lock was obtained.
+	 */
+	std::atomic_uint_least64_t shared{0}, exclusive{0};
+
+	/**
+	 * The number of times a thread had to wait for the lock.
+	 */
+	std::atomic_uint_least64_t shared_contended{0}, exclusive_contended{0};
 
-#include "thread/Id.hxx"
+	/**
+	 * The total time spent waiting for the lock [microseconds].
+	 */
+	std::atomic_uint_least64_t wait_us{0};
+};
 
-extern ThreadId db_mutex_holder;
+extern DatabaseLockCounters db_lock_counters;
 
 /**
- * Does the current thread hold the database lock?
+ * The number of modifications of the database tree; see
+ * db_modified() and db_generation().
+ */
+extern std::atomic_uint_least64_t db_modification_counter;
+
+enum class DatabaseLockMode : uint_least8_t {
+	NONE, SHARED, EXCLUSIVE,
+};
+
+/**
+ * The mode in which the current thread holds the database lock.
+ * This is tracked in release builds, too, because code which may
+ * block for a long time (e.g. waiting for a slow client) checks it
+ * to release a shared lock meanwhile.
+ */
+extern thread_local DatabaseLockMode db_lock_mode;
+
+/**
+ * Does the current thread hold the database lock (in any mode)?
  */
 [[gnu::pure]]
 static inline bool
 holding_db_lock() noexcept
 {
-	return db_mutex_holder.IsInside();
+	return db_lock_mode != DatabaseLockMode::NONE;
 }
 
-#endif
+/**
+ * Does the current thread hold the database lock in exclusive mode?
+ */
+[[gnu::pure]]
+static inline bool
+holding_db_exclusive_lock() noexcept
+{
+	return db_lock_mode == DatabaseLockMode::EXCLUSIVE;
+}
+
+/**
+ * Does the current thread hold the database lock in shared mode?
+ */
+[[gnu::pure]]
+static inline bool
+holding_db_shared_lock() noexcept
+{
+	return db_lock_mode == DatabaseLockMode::SHARED;
+}
+
+/**
+ * Note that the database tree has been modified (a song or
+ * directory was added or removed, or its attributes or tags were
+ * changed).  This invalidates everything derived from it, see
+ * db_generation().
+ *
+ * Caller must lock the #db_mutex exclusively (or be the update
+ * thread).
+ */
+static inline void
+db_modified() noexcept
+{
+	db_modification_counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * Returns a number which changes each time the database tree is
+ * modified (see db_modified()).  This allows caching data derived
+ * from the database while holding the lock in shared mode.
+ *
+ * Caller must lock the #db_mutex (in any mode).
+ */
+[[gnu::pure]]
+static inline uint_least64_t
+db_generation() noexcept
+{
+	assert(holding_db_lock());
+
+	return db_modification_counter.load(std::memory_order_relaxed);
+}
+
+/**
+ * Slow path of db_lock(): wait for the lock and update the
+ * contention counters.
+ */
+void
+db_lock_contended() noexcept;
+
+/**
+ * Slow path of db_lock_shared().
+ */
+void
+db_lock_shared_contended() noexcept;
 
 /**
- * Obtain the global database lock.  This is needed before
- * dereferencing a #song or #directory.  It is not recursive.
+ * Obtain the global database lock in exclusive mode.  This is needed
+ * before modifying a #song or #directory.  It is not recursive.
  */
 static inline void
 db_lock(void)
 {
 	assert(!holding_db_lock());
 
-	db_mutex.lock();
+	if (!db_mutex.try_lock()) [[unlikely]]
+		db_lock_contended();
 
-	assert(db_mutex_holder.IsNull());
-#ifndef NDEBUG
-	db_mutex_holder = ThreadId::GetCurrent();
-#endif
+	db_lock_counters.exclusive.fetch_add(1, std::memory_order_relaxed);
+
+	db_lock_mode = DatabaseLockMode::EXCLUSIVE;
 }
 
 /**
- * Release the global database lock.
+ * Release the global database lock obtained with db_lock().
  */
 static inline void
 db_unlock(void)
 {
-	assert(holding_db_lock());
-#ifndef NDEBUG
-	db_mutex_holder = ThreadId::Null();
-#endif
+	assert(holding_db_exclusive_lock());
+	db_lock_mode = DatabaseLockMode::NONE;
 
 	db_mutex.unlock();
 }
 
+/**
+ * Obtain the global database lock in shared mode.  This is needed
+ * before dereferencing a #song or #directory.  Other threads may
+ * hold the shared lock at the same time, but not the exclusive lock.
+ * It is not recursive.
+ */
+static inline void
+db_lock_shared(void)
+{
+	assert(!holding_db_lock());
+
+	if (!db_mutex.try_lock_shared()) [[unlikely]]
+		db_lock_shared_contended();
+
+	db_lock_counters.shared.fetch_add(1, std::memory_order_relaxed);
+
+	db_lock_mode = DatabaseLockMode::SHARED;
+}
+
+/**
+ * Release the global database lock obtained with db_lock_shared().
+ */
+static inline void
+db_unlock_shared(void)
+{
+	assert(holding_db_shared_lock());
+	db_lock_mode = DatabaseLockMode::NONE;
+
+	db_mutex.unlock_shared();
+}
+
+/**
+ * Obtain the database lock in exclusive mode while in the current
+ * scope.
+ */
 class ScopeDatabaseLock {
 	bool locked = true;
 
@@ -90,7 +225,7 @@ public:
 };
 
 /**
- * Unlock the database while in the current scope.
+ * Unlock the database (exclusive mode) while in the current scope.
  */
 class ScopeDatabaseUnlock {
 public:
@@ -103,4 +238,45 @@ public:
 	}
 };
 
+/**
+ * Obtain the database lock in shared mode while in the current scope.
+ */
+class ScopeDatabaseSharedLock {
+	bool locked = true;
+
+public:
+	ScopeDatabaseSharedLock() {
+		db_lock_shared();
+	}
+
+	~ScopeDatabaseSharedLock() {
+		if (locked)
+			db_unlock_shared();
+	}
+
+	/**
+	 * Unlock the mutex now, making the destructor a no-op.
+	 */
+	void unlock() {
+		assert(locked);
+
+		db_unlock_shared();
+		locked = false;
+	}
+};
+
+/**
+ * Unlock the database (shared mode) while in the current scope.
+ */
+class ScopeDatabaseSharedUnlock {
+public:
+	ScopeDatabaseSharedUnlock() {
+		db_unlock_shared();
+	}
+
+	~ScopeDatabaseSharedUnlock() {
+		db_lock_shared();
+	}
+};
+
 #endif
@@ -23,6 +23,14 @@ struct DatabasePlugin {
 	 */
 	static constexpr unsigned FLAG_REQUIRE_STORAGE = 0x1;
 
+	/**
+	 * The #Database methods which do not modify the database
+	 * (e.g. Visit()) may be called from any thread, even
+	 * concurrently.  This allows executing queries in a
+	 * #BackgroundCommandPool.
+	 */
+	static constexpr unsigned FLAG_CONCURRENT = 0x2;
+
 	const char *name;
 
 	unsigned flags;
@@ -45,6 +53,10 @@ struct DatabasePlugin {
 	constexpr bool RequireStorage() const {
 		return flags & FLAG_REQUIRE_STORAGE;
 	}
+
+	constexpr bool IsConcurrent() const {
+		return flags & FLAG_CONCURRENT;
+	}
 };
 
 #endif
@@ -15,7 +15,6 @@
 #include "Interface.hxx"
 #include "fs/Traits.hxx"
 #include "time/ChronoUtil.hxx"
-#include "util/RecursiveMap.hxx"
 
 #include <fmt/format.h>
 
@@ -135,23 +134,29 @@ db_selection_print(Response &r, Partition &partition,
 {
 	const Database &db = partition.GetDatabaseOrThrow();
 
+	/* each visitor calls Response::Flush() after printing one
+	   item, so large responses can be streamed */
+
 	const auto d = selection.filter == nullptr
 		? [&,base](const auto &dir)
-			{ return full ?
+			{ full ?
 				PrintDirectoryFull(r, base, dir) :
-				PrintDirectoryBrief(r, base, dir); }
+				PrintDirectoryBrief(r, base, dir);
+			  r.Flush(); }
 		: VisitDirectory();
 
 	VisitSong s = [&,base](const auto &song)
-		{ return full ?
+		{ full ?
 			PrintSongFull(r, base, song) :
-			PrintSongBrief(r, base, song); };
+			PrintSongBrief(r, base, song);
+		  r.Flush(); };
 
 	const auto p = selection.filter == nullptr
 		? [&,base](const auto &playlist, const auto &dir)
-			{ return full ?
+			{ full ?
 				PrintPlaylistFull(r, base, playlist, dir) :
-				PrintPlaylistBrief(r, base, playlist, dir); }
+				PrintPlaylistBrief(r, base, playlist, dir);
+			  r.Flush(); }
 		: VisitPlaylist();
 
 	db.Visit(selection, d, s, p);
@@ -171,35 +176,14 @@ PrintSongUris(Response &r, Partition &partition,
 
 	const DatabaseSelection selection{""sv, true, filter};
 
-	const auto f = [&](const auto &song)
-		{ return PrintSongURIVisitor(r, song); };
+	const auto f = [&](const auto &song) {
+		PrintSongURIVisitor(r, song);
+		r.Flush();
+	};
 
 	db.Visit(selection, f);
 }
 
-static void
-PrintUniqueTags(Response &r, std::span<const TagType> tag_types,
-		const RecursiveMap<std::string> &map,
-		const RangeArg window) noexcept
-{
-	const char *const name = tag_item_names[tag_types.front()];
-	tag_types = tag_types.subspan(1);
-
-	unsigned next_position = 0;
-	for (const auto &[key, tag] : map) {
-		const unsigned position = next_position++;
-		if (position < window.start)
-			continue;
-		else if (position >= window.end)
-			break;
-
-		r.Fmt("{}: {}\n", name, key);
-
-		if (!tag_types.empty())
-			PrintUniqueTags(r, tag_types, tag, RangeArg::All());
-	}
-}
-
 void
 PrintUniqueTags(Response &r, Partition &partition,
 		std::span<const TagType> tag_types,
@@ -210,7 +194,9 @@ PrintUniqueTags(Response &r, Partition &partition,
 
 	const DatabaseSelection selection{""sv, true, filter};
 
-	PrintUniqueTags(r, tag_types,
-			db.CollectUniqueTags(selection, tag_types),
-			window);
+	db.VisitUniqueTags(selection, tag_types, window,
+			   [&r, tag_types](std::size_t level, std::string_view value){
+		r.Fmt("{}: {}\n", tag_item_names[tag_types[level]], value);
+		r.Flush();
+	});
 }
@@ -28,3 +28,26 @@ AddFromDatabase(Partition &partition, const DatabaseSelection &selection)
 		{ return AddToQueue(partition, song); };
 	db.Visit(selection, f);
 }
+
+std::vector<DetachedSong>
+CollectFromDatabase(const Database &db, const Storage *storage,
+		    const DatabaseSelection &selection,
+		    std::size_t max_songs)
+{
+	std::vector<DetachedSong> songs;
+
+	const auto f = [&](const auto &song){
+		if (songs.size() < max_songs)
+			songs.emplace_back(DatabaseDetachSong(storage, song));
+	};
+	db.Visit(selection, f);
+
+	return songs;
+}
+
+void
+AppendToQueue(Partition &partition, std::vector<DetachedSong> &&songs)
+{
+	for (auto &song : songs)
+		partition.playlist.AppendSong(partition.pc, std::move(song));
+}
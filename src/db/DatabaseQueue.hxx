@@ -4,10 +4,39 @@
 #ifndef MPD_DATABASE_QUEUE_HXX
 #define MPD_DATABASE_QUEUE_HXX
 
+#include <cstddef>
+#include <vector>
+
 struct Partition;
 struct DatabaseSelection;
+class Database;
+class Storage;
+class DetachedSong;
 
 void
 AddFromDatabase(Partition &partition, const DatabaseSelection &selection);
 
+/**
+ * Collect the selected songs.  Unlike AddFromDatabase(), this does
+ * not touch the queue, and it may be called in any thread if the
+ * #Database supports concurrent access.  Pass the result to
+ * AppendToQueue().
+ *
+ * Throws on error.
+ *
+ * @param max_songs stop collecting after this number of songs
+ */
+std::vector<DetachedSong>
+CollectFromDatabase(const Database &db, const Storage *storage,
+		    const DatabaseSelection &selection,
+		    std::size_t max_songs);
+
+/**
+ * Append songs returned by CollectFromDatabase() to the queue.
+ *
+ * Throws on error (e.g. if the queue is full).
+ */
+void
+AppendToQueue(Partition &partition, std::vector<DetachedSong> &&songs);
+
 #endif
@@ -5,6 +5,7 @@
 #define MPD_DATABASE_INTERFACE_HXX
 
 #include "Visitor.hxx"
+#include "protocol/RangeArg.hxx"
 
 #include <chrono>
 #include <cstdint>
@@ -16,7 +17,6 @@ struct DatabasePlugin;
 struct DatabaseStats;
 struct DatabaseSelection;
 struct LightSong;
-template<typename Key> class RecursiveMap;
 
 class Database {
 	const DatabasePlugin &plugin;
@@ -89,20 +89,34 @@ public:
 	}
 
 	/**
-	 * Collect unique values of the given tag types.  Each item in
-	 * the #tag_types parameter results in one nesting level in
-	 * the return value.
+	 * Visit unique combinations of values of the given tag types
+	 * in sorted order.  Each item in the #tag_types parameter
+	 * results in one nesting level; values of a level are only
+	 * passed to the visitor if they differ from the previous
+	 * combination at this or a lower level.
 	 *
 	 * Throws on error.
+	 *
+	 * @param window the range of unique values of the first tag
+	 * type which shall be visited
 	 */
-	virtual RecursiveMap<std::string> CollectUniqueTags(const DatabaseSelection &selection,
-							    std::span<const TagType> tag_types) const = 0;
+	virtual void VisitUniqueTags(const DatabaseSelection &selection,
+				     std::span<const TagType> tag_types,
+				     RangeArg window,
+				     const VisitUniqueTag &visit) const = 0;
 
 	/**
 	 * Throws on error.
 	 */
 	virtual DatabaseStats GetStats(const DatabaseSelection &selection) const = 0;
 
+	/**
+	 * Visit implementation specific statistics (e.g. about
+	 * indexes and locking) as name/value pairs.  They are
+	 * appended to the "stats" response.
+	 */
+	virtual void VisitStats([[maybe_unused]] const VisitStat &visit) const noexcept {}
+
 	/**
 	 * Update the database.
 	 *
@@ -4,34 +4,215 @@
 #include "UniqueTags.hxx"
 #include "Interface.hxx"
 #include "song/LightSong.hxx"
+#include "tag/Pool.hxx"
+#include "tag/Tag.hxx"
 #include "tag/VisitFallback.hxx"
-#include "util/RecursiveMap.hxx"
 
-static void
-CollectUniqueTags(RecursiveMap<std::string> &result,
-		  const Tag &tag,
-		  std::span<const TagType> tag_types) noexcept
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <numeric>
+
+UniqueTagCollector::~UniqueTagCollector() noexcept
+{
+	ReleaseItems();
+}
+
+void
+UniqueTagCollector::ReleaseItems() noexcept
+{
+	if (items.empty())
+		return;
+
+	const std::scoped_lock<Mutex> protect(tag_pool_lock);
+	for (TagItem *item : items)
+		tag_pool_put_item(item);
+
+	items.clear();
+}
+
+void
+UniqueTagCollector::AddRow(const Tag &tag, const char **row,
+			   std::size_t level)
 {
-	if (tag_types.empty())
+	if (level == tag_types.size()) {
+		rows.insert(rows.end(), row, row + level);
 		return;
+	}
+
+	VisitTagWithFallbackOrEmpty(tag, tag_types[level], [&](const char *value){
+		row[level] = value;
+		AddRow(tag, row, level + 1);
+	});
+}
+
+void
+UniqueTagCollector::Add(const Tag &tag, bool stable)
+{
+	assert(!tag_types.empty());
+	assert(!sorted);
+
+	if (!stable && tag.num_items > 0) {
+		items.reserve(items.size() + tag.num_items);
+
+		const std::scoped_lock<Mutex> protect(tag_pool_lock);
+		for (unsigned i = 0; i < tag.num_items; ++i)
+			items.push_back(tag_pool_dup_item(tag.items[i]));
+	}
+
+	const char *row[TAG_NUM_OF_ITEM_TYPES];
+	assert(tag_types.size() <= std::size(row));
+
+	AddRow(tag, row, 0);
+}
+
+/**
+ * Compare two rows bytewise, i.e. in the same order as
+ * std::string::compare().
+ */
+[[gnu::pure]]
+static int
+CompareRows(const char *const*a, const char *const*b,
+	    std::size_t n_columns) noexcept
+{
+	for (std::size_t i = 0; i < n_columns; ++i) {
+		if (a[i] == b[i])
+			/* same pool item (or both are the empty
+			   fallback) */
+			continue;
+
+		if (int result = std::strcmp(a[i], b[i]); result != 0)
+			return result;
+	}
+
+	return 0;
+}
+
+std::vector<std::size_t>
+UniqueTagCollector::SortRows() const noexcept
+{
+	const std::size_t n_columns = tag_types.size();
+	const std::size_t n_rows = rows.size() / n_columns;
+
+	/* sort row indices instead of moving the rows around */
+	std::vector<std::size_t> order(n_rows);
+	std::iota(order.begin(), order.end(), std::size_t{});
+
+	if (sorted)
+		return order;
+
+	const auto row = [this, n_columns](std::size_t i){
+		return rows.data() + i * n_columns;
+	};
+
+	std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b){
+		return CompareRows(row(a), row(b), n_columns) < 0;
+	});
+
+	return order;
+}
+
+void
+UniqueTagCollector::Detach()
+{
+	const std::size_t n_columns = tag_types.size();
+
+	std::vector<const char *> unique_rows;
+	std::size_t total_size = 0;
+
+	const char *const*previous = nullptr;
+	for (const std::size_t i : SortRows()) {
+		const char *const*current = rows.data() + i * n_columns;
+		if (previous != nullptr &&
+		    CompareRows(previous, current, n_columns) == 0)
+			continue;
+
+		previous = current;
+
+		for (std::size_t level = 0; level < n_columns; ++level)
+			total_size += std::strlen(current[level]) + 1;
+
+		unique_rows.insert(unique_rows.end(),
+				   current, current + n_columns);
+	}
+
+	/* reserve all memory at once, so the pointers into the
+	   buffer remain valid */
+	strings.clear();
+	strings.reserve(total_size);
+
+	for (const char *&value : unique_rows) {
+		const char *copy = strings.data() + strings.size();
+		strings.insert(strings.end(),
+			       value, value + std::strlen(value) + 1);
+		value = copy;
+	}
+
+	rows = std::move(unique_rows);
+	sorted = true;
+
+	ReleaseItems();
+}
+
+void
+UniqueTagCollector::Visit(RangeArg window, const VisitUniqueTag &visit) const
+{
+	const std::size_t n_columns = tag_types.size();
+
+	const auto row = [this, n_columns](std::size_t i){
+		return rows.data() + i * n_columns;
+	};
+
+	const auto order = SortRows();
+
+	const char *const*previous = nullptr;
+	unsigned next_position = 0, position = 0;
+
+	for (const std::size_t i : order) {
+		const char *const*current = row(i);
+
+		/* find the first level which differs from the
+		   previous combination */
+		std::size_t level = 0;
+		if (previous != nullptr) {
+			while (level < n_columns &&
+			       (previous[level] == current[level] ||
+				std::strcmp(previous[level], current[level]) == 0))
+				++level;
+
+			if (level == n_columns)
+				/* duplicate */
+				continue;
+		}
+
+		previous = current;
+
+		if (level == 0)
+			position = next_position++;
 
-	const auto tag_type = tag_types.front();
-	tag_types = tag_types.subspan(1);
+		if (position < window.start)
+			continue;
+		else if (position >= window.end)
+			break;
 
-	VisitTagWithFallbackOrEmpty(tag, tag_type, [&result, &tag, tag_types](const char *value){
-			CollectUniqueTags(result[value], tag, tag_types);
-		});
+		for (; level < n_columns; ++level)
+			visit(level, current[level]);
+	}
 }
 
-RecursiveMap<std::string>
-CollectUniqueTags(const Database &db, const DatabaseSelection &selection,
-		  std::span<const TagType> tag_types)
+void
+VisitUniqueTags(const Database &db, const DatabaseSelection &selection,
+		std::span<const TagType> tag_types,
+		RangeArg window, const VisitUniqueTag &visit)
 {
-	RecursiveMap<std::string> result;
+	UniqueTagCollector collector{tag_types};
 
-	db.Visit(selection, [&result, tag_types](const LightSong &song){
-			CollectUniqueTags(result, song.tag, tag_types);
-		});
+	/* the LightSong instances are only valid during the
+	   callback, therefore the collector needs to reference the
+	   tag pool items */
+	db.Visit(selection, [&collector](const LightSong &song){
+		collector.Add(song.tag, false);
+	});
 
-	return result;
+	collector.Visit(window, visit);
 }
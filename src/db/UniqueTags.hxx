@@ -4,20 +4,106 @@
 #ifndef MPD_DB_UNIQUE_TAGS_HXX
 #define MPD_DB_UNIQUE_TAGS_HXX
 
+#include "Visitor.hxx"
+#include "protocol/RangeArg.hxx"
+
 #include <cstdint>
 #include <span>
-#include <string>
+#include <vector>
 
 enum TagType : uint8_t;
+struct Tag;
+struct TagItem;
 class Database;
 struct DatabaseSelection;
-template<typename Key> class RecursiveMap;
 
 /**
- * Walk the database and collect unique tag values.
+ * Collects unique combinations of tag values and visits them in
+ * sorted order.  Instead of copying the values into a tree of
+ * strings, this class stores pointers to the values of the (pooled)
+ * #TagItem instances, one row of pointers per combination.
+ */
+class UniqueTagCollector {
+	const std::span<const TagType> tag_types;
+
+	/**
+	 * The collected combinations; each row consists of
+	 * tag_types.size() pointers.
+	 */
+	std::vector<const char *> rows;
+
+	/**
+	 * References to tag pool items which keep the values of
+	 * unstable #Tag instances alive; they are released by the
+	 * destructor.
+	 */
+	std::vector<TagItem *> items;
+
+	/**
+	 * Copies of the values made by Detach().
+	 */
+	std::vector<char> strings;
+
+	/**
+	 * Are #rows already sorted and unique (after Detach())?
+	 */
+	bool sorted = false;
+
+public:
+	explicit UniqueTagCollector(std::span<const TagType> _tag_types) noexcept
+		:tag_types(_tag_types) {}
+
+	~UniqueTagCollector() noexcept;
+
+	UniqueTagCollector(const UniqueTagCollector &) = delete;
+	UniqueTagCollector &operator=(const UniqueTagCollector &) = delete;
+
+	/**
+	 * Add all value combinations of the given #Tag.
+	 *
+	 * @param stable true if the caller guarantees that the #Tag
+	 * outlives the Visit() call (e.g. because it is owned by the
+	 * database and the database lock is held); if false, the tag
+	 * pool items are referenced
+	 */
+	void Add(const Tag &tag, bool stable);
+
+	/**
+	 * Sort and deduplicate the collected combinations and copy
+	 * their values, so they do not refer to the #Tag instances
+	 * passed to Add() anymore.  This allows the caller to release
+	 * the database lock before calling Visit(), while copying
+	 * only the unique values.
+	 */
+	void Detach();
+
+	/**
+	 * Sort and deduplicate the collected combinations and pass
+	 * them to the visitor.
+	 *
+	 * @param window the range of unique values of the first tag
+	 * type which shall be visited
+	 */
+	void Visit(RangeArg window, const VisitUniqueTag &visit) const;
+
+private:
+	void AddRow(const Tag &tag, const char **row, std::size_t level);
+
+	/**
+	 * Returns the row indices in sorted order.
+	 */
+	std::vector<std::size_t> SortRows() const noexcept;
+
+	void ReleaseItems() noexcept;
+};
+
+/**
+ * Walk the database and visit unique tag values.  This is the
+ * generic implementation of Database::VisitUniqueTags().
  */
-RecursiveMap<std::string>
-CollectUniqueTags(const Database &db, const DatabaseSelection &selection,
-		  std::span<const TagType> tag_types);
+void
+VisitUniqueTags(const Database &db, const DatabaseSelection &selection,
+		std::span<const TagType> tag_types,
+		RangeArg window, const VisitUniqueTag &visit);
 
 #endif
@@ -11,6 +11,29 @@
 #include <cassert>
 #include <utility>
 
+SongSortKey::SongSortKey(const LightSong &song) noexcept
+	:tag(&song.tag), mtime(song.mtime), added(song.added) {}
+
+SongSortKey::SongSortKey(const DetachedSong &song) noexcept
+	:tag(&song.GetTag()), mtime(song.GetLastModified()),
+	 added(song.GetAdded()) {}
+
+bool
+IsSortedBefore(TagType sort, bool descending,
+	       const SongSortKey &a, const SongSortKey &b) noexcept
+{
+	if (sort == TagType(SORT_TAG_LAST_MODIFIED))
+		return descending
+			? a.mtime > b.mtime
+			: a.mtime < b.mtime;
+	else if (sort == TagType(SORT_TAG_ADDED))
+		return descending
+			? a.added > b.added
+			: a.added < b.added;
+	else
+		return CompareTags(sort, descending, *a.tag, *b.tag);
+}
+
 DatabaseVisitorHelper::DatabaseVisitorHelper(DatabaseSelection _selection,
 					     VisitSong &visit_song) noexcept
 	:selection(std::move(_selection))
@@ -27,7 +50,7 @@ DatabaseVisitorHelper::DatabaseVisitorHelper(DatabaseSelection _selection,
 
 		original_visit_song = std::move(visit_song);
 		visit_song = [this](const auto &song){
-			songs.emplace_back(song);
+			AddSorted(song);
 		};
 	} else if (selection.window != RangeArg::All()) {
 		original_visit_song = std::move(visit_song);
@@ -40,6 +63,57 @@ DatabaseVisitorHelper::DatabaseVisitorHelper(DatabaseSelection _selection,
 
 DatabaseVisitorHelper::~DatabaseVisitorHelper() noexcept = default;
 
+inline bool
+DatabaseVisitorHelper::IsBefore(const SortItem &a,
+				const SortItem &b) const noexcept
+{
+	const SongSortKey ka{a.song}, kb{b.song};
+	if (IsSortedBefore(selection.sort, selection.descending, ka, kb))
+		return true;
+
+	if (IsSortedBefore(selection.sort, selection.descending, kb, ka))
+		return false;
+
+	return a.position < b.position;
+}
+
+inline void
+DatabaseVisitorHelper::AddSorted(const LightSong &song)
+{
+	const unsigned position = counter++;
+
+	const auto before = [this](const SortItem &a, const SortItem &b){
+		return IsBefore(a, b);
+	};
+
+	if (selection.window.IsOpenEnded()) {
+		songs.push_back({DetachedSong{song}, position});
+		return;
+	}
+
+	if (songs.size() < selection.window.end) {
+		/* the heap is not yet full */
+		songs.push_back({DetachedSong{song}, position});
+		std::push_heap(songs.begin(), songs.end(), before);
+		return;
+	}
+
+	if (songs.empty())
+		/* empty window */
+		return;
+
+	/* only copy the song if it replaces the last one in the
+	   heap; equal songs are not moved before it, because they
+	   were visited later */
+	if (!IsSortedBefore(selection.sort, selection.descending,
+			    SongSortKey{song}, SongSortKey{songs.front().song}))
+		return;
+
+	std::pop_heap(songs.begin(), songs.end(), before);
+	songs.back() = {DetachedSong{song}, position};
+	std::push_heap(songs.begin(), songs.end(), before);
+}
+
 void
 DatabaseVisitorHelper::Commit()
 {
@@ -50,37 +124,23 @@ DatabaseVisitorHelper::Commit()
 	assert(original_visit_song);
 
 	/* sort the song collection */
-	const auto sort = selection.sort;
-	const auto descending = selection.descending;
-
-	if (sort == TagType(SORT_TAG_LAST_MODIFIED))
+	if (selection.window.IsOpenEnded())
+		/* the songs were added in visiting order */
 		std::stable_sort(songs.begin(), songs.end(),
-				 [descending](const DetachedSong &a, const DetachedSong &b){
-					 return descending
-						 ? a.GetLastModified() > b.GetLastModified()
-						 : a.GetLastModified() < b.GetLastModified();
-				 });
-	else if (sort == TagType(SORT_TAG_ADDED))
-		std::stable_sort(songs.begin(), songs.end(),
-				 [descending](const DetachedSong &a, const DetachedSong &b){
-					 return descending
-						 ? a.GetAdded() > b.GetAdded()
-						 : a.GetAdded() < b.GetAdded();
+				 [this](const SortItem &a, const SortItem &b){
+					 return IsSortedBefore(selection.sort,
+							       selection.descending,
+							       SongSortKey{a.song},
+							       SongSortKey{b.song});
 				 });
 	else
-		std::stable_sort(songs.begin(), songs.end(),
-				 [sort, descending](const DetachedSong &a,
-						    const DetachedSong &b){
-					 return CompareTags(sort, descending,
-							    a.GetTag(),
-							    b.GetTag());
-				 });
+		/* the heap contains at most window.end songs */
+		std::sort_heap(songs.begin(), songs.end(),
+			       [this](const SortItem &a, const SortItem &b){
+				       return IsBefore(a, b);
+			       });
 
 	/* apply the "window" */
-	if (selection.window.end < songs.size())
-		songs.erase(std::next(songs.begin(), selection.window.end),
-			    songs.end());
-
 	if (selection.window.start >= songs.size())
 		return;
 
@@ -88,6 +148,6 @@ DatabaseVisitorHelper::Commit()
 		    std::next(songs.begin(), selection.window.start));
 
 	/* now pass all songs to the original visitor callback */
-	for (const auto &song : songs)
-		original_visit_song((LightSong)song);
+	for (const auto &i : songs)
+		original_visit_song((LightSong)i.song);
 }
@@ -6,10 +6,37 @@
 
 #include "Visitor.hxx"
 #include "Selection.hxx"
+#include "song/DetachedSong.hxx"
 
+#include <chrono>
 #include <vector>
 
-class DetachedSong;
+struct Tag;
+
+/**
+ * The attributes of a song which determine its position in a sorted
+ * result (see DatabaseSelection::sort).
+ */
+struct SongSortKey {
+	const Tag *tag;
+	std::chrono::system_clock::time_point mtime, added;
+
+	explicit SongSortKey(const LightSong &song) noexcept;
+	explicit SongSortKey(const DetachedSong &song) noexcept;
+};
+
+/**
+ * Shall the song with key #a be moved before the song with key #b?
+ * Songs which compare equal keep their order (i.e. this is used with
+ * std::stable_sort()).
+ *
+ * @param sort the #DatabaseSelection::sort value (not
+ * #TAG_NUM_OF_ITEM_TYPES)
+ */
+[[gnu::pure]]
+bool
+IsSortedBefore(TagType sort, bool descending,
+	       const SongSortKey &a, const SongSortKey &b) noexcept;
 
 /**
  * This class helps implementing Database::Visit() by emulating
@@ -23,12 +50,24 @@ class DetachedSong;
 class DatabaseVisitorHelper {
 	const DatabaseSelection selection;
 
+	struct SortItem {
+		DetachedSong song;
+
+		/**
+		 * The visiting order, which decides between songs
+		 * with equal sort keys.
+		 */
+		unsigned position;
+	};
+
 	/**
 	 * If the plugin can't sort, then this container will collect
 	 * all songs, sort them and report them to the visitor in
-	 * Commit().
+	 * Commit().  If the "window" has an end, then only the first
+	 * window.end songs are kept in a heap whose front is the
+	 * last one.
 	 */
-	std::vector<DetachedSong> songs;
+	std::vector<SortItem> songs;
 
 	VisitSong original_visit_song;
 
@@ -49,6 +88,12 @@ public:
 	~DatabaseVisitorHelper() noexcept;
 
 	void Commit();
+
+private:
+	[[gnu::pure]]
+	bool IsBefore(const SortItem &a, const SortItem &b) const noexcept;
+
+	void AddSorted(const LightSong &song);
 };
 
 #endif
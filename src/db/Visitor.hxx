@@ -4,7 +4,10 @@
 #ifndef MPD_DATABASE_VISITOR_HXX
 #define MPD_DATABASE_VISITOR_HXX
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <string_view>
 
 struct LightDirectory;
 struct LightSong;
@@ -18,4 +21,18 @@ typedef std::function<void(const PlaylistInfo &,
 
 typedef std::function<void(const Tag &)> VisitTag;
 
+/**
+ * Receives one value from Database::VisitUniqueTags().  The level is
+ * the index into the "tag_types" parameter; a value on level N
+ * belongs to the most recent values on levels 0..N-1.
+ */
+typedef std::function<void(std::size_t level,
+			   std::string_view value)> VisitUniqueTag;
+
+/**
+ * Receives one statistics value from Database::VisitStats().
+ */
+typedef std::function<void(std::string_view name,
+			   uint_least64_t value)> VisitStat;
+
 #endif
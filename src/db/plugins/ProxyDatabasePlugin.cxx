@@ -116,8 +116,10 @@ public:
 		   VisitSong visit_song,
 		   VisitPlaylist visit_playlist) const override;
 
-	RecursiveMap<std::string> CollectUniqueTags(const DatabaseSelection &selection,
-						    std::span<const TagType> tag_types) const override;
+	void VisitUniqueTags(const DatabaseSelection &selection,
+			     std::span<const TagType> tag_types,
+			     RangeArg window,
+			     const VisitUniqueTag &visit) const override;
 
 	DatabaseStats GetStats(const DatabaseSelection &selection) const override;
 
@@ -134,6 +136,10 @@ private:
 
 	void Disconnect() noexcept;
 
+	RecursiveMap<std::string> CollectUniqueTags(const DatabaseSelection &selection,
+						    std::span<const TagType> tag_types,
+						    const RangeArg &window) const;
+
 	void OnSocketReady(unsigned flags) noexcept;
 	void OnIdle() noexcept;
 };
@@ -897,7 +903,8 @@ ProxyDatabase::Visit(const DatabaseSelection &selection,
 
 RecursiveMap<std::string>
 ProxyDatabase::CollectUniqueTags(const DatabaseSelection &selection,
-				 std::span<const TagType> tag_types) const
+				 std::span<const TagType> tag_types,
+				 const RangeArg &window) const
 try {
 	// TODO: eliminate the const_cast
 	const_cast<ProxyDatabase *>(this)->EnsureConnected();
@@ -909,7 +916,7 @@ try {
 	const auto group = tag_types.first(tag_types.size() - 1);
 
 	if (!mpd_search_db_tags(connection, tag_type2) ||
-	    !SendConstraints(connection, selection, selection.window) ||
+	    !SendConstraints(connection, selection, window) ||
 	    !SendGroup(connection, group))
 		ThrowError(connection);
 
@@ -956,6 +963,43 @@ try {
 	throw;
 }
 
+static void
+VisitRecursiveMap(const RecursiveMap<std::string> &map, RangeArg window,
+		  const VisitUniqueTag &visit, std::size_t level)
+{
+	unsigned next_position = 0;
+	for (const auto &[key, child] : map) {
+		const unsigned position = next_position++;
+		if (position < window.start)
+			continue;
+		else if (position >= window.end)
+			break;
+
+		visit(level, key);
+		VisitRecursiveMap(child, RangeArg::All(), visit, level + 1);
+	}
+}
+
+void
+ProxyDatabase::VisitUniqueTags(const DatabaseSelection &selection,
+			       std::span<const TagType> tag_types,
+			       RangeArg window,
+			       const VisitUniqueTag &visit) const
+{
+	// TODO: eliminate the const_cast
+	const_cast<ProxyDatabase *>(this)->EnsureConnected();
+
+	/* "list" implements "window" since MPD 0.25; with older
+	   servers, the window is applied here */
+	const bool remote_window =
+		mpd_connection_cmp_server_version(connection, 0, 25, 0) >= 0;
+
+	const auto map = CollectUniqueTags(selection, tag_types,
+					   remote_window ? window : RangeArg::All());
+	VisitRecursiveMap(map, remote_window ? RangeArg::All() : window,
+			  visit, 0);
+}
+
 DatabaseStats
 ProxyDatabase::GetStats(const DatabaseSelection &selection) const
 {
@@ -0,0 +1,707 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "BinaryDatabase.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "SongArena.hxx"
+#include "song/Analysis.hxx"
+#include "db/DatabaseLock.hxx"
+#include "io/BufferedOutputStream.hxx"
+#include "io/FileReader.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "tag/Builder.hxx"
+#include "tag/Settings.hxx"
+#include "fs/Charset.hxx"
+#include "fs/Path.hxx"
+#include "time/ChronoUtil.hxx"
+#include "util/ByteOrder.hxx"
+#include "util/SpanCast.hxx"
+#include "util/StringAPI.hxx"
+#include "Version.h"
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <string.h>
+
+/*
+ * File layout: a #BinaryHeader followed by the record arrays
+ * (directories, songs, tag items, playlists, song analyses), each
+ * aligned to 8 bytes, and finally the string table.  All strings are referenced
+ * by their offset in the string table; identical strings (e.g. tag
+ * values shared by all songs of an album) are stored only once.
+ *
+ * Directories are stored in pre-order, i.e. each directory's parent
+ * precedes it, and the first record is the root directory.  The
+ * songs and playlists of a directory are stored contiguously.
+ *
+ * All integers and floating point values are stored in little-endian
+ * byte order, so the file can be shared between hosts; LE() converts
+ * each field when it is written and read.
+ */
+
+static constexpr char BINARY_MAGIC[8] = {
+	'M', 'P', 'D', 'B', 'I', 'N', 'D', 'B',
+};
+
+static constexpr uint32_t BINARY_FORMAT = 3;
+
+static constexpr uint32_t BINARY_BYTE_ORDER = 0x01020304;
+
+/**
+ * Special value for BinaryDirectory::parent (the root directory).
+ */
+static constexpr uint32_t BINARY_NO_PARENT = UINT32_MAX;
+
+/**
+ * Special value for time stamps which are unknown/unavailable.
+ */
+static constexpr int64_t BINARY_NO_TIME = INT64_MIN;
+
+/**
+ * Special value for BinarySong::analysis (not analyzed).
+ */
+static constexpr uint32_t BINARY_NO_ANALYSIS = UINT32_MAX;
+
+static constexpr uint8_t BINARY_SONG_IN_PLAYLIST = 0x1;
+static constexpr uint8_t BINARY_SONG_HAS_PLAYLIST = 0x2;
+
+struct BinarySection {
+	uint64_t offset, count;
+};
+
+struct BinaryHeader {
+	char magic[sizeof(BINARY_MAGIC)];
+	uint32_t format;
+	uint32_t byte_order;
+
+	/**
+	 * A bit mask of all tag types which were enabled when this
+	 * file was written.
+	 */
+	uint64_t tag_mask;
+
+	uint32_t fs_charset, mpd_version;
+
+	BinarySection directories, songs, tag_items, playlists, analyses,
+		strings;
+};
+
+struct BinaryDirectory {
+	uint32_t name, parent;
+	int64_t mtime;
+	uint32_t device;
+	uint32_t first_song, n_songs;
+	uint32_t first_playlist, n_playlists;
+	uint32_t reserved;
+};
+
+struct BinarySong {
+	uint32_t filename, target;
+	int64_t mtime, added;
+	uint32_t start_ms, end_ms;
+	int32_t duration_ms;
+	uint32_t sample_rate;
+	uint32_t first_tag_item;
+	uint16_t n_tag_items;
+	uint8_t format, channels;
+	uint8_t flags;
+	uint8_t reserved[3];
+
+	/**
+	 * Index of the #BinarySongAnalysis or #BINARY_NO_ANALYSIS.
+	 */
+	uint32_t analysis;
+};
+
+struct BinaryTagItem {
+	uint32_t value;
+	uint8_t type;
+	uint8_t reserved[3];
+};
+
+struct BinaryPlaylist {
+	uint32_t name, reserved;
+	int64_t mtime;
+};
+
+struct BinarySongAnalysis {
+	float track_gain, track_peak, album_gain, album_peak;
+	uint32_t mix_ramp_start, mix_ramp_end;
+};
+
+static_assert(sizeof(BinaryHeader) % 8 == 0);
+static_assert(sizeof(BinaryDirectory) % 8 == 0);
+static_assert(sizeof(BinarySong) % 8 == 0);
+static_assert(sizeof(BinaryTagItem) % 8 == 0);
+static_assert(sizeof(BinaryPlaylist) % 8 == 0);
+static_assert(sizeof(BinarySongAnalysis) % 8 == 0);
+
+/**
+ * Convert between host byte order and little-endian (the conversion
+ * is its own inverse).
+ */
+static constexpr uint16_t
+LE(uint16_t value) noexcept
+{
+	return ToLE16(value);
+}
+
+static constexpr uint32_t
+LE(uint32_t value) noexcept
+{
+	return ToLE32(value);
+}
+
+static constexpr uint64_t
+LE(uint64_t value) noexcept
+{
+	return ToLE64(value);
+}
+
+static constexpr int32_t
+LE(int32_t value) noexcept
+{
+	return static_cast<int32_t>(ToLE32(static_cast<uint32_t>(value)));
+}
+
+static constexpr int64_t
+LE(int64_t value) noexcept
+{
+	return static_cast<int64_t>(ToLE64(static_cast<uint64_t>(value)));
+}
+
+static constexpr float
+LE(float value) noexcept
+{
+	return std::bit_cast<float>(ToLE32(std::bit_cast<uint32_t>(value)));
+}
+
+static constexpr int64_t
+ExportTime(std::chrono::system_clock::time_point t) noexcept
+{
+	return LE(IsNegative(t)
+		  ? BINARY_NO_TIME
+		  : int64_t(std::chrono::system_clock::to_time_t(t)));
+}
+
+static constexpr std::chrono::system_clock::time_point
+ImportTime(int64_t t) noexcept
+{
+	t = LE(t);
+	return t == BINARY_NO_TIME
+		? std::chrono::system_clock::time_point::min()
+		: std::chrono::system_clock::from_time_t(t);
+}
+
+[[gnu::pure]]
+static uint64_t
+GetEnabledTagMask() noexcept
+{
+	uint64_t mask = 0;
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (IsTagEnabled(i))
+			mask |= uint64_t(1) << i;
+	return mask;
+}
+
+bool
+IsBinaryDatabase(std::span<const std::byte> src) noexcept
+{
+	return src.size() >= sizeof(BINARY_MAGIC) &&
+		memcmp(src.data(), BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0;
+}
+
+bool
+IsBinaryDatabaseFile(Path path)
+{
+	std::array<std::byte, sizeof(BINARY_MAGIC)> buffer;
+	FileReader reader{path};
+	const std::size_t nbytes = reader.Read(buffer);
+	return IsBinaryDatabase(std::span{buffer}.first(nbytes));
+}
+
+namespace {
+
+class BinaryDatabaseWriter {
+	std::string strings;
+
+	/**
+	 * Maps string values to their offset in #strings.  The
+	 * keys point into the #Directory tree, which must not be
+	 * modified while this object exists.
+	 */
+	std::unordered_map<std::string_view, uint32_t> string_map;
+
+	std::vector<BinaryDirectory> directories;
+	std::vector<BinarySong> songs;
+	std::vector<BinaryTagItem> tag_items;
+	std::vector<BinaryPlaylist> playlists;
+	std::vector<BinarySongAnalysis> analyses;
+
+	uint32_t fs_charset, mpd_version;
+
+public:
+	BinaryDatabaseWriter() {
+		/* offset 0 is the empty string */
+		strings.push_back('\0');
+		string_map.emplace(std::string_view{}, 0);
+
+		fs_charset = AddString(GetFSCharset());
+		mpd_version = AddString(VERSION);
+	}
+
+	void AddDirectory(const Directory &directory, uint32_t parent);
+
+	void Write(BufferedOutputStream &os) const;
+
+private:
+	uint32_t AddString(std::string_view s);
+	uint32_t AddString(const char *s) {
+		return AddString(std::string_view{s != nullptr ? s : ""});
+	}
+
+	uint32_t AddAnalysis(const SongAnalysis &analysis);
+	void AddSong(const Song &song);
+};
+
+}
+
+uint32_t
+BinaryDatabaseWriter::AddString(std::string_view s)
+{
+	auto [i, inserted] = string_map.try_emplace(s, 0);
+	if (inserted) {
+		if (strings.size() + s.size() >= UINT32_MAX)
+			throw std::runtime_error("Database too large");
+
+		i->second = strings.size();
+		strings.append(s);
+		strings.push_back('\0');
+	}
+
+	return i->second;
+}
+
+inline uint32_t
+BinaryDatabaseWriter::AddAnalysis(const SongAnalysis &analysis)
+{
+	const uint32_t index = analyses.size();
+
+	BinarySongAnalysis &b = analyses.emplace_back();
+	b.track_gain = LE(analysis.replay_gain.track.gain);
+	b.track_peak = LE(analysis.replay_gain.track.peak);
+	b.album_gain = LE(analysis.replay_gain.album.gain);
+	b.album_peak = LE(analysis.replay_gain.album.peak);
+	b.mix_ramp_start = LE(AddString(analysis.mix_ramp.GetStart()));
+	b.mix_ramp_end = LE(AddString(analysis.mix_ramp.GetEnd()));
+
+	return index;
+}
+
+inline void
+BinaryDatabaseWriter::AddSong(const Song &song)
+{
+	const uint32_t analysis = song.analysis != nullptr
+		? AddAnalysis(*song.analysis)
+		: BINARY_NO_ANALYSIS;
+
+	BinarySong &b = songs.emplace_back();
+	b.filename = LE(AddString(song.filename));
+	b.target = LE(AddString(song.target));
+	b.mtime = ExportTime(song.mtime);
+	b.added = ExportTime(song.added);
+	b.start_ms = LE(uint32_t(song.start_time.ToMS()));
+	b.end_ms = LE(uint32_t(song.end_time.ToMS()));
+	b.duration_ms = LE(int32_t(song.tag.duration.count()));
+	b.sample_rate = LE(uint32_t(song.audio_format.sample_rate));
+	b.format = uint8_t(song.audio_format.format);
+	b.channels = song.audio_format.channels;
+	b.first_tag_item = LE(uint32_t(tag_items.size()));
+	b.n_tag_items = LE(uint16_t(song.tag.num_items));
+	b.analysis = LE(analysis);
+
+	if (song.in_playlist)
+		b.flags |= BINARY_SONG_IN_PLAYLIST;
+	if (song.tag.has_playlist)
+		b.flags |= BINARY_SONG_HAS_PLAYLIST;
+
+	for (const auto &item : song.tag) {
+		BinaryTagItem &t = tag_items.emplace_back();
+		t.type = item.type;
+		t.value = LE(AddString(item.value));
+	}
+}
+
+void
+BinaryDatabaseWriter::AddDirectory(const Directory &directory,
+				   uint32_t parent)
+{
+	const uint32_t index = directories.size();
+
+	const uint32_t name = directory.IsRoot()
+		? 0
+		: AddString(directory.GetName());
+
+	const uint32_t first_song = songs.size();
+	for (const auto &song : directory.songs)
+		AddSong(song);
+
+	const uint32_t first_playlist = playlists.size();
+	for (const auto &playlist : directory.playlists) {
+		BinaryPlaylist &p = playlists.emplace_back();
+		p.name = LE(AddString(playlist.name));
+		p.mtime = ExportTime(playlist.mtime);
+	}
+
+	BinaryDirectory &b = directories.emplace_back();
+	b.name = LE(name);
+	b.parent = LE(parent);
+	b.mtime = ExportTime(directory.mtime);
+
+	/* only the special "device" values are persistent; see
+	   DeviceToTypeString() in DirectorySave.cxx */
+	b.device = LE(uint32_t(directory.IsReallyAFile() ? directory.device : 0));
+
+	b.first_song = LE(first_song);
+	b.n_songs = LE(uint32_t(songs.size() - first_song));
+	b.first_playlist = LE(first_playlist);
+	b.n_playlists = LE(uint32_t(playlists.size() - first_playlist));
+
+	/* "b" may become a dangling reference below, because the
+	   recursive calls append to the #directories vector */
+
+	for (const auto &child : directory.children) {
+		if (child.IsMount())
+			continue;
+
+		AddDirectory(child, index);
+	}
+}
+
+static void
+WritePadding(BufferedOutputStream &os, uint64_t &position)
+{
+	static constexpr std::byte zero[8]{};
+
+	const std::size_t n = (8 - position % 8) % 8;
+	os.Write(std::span{zero, n});
+	position += n;
+}
+
+template<typename T>
+static void
+WriteSection(BufferedOutputStream &os, uint64_t &position, const std::vector<T> &v)
+{
+	WritePadding(os, position);
+
+	os.Write(std::as_bytes(std::span{v}));
+	position += v.size() * sizeof(T);
+}
+
+template<typename T>
+static BinarySection
+MakeSection(uint64_t &position, const std::vector<T> &v) noexcept
+{
+	position += (8 - position % 8) % 8;
+	const BinarySection section{LE(position), LE(uint64_t(v.size()))};
+	position += v.size() * sizeof(T);
+	return section;
+}
+
+void
+BinaryDatabaseWriter::Write(BufferedOutputStream &os) const
+{
+	/* the header must be written first, so calculate the
+	   section offsets before writing anything */
+
+	BinaryHeader header{};
+	memcpy(header.magic, BINARY_MAGIC, sizeof(header.magic));
+	header.format = LE(BINARY_FORMAT);
+	header.byte_order = LE(BINARY_BYTE_ORDER);
+	header.tag_mask = LE(GetEnabledTagMask());
+	header.fs_charset = LE(fs_charset);
+	header.mpd_version = LE(mpd_version);
+
+	uint64_t position = sizeof(header);
+	header.directories = MakeSection(position, directories);
+	header.songs = MakeSection(position, songs);
+	header.tag_items = MakeSection(position, tag_items);
+	header.playlists = MakeSection(position, playlists);
+	header.analyses = MakeSection(position, analyses);
+	header.strings = {LE(position), LE(uint64_t(strings.size()))};
+
+	os.Write(ReferenceAsBytes(header));
+
+	position = sizeof(header);
+	WriteSection(os, position, directories);
+	WriteSection(os, position, songs);
+	WriteSection(os, position, tag_items);
+	WriteSection(os, position, playlists);
+	WriteSection(os, position, analyses);
+
+	os.Write(AsBytes(strings));
+}
+
+void
+db_save_binary(BufferedOutputStream &os, const Directory &root)
+{
+	BinaryDatabaseWriter writer;
+	writer.AddDirectory(root, BINARY_NO_PARENT);
+	writer.Write(os);
+}
+
+namespace {
+
+class BinaryDatabaseReader {
+	const std::span<const std::byte> src;
+
+	BinaryHeader header;
+
+	std::span<const BinaryDirectory> directories;
+	std::span<const BinarySong> songs;
+	std::span<const BinaryTagItem> tag_items;
+	std::span<const BinaryPlaylist> playlists;
+	std::span<const BinarySongAnalysis> analyses;
+	std::span<const char> strings;
+
+public:
+	explicit BinaryDatabaseReader(std::span<const std::byte> _src);
+
+	void CheckConfig() const;
+
+	void Load(Directory &root, SongArena *arena) const;
+
+private:
+	template<typename T>
+	std::span<const T> GetSection(const BinarySection &section) const;
+
+	const char *GetString(uint32_t offset) const;
+
+	std::shared_ptr<const SongAnalysis> GetAnalysis(uint32_t index) const;
+
+	void LoadSongs(Directory &directory,
+		       const BinaryDirectory &b, SongArena *arena) const;
+	void LoadPlaylists(Directory &directory,
+			   const BinaryDirectory &b) const;
+};
+
+}
+
+template<typename T>
+inline std::span<const T>
+BinaryDatabaseReader::GetSection(const BinarySection &section) const
+{
+	const uint64_t offset = LE(section.offset), count = LE(section.count);
+
+	if (offset % alignof(T) != 0 ||
+	    offset > src.size() ||
+	    count > (src.size() - offset) / sizeof(T))
+		throw std::runtime_error("Database corrupted");
+
+	return FromBytesStrict<const T>(src.subspan(offset,
+						    count * sizeof(T)));
+}
+
+BinaryDatabaseReader::BinaryDatabaseReader(std::span<const std::byte> _src)
+	:src(_src)
+{
+	if (!IsBinaryDatabase(src) || src.size() < sizeof(header))
+		throw std::runtime_error("Database corrupted");
+
+	memcpy(&header, src.data(), sizeof(header));
+
+	if (LE(header.format) != BINARY_FORMAT ||
+	    LE(header.byte_order) != BINARY_BYTE_ORDER)
+		throw std::runtime_error("Database format mismatch, "
+					 "discarding database file");
+
+	directories = GetSection<BinaryDirectory>(header.directories);
+	songs = GetSection<BinarySong>(header.songs);
+	tag_items = GetSection<BinaryTagItem>(header.tag_items);
+	playlists = GetSection<BinaryPlaylist>(header.playlists);
+	analyses = GetSection<BinarySongAnalysis>(header.analyses);
+	strings = GetSection<char>(header.strings);
+
+	/* the last string must be null-terminated, which guarantees
+	   that all strings are */
+	if (strings.empty() || strings.back() != '\0' ||
+	    directories.empty() ||
+	    LE(directories.front().parent) != BINARY_NO_PARENT)
+		throw std::runtime_error("Database corrupted");
+}
+
+inline const char *
+BinaryDatabaseReader::GetString(uint32_t offset) const
+{
+	offset = LE(offset);
+	if (offset >= strings.size())
+		throw std::runtime_error("Database corrupted");
+
+	return strings.data() + offset;
+}
+
+inline std::shared_ptr<const SongAnalysis>
+BinaryDatabaseReader::GetAnalysis(uint32_t index) const
+{
+	index = LE(index);
+	if (index == BINARY_NO_ANALYSIS)
+		return nullptr;
+
+	if (index >= analyses.size())
+		throw std::runtime_error("Database corrupted");
+
+	const auto &b = analyses[index];
+
+	auto analysis = std::make_shared<SongAnalysis>();
+	analysis->replay_gain.track = {LE(b.track_gain), LE(b.track_peak)};
+	analysis->replay_gain.album = {LE(b.album_gain), LE(b.album_peak)};
+	analysis->mix_ramp.SetStart(GetString(b.mix_ramp_start));
+	analysis->mix_ramp.SetEnd(GetString(b.mix_ramp_end));
+	return analysis;
+}
+
+inline void
+BinaryDatabaseReader::CheckConfig() const
+{
+	const char *new_charset = GetString(header.fs_charset);
+	const char *const old_charset = GetFSCharset();
+	if (*old_charset != 0 && !StringIsEqual(new_charset, old_charset))
+		throw FmtRuntimeError("Existing database has charset "
+				      "{:?} instead of {:?}; "
+				      "discarding database file",
+				      new_charset, old_charset);
+
+	if ((GetEnabledTagMask() & ~LE(header.tag_mask)) != 0)
+		throw std::runtime_error("Tag list mismatch, "
+					 "discarding database file");
+}
+
+inline void
+BinaryDatabaseReader::LoadSongs(Directory &directory,
+				const BinaryDirectory &b,
+				SongArena *arena) const
+{
+	const uint32_t first_song = LE(b.first_song), n_songs = LE(b.n_songs);
+	if (first_song > songs.size() ||
+	    n_songs > songs.size() - first_song)
+		throw std::runtime_error("Database corrupted");
+
+	for (const auto &s : songs.subspan(first_song, n_songs)) {
+		const uint32_t first_tag_item = LE(s.first_tag_item);
+		const uint16_t n_tag_items = LE(s.n_tag_items);
+		if (first_tag_item > tag_items.size() ||
+		    n_tag_items > tag_items.size() - first_tag_item)
+			throw std::runtime_error("Database corrupted");
+
+		const char *filename = GetString(s.filename);
+		if (*filename == 0)
+			throw std::runtime_error("Database corrupted");
+
+		auto song = NewSong(arena, filename, directory);
+		song->target = GetString(s.target);
+		song->mtime = ImportTime(s.mtime);
+		song->added = ImportTime(s.added);
+		song->start_time = SongTime::FromMS(LE(s.start_ms));
+		song->end_time = SongTime::FromMS(LE(s.end_ms));
+		song->audio_format = AudioFormat(LE(s.sample_rate),
+						 SampleFormat(s.format),
+						 s.channels);
+		song->in_playlist = (s.flags & BINARY_SONG_IN_PLAYLIST) != 0;
+		song->analysis = GetAnalysis(s.analysis);
+
+		TagBuilder tag;
+		tag.Reserve(n_tag_items);
+		tag.SetDuration(SignedSongTime(SignedSongTime::rep(LE(s.duration_ms))));
+		tag.SetHasPlaylist((s.flags & BINARY_SONG_HAS_PLAYLIST) != 0);
+
+		for (const auto &t : tag_items.subspan(first_tag_item,
+						       n_tag_items)) {
+			if (t.type >= TAG_NUM_OF_ITEM_TYPES)
+				throw std::runtime_error("Database corrupted");
+
+			tag.AddItemUnchecked(TagType(t.type),
+					     GetString(t.value));
+		}
+
+		tag.Commit(song->tag);
+
+		directory.AddSong(std::move(song));
+	}
+}
+
+inline void
+BinaryDatabaseReader::LoadPlaylists(Directory &directory,
+				    const BinaryDirectory &b) const
+{
+	const uint32_t first_playlist = LE(b.first_playlist),
+		n_playlists = LE(b.n_playlists);
+	if (first_playlist > playlists.size() ||
+	    n_playlists > playlists.size() - first_playlist)
+		throw std::runtime_error("Database corrupted");
+
+	for (const auto &p : playlists.subspan(first_playlist, n_playlists))
+		directory.playlists.push_back(PlaylistInfo(GetString(p.name),
+							   ImportTime(p.mtime)));
+}
+
+inline void
+BinaryDatabaseReader::Load(Directory &root, SongArena *arena) const
+{
+	assert(holding_db_exclusive_lock());
+
+	if (arena != nullptr)
+		/* allocate all songs in one chunk */
+		arena->Reserve(songs.size() * sizeof(Song));
+
+	/* maps directory record indexes to the #Directory objects
+	   created so far */
+	std::vector<Directory *> map;
+	map.reserve(directories.size());
+
+	for (const auto &b : directories) {
+		Directory *directory;
+
+		if (map.empty()) {
+			directory = &root;
+		} else {
+			const uint32_t parent = LE(b.parent);
+			if (parent >= map.size())
+				throw std::runtime_error("Database corrupted");
+
+			const char *name = GetString(b.name);
+			if (*name == 0)
+				throw std::runtime_error("Database corrupted");
+
+			directory = map[parent]->CreateChild(name);
+			directory->device = LE(b.device);
+		}
+
+		directory->mtime = ImportTime(b.mtime);
+
+		map.push_back(directory);
+
+		LoadSongs(*directory, b, arena);
+		LoadPlaylists(*directory, b);
+	}
+}
+
+void
+db_load_binary(std::span<const std::byte> src, Directory &root,
+	       bool ignore_config_mismatches, SongArena *arena)
+{
+	const BinaryDatabaseReader reader{src};
+
+	if (!ignore_config_mismatches)
+		reader.CheckConfig();
+
+	const ScopeDatabaseLock protect;
+	reader.Load(root, arena);
+}
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+struct Directory;
+class SongArena;
+class BufferedOutputStream;
+class Path;
+
+/**
+ * Does the given buffer (the beginning of a database file) look like
+ * a database file in the binary format?
+ */
+[[gnu::pure]]
+bool
+IsBinaryDatabase(std::span<const std::byte> src) noexcept;
+
+/**
+ * Does the given file look like a database file in the binary format?
+ * Only the first few bytes are read.
+ *
+ * Throws on I/O error.
+ */
+bool
+IsBinaryDatabaseFile(Path path);
+
+/**
+ * Write the whole database in the binary format.  Unlike the text
+ * format, it consists of a string table and arrays of fixed-size
+ * records which can be loaded without parsing.
+ *
+ * Throws on error.
+ */
+void
+db_save_binary(BufferedOutputStream &os, const Directory &root);
+
+/**
+ * Load a database file in the binary format.  The whole file must be
+ * in memory; all directories, songs and tags are copied from it, so
+ * the buffer may be freed afterwards.
+ *
+ * Throws #std::runtime_error on error.
+ *
+ * @param ignore_config_mismatches if true, then configuration
+ * mismatches (e.g. enabled tags or filesystem charset) are ignored
+ * @param arena allocate songs in this arena (or on the heap if
+ * nullptr)
+ */
+void
+db_load_binary(std::span<const std::byte> src, Directory &root,
+	       bool ignore_config_mismatches=false,
+	       SongArena *arena=nullptr);
@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "DatabaseJournal.hxx"
+#include "DirectorySave.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "io/BufferedOutputStream.hxx"
+#include "io/LineReader.hxx"
+#include "fs/Traits.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "util/CNumberParser.hxx"
+#include "util/IterableSplitString.hxx"
+#include "util/ScopeExit.hxx"
+#include "util/StringCompare.hxx"
+
+#include <cassert>
+
+using std::string_view_literals::operator""sv;
+
+#define JOURNAL_FORMAT "mpd_journal: "
+#define JOURNAL_BASE "base: "
+#define JOURNAL_DIRECTORY "directory: "
+
+static constexpr unsigned JOURNAL_VERSION = 1;
+
+void
+journal_write_header(BufferedOutputStream &os, const JournalBase &base)
+{
+	os.Fmt(JOURNAL_FORMAT "{}\n", JOURNAL_VERSION);
+	os.Fmt(JOURNAL_BASE "{} {}\n", base.size, base.mtime);
+}
+
+static void
+journal_save_recursive(BufferedOutputStream &os, const Directory &directory,
+		       std::size_t &n)
+{
+	if (directory.dirty) {
+		os.Fmt(JOURNAL_DIRECTORY "{}\n", directory.GetPath());
+		directory_save_shallow(os, directory);
+		++n;
+	}
+
+	/* parents are saved before their children, because replaying
+	   a parent record deletes children which are not listed */
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			journal_save_recursive(os, child, n);
+}
+
+std::size_t
+journal_save(BufferedOutputStream &os, const Directory &root)
+{
+	assert(holding_db_lock());
+
+	std::size_t n = 0;
+	journal_save_recursive(os, root, n);
+	return n;
+}
+
+void
+journal_clear(Directory &root) noexcept
+{
+	assert(holding_db_exclusive_lock());
+
+	root.dirty = false;
+
+	for (auto &child : root.children)
+		journal_clear(child);
+}
+
+/**
+ * Look up a directory by its path, creating all missing directories.
+ */
+static Directory &
+MakeDirectory(Directory &root, std::string_view path)
+{
+	Directory *directory = &root;
+
+	for (const std::string_view name :
+		     IterableSplitString(path, PathTraitsUTF8::SEPARATOR)) {
+		if (name.empty() || name == "."sv || name == ".."sv)
+			throw FmtRuntimeError("Malformed path: {:?}", path);
+
+		directory = directory->MakeChild(name);
+		if (directory->IsMount())
+			throw FmtRuntimeError("Mount point in path: {:?}",
+					      path);
+	}
+
+	return *directory;
+}
+
+/**
+ * Set the "in_playlist" flag of all songs which are referenced by a
+ * playlist, like UpdateWalk::PurgeDanglingFromPlaylists() does.
+ */
+static void
+MarkPlaylistTargets(Directory &directory) noexcept
+{
+	for (auto &child : directory.children)
+		MarkPlaylistTargets(child);
+
+	if (!directory.IsPlaylist())
+		return;
+
+	for (auto &song : directory.songs) {
+		if (song.target.empty() ||
+		    PathTraitsUTF8::IsAbsoluteOrHasScheme(song.target.c_str()))
+			continue;
+
+		Song *target = directory.LookupTargetSong(song.target);
+		if (target != nullptr)
+			target->in_playlist = true;
+	}
+}
+
+static void
+journal_replay(LineReader &file, Directory &root, SongArena *arena)
+{
+	const char *line;
+	while ((line = file.ReadLine()) != nullptr) {
+		const char *path = StringAfterPrefix(line, JOURNAL_DIRECTORY);
+		if (path == nullptr)
+			throw FmtRuntimeError("Malformed line in journal: {:?}",
+					      line);
+
+		directory_load_shallow(file, *path == 0
+				       ? root
+				       : MakeDirectory(root, path),
+				       arena);
+	}
+}
+
+bool
+journal_load(LineReader &file, Directory &root, const JournalBase &base,
+	     SongArena *arena)
+{
+	assert(holding_db_exclusive_lock());
+
+	const char *line = file.ReadLine();
+	const char *p;
+	if (line == nullptr ||
+	    (p = StringAfterPrefix(line, JOURNAL_FORMAT)) == nullptr ||
+	    ParseUnsigned(p) != JOURNAL_VERSION)
+		return false;
+
+	line = file.ReadLine();
+	if (line == nullptr ||
+	    (p = StringAfterPrefix(line, JOURNAL_BASE)) == nullptr)
+		return false;
+
+	char *endptr;
+	JournalBase file_base;
+	file_base.size = ParseUint64(p, &endptr);
+	file_base.mtime = static_cast<std::time_t>(ParseUint64(endptr));
+	if (file_base != base)
+		return false;
+
+	/* even if the journal is corrupt, the records which were
+	   replayed need to be finished */
+	AtScopeExit(&root) {
+		root.Sort();
+		root.ClearInPlaylist();
+		MarkPlaylistTargets(root);
+	};
+
+	journal_replay(file, root, arena);
+	return true;
+}
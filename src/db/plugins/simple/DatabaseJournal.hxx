@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+struct Directory;
+class SongArena;
+class LineReader;
+class BufferedOutputStream;
+
+/*
+ * The database journal is a text file next to the database file
+ * ("snapshot") which contains the directories modified since the
+ * snapshot was written.  Each record is a full copy of one
+ * directory (see directory_save_shallow()); the journal is replayed
+ * after loading the snapshot, later records replacing earlier ones.
+ */
+
+/**
+ * Identifies the snapshot a journal belongs to.  A journal with a
+ * different identity (e.g. because the snapshot was replaced, or
+ * writing the new snapshot succeeded but deleting the journal did
+ * not) is discarded.
+ */
+struct JournalBase {
+	uint_least64_t size;
+	std::time_t mtime;
+
+	constexpr bool operator==(const JournalBase &) const noexcept = default;
+};
+
+/**
+ * Write the header of a new journal file.
+ */
+void
+journal_write_header(BufferedOutputStream &os, const JournalBase &base);
+
+/**
+ * Append a record for each directory whose "dirty" flag is set.
+ * Mount points and their contents are skipped.
+ *
+ * Caller must lock the #db_mutex.
+ *
+ * @return the number of records which were written
+ */
+std::size_t
+journal_save(BufferedOutputStream &os, const Directory &root);
+
+/**
+ * Clear the "dirty" flags of all directories (after they have been
+ * saved or loaded).
+ *
+ * Caller must lock the #db_mutex exclusively.
+ */
+void
+journal_clear(Directory &root) noexcept;
+
+/**
+ * Check the header of a journal file and replay all of its records.
+ * Afterwards, the directories are sorted and the "in_playlist" flags
+ * of all songs are recalculated.
+ *
+ * Throws on error; in that case, the records which were read so far
+ * have been applied.
+ *
+ * Caller must lock the #db_mutex exclusively.
+ *
+ * @param arena allocate new songs in this arena (or on the heap if
+ * nullptr)
+ * @return false if the journal does not belong to the given snapshot
+ */
+bool
+journal_load(LineReader &file, Directory &root, const JournalBase &base,
+	     SongArena *arena=nullptr);
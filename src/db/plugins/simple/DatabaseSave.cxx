@@ -26,7 +26,7 @@
 #define DIRECTORY_FS_CHARSET "fs_charset: "
 #define DB_TAG_PREFIX "tag: "
 
-static constexpr unsigned DB_FORMAT = 2;
+static constexpr unsigned DB_FORMAT = 3;
 
 /**
  * The oldest database format understood by this MPD version.
@@ -53,7 +53,7 @@ db_save_internal(BufferedOutputStream &os, const Directory &music_root)
 
 void
 db_load_internal(LineReader &file, Directory &music_root,
-		 bool ignore_config_mismatches)
+		 bool ignore_config_mismatches, SongArena *arena)
 {
 	char *line;
 	unsigned format = 0;
@@ -121,5 +121,5 @@ db_load_internal(LineReader &file, Directory &music_root,
 							 "discarding database file");
 
 	const ScopeDatabaseLock protect;
-	directory_load(file, music_root);
+	directory_load(file, music_root, arena);
 }
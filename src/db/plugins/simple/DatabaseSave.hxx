@@ -5,6 +5,7 @@
 #define MPD_DATABASE_SAVE_HXX
 
 struct Directory;
+class SongArena;
 class BufferedOutputStream;
 class LineReader;
 
@@ -16,9 +17,12 @@ db_save_internal(BufferedOutputStream &os, const Directory &root);
  *
  * @param ignore_config_mismatches if true, then configuration
  * mismatches (e.g. enabled tags or filesystem charset) are ignored
+ * @param arena allocate songs in this arena (or on the heap if
+ * nullptr)
  */
 void
 db_load_internal(LineReader &file, Directory &root,
-		 bool ignore_config_mismatches=false);
+		 bool ignore_config_mismatches=false,
+		 SongArena *arena=nullptr);
 
 #endif
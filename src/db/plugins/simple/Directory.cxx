@@ -19,6 +19,7 @@
 #include "util/StringCompare.hxx"
 #include "util/StringSplit.hxx"
 
+#include <algorithm>
 #include <cassert>
 
 #include <string.h>
@@ -39,16 +40,24 @@ Directory::~Directory() noexcept
 		mounted_database.reset();
 	}
 
-	songs.clear_and_dispose(DeleteDisposer());
+	songs.clear_and_dispose(SongDeleter{});
 	children.clear_and_dispose(DeleteDisposer());
 }
 
+void
+Directory::MarkModified() noexcept
+{
+	dirty = true;
+	db_modified();
+}
+
 void
 Directory::Delete() noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 	assert(parent != nullptr);
 
+	parent->MarkModified();
 	parent->children.erase_and_dispose(parent->children.iterator_to(*this),
 					   DeleteDisposer());
 }
@@ -72,7 +81,7 @@ Directory::GetName() const noexcept
 Directory *
 Directory::CreateChild(std::string_view name_utf8) noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 	assert(!name_utf8.empty());
 
 	std::string path_utf8 = IsRoot()
@@ -80,7 +89,9 @@ Directory::CreateChild(std::string_view name_utf8) noexcept
 		: PathTraitsUTF8::Build(GetPath(), name_utf8);
 
 	auto *child = new Directory(std::move(path_utf8), this);
+	child->dirty = true;
 	children.push_back(*child);
+	MarkModified();
 	return child;
 }
 
@@ -114,7 +125,7 @@ Directory::LookupTargetSong(std::string_view target) noexcept
 void
 Directory::ClearInPlaylist() noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 
 	for (auto &child : children)
 		child.ClearInPlaylist();
@@ -126,16 +137,17 @@ Directory::ClearInPlaylist() noexcept
 void
 Directory::PruneEmpty() noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 
 	for (auto child = children.begin(), end = children.end();
 	     child != end;) {
 		child->PruneEmpty();
 
-		if (child->IsEmpty() && !child->IsMount())
+		if (child->IsEmpty() && !child->IsMount()) {
 			child = children.erase_and_dispose(child,
 							   DeleteDisposer());
-		else
+			MarkModified();
+		} else
 			++child;
 	}
 }
@@ -172,21 +184,23 @@ Directory::LookupDirectory(std::string_view _uri) noexcept
 void
 Directory::AddSong(SongPtr song) noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 	assert(song != nullptr);
 	assert(&song->parent == this);
 
 	songs.push_back(*song.release());
+	MarkModified();
 }
 
 SongPtr
 Directory::RemoveSong(Song *song) noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 	assert(song != nullptr);
 	assert(&song->parent == this);
 
 	songs.erase(songs.iterator_to(*song));
+	MarkModified();
 	return SongPtr(song);
 }
 
@@ -215,10 +229,19 @@ directory_cmp(const Directory &a, const Directory &b) noexcept
 void
 Directory::Sort() noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
+
+	/* reordering is a modification for iterators (e.g. of a
+	   query which has released the lock meanwhile), but not for
+	   the journal */
+	if (!std::is_sorted(children.begin(), children.end(),
+			    directory_cmp)) {
+		SortList(children, directory_cmp);
+		db_modified();
+	}
 
-	SortList(children, directory_cmp);
-	song_list_sort(songs);
+	if (song_list_sort(songs))
+		db_modified();
 
 	for (auto &child : children)
 		child.Sort();
@@ -236,7 +259,7 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 		/* TODO: eliminate this unlock/lock; it is necessary
 		   because the child's SimpleDatabasePlugin::Visit()
 		   call will lock it again */
-		const ScopeDatabaseUnlock unlock;
+		const ScopeDatabaseSharedUnlock unlock;
 		WalkMount(GetPath(), *mounted_database,
 			  "", DatabaseSelection{""sv, recursive, filter},
 			  visit_directory, visit_song,
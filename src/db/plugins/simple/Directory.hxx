@@ -81,6 +81,19 @@ struct Directory : IntrusiveListHook<> {
 	 */
 	bool mark;
 
+	/**
+	 * Has this directory (its attributes, its songs, its
+	 * playlists or its list of children) been modified since the
+	 * database was saved?  This is used by the database journal
+	 * (see DatabaseJournal.hxx); the methods of this class set it
+	 * automatically, but code which modifies attributes directly
+	 * must call MarkModified().
+	 *
+	 * Access is only allowed in the update thread (or while
+	 * holding #db_mutex exclusively).
+	 */
+	bool dirty = false;
+
 public:
 	Directory(std::string &&_path_utf8, Directory *_parent) noexcept;
 	~Directory() noexcept;
@@ -119,6 +132,17 @@ public:
 	[[gnu::pure]]
 	bool IsPluginAvailable() const noexcept;
 
+	/**
+	 * Set the #dirty flag and note the modification in the
+	 * database generation (see db_modified()).  This must be
+	 * called after modifying attributes of this directory or its
+	 * songs directly.
+	 *
+	 * Caller must lock the #db_mutex exclusively (or be the
+	 * update thread).
+	 */
+	void MarkModified() noexcept;
+
 	/**
 	 * Remove this #Directory object from its parent and free it.  This
 	 * must not be called with the root Directory.
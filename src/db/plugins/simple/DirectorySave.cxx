@@ -4,6 +4,7 @@
 #include "DirectorySave.hxx"
 #include "Directory.hxx"
 #include "Song.hxx"
+#include "SongArena.hxx"
 #include "SongSave.hxx"
 #include "song/DetachedSong.hxx"
 #include "PlaylistDatabase.hxx"
@@ -18,6 +19,7 @@
 #include <fmt/format.h>
 
 #include <set>
+#include <string>
 #include <string_view>
 
 #include <string.h>
@@ -27,6 +29,8 @@
 #define DIRECTORY_MTIME "mtime: "
 #define DIRECTORY_BEGIN "begin: "
 #define DIRECTORY_END "end: "
+#define DIRECTORY_CHILD "child: "
+#define DIRECTORY_SHALLOW_END "directory_end"
 
 [[gnu::const]]
 static const char *
@@ -61,18 +65,23 @@ ParseTypeString(const char *type) noexcept
 		return 0;
 }
 
+static void
+directory_save_attributes(BufferedOutputStream &os, const Directory &directory)
+{
+	const char *type = DeviceToTypeString(directory.device);
+	if (type != nullptr)
+		os.Fmt(DIRECTORY_TYPE "{}\n", type);
+
+	if (!IsNegative(directory.mtime))
+		os.Fmt(DIRECTORY_MTIME "{}\n",
+		       std::chrono::system_clock::to_time_t(directory.mtime));
+}
+
 void
 directory_save(BufferedOutputStream &os, const Directory &directory)
 {
 	if (!directory.IsRoot()) {
-		const char *type = DeviceToTypeString(directory.device);
-		if (type != nullptr)
-			os.Fmt(DIRECTORY_TYPE "{}\n", type);
-
-		if (!IsNegative(directory.mtime))
-			os.Fmt(DIRECTORY_MTIME "{}\n",
-			       std::chrono::system_clock::to_time_t(directory.mtime));
-
+		directory_save_attributes(os, directory);
 		os.Fmt(DIRECTORY_BEGIN "{}\n", directory.GetPath());
 	}
 
@@ -93,6 +102,24 @@ directory_save(BufferedOutputStream &os, const Directory &directory)
 		os.Fmt(DIRECTORY_END "{}\n", directory.GetPath());
 }
 
+void
+directory_save_shallow(BufferedOutputStream &os, const Directory &directory)
+{
+	if (!directory.IsRoot())
+		directory_save_attributes(os, directory);
+
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			os.Fmt(DIRECTORY_CHILD "{}\n", child.GetName());
+
+	for (const auto &song : directory.songs)
+		song_save(os, song);
+
+	playlist_vector_save(os, directory.playlists);
+
+	os.Write(DIRECTORY_SHALLOW_END "\n");
+}
+
 static bool
 ParseLine(Directory &directory, const char *line)
 {
@@ -110,7 +137,8 @@ ParseLine(Directory &directory, const char *line)
 }
 
 static Directory *
-directory_load_subdir(LineReader &file, Directory &parent, std::string_view name)
+directory_load_subdir(LineReader &file, Directory &parent, std::string_view name,
+		      SongArena *arena)
 {
 	Directory *directory = parent.CreateChild(name);
 
@@ -127,7 +155,7 @@ directory_load_subdir(LineReader &file, Directory &parent, std::string_view name
 				throw FmtRuntimeError("Malformed line: {:?}", line);
 		}
 
-		directory_load(file, *directory);
+		directory_load(file, *directory, arena);
 	} catch (...) {
 		directory->Delete();
 		throw;
@@ -136,8 +164,27 @@ directory_load_subdir(LineReader &file, Directory &parent, std::string_view name
 	return directory;
 }
 
+static void
+directory_load_song(LineReader &file, Directory &directory, const char *name,
+		    std::set<std::string_view> &songs, SongArena *arena)
+{
+	std::string target;
+	bool in_playlist = false;
+	auto detached_song = song_load(file, name,
+				       &target, &in_playlist);
+
+	auto song = NewSong(arena, std::move(detached_song), directory);
+	song->target = std::move(target);
+	song->in_playlist = in_playlist;
+
+	if (!songs.emplace(song->filename).second)
+		throw FmtRuntimeError("Duplicate song {:?}", name);
+
+	directory.AddSong(std::move(song));
+}
+
 void
-directory_load(LineReader &file, Directory &directory)
+directory_load(LineReader &file, Directory &directory, SongArena *arena)
 {
 	/* these sets are used to quickly check for duplicates,
 	   avoiding linear lookups */
@@ -149,34 +196,60 @@ directory_load(LineReader &file, Directory &directory)
 	       !StringStartsWith(line, DIRECTORY_END)) {
 		const char *p;
 		if ((p = StringAfterPrefix(line, DIRECTORY_DIR))) {
-			auto *child = directory_load_subdir(file, directory, p);
+			auto *child = directory_load_subdir(file, directory, p,
+							    arena);
 
 			const std::string_view name = child->GetName();
 			if (!children.emplace(name).second)
 				throw FmtRuntimeError("Duplicate subdirectory {:?}", name);
 		} else if ((p = StringAfterPrefix(line, SONG_BEGIN))) {
+			directory_load_song(file, directory, p, songs, arena);
+		} else if ((p = StringAfterPrefix(line, PLAYLIST_META_BEGIN))) {
 			const char *name = p;
+			playlist_metadata_load(file, directory.playlists, name);
+		} else {
+			throw FmtRuntimeError("Malformed line: {:?}", line);
+		}
+	}
+}
 
-			std::string target;
-			bool in_playlist = false;
-			auto detached_song = song_load(file, name,
-						       &target, &in_playlist);
+void
+directory_load_shallow(LineReader &file, Directory &directory,
+		       SongArena *arena)
+{
+	/* replace everything except for the children, which are
+	   only removed if they are not listed */
+	directory.songs.clear_and_dispose(SongDeleter{});
+	directory.playlists = PlaylistVector{};
+	directory.mtime = std::chrono::system_clock::time_point::min();
+	directory.device = 0;
 
-			auto song = std::make_unique<Song>(std::move(detached_song),
-							   directory);
-			song->target = std::move(target);
-			song->in_playlist = in_playlist;
+	std::set<std::string, std::less<>> children;
+	std::set<std::string_view> songs;
 
-			if (!songs.emplace(song->filename).second)
-				throw FmtRuntimeError("Duplicate song {:?}",
-						      name);
+	const char *line;
 
-			directory.AddSong(std::move(song));
+	while ((line = file.ReadLine()) != nullptr &&
+	       !StringIsEqual(line, DIRECTORY_SHALLOW_END)) {
+		const char *p;
+		if ((p = StringAfterPrefix(line, DIRECTORY_CHILD))) {
+			if (!children.emplace(p).second)
+				throw FmtRuntimeError("Duplicate subdirectory {:?}", p);
+		} else if ((p = StringAfterPrefix(line, SONG_BEGIN))) {
+			directory_load_song(file, directory, p, songs, arena);
 		} else if ((p = StringAfterPrefix(line, PLAYLIST_META_BEGIN))) {
 			const char *name = p;
 			playlist_metadata_load(file, directory.playlists, name);
-		} else {
+		} else if (directory.IsRoot() || !ParseLine(directory, line)) {
 			throw FmtRuntimeError("Malformed line: {:?}", line);
 		}
 	}
+
+	if (line == nullptr)
+		throw std::runtime_error("Unexpected end of file");
+
+	directory.ForEachChildSafe([&children](Directory &child){
+		if (!child.IsMount() && !children.contains(child.GetName()))
+			child.Delete();
+	});
 }
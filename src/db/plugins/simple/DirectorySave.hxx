@@ -5,6 +5,7 @@
 #define MPD_DIRECTORY_SAVE_HXX
 
 struct Directory;
+class SongArena;
 class LineReader;
 class BufferedOutputStream;
 
@@ -13,8 +14,35 @@ directory_save(BufferedOutputStream &os, const Directory &directory);
 
 /**
  * Throws #std::runtime_error on error.
+ *
+ * @param arena allocate new songs in this arena (or on the heap if
+ * nullptr)
  */
 void
-directory_load(LineReader &file, Directory &directory);
+directory_load(LineReader &file, Directory &directory,
+	       SongArena *arena=nullptr);
+
+/**
+ * Save only the given directory itself: its attributes, the names
+ * of its children, its songs and its playlists, but not the contents
+ * of the children.  This is used for the database journal.
+ */
+void
+directory_save_shallow(BufferedOutputStream &os, const Directory &directory);
+
+/**
+ * Load a record written by directory_save_shallow(), replacing the
+ * contents of the given directory.  Children which are not listed in
+ * the record are deleted; listed children which do not exist are not
+ * created.
+ *
+ * Throws #std::runtime_error on error.
+ *
+ * @param arena allocate new songs in this arena (or on the heap if
+ * nullptr)
+ */
+void
+directory_load_shallow(LineReader &file, Directory &directory,
+		       SongArena *arena=nullptr);
 
 #endif
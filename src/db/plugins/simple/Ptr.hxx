@@ -8,6 +8,22 @@
 
 struct Song;
 
-using SongPtr = std::unique_ptr<Song>;
+/**
+ * Destructs a #Song and frees its memory, unless it was allocated by
+ * a #SongArena.
+ */
+struct SongDeleter {
+	constexpr SongDeleter() noexcept = default;
+
+	/**
+	 * Allow converting from the return value of
+	 * std::make_unique<Song>().
+	 */
+	constexpr SongDeleter(std::default_delete<Song>) noexcept {}
+
+	void operator()(Song *song) const noexcept;
+};
+
+using SongPtr = std::unique_ptr<Song, SongDeleter>;
 
 #endif
@@ -4,6 +4,7 @@
 #include "config.h"
 #include "SimpleDatabasePlugin.hxx"
 #include "PrefixedLightSong.hxx"
+#include "ExportedSong.hxx"
 #include "Mount.hxx"
 #include "db/DatabasePlugin.hxx"
 #include "db/Selection.hxx"
@@ -12,33 +13,95 @@
 #include "db/UniqueTags.hxx"
 #include "db/VHelper.hxx"
 #include "db/LightDirectory.hxx"
+#include "song/Filter.hxx"
 #include "Directory.hxx"
 #include "Song.hxx"
 #include "DatabaseSave.hxx"
+#include "BinaryDatabase.hxx"
+#include "TagIndex.hxx"
+#include "StatsIndex.hxx"
+#include "SortCache.hxx"
+#include "SongArena.hxx"
+#include "DatabaseJournal.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/DatabaseError.hxx"
 #include "lib/fmt/PathFormatter.hxx"
 #include "lib/zlib/AutoGunzipFileLineReader.hxx"
 #include "io/BufferedOutputStream.hxx"
 #include "io/FileOutputStream.hxx"
+#include "io/FileLineReader.hxx"
+#include "io/FileReader.hxx"
 #include "fs/FileInfo.hxx"
 #include "config/Block.hxx"
 #include "fs/FileSystem.hxx"
+#include "input/Error.hxx"
+#include "tag/ParseName.hxx"
+#include "lib/fmt/RuntimeError.hxx"
 #include "lib/fmt/SystemError.hxx"
+#include "util/AllocatedArray.hxx"
 #include "util/CharUtil.hxx"
+#include "util/Manual.hxx"
 #include "util/Domain.hxx"
-#include "util/RecursiveMap.hxx"
+#include "util/StringAPI.hxx"
+#include "util/StringStrip.hxx"
+#include "util/IterableSplitString.hxx"
 #include "Log.hxx"
 
 #ifdef ENABLE_ZLIB
 #include "lib/zlib/GzipOutputStream.hxx"
 #endif
 
+#include <algorithm>
 #include <cerrno>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
 
 static constexpr Domain simple_db_domain("simple_db");
 
+/**
+ * Parse the "format" setting.
+ *
+ * @return true for the binary format, false for the text format
+ */
+static bool
+ParseFormat(const char *value)
+{
+	if (StringIsEqual(value, "text"))
+		return false;
+	else if (StringIsEqual(value, "binary"))
+		return true;
+	else
+		throw std::runtime_error("Invalid database format");
+}
+
+/**
+ * Parse the "index_tags" setting, a comma-separated list of tag
+ * names.
+ */
+static TagMask
+ParseIndexTags(const char *value)
+{
+	TagMask mask = TagMask::None();
+
+	for (std::string_view name : IterableSplitString(value, ',')) {
+		name = Strip(name);
+		if (name.empty())
+			continue;
+
+		const auto type = tag_name_parse_i(name);
+		if (type == TAG_NUM_OF_ITEM_TYPES)
+			throw FmtRuntimeError("Unknown tag in \"index_tags\": {:?}",
+					      name);
+
+		mask.Set(type);
+	}
+
+	return mask;
+}
+
 inline SimpleDatabase::SimpleDatabase(const ConfigBlock &block)
 	:Database(simple_db_plugin),
 	 path(block.GetPath("path")),
@@ -46,7 +109,12 @@ inline SimpleDatabase::SimpleDatabase(const ConfigBlock &block)
 #ifdef ENABLE_ZLIB
 	 compress(block.GetBlockValue("compress", true)),
 #endif
-	 hide_playlist_targets(block.GetBlockValue("hide_playlist_targets", true))
+	 hide_playlist_targets(block.GetBlockValue("hide_playlist_targets", true)),
+	 binary(ParseFormat(block.GetBlockValue("format", "text"))),
+	 index_tags(ParseIndexTags(block.GetBlockValue("index_tags", ""))),
+	 journal_path(!path.IsNull() && block.GetBlockValue("journal", false)
+		      ? path + PATH_LITERAL(".journal")
+		      : nullptr)
 {
 	if (path.IsNull())
 		throw std::runtime_error("No \"path\" parameter specified");
@@ -60,7 +128,8 @@ SimpleDatabase::SimpleDatabase(AllocatedPath &&_path,
 			       [[maybe_unused]]
 #endif
 			       bool _compress,
-			       bool _hide_playlist_targets) noexcept
+			       bool _hide_playlist_targets,
+			       bool _binary, TagMask _index_tags) noexcept
 	:Database(simple_db_plugin),
 	 path(std::move(_path)),
 	 path_utf8(path.ToUTF8()),
@@ -68,10 +137,15 @@ SimpleDatabase::SimpleDatabase(AllocatedPath &&_path,
 #ifdef ENABLE_ZLIB
 	 compress(_compress),
 #endif
-	 hide_playlist_targets(_hide_playlist_targets)
+	 hide_playlist_targets(_hide_playlist_targets),
+	 binary(_binary),
+	 index_tags(_index_tags),
+	 journal_path(nullptr)
 {
 }
 
+SimpleDatabase::~SimpleDatabase() noexcept = default;
+
 DatabasePtr
 SimpleDatabase::Create(EventLoop &, EventLoop &,
 		       [[maybe_unused]] DatabaseListener &listener,
@@ -135,52 +209,177 @@ SimpleDatabase::Load()
 	assert(!path.IsNull());
 	assert(root != nullptr);
 
-	AutoGunzipFileLineReader file{path};
+	if (IsBinaryDatabaseFile(path)) {
+		LogDebug(simple_db_domain, "reading binary DB");
+
+		/* the file is read into a temporary buffer in one go;
+		   db_load_binary() copies everything it needs */
+		FileReader reader{path};
+		AllocatedArray<std::byte> buffer(reader.GetSize());
+		reader.ReadFull(buffer);
+
+		db_load_binary(buffer, *root, false, arena.get());
+	} else {
+		AutoGunzipFileLineReader file{path};
+
+		LogDebug(simple_db_domain, "reading DB");
 
-	LogDebug(simple_db_domain, "reading DB");
+		db_load_internal(file, *root, false, arena.get());
+	}
 
-	db_load_internal(file, *root);
+	UpdateFileInfo();
 
+	if (!journal_path.IsNull())
+		LoadJournal();
+}
+
+void
+SimpleDatabase::UpdateFileInfo() noexcept
+{
 	FileInfo fi;
-	if (GetFileInfo(path, fi))
+	if (GetFileInfo(path, fi)) {
 		mtime = fi.GetModificationTime();
+		journal_base = {
+			fi.GetSize(),
+			std::chrono::system_clock::to_time_t(mtime),
+		};
+	}
 }
 
 void
-SimpleDatabase::Open()
+SimpleDatabase::LoadJournal() noexcept
 {
-	assert(prefixed_light_song == nullptr);
+	assert(!journal_path.IsNull());
+
+	journal_size = 0;
 
+	try {
+		FileLineReader file{journal_path};
+
+		LogDebug(simple_db_domain, "replaying journal");
+
+		bool valid;
+		{
+			const ScopeDatabaseLock protect;
+			valid = journal_load(file, *root, journal_base,
+					     arena.get());
+		}
+
+		if (!valid) {
+			/* the next Save() will replace it */
+			FmtNotice(simple_db_domain,
+				  "Discarding obsolete journal {}",
+				  journal_path);
+			return;
+		}
+	} catch (...) {
+		if (IsFileNotFound(std::current_exception()))
+			return;
+
+		LogError(std::current_exception(),
+			 "Failed to load the database journal");
+
+		/* the records which were read successfully have
+		   been applied; write a clean database file as soon
+		   as possible */
+		journal_compact = true;
+	}
+
+	FileInfo fi;
+	if (GetFileInfo(journal_path, fi)) {
+		journal_size = fi.GetSize();
+		if (fi.GetModificationTime() > mtime)
+			mtime = fi.GetModificationTime();
+	}
+}
+
+void
+SimpleDatabase::Open()
+{
 	root = Directory::NewRoot();
+	arena = std::make_unique<SongArena>();
 	mtime = std::chrono::system_clock::time_point::min();
 
-#ifndef NDEBUG
-	borrowed_song_count = 0;
-#endif
-
 	try {
 		Load();
 	} catch (...) {
 		LogError(std::current_exception());
 
 		delete root;
+		arena = std::make_unique<SongArena>();
 
 		Check();
 
 		root = Directory::NewRoot();
 	}
+
+	{
+		/* everything is saved at this point */
+		const ScopeDatabaseLock protect;
+		journal_clear(*root);
+
+		stats_index = std::make_unique<StatsIndex>();
+		stats_index->Build(*root);
+	}
+
+	sort_cache = std::make_unique<SortCache>();
+
+	if (index_tags.TestAny()) {
+		LogDebug(simple_db_domain, "building tag index");
+
+		const ScopeDatabaseLock protect;
+		tag_index = std::make_unique<TagIndex>(index_tags);
+		tag_index->Build(*root);
+	}
 }
 
 void
 SimpleDatabase::Close() noexcept
 {
 	assert(root != nullptr);
-	assert(prefixed_light_song == nullptr);
-	assert(borrowed_song_count == 0);
+
+	tag_index.reset();
+	stats_index.reset();
+	sort_cache.reset();
 
 	delete root;
+
+	/* after all songs have been destroyed */
+	arena.reset();
 }
 
+std::size_t
+SimpleDatabase::GetMemoryUsage() const noexcept
+{
+	assert(holding_db_lock());
+
+	std::size_t result = 0;
+	if (arena != nullptr)
+		result += arena->GetSize();
+	if (stats_index != nullptr)
+		result += stats_index->GetSongMemory();
+	return result;
+}
+
+/*
+ * Buffers for SimpleDatabase::GetSong().  They are thread-local, so
+ * several threads may query the database concurrently; each thread
+ * may borrow only one song at a time (from all #SimpleDatabase
+ * instances).
+ */
+
+/**
+ * A buffer for GetSong() when prefixing the #LightSong instance
+ * from a mounted #Database.
+ */
+static thread_local PrefixedLightSong *prefixed_light_song = nullptr;
+
+static thread_local Manual<ExportedSong> exported_song;
+
+#ifndef NDEBUG
+static thread_local unsigned borrowed_song_count = 0;
+#endif
+
 const LightSong *
 SimpleDatabase::GetSong(std::string_view uri) const
 {
@@ -188,7 +387,8 @@ SimpleDatabase::GetSong(std::string_view uri) const
 	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
-	ScopeDatabaseLock protect;
+	const std::shared_lock mount_lock{mount_mutex};
+	ScopeDatabaseSharedLock protect;
 
 	auto r = root->LookupDirectory(uri);
 
@@ -196,15 +396,18 @@ SimpleDatabase::GetSong(std::string_view uri) const
 		/* pass the request to the mounted database */
 		protect.unlock();
 
-		const LightSong *song =
-			r.directory->mounted_database->GetSong(r.rest);
+		auto &db = *r.directory->mounted_database;
+		const LightSong *song = db.GetSong(r.rest);
 		if (song == nullptr)
 			return nullptr;
 
-		prefixed_light_song =
-			new PrefixedLightSong(*song, r.uri);
-		r.directory->mounted_database->ReturnSong(song);
-		return prefixed_light_song;
+		/* the mounted database uses the same thread-local
+		   buffers; assign prefixed_light_song only after
+		   returning its song */
+		auto *prefixed = new PrefixedLightSong(*song, r.uri);
+		db.ReturnSong(song);
+		prefixed_light_song = prefixed;
+		return prefixed;
 	}
 
 	if (r.rest.empty())
@@ -266,7 +469,8 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		      VisitSong visit_song,
 		      VisitPlaylist visit_playlist) const
 {
-	ScopeDatabaseLock protect;
+	const std::shared_lock mount_lock{mount_mutex};
+	ScopeDatabaseSharedLock protect;
 
 	auto r = root->LookupDirectory(selection.uri);
 
@@ -282,6 +486,22 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		return;
 	}
 
+	/* the sorted list contains the whole database; for a
+	   subdirectory, sorting the (usually few) songs below it with
+	   DatabaseVisitorHelper is cheaper than skipping all others */
+	if (r.directory == root && r.rest.data() == nullptr &&
+	    selection.sort != TAG_NUM_OF_ITEM_TYPES &&
+	    visit_song && !visit_directory && !visit_playlist &&
+	    selection.recursive && n_mounts == 0 &&
+	    /* if the filter is selective enough for the TagIndex,
+	       sorting its few results is cheaper than walking
+	       the sorted list */
+	    (tag_index == nullptr || selection.filter == nullptr ||
+	     !tag_index->CanVisit(*selection.filter))) {
+		VisitSorted(selection, visit_song);
+		return;
+	}
+
 	DatabaseVisitorHelper helper(CheckSelection(selection), visit_song);
 
 	if (r.rest.data() == nullptr) {
@@ -290,6 +510,21 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		if (selection.recursive && visit_directory)
 			visit_directory(r.directory->Export());
 
+		if (tag_index != nullptr && selection.filter != nullptr &&
+		    visit_song && !visit_directory && !visit_playlist &&
+		    selection.recursive) {
+			if (n_mounts == 0) {
+				if (tag_index->Visit(*r.directory,
+						     *selection.filter,
+						     hide_playlist_targets,
+						     visit_song)) {
+					helper.Commit();
+					return;
+				}
+			} else
+				tag_index->CountMiss();
+		}
+
 		r.directory->Walk(selection.recursive, selection.filter,
 				  hide_playlist_targets,
 				  visit_directory, visit_song,
@@ -316,19 +551,183 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 			    "No such directory");
 }
 
-RecursiveMap<std::string>
-SimpleDatabase::CollectUniqueTags(const DatabaseSelection &selection,
-				  std::span<const TagType> tag_types) const
+void
+SimpleDatabase::VisitSorted(const DatabaseSelection &selection,
+			    const VisitSong &visit_song) const
+{
+	assert(selection.sort != TAG_NUM_OF_ITEM_TYPES);
+
+	const auto songs = sort_cache->Get(*root, hide_playlist_targets,
+					   selection.sort,
+					   selection.descending);
+
+	/* stop at the end of the window instead of visiting all
+	   songs */
+	unsigned position = 0;
+	for (const Song *song : *songs) {
+		if (position >= selection.window.end)
+			break;
+
+		const auto song2 = song->Export();
+		if (!selection.Match(song2))
+			continue;
+
+		if (position++ >= selection.window.start)
+			visit_song(song2);
+	}
+}
+
+void
+SimpleDatabase::VisitUniqueTags(const DatabaseSelection &selection,
+				std::span<const TagType> tag_types,
+				RangeArg window,
+				const VisitUniqueTag &visit) const
 {
-	return ::CollectUniqueTags(*this, selection, tag_types);
+	ScopeDatabaseSharedLock protect;
+
+	auto r = root->LookupDirectory(selection.uri);
+
+	if (n_mounts > 0 || r.directory->IsMount() ||
+	    r.rest.data() != nullptr || !selection.window.IsAll()) {
+		/* values from mounted databases are not protected
+		   by our lock; use the generic implementation which
+		   references the tag pool items */
+		protect.unlock();
+		::VisitUniqueTags(*this, selection, tag_types, window, visit);
+		return;
+	}
+
+	if (tag_index != nullptr && tag_types.size() == 1 &&
+	    tag_index->IsIndexed(tag_types.front()) &&
+	    r.directory == root && selection.recursive &&
+	    (selection.filter == nullptr || selection.filter->IsEmpty())) {
+		VisitUniqueIndexed(tag_types.front(), window, visit);
+		return;
+	}
+
+	UniqueTagCollector collector{tag_types};
+
+	r.directory->Walk(selection.recursive, selection.filter,
+			  hide_playlist_targets,
+			  {}, [&collector](const LightSong &song){
+		/* the tag of a song with a "target" may have been
+		   merged into a temporary (see Song::Export());
+		   all others belong to the database, which cannot
+		   be modified while we hold the lock */
+		collector.Add(song.tag, song.real_uri == nullptr);
+	}, {});
+
+	/* copy the unique values, so the visitor (which may block
+	   on a slow client) can be invoked without holding the
+	   lock */
+	collector.Detach();
+	protect.unlock();
+
+	collector.Visit(window, visit);
+}
+
+inline void
+SimpleDatabase::VisitUniqueIndexed(TagType tag_type, RangeArg window,
+				   const VisitUniqueTag &visit) const
+{
+	assert(holding_db_lock());
+
+	/* copy the values in small batches and release the lock
+	   while passing them to the visitor; the next batch resumes
+	   after the last value */
+	static constexpr unsigned BATCH_SIZE = 256;
+
+	std::vector<std::string> batch;
+	batch.reserve(BATCH_SIZE);
+
+	unsigned skip = window.start;
+	unsigned remaining = window.Count();
+
+	while (remaining > 0) {
+		const unsigned n = std::min(remaining, BATCH_SIZE);
+		const std::string *after = batch.empty()
+			? nullptr
+			: &batch.back();
+
+		std::vector<std::string> next;
+		next.reserve(n);
+		tag_index->VisitUniqueValues(tag_type, hide_playlist_targets,
+					     after, {skip, skip + n},
+					     [&next](std::string_view value){
+			next.emplace_back(value);
+		});
+
+		skip = 0;
+		remaining -= next.size();
+		batch = std::move(next);
+
+		{
+			const ScopeDatabaseSharedUnlock unlock;
+			for (const auto &value : batch)
+				visit(0, value);
+		}
+
+		if (batch.size() < n)
+			/* end of the list */
+			break;
+	}
 }
 
 DatabaseStats
 SimpleDatabase::GetStats(const DatabaseSelection &selection) const
 {
+	if (selection.recursive && !selection.IsFiltered()) {
+		const ScopeDatabaseSharedLock protect;
+
+		/* the StatsIndex does not cover mounted databases */
+		if (n_mounts == 0)
+			return stats_index->Get(hide_playlist_targets);
+	}
+
 	return ::GetStats(*this, selection);
 }
 
+void
+SimpleDatabase::VisitStats(const VisitStat &visit) const noexcept
+{
+	bool have_index;
+	uint_least64_t index_hits = 0, index_misses = 0;
+	std::size_t song_memory;
+
+	{
+		const ScopeDatabaseSharedLock protect;
+
+		have_index = tag_index != nullptr;
+		if (have_index) {
+			index_hits = tag_index->GetHits();
+			index_misses = tag_index->GetMisses();
+		}
+
+		song_memory = GetMemoryUsage();
+	}
+
+	/* the visitor is invoked without holding the database lock */
+
+	if (have_index) {
+		visit("db_index_hits", index_hits);
+		visit("db_index_misses", index_misses);
+	}
+
+	visit("db_song_memory", song_memory);
+
+	const auto &lc = db_lock_counters;
+	visit("db_lock_shared",
+	      lc.shared.load(std::memory_order_relaxed));
+	visit("db_lock_shared_contended",
+	      lc.shared_contended.load(std::memory_order_relaxed));
+	visit("db_lock_exclusive",
+	      lc.exclusive.load(std::memory_order_relaxed));
+	visit("db_lock_exclusive_contended",
+	      lc.exclusive_contended.load(std::memory_order_relaxed));
+	visit("db_lock_wait_ms",
+	      lc.wait_us.load(std::memory_order_relaxed) / 1000);
+}
+
 void
 SimpleDatabase::Save()
 {
@@ -342,38 +741,129 @@ SimpleDatabase::Save()
 		root->Sort();
 	}
 
+	if (!journal_path.IsNull() && !NeedsCompaction()) {
+		try {
+			SaveJournal();
+			return;
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to write the database journal");
+		}
+	}
+
 	LogDebug(simple_db_domain, "writing DB");
 
 	FileOutputStream fos(path);
 
-	OutputStream *os = &fos;
+	if (binary) {
+		/* the binary format is never compressed, because
+		   that would defeat mapping it into memory */
+		BufferedOutputStream bos(fos);
+		db_save_binary(bos, *root);
+		bos.Flush();
+	} else {
+		OutputStream *os = &fos;
 
 #ifdef ENABLE_ZLIB
-	std::unique_ptr<GzipOutputStream> gzip;
-	if (compress) {
-		gzip = std::make_unique<GzipOutputStream>(*os);
-		os = gzip.get();
-	}
+		std::unique_ptr<GzipOutputStream> gzip;
+		if (compress) {
+			gzip = std::make_unique<GzipOutputStream>(*os);
+			os = gzip.get();
+		}
 #endif
 
-	BufferedOutputStream bos(*os);
+		BufferedOutputStream bos(*os);
 
-	db_save_internal(bos, *root);
+		db_save_internal(bos, *root);
 
-	bos.Flush();
+		bos.Flush();
 
 #ifdef ENABLE_ZLIB
-	if (gzip != nullptr) {
-		gzip->Finish();
-		gzip.reset();
-	}
+		if (gzip != nullptr) {
+			gzip->Finish();
+			gzip.reset();
+		}
 #endif
+	}
 
 	fos.Commit();
 
+	UpdateFileInfo();
+
+	if (!journal_path.IsNull()) {
+		/* the journal has been merged into the new database
+		   file */
+		try {
+			RemoveFile(journal_path);
+		} catch (...) {
+			/* ignore; the journal is now obsolete and
+			   will be replaced by the next Save() */
+		}
+
+		journal_size = 0;
+		journal_compact = false;
+	}
+
+	const ScopeDatabaseLock protect;
+	journal_clear(*root);
+}
+
+inline bool
+SimpleDatabase::NeedsCompaction() const noexcept
+{
+	/* rewrite the database file if the journal has grown as
+	   large as the database file itself, because replaying a
+	   large journal slows down startup and the records of
+	   directories which were modified repeatedly accumulate */
+	return !FileExists() || journal_compact ||
+		journal_size >= journal_base.size;
+}
+
+void
+SimpleDatabase::SaveJournal()
+{
+	assert(!journal_path.IsNull());
+	assert(FileExists());
+
+	LogDebug(simple_db_domain, "writing DB journal");
+
+	/* if there is no (valid) journal yet, create a new one */
+	const bool create = journal_size == 0;
+
+	FileOutputStream fos(journal_path,
+			     create
+			     ? FileOutputStream::Mode::CREATE
+			     : FileOutputStream::Mode::APPEND_EXISTING);
+	BufferedOutputStream bos(fos);
+
+	if (create)
+		journal_write_header(bos, journal_base);
+
+	std::size_t n;
+
+	{
+		const ScopeDatabaseSharedLock protect;
+		n = journal_save(bos, *root);
+	}
+
+	bos.Flush();
+	fos.Commit();
+
+	{
+		const ScopeDatabaseLock protect;
+		journal_clear(*root);
+	}
+
+	FmtDebug(simple_db_domain, "appended {} directories to the journal",
+		 n);
+
 	FileInfo fi;
-	if (GetFileInfo(path, fi))
+	if (GetFileInfo(journal_path, fi)) {
+		journal_size = fi.GetSize();
 		mtime = fi.GetModificationTime();
+	} else
+		/* make sure the journal gets replaced */
+		journal_compact = true;
 }
 
 void
@@ -386,6 +876,7 @@ SimpleDatabase::Mount(const char *uri, DatabasePtr db)
 	assert(db != nullptr);
 	assert(*uri != 0);
 
+	const std::scoped_lock mount_lock{mount_mutex};
 	ScopeDatabaseLock protect;
 
 	auto r = root->LookupDirectory(uri);
@@ -399,6 +890,7 @@ SimpleDatabase::Mount(const char *uri, DatabasePtr db)
 
 	Directory *mnt = r.directory->CreateChild(r.rest);
 	mnt->mounted_database = std::move(db);
+	++n_mounts;
 }
 
 static constexpr bool
@@ -429,7 +921,8 @@ SimpleDatabase::Mount(const char *local_uri, const char *storage_uri)
 	constexpr bool compress = false;
 #endif
 	auto db = std::make_unique<SimpleDatabase>(cache_path / name_fs,
-						   compress, hide_playlist_targets);
+						   compress, hide_playlist_targets,
+						   binary, index_tags);
 	db->Open();
 
 	bool exists = db->FileExists();
@@ -442,6 +935,9 @@ SimpleDatabase::Mount(const char *local_uri, const char *storage_uri)
 inline DatabasePtr
 SimpleDatabase::LockUmountSteal(const char *uri) noexcept
 {
+	/* this waits for queries in other threads which may be
+	   walking the mounted database */
+	const std::scoped_lock mount_lock{mount_mutex};
 	ScopeDatabaseLock protect;
 
 	auto r = root->LookupDirectory(uri);
@@ -451,6 +947,9 @@ SimpleDatabase::LockUmountSteal(const char *uri) noexcept
 	auto db = std::move(r.directory->mounted_database);
 	r.directory->Delete();
 
+	assert(n_mounts > 0);
+	--n_mounts;
+
 	return db;
 }
 
@@ -467,6 +966,6 @@ SimpleDatabase::Unmount(const char *uri) noexcept
 
 constexpr DatabasePlugin simple_db_plugin = {
 	"simple",
-	DatabasePlugin::FLAG_REQUIRE_STORAGE,
+	DatabasePlugin::FLAG_REQUIRE_STORAGE|DatabasePlugin::FLAG_CONCURRENT,
 	SimpleDatabase::Create,
 };
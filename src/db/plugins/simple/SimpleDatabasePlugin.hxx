@@ -4,21 +4,27 @@
 #ifndef MPD_SIMPLE_DATABASE_PLUGIN_HXX
 #define MPD_SIMPLE_DATABASE_PLUGIN_HXX
 
-#include "ExportedSong.hxx"
+#include "DatabaseJournal.hxx"
 #include "db/Interface.hxx"
 #include "db/Ptr.hxx"
 #include "fs/AllocatedPath.hxx"
-#include "util/Manual.hxx"
+#include "thread/SharedMutex.hxx"
+#include "tag/Mask.hxx"
 #include "config.h"
 
 #include <cassert>
+#include <cstddef>
+#include <memory>
 
 struct ConfigBlock;
 struct Directory;
 struct DatabasePlugin;
 class EventLoop;
 class DatabaseListener;
-class PrefixedLightSong;
+class TagIndex;
+class StatsIndex;
+class SortCache;
+class SongArena;
 
 class SimpleDatabase : public Database {
 	const AllocatedPath path;
@@ -34,19 +40,12 @@ class SimpleDatabase : public Database {
 	std::chrono::system_clock::time_point mtime;
 
 	/**
-	 * A buffer for GetSong() when prefixing the #LightSong
-	 * instance from a mounted #Database.
+	 * Obtained in shared mode by Visit() and GetSong() and in
+	 * exclusive mode by Mount() and Unmount(), because walking
+	 * a mounted #Database requires releasing the #db_mutex, and
+	 * another thread must not unmount it meanwhile.
 	 */
-	mutable PrefixedLightSong *prefixed_light_song = nullptr;
-
-	/**
-	 * A buffer for GetSong().
-	 */
-	mutable Manual<ExportedSong> exported_song;
-
-#ifndef NDEBUG
-	mutable unsigned borrowed_song_count;
-#endif
+	mutable SharedMutex mount_mutex;
 
 #ifdef ENABLE_ZLIB
 	const bool compress;
@@ -54,10 +53,85 @@ class SimpleDatabase : public Database {
 
 	const bool hide_playlist_targets;
 
+	/**
+	 * Write the database file in the binary format (see
+	 * BinaryDatabase.hxx) instead of the text format?  Load()
+	 * detects the format automatically, regardless of this
+	 * setting.
+	 */
+	const bool binary;
+
+	/**
+	 * The tag types which shall be indexed by #tag_index.
+	 */
+	const TagMask index_tags;
+
+	/**
+	 * An inverted index for "find" and "search"; nullptr if no
+	 * tag types are configured to be indexed.  Protected by
+	 * #db_mutex.
+	 */
+	std::unique_ptr<TagIndex> tag_index;
+
+	/**
+	 * Answers unfiltered GetStats() calls.  Protected by
+	 * #db_mutex.
+	 */
+	std::unique_ptr<StatsIndex> stats_index;
+
+	/**
+	 * Sorted song lists for "find" with "sort" and "window".
+	 */
+	std::unique_ptr<SortCache> sort_cache;
+
+	/**
+	 * Contains the #Song objects loaded from the database file
+	 * (and the journal); all of them are freed at once by
+	 * Close().  Songs added later by the database update are
+	 * allocated on the heap.
+	 */
+	std::unique_ptr<SongArena> arena;
+
+	/**
+	 * The number of databases mounted with Mount().  Since
+	 * #tag_index does not cover mounted databases, it is only
+	 * used if this is zero.  Protected by #db_mutex.
+	 */
+	unsigned n_mounts = 0;
+
+	/**
+	 * The path of the journal file (see DatabaseJournal.hxx);
+	 * "nulled" if the journal is disabled.  If enabled, Save()
+	 * appends the modified directories to the journal instead
+	 * of rewriting the database file.
+	 */
+	const AllocatedPath journal_path;
+
+	/**
+	 * The identity of the database file; the journal is only
+	 * valid for this file.  Only set if FileExists() returns
+	 * true.
+	 */
+	JournalBase journal_base;
+
+	/**
+	 * The size of the journal file; 0 if it does not exist (or
+	 * is obsolete and shall be replaced).
+	 */
+	uint_least64_t journal_size = 0;
+
+	/**
+	 * If true, then the next Save() call rewrites the database
+	 * file, e.g. because the journal is corrupt.
+	 */
+	bool journal_compact = false;
+
 public:
 	SimpleDatabase(const ConfigBlock &block);
 	SimpleDatabase(AllocatedPath &&_path, bool _compress,
-		       bool _hide_playlist_targets) noexcept;
+		       bool _hide_playlist_targets, bool _binary,
+		       TagMask _index_tags) noexcept;
+	~SimpleDatabase() noexcept override;
 
 	static DatabasePtr Create(EventLoop &main_event_loop,
 				  EventLoop &io_event_loop,
@@ -71,6 +145,30 @@ public:
 		return *root;
 	}
 
+	/**
+	 * Returns the #TagIndex or nullptr if it is disabled.  The
+	 * caller must lock the #db_mutex to access it.
+	 */
+	TagIndex *GetTagIndex() const noexcept {
+		return tag_index.get();
+	}
+
+	/**
+	 * Returns the #StatsIndex.  The caller must lock the
+	 * #db_mutex to access it.
+	 */
+	StatsIndex *GetStatsIndex() const noexcept {
+		return stats_index.get();
+	}
+
+	/**
+	 * Returns an estimate of the number of bytes allocated by
+	 * the songs of this database (not including mounted
+	 * databases).  The caller must lock the #db_mutex.
+	 */
+	[[gnu::pure]]
+	std::size_t GetMemoryUsage() const noexcept;
+
 	bool HasCache() const noexcept {
 		return !cache_path.IsNull();
 	}
@@ -114,18 +212,38 @@ public:
 		   VisitSong visit_song,
 		   VisitPlaylist visit_playlist) const override;
 
-	RecursiveMap<std::string> CollectUniqueTags(const DatabaseSelection &selection,
-						    std::span<const TagType> tag_types) const override;
+	void VisitUniqueTags(const DatabaseSelection &selection,
+			     std::span<const TagType> tag_types,
+			     RangeArg window,
+			     const VisitUniqueTag &visit) const override;
 
 	DatabaseStats GetStats(const DatabaseSelection &selection) const override;
+	void VisitStats(const VisitStat &visit) const noexcept override;
 
 	std::chrono::system_clock::time_point GetUpdateStamp() const noexcept override {
 		return mtime;
 	}
 
 private:
+	/**
+	 * Implementation of VisitUniqueTags() using the #TagIndex.
+	 * Caller must lock the #db_mutex (shared); it is released
+	 * while the visitor is invoked.
+	 */
+	void VisitUniqueIndexed(TagType tag_type, RangeArg window,
+				const VisitUniqueTag &visit) const;
+
 	void Configure(const ConfigBlock &block);
 
+	/**
+	 * Visit all songs of the database matching the selection
+	 * (which has a "sort" parameter) using #sort_cache.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void VisitSorted(const DatabaseSelection &selection,
+			 const VisitSong &visit_song) const;
+
 	void Check() const;
 
 	/**
@@ -133,6 +251,31 @@ private:
 	 */
 	void Load();
 
+	/**
+	 * Replay the journal after the database file has been
+	 * loaded.  Errors are logged.
+	 */
+	void LoadJournal() noexcept;
+
+	/**
+	 * Append all modified directories to the journal.
+	 *
+	 * Throws on error.
+	 */
+	void SaveJournal();
+
+	/**
+	 * Shall the next Save() rewrite the database file?
+	 */
+	[[gnu::pure]]
+	bool NeedsCompaction() const noexcept;
+
+	/**
+	 * Update #mtime and #journal_base after the database file has
+	 * been written or loaded.
+	 */
+	void UpdateFileInfo() noexcept;
+
 	DatabasePtr LockUmountSteal(const char *uri) noexcept;
 };
 
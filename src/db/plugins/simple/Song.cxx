@@ -8,10 +8,13 @@
 #include "tag/Builder.hxx"
 #include "song/DetachedSong.hxx"
 #include "song/LightSong.hxx"
+#include "song/Analysis.hxx"
 #include "fs/Traits.hxx"
 #include "time/ChronoUtil.hxx"
 #include "util/IterableSplitString.hxx"
 
+#include <memory>
+
 using std::string_view_literals::operator""sv;
 
 Song::Song(DetachedSong &&other, Directory &_parent) noexcept
@@ -22,10 +25,21 @@ Song::Song(DetachedSong &&other, Directory &_parent) noexcept
 	 added(other.GetAdded()),
 	 start_time(other.GetStartTime()),
 	 end_time(other.GetEndTime()),
-	 audio_format(other.GetAudioFormat())
+	 audio_format(other.GetAudioFormat()),
+	 analysis(std::move(other.WritableAnalysis()))
 {
 }
 
+void
+SongDeleter::operator()(Song *song) const noexcept
+{
+	if (song->in_arena)
+		/* the memory is owned by the SongArena */
+		std::destroy_at(song);
+	else
+		delete song;
+}
+
 const char *
 Song::GetFilenameSuffix() const noexcept
 {
@@ -130,5 +144,12 @@ Song::Export() const noexcept
 	dest.audio_format = audio_format.IsDefined() || target_song == nullptr
 		? audio_format
 		: target_song->audio_format;
+
+	/* the analysis of the target song is only valid if this
+	   song is not just a range of it (e.g. a CUE track) */
+	dest.analysis = analysis != nullptr || target_song == nullptr ||
+		!start_time.IsZero() || !end_time.IsZero()
+		? analysis.get()
+		: target_song->analysis.get();
 	return dest;
 }
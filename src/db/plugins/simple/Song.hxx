@@ -10,9 +10,11 @@
 #include "pcm/AudioFormat.hxx"
 #include "util/IntrusiveList.hxx"
 
+#include <memory>
 #include <string>
 
 struct Directory;
+struct SongAnalysis;
 struct StorageFileInfo;
 class ExportedSong;
 class DetachedSong;
@@ -80,6 +82,12 @@ struct Song : IntrusiveListHook<> {
 	 */
 	AudioFormat audio_format = AudioFormat::Undefined();
 
+	/**
+	 * ReplayGain and MixRamp values calculated by the database
+	 * update; nullptr if the song has not been analyzed (yet).
+	 */
+	std::shared_ptr<const SongAnalysis> analysis;
+
 	/**
 	 * Is this song referenced by at least one playlist file that
 	 * is part of the database?
@@ -92,6 +100,12 @@ struct Song : IntrusiveListHook<> {
 	 */
 	bool mark;
 
+	/**
+	 * Was this object allocated by a #SongArena?  If yes, then
+	 * #SongDeleter only calls the destructor.
+	 */
+	bool in_arena = false;
+
 	template<typename F>
 	Song(F &&_filename, Directory &_parent) noexcept
 		:parent(_parent), filename(std::forward<F>(_filename)) {}
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "SongArena.hxx"
+
+#include <algorithm>
+#include <memory> // for std::align()
+
+void
+SongArena::Reserve(std::size_t nbytes)
+{
+	if (nbytes <= available)
+		return;
+
+	const std::size_t chunk_size = std::max(nbytes, CHUNK_SIZE);
+	auto &chunk = chunks.emplace_back(std::make_unique_for_overwrite<std::byte[]>(chunk_size));
+	position = chunk.get();
+	available = chunk_size;
+	size += chunk_size;
+}
+
+void *
+SongArena::Allocate(std::size_t nbytes, std::size_t alignment)
+{
+	void *p = position;
+	if (std::align(alignment, nbytes, p, available) == nullptr) {
+		/* the rest of the current chunk is wasted */
+		Reserve(nbytes + alignment);
+
+		p = position;
+		p = std::align(alignment, nbytes, p, available);
+	}
+
+	position = static_cast<std::byte *>(p) + nbytes;
+	available -= nbytes;
+	return p;
+}
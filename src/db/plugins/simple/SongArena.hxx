@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Song.hxx"
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * A simple bump allocator for #Song objects which are loaded from
+ * the database file.  Compared to allocating each #Song on the heap,
+ * this saves the allocator's per-object overhead and places songs
+ * which are visited together next to each other in memory.
+ *
+ * Only the #Song objects themselves live in the arena; their
+ * filenames, targets and tag item arrays are still separate heap
+ * allocations, and #Directory objects are not allocated here at all.
+ *
+ * Memory is only freed by the destructor; songs which are deleted
+ * (see SongDeleter) are destructed, but their memory is not reused.
+ * Therefore, the arena should be replaced each time the database is
+ * reloaded.
+ *
+ * This class is not thread-safe; it is only used while loading the
+ * database.
+ */
+class SongArena {
+	static constexpr std::size_t CHUNK_SIZE = 256 * 1024;
+
+	std::vector<std::unique_ptr<std::byte[]>> chunks;
+
+	std::byte *position = nullptr;
+	std::size_t available = 0;
+
+	/**
+	 * The total size of all chunks.
+	 */
+	std::size_t size = 0;
+
+public:
+	SongArena() noexcept = default;
+
+	SongArena(const SongArena &) = delete;
+	SongArena &operator=(const SongArena &) = delete;
+
+	/**
+	 * Returns the number of bytes allocated from the heap.
+	 */
+	std::size_t GetSize() const noexcept {
+		return size;
+	}
+
+	/**
+	 * Make sure that the given number of bytes can be allocated
+	 * without gaps, e.g. because the number of songs is known in
+	 * advance.
+	 *
+	 * Throws std::bad_alloc on error.
+	 */
+	void Reserve(std::size_t nbytes);
+
+	/**
+	 * Throws std::bad_alloc on error.
+	 */
+	void *Allocate(std::size_t nbytes, std::size_t alignment);
+};
+
+/**
+ * Construct a new #Song in the given arena (or on the heap if
+ * #arena is nullptr).
+ *
+ * Throws std::bad_alloc on error.
+ */
+template<typename... Args>
+SongPtr
+NewSong(SongArena *arena, Args&&... args)
+{
+	if (arena == nullptr)
+		return std::make_unique<Song>(std::forward<Args>(args)...);
+
+	void *p = arena->Allocate(sizeof(Song), alignof(Song));
+	Song *song = ::new(p) Song(std::forward<Args>(args)...);
+	song->in_arena = true;
+	return SongPtr{song};
+}
@@ -8,6 +8,8 @@
 #include "util/IntrusiveList.hxx"
 #include "util/SortList.hxx"
 
+#include <algorithm>
+
 #include <stdlib.h>
 
 static int
@@ -85,8 +87,12 @@ song_cmp(const Song &a, const Song &b) noexcept
 	return IcuCollate(a.filename, b.filename) < 0;
 }
 
-void
+bool
 song_list_sort(IntrusiveList<Song> &songs) noexcept
 {
+	if (std::is_sorted(songs.begin(), songs.end(), song_cmp))
+		return false;
+
 	SortList(songs, song_cmp);
+	return true;
 }
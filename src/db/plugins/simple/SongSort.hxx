@@ -8,7 +8,11 @@
 
 struct Song;
 
-void
+/**
+ * @return true if the order was changed, false if the list was
+ * already sorted
+ */
+bool
 song_list_sort(IntrusiveList<Song> &songs) noexcept;
 
 #endif
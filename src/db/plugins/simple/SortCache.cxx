@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "SortCache.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "ExportedSong.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/VHelper.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <forward_list>
+
+namespace {
+
+struct SortItem {
+	const Song *song;
+	SongSortKey key;
+};
+
+} // anonymous namespace
+
+/**
+ * Collect all songs in the order of Directory::Walk().
+ *
+ * @param tags receives the merged tags of songs with a "target",
+ * which are referenced by the #SongSortKey
+ */
+static void
+CollectSongs(const Directory &directory, bool hide_playlist_targets,
+	     std::vector<SortItem> &items, std::forward_list<Tag> &tags)
+{
+	assert(!directory.IsMount());
+
+	for (const auto &song : directory.songs) {
+		if (hide_playlist_targets && song.in_playlist)
+			continue;
+
+		const auto exported = song.Export();
+		SongSortKey key{exported};
+		if (key.tag != &song.tag)
+			/* the merged tag is owned by the temporary
+			   ExportedSong */
+			key.tag = &tags.emplace_front(exported.tag);
+
+		items.push_back({&song, key});
+	}
+
+	for (const auto &child : directory.children)
+		CollectSongs(child, hide_playlist_targets, items, tags);
+}
+
+static SortCache::SongList
+SortSongs(const Directory &root, bool hide_playlist_targets,
+	  TagType sort, bool descending)
+{
+	std::vector<SortItem> items;
+	std::forward_list<Tag> tags;
+	CollectSongs(root, hide_playlist_targets, items, tags);
+
+	std::stable_sort(items.begin(), items.end(),
+			 [sort, descending](const SortItem &a, const SortItem &b){
+				 return IsSortedBefore(sort, descending,
+						       a.key, b.key);
+			 });
+
+	SortCache::SongList result;
+	result.reserve(items.size());
+	for (const auto &i : items)
+		result.push_back(i.song);
+	return result;
+}
+
+std::shared_ptr<const SortCache::SongList>
+SortCache::Get(const Directory &root, bool hide_playlist_targets,
+	       TagType sort, bool descending)
+{
+	assert(holding_db_lock());
+
+	const std::scoped_lock lock{mutex};
+
+	if (const auto current = db_generation(); generation != current) {
+		entries.clear();
+		generation = current;
+	}
+
+	for (auto i = entries.begin(); i != entries.end(); ++i) {
+		if (i->sort == sort && i->descending == descending) {
+			entries.splice(entries.begin(), entries, i);
+			return i->songs;
+		}
+	}
+
+	auto songs = std::make_shared<const SongList>(SortSongs(root,
+								hide_playlist_targets,
+								sort,
+								descending));
+
+	if (entries.size() >= MAX_ENTRIES)
+		entries.pop_back();
+
+	entries.push_front({sort, descending, songs});
+	return songs;
+}
+
+void
+SortCache::Clear() noexcept
+{
+	const std::scoped_lock lock{mutex};
+	entries.clear();
+}
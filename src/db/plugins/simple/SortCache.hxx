@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "tag/Type.hxx"
+#include "thread/Mutex.hxx"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <vector>
+
+struct Song;
+struct Directory;
+
+/**
+ * Caches sorted lists of all songs for "find" and "search" with a
+ * "sort" parameter.  This allows #SimpleDatabase to stop walking as
+ * soon as the end of the "window" has been reached, instead of
+ * sorting all matching songs for each request, which makes paging
+ * through a large result cheap.
+ *
+ * The cache is discarded whenever the database has been modified
+ * (see db_generation()); merely obtaining the lock in exclusive
+ * mode (e.g. an update which finds nothing new) keeps it.  All methods
+ * must be called while holding the #db_mutex; shared mode is enough
+ * because this class has its own mutex.
+ */
+class SortCache {
+public:
+	using SongList = std::vector<const Song *>;
+
+private:
+	/**
+	 * The maximum number of sort orders which are kept.
+	 */
+	static constexpr std::size_t MAX_ENTRIES = 4;
+
+	struct Entry {
+		TagType sort;
+		bool descending;
+
+		std::shared_ptr<const SongList> songs;
+	};
+
+	Mutex mutex;
+
+	/**
+	 * The db_generation() value #entries were built with.
+	 */
+	uint_least64_t generation = 0;
+
+	/**
+	 * The most recently used entry is at the front.
+	 */
+	std::list<Entry> entries;
+
+public:
+	/**
+	 * Returns all songs of the tree in sorted order (like
+	 * DatabaseVisitorHelper would sort them after
+	 * Directory::Walk()), building the list if it is not cached
+	 * already.  The list remains valid while the caller holds
+	 * the #db_mutex.
+	 *
+	 * The tree must not contain mount points.
+	 *
+	 * @param sort the #DatabaseSelection::sort value (not
+	 * #TAG_NUM_OF_ITEM_TYPES)
+	 */
+	std::shared_ptr<const SongList> Get(const Directory &root,
+					    bool hide_playlist_targets,
+					    TagType sort, bool descending);
+
+	/**
+	 * Discard all cached lists.
+	 */
+	void Clear() noexcept;
+};
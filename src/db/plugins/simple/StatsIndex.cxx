@@ -0,0 +1,340 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "StatsIndex.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "ExportedSong.hxx"
+#include "db/DatabaseLock.hxx"
+#include "fs/Traits.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <set>
+#include <string_view>
+
+static void
+Increment(std::map<std::string, unsigned, std::less<>> &map,
+	  std::string_view value) noexcept
+{
+	auto i = map.lower_bound(value);
+	if (i == map.end() || i->first != value)
+		i = map.emplace_hint(i, value, 0U);
+	++i->second;
+}
+
+static void
+Decrement(std::map<std::string, unsigned, std::less<>> &map,
+	  std::string_view value) noexcept
+{
+	auto i = map.find(value);
+	assert(i != map.end());
+	assert(i->second > 0);
+
+	if (--i->second == 0)
+		map.erase(i);
+}
+
+/**
+ * Estimate the heap memory owned by a string.
+ */
+[[gnu::pure]]
+static std::size_t
+GetStringMemory(const std::string &s) noexcept
+{
+	/* short strings are stored inside the std::string object */
+	return s.capacity() > std::string{}.capacity()
+		? s.capacity() + 1
+		: 0;
+}
+
+[[gnu::pure]]
+static std::size_t
+GetTagMemory(const Tag &tag) noexcept
+{
+	return tag.num_items * sizeof(*tag.items);
+}
+
+/**
+ * Estimate the heap memory owned by a #Song.
+ */
+[[gnu::pure]]
+static std::size_t
+EstimateSongMemory(const Song &song) noexcept
+{
+	return (song.in_arena ? 0 : sizeof(song)) +
+		GetStringMemory(song.filename) +
+		GetStringMemory(song.target) +
+		GetTagMemory(song.tag);
+}
+
+void
+StatsIndex::AddTag(const Tag &tag) noexcept
+{
+	++song_count;
+
+	if (!tag.duration.IsNegative())
+		total_duration += tag.duration;
+
+	for (const auto &item : tag) {
+		switch (item.type) {
+		case TAG_ARTIST:
+			Increment(artists, item.value);
+			break;
+
+		case TAG_ALBUM:
+			Increment(albums, item.value);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+void
+StatsIndex::RemoveTag(const Tag &tag) noexcept
+{
+	assert(song_count > 0);
+	--song_count;
+
+	if (!tag.duration.IsNegative())
+		total_duration -= tag.duration;
+
+	for (const auto &item : tag) {
+		switch (item.type) {
+		case TAG_ARTIST:
+			Decrement(artists, item.value);
+			break;
+
+		case TAG_ALBUM:
+			Decrement(albums, item.value);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+void
+StatsIndex::Clear() noexcept
+{
+	song_count = 0;
+	total_duration = total_duration.zero();
+	artists.clear();
+	albums.clear();
+	virtual_songs.clear();
+	song_memory = 0;
+}
+
+static void
+AddDirectory(StatsIndex &index, const Directory &directory) noexcept
+{
+	for (const auto &song : directory.songs)
+		index.Add(song);
+
+	for (const auto &child : directory.children)
+		AddDirectory(index, child);
+}
+
+void
+StatsIndex::Build(const Directory &root) noexcept
+{
+	assert(holding_db_exclusive_lock());
+
+	Clear();
+	AddDirectory(*this, root);
+}
+
+void
+StatsIndex::Add(const Song &song) noexcept
+{
+	assert(holding_db_exclusive_lock());
+
+	song_memory += EstimateSongMemory(song);
+
+	if (!song.target.empty()) {
+		const auto i = std::lower_bound(virtual_songs.begin(),
+						virtual_songs.end(), &song,
+						std::less<>{});
+		if (i == virtual_songs.end() || *i != &song)
+			virtual_songs.insert(i, &song);
+		return;
+	}
+
+	AddTag(song.tag);
+}
+
+void
+StatsIndex::Remove(const Song &song) noexcept
+{
+	assert(holding_db_exclusive_lock());
+	assert(song_memory >= EstimateSongMemory(song));
+
+	song_memory -= EstimateSongMemory(song);
+
+	if (!song.target.empty()) {
+		const auto i = std::lower_bound(virtual_songs.begin(),
+						virtual_songs.end(), &song,
+						std::less<>{});
+		if (i != virtual_songs.end() && *i == &song)
+			virtual_songs.erase(i);
+		return;
+	}
+
+	RemoveTag(song.tag);
+}
+
+void
+StatsIndex::Update(const Song &song, const Tag &old_tag) noexcept
+{
+	assert(holding_db_exclusive_lock());
+
+	song_memory += GetTagMemory(song.tag);
+	song_memory -= GetTagMemory(old_tag);
+
+	if (!song.target.empty() || song.tag == old_tag)
+		return;
+
+	RemoveTag(old_tag);
+	AddTag(song.tag);
+}
+
+/**
+ * Count the tag values of songs which shall not be counted.
+ */
+static void
+CountHidden(std::map<std::string_view, unsigned> &artists,
+	    std::map<std::string_view, unsigned> &albums,
+	    const Tag &tag) noexcept
+{
+	for (const auto &item : tag) {
+		switch (item.type) {
+		case TAG_ARTIST:
+			++artists[item.value];
+			break;
+
+		case TAG_ALBUM:
+			++albums[item.value];
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+/**
+ * Count the keys of the #CountMap which have at least one item which
+ * is not hidden.
+ */
+static unsigned
+CountVisible(const std::map<std::string, unsigned, std::less<>> &map,
+	     const std::map<std::string_view, unsigned> &hidden) noexcept
+{
+	unsigned n = map.size();
+	for (const auto &[value, count] : hidden) {
+		const auto i = map.find(value);
+		assert(i != map.end());
+		assert(i->second >= count);
+
+		if (i->second == count)
+			--n;
+	}
+
+	return n;
+}
+
+[[gnu::pure]]
+static bool
+IsVisible(const std::map<std::string, unsigned, std::less<>> &map,
+	  const std::map<std::string_view, unsigned> &hidden,
+	  std::string_view value) noexcept
+{
+	const auto i = map.find(value);
+	if (i == map.end())
+		return false;
+
+	const auto j = hidden.find(value);
+	return j == hidden.end() || i->second > j->second;
+}
+
+DatabaseStats
+StatsIndex::Get(bool hide_playlist_targets) const noexcept
+{
+	assert(holding_db_lock());
+
+	DatabaseStats stats;
+	stats.song_count = song_count;
+	stats.total_duration = total_duration;
+
+	/* subtract the songs which are hidden because a playlist
+	   refers to them, like UpdateWalk::PurgeDanglingFromPlaylists()
+	   finds them */
+
+	std::set<const Song *> hidden;
+	if (hide_playlist_targets) {
+		for (const Song *song : virtual_songs) {
+			if (!song->parent.IsPlaylist() ||
+			    PathTraitsUTF8::IsAbsoluteOrHasScheme(song->target.c_str()))
+				continue;
+
+			/* LookupTargetSong() does not modify
+			   anything */
+			const Song *target = const_cast<Directory &>(song->parent)
+				.LookupTargetSong(song->target);
+			if (target != nullptr && target->in_playlist &&
+			    target->target.empty())
+				hidden.insert(target);
+		}
+	}
+
+	std::map<std::string_view, unsigned> hidden_artists, hidden_albums;
+	for (const Song *song : hidden) {
+		--stats.song_count;
+		if (!song->tag.duration.IsNegative())
+			stats.total_duration -= song->tag.duration;
+
+		CountHidden(hidden_artists, hidden_albums, song->tag);
+	}
+
+	/* add the songs with a "target" (with the merged tag
+	   returned by Song::Export()) */
+
+	std::set<std::string, std::less<>> extra_artists, extra_albums;
+	for (const Song *song : virtual_songs) {
+		if (hide_playlist_targets && song->in_playlist)
+			continue;
+
+		const auto exported = song->Export();
+		const Tag &tag = exported.tag;
+
+		++stats.song_count;
+		if (!tag.duration.IsNegative())
+			stats.total_duration += tag.duration;
+
+		for (const auto &item : tag) {
+			switch (item.type) {
+			case TAG_ARTIST:
+				if (!IsVisible(artists, hidden_artists, item.value))
+					extra_artists.emplace(item.value);
+				break;
+
+			case TAG_ALBUM:
+				if (!IsVisible(albums, hidden_albums, item.value))
+					extra_albums.emplace(item.value);
+				break;
+
+			default:
+				break;
+			}
+		}
+	}
+
+	stats.artist_count = CountVisible(artists, hidden_artists) +
+		extra_artists.size();
+	stats.album_count = CountVisible(albums, hidden_albums) +
+		extra_albums.size();
+	return stats;
+}
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "db/Stats.hxx"
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+struct Song;
+struct Directory;
+struct Tag;
+
+/**
+ * Maintains the numbers reported by the "stats" command while songs
+ * are being added and removed, which allows #SimpleDatabase to
+ * answer unfiltered GetStats() calls without walking the whole
+ * #Directory tree.
+ *
+ * Songs with a "target" (e.g. CUE tracks) are not counted, because
+ * their effective tags depend on other songs; the same goes for the
+ * "in_playlist" flag, which is only valid after the update has
+ * finished.  Both are evaluated by Get(), which only needs to look
+ * at the songs with a "target".
+ *
+ * All methods must be called while holding the #db_mutex; methods
+ * which modify the index need it in exclusive mode.
+ */
+class StatsIndex {
+	/**
+	 * Maps a tag value to the number of tag items which have it.
+	 */
+	using CountMap = std::map<std::string, unsigned, std::less<>>;
+
+	/**
+	 * The number of songs without a "target".
+	 */
+	unsigned song_count = 0;
+
+	/**
+	 * The total duration of all songs without a "target".
+	 */
+	decltype(DatabaseStats::total_duration) total_duration{};
+
+	CountMap artists, albums;
+
+	/**
+	 * Songs with a "target", sorted by address.
+	 */
+	std::vector<const Song *> virtual_songs;
+
+	/**
+	 * The heap memory owned by all songs (see EstimateSongMemory()).
+	 */
+	std::size_t song_memory = 0;
+
+public:
+	StatsIndex() noexcept = default;
+
+	StatsIndex(const StatsIndex &) = delete;
+	StatsIndex &operator=(const StatsIndex &) = delete;
+
+	/**
+	 * Remove all songs.
+	 */
+	void Clear() noexcept;
+
+	/**
+	 * Clear the index and add all songs in the given directory
+	 * tree (usually after loading the database file).
+	 */
+	void Build(const Directory &root) noexcept;
+
+	void Add(const Song &song) noexcept;
+
+	/**
+	 * Remove the song.  The song's tag must not have been
+	 * modified since it was added.
+	 */
+	void Remove(const Song &song) noexcept;
+
+	/**
+	 * Update the index after the song's tag has been modified.
+	 *
+	 * @param old_tag the tag which was used to add the song
+	 */
+	void Update(const Song &song, const Tag &old_tag) noexcept;
+
+	/**
+	 * Calculate the statistics of all songs, like ::GetStats()
+	 * with an unfiltered #DatabaseSelection would.
+	 */
+	[[gnu::pure]]
+	DatabaseStats Get(bool hide_playlist_targets) const noexcept;
+
+	/**
+	 * Returns the number of bytes allocated on the heap by all
+	 * songs, excluding the #SongArena and the (shared) tag pool
+	 * items.
+	 */
+	std::size_t GetSongMemory() const noexcept {
+		return song_memory;
+	}
+
+private:
+	void AddTag(const Tag &tag) noexcept;
+	void RemoveTag(const Tag &tag) noexcept;
+};
@@ -0,0 +1,418 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "TagIndex.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "ExportedSong.hxx"
+#include "db/DatabaseLock.hxx"
+#include "song/Filter.hxx"
+#include "song/TagSongFilter.hxx"
+#include "song/StringFilter.hxx"
+#include "tag/VisitFallback.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <set>
+#include <unordered_set>
+
+using DirectorySet = std::unordered_set<const Directory *>;
+
+static void
+InsertSorted(std::vector<const Song *> &list, const Song &song) noexcept
+{
+	const auto i = std::lower_bound(list.begin(), list.end(), &song,
+					std::less<>{});
+	if (i == list.end() || *i != &song)
+		list.insert(i, &song);
+}
+
+static void
+EraseSorted(std::vector<const Song *> &list, const Song &song) noexcept
+{
+	const auto i = std::lower_bound(list.begin(), list.end(), &song,
+					std::less<>{});
+	if (i != list.end() && *i == &song)
+		list.erase(i);
+}
+
+static void
+SortUnique(std::vector<const Song *> &list) noexcept
+{
+	std::sort(list.begin(), list.end(), std::less<>{});
+	list.erase(std::unique(list.begin(), list.end()), list.end());
+}
+
+/**
+ * Invoke the given function for each index key of the song for the
+ * given tag type.
+ */
+template<typename F>
+static void
+VisitKeys(const Tag &tag, TagType type, F &&f) noexcept
+{
+	VisitTagWithFallbackOrEmpty(tag, type, [&f](const char *value){
+		f(std::string_view{value});
+	});
+}
+
+void
+TagIndex::Clear() noexcept
+{
+	for (auto &i : values)
+		i.clear();
+
+	unindexed.clear();
+}
+
+static void
+CollectSongs(const Directory &directory,
+	     std::vector<const Song *> &songs) noexcept
+{
+	for (const auto &song : directory.songs)
+		songs.push_back(&song);
+
+	for (const auto &child : directory.children)
+		CollectSongs(child, songs);
+}
+
+void
+TagIndex::Build(const Directory &root) noexcept
+{
+	assert(holding_db_exclusive_lock());
+
+	Clear();
+
+	std::vector<const Song *> songs;
+	CollectSongs(root, songs);
+
+	/* append to the lists in bulk and sort them afterwards,
+	   which is much cheaper than sorted insertion */
+
+	for (const Song *song : songs) {
+		if (!song->target.empty()) {
+			unindexed.push_back(song);
+			continue;
+		}
+
+		for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+			const auto type = TagType(i);
+			if (!IsIndexed(type))
+				continue;
+
+			auto &map = values[i];
+			VisitKeys(song->tag, type, [&](std::string_view value){
+				auto j = map.lower_bound(value);
+				if (j == map.end() || j->first != value)
+					j = map.emplace_hint(j, value,
+							     SongList{});
+				j->second.push_back(song);
+			});
+		}
+	}
+
+	SortUnique(unindexed);
+
+	for (auto &map : values)
+		for (auto &[value, list] : map)
+			SortUnique(list);
+}
+
+void
+TagIndex::Add(const Song &song) noexcept
+{
+	assert(holding_db_exclusive_lock());
+
+	if (!song.target.empty()) {
+		InsertSorted(unindexed, song);
+		return;
+	}
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		const auto type = TagType(i);
+		if (!IsIndexed(type))
+			continue;
+
+		auto &map = values[i];
+		VisitKeys(song.tag, type, [&](std::string_view value){
+			auto j = map.lower_bound(value);
+			if (j == map.end() || j->first != value)
+				j = map.emplace_hint(j, value, SongList{});
+			InsertSorted(j->second, song);
+		});
+	}
+}
+
+void
+TagIndex::Remove(const Song &song) noexcept
+{
+	Remove(song, song.tag);
+}
+
+void
+TagIndex::Remove(const Song &song, const Tag &tag) noexcept
+{
+	assert(holding_db_exclusive_lock());
+
+	if (!song.target.empty()) {
+		EraseSorted(unindexed, song);
+		return;
+	}
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		const auto type = TagType(i);
+		if (!IsIndexed(type))
+			continue;
+
+		auto &map = values[i];
+		VisitKeys(tag, type, [&](std::string_view value){
+			auto j = map.find(value);
+			if (j == map.end())
+				return;
+
+			EraseSorted(j->second, song);
+			if (j->second.empty())
+				map.erase(j);
+		});
+	}
+}
+
+void
+TagIndex::Update(const Song &song, const Tag &old_tag) noexcept
+{
+	if (!song.target.empty() || song.tag == old_tag)
+		/* nothing to do; this is the common case during a
+		   "rescan" */
+		return;
+
+	Remove(song, old_tag);
+	Add(song);
+}
+
+/**
+ * Can the index be used to find the songs matching this filter item?
+ */
+[[gnu::pure]]
+static const TagSongFilter *
+GetIndexableFilter(const ISongFilter &item) noexcept
+{
+	const auto *f = dynamic_cast<const TagSongFilter *>(&item);
+	if (f == nullptr || f->GetTagType() == TAG_NUM_OF_ITEM_TYPES)
+		return nullptr;
+
+	const auto &filter = f->GetFilter();
+	if (filter.IsNegated() || !filter.IsBytewise())
+		return nullptr;
+
+	switch (filter.GetPosition()) {
+	case StringFilter::Position::FULL:
+	case StringFilter::Position::PREFIX:
+		return f;
+
+	case StringFilter::Position::ANYWHERE:
+		break;
+	}
+
+	return nullptr;
+}
+
+bool
+TagIndex::CanVisit(const SongFilter &filter) const noexcept
+{
+	return std::any_of(filter.GetItems().begin(), filter.GetItems().end(),
+			   [this](const auto &item){
+				   const auto *f = GetIndexableFilter(*item);
+				   return f != nullptr &&
+					   IsIndexed(f->GetTagType());
+			   });
+}
+
+bool
+TagIndex::FindCandidates(const SongFilter &filter,
+			 SongList &candidates) const noexcept
+{
+	/* pick the filter item with the fewest songs */
+
+	ValueMap::const_iterator best_begin, best_end;
+	std::size_t best_count = SIZE_MAX;
+
+	for (const auto &item : filter.GetItems()) {
+		const auto *f = GetIndexableFilter(*item);
+		if (f == nullptr || !IsIndexed(f->GetTagType()))
+			continue;
+
+		const auto &map = values[f->GetTagType()];
+		const std::string_view value = f->GetValue();
+
+		ValueMap::const_iterator begin, end;
+		if (f->GetFilter().GetPosition() == StringFilter::Position::FULL) {
+			begin = end = map.find(value);
+			if (end != map.end())
+				++end;
+		} else {
+			begin = end = map.lower_bound(value);
+			while (end != map.end() && end->first.starts_with(value))
+				++end;
+		}
+
+		std::size_t count = 0;
+		for (auto i = begin; i != end; ++i)
+			count += i->second.size();
+
+		if (count < best_count) {
+			best_begin = begin;
+			best_end = end;
+			best_count = count;
+		}
+	}
+
+	if (best_count == SIZE_MAX)
+		return false;
+
+	candidates.reserve(best_count + unindexed.size());
+
+	const bool single = best_begin != best_end &&
+		std::next(best_begin) == best_end;
+
+	for (auto i = best_begin; i != best_end; ++i)
+		candidates.insert(candidates.end(),
+				  i->second.begin(), i->second.end());
+
+	if (!single)
+		/* a song may have several values with the same
+		   prefix */
+		SortUnique(candidates);
+
+	if (!unindexed.empty()) {
+		const auto middle = candidates.insert(candidates.end(),
+						      unindexed.begin(),
+						      unindexed.end());
+		std::inplace_merge(candidates.begin(), middle,
+				   candidates.end(), std::less<>{});
+	}
+
+	return true;
+}
+
+/**
+ * Like Directory::Walk(), but visit only the candidate songs and
+ * descend only into marked directories.
+ */
+static void
+WalkCandidates(const Directory &directory,
+	       const std::vector<const Song *> &candidates,
+	       const DirectorySet &marked,
+	       const SongFilter &filter, bool hide_playlist_targets,
+	       const VisitSong &visit_song)
+{
+	for (const auto &song : directory.songs) {
+		if (!std::binary_search(candidates.begin(), candidates.end(),
+					&song, std::less<>{}))
+			continue;
+
+		if (hide_playlist_targets && song.in_playlist)
+			continue;
+
+		const auto song2 = song.Export();
+		if (filter.Match(song2))
+			visit_song(song2);
+	}
+
+	for (const auto &child : directory.children)
+		if (marked.contains(&child))
+			WalkCandidates(child, candidates, marked,
+				       filter, hide_playlist_targets,
+				       visit_song);
+}
+
+bool
+TagIndex::Visit(const Directory &directory, const SongFilter &filter,
+		bool hide_playlist_targets,
+		const VisitSong &visit_song) const
+{
+	assert(holding_db_lock());
+
+	SongList candidates;
+	if (!FindCandidates(filter, candidates)) {
+		CountMiss();
+		return false;
+	}
+
+	hits.fetch_add(1, std::memory_order_relaxed);
+
+	if (candidates.empty())
+		return true;
+
+	/* mark all directories containing candidates (and their
+	   ancestors) below the given directory; songs outside of it
+	   will never be reached by WalkCandidates() */
+	DirectorySet marked;
+	for (const Song *song : candidates)
+		for (const Directory *i = &song->parent;
+		     i != nullptr && i != &directory; i = i->parent)
+			if (!marked.insert(i).second)
+				break;
+
+	WalkCandidates(directory, candidates, marked,
+		       filter, hide_playlist_targets, visit_song);
+	return true;
+}
+
+void
+TagIndex::VisitUniqueValues(TagType type, bool hide_playlist_targets,
+			    const std::string *after, RangeArg window,
+			    const std::function<void(std::string_view)> &visit) const
+{
+	assert(holding_db_lock());
+	assert(IsIndexed(type));
+
+	hits.fetch_add(1, std::memory_order_relaxed);
+
+	const auto is_visible = [hide_playlist_targets](const Song *song){
+		return !hide_playlist_targets || !song->in_playlist;
+	};
+
+	/* the values of unindexed songs need to be merged into the
+	   index keys */
+	std::set<std::string, std::less<>> extra;
+	for (const Song *song : unindexed) {
+		if (!is_visible(song))
+			continue;
+
+		const auto exported = song->Export();
+		VisitKeys(exported.tag, type, [after, &extra](std::string_view value){
+			if (after == nullptr || value > *after)
+				extra.emplace(value);
+		});
+	}
+
+	const auto &map = values[type];
+	auto i = after != nullptr ? map.upper_bound(*after) : map.begin();
+	auto j = extra.begin();
+
+	for (unsigned position = 0; position < window.end;) {
+		if (i != map.end() &&
+		    std::none_of(i->second.begin(), i->second.end(),
+				 is_visible)) {
+			++i;
+			continue;
+		}
+
+		std::string_view value;
+		if (i != map.end() && (j == extra.end() || i->first <= *j)) {
+			value = i->first;
+			if (j != extra.end() && *j == i->first)
+				++j;
+			++i;
+		} else if (j != extra.end()) {
+			value = *j;
+			++j;
+		} else
+			break;
+
+		if (position++ >= window.start)
+			visit(value);
+	}
+}
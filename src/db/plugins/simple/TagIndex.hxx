@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "db/Visitor.hxx"
+#include "protocol/RangeArg.hxx"
+#include "tag/Mask.hxx"
+#include "tag/Type.hxx"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct Song;
+struct Directory;
+struct Tag;
+class SongFilter;
+
+/**
+ * An inverted index which maps tag values to the songs which have
+ * them.  It allows #SimpleDatabase to answer requests with
+ * case-sensitive equality and prefix tag filters (i.e. "find",
+ * "list" and filter expressions with "==" or "starts_with") without
+ * walking the whole #Directory tree.
+ *
+ * Case-folding filters (e.g. "search") are not accelerated: the
+ * keys are the raw tag values, and looking up a folded value would
+ * require a second set of keys.
+ *
+ * The index keys are the same values which #TagSongFilter compares,
+ * i.e. including the tag fallbacks (see VisitTagWithFallbackOrEmpty()).
+ * Songs with a "target" (e.g. playlist entries) are not indexed,
+ * because their effective tags depend on other songs; they are always
+ * considered candidates.
+ *
+ * All methods must be called while holding the #db_mutex; methods
+ * which modify the index need it in exclusive mode.
+ */
+class TagIndex {
+	/**
+	 * A list of songs sorted by address, which allows binary
+	 * searching and merging.
+	 */
+	using SongList = std::vector<const Song *>;
+
+	using ValueMap = std::map<std::string, SongList, std::less<>>;
+
+	/**
+	 * The tag types which are indexed.
+	 */
+	const TagMask mask;
+
+	std::array<ValueMap, TAG_NUM_OF_ITEM_TYPES> values;
+
+	/**
+	 * Songs which could not be indexed (see class
+	 * documentation).
+	 */
+	SongList unindexed;
+
+	/**
+	 * The number of Visit() calls which could use the index.
+	 */
+	mutable std::atomic_uint_least64_t hits{0};
+
+	/**
+	 * The number of Visit() calls which required a full scan.
+	 */
+	mutable std::atomic_uint_least64_t misses{0};
+
+public:
+	explicit TagIndex(TagMask _mask) noexcept
+		:mask(_mask) {}
+
+	TagIndex(const TagIndex &) = delete;
+	TagIndex &operator=(const TagIndex &) = delete;
+
+	bool IsIndexed(TagType type) const noexcept {
+		return mask.Test(type);
+	}
+
+	uint_least64_t GetHits() const noexcept {
+		return hits.load(std::memory_order_relaxed);
+	}
+
+	uint_least64_t GetMisses() const noexcept {
+		return misses.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Remove all songs from the index.
+	 */
+	void Clear() noexcept;
+
+	/**
+	 * Clear the index and add all songs in the given directory
+	 * tree (usually after loading the database file).
+	 */
+	void Build(const Directory &root) noexcept;
+
+	void Add(const Song &song) noexcept;
+
+	/**
+	 * Remove the song from the index.  The song's tag must not
+	 * have been modified since it was added.
+	 */
+	void Remove(const Song &song) noexcept;
+
+	/**
+	 * Update the index after the song's tag has been modified.
+	 *
+	 * @param old_tag the tag which was used to add the song
+	 */
+	void Update(const Song &song, const Tag &old_tag) noexcept;
+
+	/**
+	 * Can Visit() use the index for this filter?
+	 */
+	[[gnu::pure]]
+	bool CanVisit(const SongFilter &filter) const noexcept;
+
+	/**
+	 * Attempt to visit all songs within the given directory
+	 * (recursively) which match the filter, in the same order as
+	 * Directory::Walk() would.  This only works if the filter
+	 * contains at least one non-negated equality or prefix
+	 * #TagSongFilter on an indexed tag.
+	 *
+	 * Throws if #visit_song throws.
+	 *
+	 * @return false if the index cannot be used for this filter
+	 * and the caller needs to fall back to Directory::Walk()
+	 */
+	bool Visit(const Directory &directory, const SongFilter &filter,
+		   bool hide_playlist_targets,
+		   const VisitSong &visit_song) const;
+
+	/**
+	 * Visit the unique values of the given (indexed) tag type of
+	 * all songs in sorted order, like UniqueTagCollector would.
+	 *
+	 * Throws if #visit throws.
+	 *
+	 * @param after if not nullptr, then start after this value;
+	 * this allows resuming after the #db_mutex has been released
+	 * @param window the range of unique values (after #after)
+	 * which shall be visited
+	 */
+	void VisitUniqueValues(TagType type, bool hide_playlist_targets,
+			       const std::string *after, RangeArg window,
+			       const std::function<void(std::string_view)> &visit) const;
+
+	/**
+	 * Count a Visit() call which needed a full scan for reasons
+	 * unrelated to the filter.
+	 */
+	void CountMiss() const noexcept {
+		misses.fetch_add(1, std::memory_order_relaxed);
+	}
+
+private:
+	void Remove(const Song &song, const Tag &tag) noexcept;
+
+	/**
+	 * Collect the songs for the most selective filter item.
+	 *
+	 * @return false if no filter item can use the index
+	 */
+	bool FindCandidates(const SongFilter &filter,
+			    SongList &candidates) const noexcept;
+};
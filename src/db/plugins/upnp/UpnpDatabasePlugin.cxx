@@ -20,7 +20,6 @@
 #include "db/Stats.hxx"
 #include "tag/Table.hxx"
 #include "fs/Traits.hxx"
-#include "util/RecursiveMap.hxx"
 #include "util/StringSplit.hxx"
 #include "config/Block.hxx"
 
@@ -97,8 +96,10 @@ public:
 		   VisitSong visit_song,
 		   VisitPlaylist visit_playlist) const override;
 
-	[[nodiscard]] RecursiveMap<std::string> CollectUniqueTags(const DatabaseSelection &selection,
-								  std::span<const TagType> tag_types) const override;
+	void VisitUniqueTags(const DatabaseSelection &selection,
+			     std::span<const TagType> tag_types,
+			     RangeArg window,
+			     const VisitUniqueTag &visit) const override;
 
 	[[nodiscard]] DatabaseStats GetStats(const DatabaseSelection &selection) const override;
 
@@ -606,11 +607,13 @@ UpnpDatabase::Visit(const DatabaseSelection &selection,
 	helper.Commit();
 }
 
-RecursiveMap<std::string>
-UpnpDatabase::CollectUniqueTags(const DatabaseSelection &selection,
-				std::span<const TagType> tag_types) const
+void
+UpnpDatabase::VisitUniqueTags(const DatabaseSelection &selection,
+			      std::span<const TagType> tag_types,
+			      RangeArg window,
+			      const VisitUniqueTag &visit) const
 {
-	return ::CollectUniqueTags(*this, selection, tag_types);
+	::VisitUniqueTags(*this, selection, tag_types, window, visit);
 }
 
 DatabaseStats
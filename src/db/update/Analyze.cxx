@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Analyze.hxx"
+#include "song/Analysis.hxx"
+#include "decoder/Client.hxx"
+#include "decoder/Command.hxx"
+#include "decoder/DecoderList.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "input/InputStream.hxx"
+#include "input/LocalOpen.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "pcm/Convert.hxx"
+#include "pcm/MixRampAnalyzer.hxx"
+#include "pcm/MixRampGlue.hxx"
+#include "fs/Path.hxx"
+#include "util/SpanCast.hxx"
+
+#include <cassert>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+/**
+ * A #DecoderClient which feeds all decoded samples into the
+ * ReplayGain and MixRamp analyzers.
+ */
+class AnalysisDecoderClient final : public DecoderClient {
+	static constexpr AudioFormat analysis_format{
+		ReplayGainAnalyzer::SAMPLE_RATE,
+		SampleFormat::FLOAT,
+		ReplayGainAnalyzer::CHANNELS,
+	};
+
+	const std::atomic_bool &cancel;
+
+	/**
+	 * Converts the decoder output to #analysis_format; nullptr
+	 * if the decoder produces this format already.
+	 */
+	std::unique_ptr<PcmConvert> convert;
+
+	WindowReplayGainAnalyzer replay_gain;
+
+	MixRampAnalyzer mix_ramp;
+
+	/**
+	 * This is set when an error occurs while decoding; it will
+	 * be rethrown by Finish().
+	 */
+	std::exception_ptr error;
+
+	bool ready = false;
+
+	/**
+	 * Has the decoder plugin found ReplayGain/MixRamp tags?  In
+	 * that case, the respective analyzer is not used.
+	 */
+	bool has_replay_gain = false, has_mix_ramp = false;
+
+public:
+	Mutex mutex;
+
+	explicit AnalysisDecoderClient(const std::atomic_bool &_cancel) noexcept
+		:cancel(_cancel) {}
+
+	bool IsReady() const noexcept {
+		return ready;
+	}
+
+	/**
+	 * Throws on error.
+	 */
+	SongAnalysis Finish(AlbumAnalyzer *album);
+
+	/* virtual methods from DecoderClient */
+	void Ready(AudioFormat audio_format,
+		   bool seekable, SignedSongTime duration) noexcept override;
+
+	DecoderCommand GetCommand() noexcept override {
+		return error || cancel || (has_replay_gain && has_mix_ramp)
+			? DecoderCommand::STOP
+			: DecoderCommand::NONE;
+	}
+
+	void CommandFinished() noexcept override {}
+
+	SongTime GetSeekTime() noexcept override {
+		return SongTime::zero();
+	}
+
+	uint64_t GetSeekFrame() noexcept override {
+		return 0;
+	}
+
+	void SeekError(std::exception_ptr &&) noexcept override {}
+
+	InputStreamPtr OpenUri(std::string_view uri) override {
+		return InputStream::OpenReady(uri, mutex);
+	}
+
+	size_t Read(InputStream &is,
+		    std::span<std::byte> dest) noexcept override;
+
+	void SubmitTimestamp(FloatDuration) noexcept override {}
+	DecoderCommand SubmitAudio(InputStream *is,
+				   std::span<const std::byte> audio,
+				   uint16_t kbit_rate) noexcept override;
+
+	DecoderCommand SubmitTag(InputStream *, Tag &&) noexcept override {
+		return GetCommand();
+	}
+
+	void SubmitReplayGain(const ReplayGainInfo *info) noexcept override {
+		if (info != nullptr && info->IsDefined())
+			has_replay_gain = true;
+	}
+
+	void SubmitMixRamp(MixRampInfo &&info) noexcept override {
+		if (info.IsDefined())
+			has_mix_ramp = true;
+	}
+
+private:
+	void Feed(std::span<const std::byte> audio) noexcept;
+};
+
+}
+
+void
+AnalysisDecoderClient::Ready(AudioFormat audio_format, bool,
+			     SignedSongTime) noexcept
+{
+	if (audio_format != analysis_format) {
+		try {
+			convert = std::make_unique<PcmConvert>(audio_format,
+							       analysis_format);
+		} catch (...) {
+			error = std::current_exception();
+		}
+	}
+
+	ready = true;
+}
+
+inline void
+AnalysisDecoderClient::Feed(std::span<const std::byte> audio) noexcept
+{
+	const auto frames =
+		FromBytesStrict<const ReplayGainAnalyzer::Frame>(audio);
+	if (frames.empty())
+		return;
+
+	if (!has_replay_gain)
+		replay_gain.Process(frames);
+
+	if (!has_mix_ramp)
+		mix_ramp.Process(frames);
+}
+
+DecoderCommand
+AnalysisDecoderClient::SubmitAudio(InputStream *,
+				   std::span<const std::byte> audio,
+				   uint16_t) noexcept
+{
+	assert(ready);
+
+	if (convert) {
+		try {
+			audio = convert->Convert(audio);
+		} catch (...) {
+			error = std::current_exception();
+			return DecoderCommand::STOP;
+		}
+	}
+
+	Feed(audio);
+
+	return GetCommand();
+}
+
+size_t
+AnalysisDecoderClient::Read(InputStream &is,
+			    std::span<std::byte> dest) noexcept
+{
+	try {
+		return is.LockRead(dest);
+	} catch (...) {
+		error = std::current_exception();
+		return 0;
+	}
+}
+
+inline SongAnalysis
+AnalysisDecoderClient::Finish(AlbumAnalyzer *album)
+{
+	if (error)
+		std::rethrow_exception(error);
+
+	if (!ready)
+		throw std::runtime_error("Decoding failed");
+
+	if (convert) {
+		while (true) {
+			const auto flushed = convert->Flush();
+			if (flushed.empty())
+				break;
+
+			Feed(flushed);
+		}
+	}
+
+	SongAnalysis result;
+
+	if (!has_replay_gain) {
+		replay_gain.Flush();
+
+		if (replay_gain.IsDefined()) {
+			result.replay_gain.track = {
+				replay_gain.GetGain(),
+				replay_gain.GetPeak(),
+			};
+
+			if (album != nullptr)
+				album->Add(replay_gain);
+		}
+	}
+
+	if (!has_mix_ramp && mix_ramp.GetTime() > FloatDuration{}) {
+		const auto &data = mix_ramp.GetResult();
+		result.mix_ramp.SetStart(MixRampStartToString(data));
+		result.mix_ramp.SetEnd(MixRampEndToString(data,
+							  mix_ramp.GetTime()));
+	}
+
+	return result;
+}
+
+SongAnalysis
+AnalyzeSongFile(Path path, std::string_view suffix,
+		AlbumAnalyzer *album, const std::atomic_bool &cancel)
+{
+	/* the analyzers are too large for the stack */
+	auto client = std::make_unique<AnalysisDecoderClient>(cancel);
+
+	auto is = OpenLocalInputStream(path, client->mutex);
+
+	for (const auto &plugin : GetEnabledDecoderPlugins()) {
+		if (!plugin.SupportsSuffix(suffix))
+			continue;
+
+		if (plugin.file_decode != nullptr) {
+			plugin.FileDecode(*client, path);
+		} else if (plugin.stream_decode != nullptr) {
+			/* rewind the stream, so each plugin gets a
+			   fresh start */
+			try {
+				is->LockRewind();
+			} catch (...) {
+			}
+
+			plugin.StreamDecode(*client, *is);
+		} else
+			continue;
+
+		if (client->IsReady() || cancel)
+			break;
+	}
+
+	return client->Finish(album);
+}
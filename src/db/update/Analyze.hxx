@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "pcm/ReplayGainAnalyzer.hxx"
+#include "tag/ReplayGainInfo.hxx"
+#include "thread/Mutex.hxx"
+
+#include <atomic>
+#include <string_view>
+
+struct SongAnalysis;
+class Path;
+
+/**
+ * Collects the loudness of all tracks of an album to calculate the
+ * album gain.  Tracks may be added from several threads.
+ */
+class AlbumAnalyzer {
+	Mutex mutex;
+
+	ReplayGainAnalyzer analyzer;
+
+public:
+	void Add(const ReplayGainAnalyzer &track) noexcept {
+		const std::scoped_lock protect{mutex};
+		analyzer.Merge(track);
+	}
+
+	/**
+	 * Obtain the album gain.  This must not be called while
+	 * other threads may still call Add().
+	 */
+	[[gnu::pure]]
+	ReplayGainTuple GetTuple() const noexcept {
+		return analyzer.IsDefined()
+			? ReplayGainTuple{analyzer.GetGain(), analyzer.GetPeak()}
+			: ReplayGainTuple::Undefined();
+	}
+};
+
+/**
+ * Decode a local song file and calculate its ReplayGain track gain
+ * and its MixRamp values, unless the decoder plugin finds the
+ * corresponding tags in the file.  This does not touch the
+ * database and may be called in a #UpdateScanPool thread.
+ *
+ * Throws on error.
+ *
+ * @param suffix the file name suffix which selects the decoder
+ * plugin
+ * @param album if not nullptr, then the loudness of this track is
+ * added to it
+ * @param cancel decoding stops as soon as this becomes true
+ */
+SongAnalysis
+AnalyzeSongFile(Path path, std::string_view suffix,
+		AlbumAnalyzer *album, const std::atomic_bool &cancel);
@@ -32,7 +32,7 @@ LockMakeChild(Directory &directory, std::string_view name) noexcept
 static Song *
 LockFindSong(Directory &directory, std::string_view name) noexcept
 {
-	const ScopeDatabaseLock protect;
+	const ScopeDatabaseSharedLock protect;
 	return directory.FindSong(name);
 }
 
@@ -60,17 +60,17 @@ UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Directory &directory,
 		if (song == nullptr) {
 			auto new_song = Song::LoadFromArchive(archive, name, directory);
 			if (new_song) {
-				{
-					const ScopeDatabaseLock protect;
-					directory.AddSong(std::move(new_song));
-				}
+				editor.LockAddSong(directory,
+						   std::move(new_song));
 
 				modified = true;
 				FmtNotice(update_domain, "added {}/{}",
 					  directory.GetPath(), name);
 			}
 		} else {
-			if (!song->UpdateFileInArchive(archive)) {
+			if (!editor.UpdateSong(*song, [song, &archive]{
+				return song->UpdateFileInArchive(archive);
+			})) {
 				FmtDebug(update_domain,
 					 "deleting unrecognized file {}/{}",
 					 directory.GetPath(), name);
@@ -6,6 +6,10 @@
 #include "config/Option.hxx"
 
 UpdateConfig::UpdateConfig(const ConfigData &config)
+	:n_threads(config.GetPositive(ConfigOption::UPDATE_THREADS,
+				      DEFAULT_N_THREADS)),
+	 scan_cache_path(config.GetPath(ConfigOption::SCAN_CACHE_FILE)),
+	 analysis(config.GetBool(ConfigOption::UPDATE_ANALYSIS, false))
 {
 #ifndef _WIN32
 	follow_inside_symlinks =
@@ -15,7 +19,5 @@ UpdateConfig::UpdateConfig(const ConfigData &config)
 	follow_outside_symlinks =
 		config.GetBool(ConfigOption::FOLLOW_OUTSIDE_SYMLINKS,
 			       DEFAULT_FOLLOW_OUTSIDE_SYMLINKS);
-#else
-	(void)config;
 #endif
 }
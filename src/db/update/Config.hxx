@@ -4,6 +4,8 @@
 #ifndef MPD_UPDATE_CONFIG_HXX
 #define MPD_UPDATE_CONFIG_HXX
 
+#include "fs/AllocatedPath.hxx"
+
 struct ConfigData;
 
 struct UpdateConfig {
@@ -15,6 +17,26 @@ struct UpdateConfig {
 	bool follow_outside_symlinks = DEFAULT_FOLLOW_OUTSIDE_SYMLINKS;
 #endif
 
+	static constexpr unsigned DEFAULT_N_THREADS = 1;
+
+	/**
+	 * The number of threads which scan song files concurrently
+	 * (including the update thread itself).
+	 */
+	unsigned n_threads = DEFAULT_N_THREADS;
+
+	/**
+	 * The path of the #UpdateScanCache file; "nulled" if the
+	 * cache is disabled.
+	 */
+	AllocatedPath scan_cache_path = nullptr;
+
+	/**
+	 * Calculate ReplayGain and MixRamp values for song files
+	 * which do not have such tags?
+	 */
+	bool analysis = false;
+
 	explicit UpdateConfig(const ConfigData &config);
 };
 
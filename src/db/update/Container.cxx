@@ -63,10 +63,7 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 				  contdir->GetPath(),
 				  song->filename);
 
-			{
-				const ScopeDatabaseLock protect;
-				contdir->AddSong(std::move(song));
-			}
+			editor.LockAddSong(*contdir, std::move(song));
 
 			modified = true;
 		}
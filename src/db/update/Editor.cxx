@@ -7,14 +7,95 @@
 #include "db/DatabaseLock.hxx"
 #include "db/plugins/simple/Directory.hxx"
 #include "db/plugins/simple/Song.hxx"
+#include "db/plugins/simple/TagIndex.hxx"
+#include "db/plugins/simple/StatsIndex.hxx"
 
 #include <cassert>
+#include <utility>
+
+void
+DatabaseEditor::LockAddSong(Directory &parent, SongPtr song)
+{
+	assert(&song->parent == &parent);
+
+	const ScopeDatabaseLock protect;
+
+	if (tag_index != nullptr)
+		tag_index->Add(*song);
+
+	if (stats_index != nullptr)
+		stats_index->Add(*song);
+
+	parent.AddSong(std::move(song));
+}
+
+void
+DatabaseEditor::LockUpdateSong(Song &song, Song &&src) noexcept
+{
+	const ScopeDatabaseLock protect;
+
+	Tag old_tag = std::exchange(song.tag, std::move(src.tag));
+	song.mtime = src.mtime;
+	song.audio_format = src.audio_format;
+	song.analysis = std::move(src.analysis);
+	song.parent.MarkModified();
+
+	if (tag_index != nullptr)
+		tag_index->Update(song, old_tag);
+
+	if (stats_index != nullptr)
+		stats_index->Update(song, old_tag);
+}
+
+void
+DatabaseEditor::LockSetAnalysis(Song &song,
+				std::shared_ptr<const SongAnalysis> &&analysis) noexcept
+{
+	const ScopeDatabaseLock protect;
+	song.analysis = std::move(analysis);
+	song.parent.MarkModified();
+}
+
+Tag
+DatabaseEditor::LockCopyTag(const Song &song) noexcept
+{
+	const ScopeDatabaseLock protect;
+	return Tag{song.tag};
+}
+
+void
+DatabaseEditor::LockSongModified(Song &song) noexcept
+{
+	const ScopeDatabaseLock protect;
+	song.parent.MarkModified();
+}
+
+void
+DatabaseEditor::LockTagModified(Song &song, const Tag &old_tag) noexcept
+{
+	assert(tag_index != nullptr || stats_index != nullptr);
+
+	const ScopeDatabaseLock protect;
+	song.parent.MarkModified();
+
+	if (tag_index != nullptr)
+		tag_index->Update(song, old_tag);
+
+	if (stats_index != nullptr)
+		stats_index->Update(song, old_tag);
+}
 
 void
 DatabaseEditor::DeleteSong(Directory &dir, Song *del)
 {
 	assert(&del->parent == &dir);
 
+	if (tag_index != nullptr)
+		tag_index->Remove(*del);
+
+	if (stats_index != nullptr)
+		stats_index->Remove(*del);
+
 	/* first, prevent traversers in main task from getting this */
 	const SongPtr song = dir.RemoveSong(del);
 
@@ -91,7 +172,8 @@ DatabaseEditor::DeleteNameIn(Directory &parent, std::string_view name)
 		modified = true;
 	}
 
-	parent.playlists.erase(name);
+	if (parent.playlists.erase(name))
+		parent.MarkModified();
 
 	return modified;
 }
@@ -5,16 +5,85 @@
 #define MPD_UPDATE_DATABASE_HXX
 
 #include "Remove.hxx"
+#include "db/plugins/simple/Ptr.hxx"
+#include "tag/Tag.hxx"
+
+#include <memory>
 
 struct Directory;
 struct Song;
+struct SongAnalysis;
+class TagIndex;
+class StatsIndex;
 
 class DatabaseEditor final {
 	UpdateRemoveService remove;
 
+	/**
+	 * The index which needs to be updated with all modifications
+	 * (or nullptr if the database has none).
+	 */
+	TagIndex *const tag_index;
+
+	/**
+	 * The statistics which need to be updated with all
+	 * modifications (or nullptr if the database has none).
+	 */
+	StatsIndex *const stats_index;
+
 public:
-	DatabaseEditor(EventLoop &_loop, DatabaseListener &_listener)
-		:remove(_loop, _listener) {}
+	DatabaseEditor(EventLoop &_loop, DatabaseListener &_listener,
+		       TagIndex *_tag_index, StatsIndex *_stats_index) noexcept
+		:remove(_loop, _listener),
+		 tag_index(_tag_index), stats_index(_stats_index) {}
+
+	/**
+	 * Add a new song to the directory.
+	 *
+	 * Caller must NOT lock the #db_mutex.
+	 */
+	void LockAddSong(Directory &parent, SongPtr song);
+
+	/**
+	 * Copy the metadata (tag, modification time and audio format)
+	 * of a freshly loaded #Song object to an existing song.  The
+	 * old #SongAnalysis is discarded because it belongs to the
+	 * old file contents.
+	 *
+	 * Caller must NOT lock the #db_mutex.
+	 */
+	void LockUpdateSong(Song &song, Song &&src) noexcept;
+
+	/**
+	 * Store the result of a song analysis.
+	 *
+	 * Caller must NOT lock the #db_mutex.
+	 */
+	void LockSetAnalysis(Song &song,
+			     std::shared_ptr<const SongAnalysis> &&analysis) noexcept;
+
+	/**
+	 * Invoke a function which modifies the tag of an existing
+	 * song (e.g. Song::UpdateFile()) and update the #TagIndex
+	 * and the #StatsIndex afterwards.
+	 *
+	 * Caller must NOT lock the #db_mutex.
+	 *
+	 * @return the return value of the function
+	 */
+	template<typename F>
+	bool UpdateSong(Song &song, F &&f) {
+		if (tag_index == nullptr && stats_index == nullptr) {
+			const bool result = f();
+			LockSongModified(song);
+			return result;
+		}
+
+		const auto old_tag = LockCopyTag(song);
+		const bool result = f();
+		LockTagModified(song, old_tag);
+		return result;
+	}
 
 	/**
 	 * Caller must lock the #db_mutex.
@@ -46,6 +115,10 @@ public:
 	bool DeleteNameIn(Directory &parent, std::string_view name);
 
 private:
+	Tag LockCopyTag(const Song &song) noexcept;
+	void LockSongModified(Song &song) noexcept;
+	void LockTagModified(Song &song, const Tag &old_tag) noexcept;
+
 	void ClearDirectory(Directory &directory);
 };
 
@@ -45,10 +45,7 @@ UpdateWalk::UpdatePlaylistFile(Directory &directory,
 			: "../" + db_song->filename;
 		db_song->filename = fmt::format("track{:04}", ++track);
 
-		{
-			const ScopeDatabaseLock protect;
-			directory.AddSong(std::move(db_song));
-		}
+		editor.LockAddSong(directory, std::move(db_song));
 	}
 }
 
@@ -109,8 +106,10 @@ UpdateWalk::UpdatePlaylistFile(Directory &directory,
 	PlaylistInfo pi(name, info.mtime);
 
 	const ScopeDatabaseLock protect;
-	if (directory.playlists.UpdateOrInsert(std::move(pi)))
+	if (directory.playlists.UpdateOrInsert(std::move(pi))) {
+		directory.MarkModified();
 		modified = true;
+	}
 
 	return true;
 }
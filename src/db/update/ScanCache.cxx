@@ -0,0 +1,347 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ScanCache.hxx"
+#include "UpdateDomain.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "storage/FileInfo.hxx"
+#include "pcm/AudioParser.hxx"
+#include "lib/fmt/AudioFormatFormatter.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
+#include "lib/fmt/PathFormatter.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "io/BufferedOutputStream.hxx"
+#include "io/FileLineReader.hxx"
+#include "io/FileOutputStream.hxx"
+#include "input/Error.hxx"
+#include "system/Error.hxx"
+#include "tag/Builder.hxx"
+#include "tag/Names.hxx"
+#include "tag/ParseName.hxx"
+#include "tag/Settings.hxx"
+#include "TagSave.hxx"
+#include "util/CNumberParser.hxx"
+#include "util/StringAPI.hxx"
+#include "util/StringCompare.hxx"
+#include "util/StringStrip.hxx"
+#include "Log.hxx"
+#include "Version.h"
+
+#include <cassert>
+#include <cstring>
+
+#define SCAN_CACHE_FORMAT "mpd_scan_cache: "
+#define SCAN_CACHE_MPD_VERSION "mpd_version: "
+#define SCAN_CACHE_TAG "tag: "
+#define SCAN_CACHE_INFO_END "info_end"
+#define SCAN_CACHE_ENTRY "entry: "
+#define SCAN_CACHE_ENTRY_END "entry_end"
+
+static constexpr unsigned SCAN_CACHE_VERSION = 1;
+
+UpdateScanCache::Entry::Entry(const StorageFileInfo &info,
+			      const Song &song) noexcept
+	:size(info.size), inode(info.inode),
+	 mtime(std::chrono::system_clock::to_time_t(info.mtime)),
+	 tag(song.tag), audio_format(song.audio_format)
+{
+}
+
+static void
+WriteHeader(BufferedOutputStream &os)
+{
+	os.Fmt(SCAN_CACHE_FORMAT "{}\n", SCAN_CACHE_VERSION);
+
+	/* a different MPD version may have different decoder
+	   plugins, which may yield different results */
+	os.Write(SCAN_CACHE_MPD_VERSION VERSION "\n");
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (IsTagEnabled(i))
+			os.Fmt(SCAN_CACHE_TAG "{}\n", tag_item_names[i]);
+
+	os.Write(SCAN_CACHE_INFO_END "\n");
+}
+
+/**
+ * Read the header and check whether it was written by this MPD
+ * version with the same configuration.
+ */
+static bool
+CheckHeader(LineReader &file)
+{
+	const char *line = file.ReadLine();
+	if (line == nullptr)
+		return false;
+
+	const char *p = StringAfterPrefix(line, SCAN_CACHE_FORMAT);
+	if (p == nullptr || ParseUnsigned(p) != SCAN_CACHE_VERSION)
+		return false;
+
+	bool tags[TAG_NUM_OF_ITEM_TYPES]{};
+	bool version_ok = false;
+
+	while ((line = file.ReadLine()) != nullptr &&
+	       !StringIsEqual(line, SCAN_CACHE_INFO_END)) {
+		if ((p = StringAfterPrefix(line, SCAN_CACHE_MPD_VERSION))) {
+			version_ok = StringIsEqual(p, VERSION);
+		} else if ((p = StringAfterPrefix(line, SCAN_CACHE_TAG))) {
+			const auto type = tag_name_parse(p);
+			if (type == TAG_NUM_OF_ITEM_TYPES)
+				return false;
+
+			tags[type] = true;
+		} else
+			return false;
+	}
+
+	if (line == nullptr || !version_ok)
+		return false;
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (tags[i] != IsTagEnabled(i))
+			return false;
+
+	return true;
+}
+
+void
+UpdateScanCache::SaveEntry(BufferedOutputStream &os, const std::string &key,
+			   const Entry &entry)
+{
+	os.Fmt(SCAN_CACHE_ENTRY "{}\n", key);
+	os.Fmt("size: {}\n", entry.size);
+	os.Fmt("inode: {}\n", entry.inode);
+	os.Fmt("mtime: {}\n", entry.mtime);
+
+	if (entry.audio_format.IsDefined())
+		os.Fmt("Format: {}\n", entry.audio_format);
+
+	tag_save(os, entry.tag);
+	os.Write(SCAN_CACHE_ENTRY_END "\n");
+}
+
+static void
+LoadEntry(LineReader &file, uint_least64_t &size, uint_least64_t &inode,
+	  std::time_t &mtime, AudioFormat &audio_format, Tag &tag)
+{
+	TagBuilder builder;
+
+	char *line;
+	while ((line = file.ReadLine()) != nullptr &&
+	       !StringIsEqual(line, SCAN_CACHE_ENTRY_END)) {
+		char *colon = std::strchr(line, ':');
+		if (colon == nullptr || colon == line)
+			throw FmtRuntimeError("unknown line in scan cache: {}",
+					      line);
+
+		*colon++ = 0;
+		const char *value = StripLeft(colon);
+
+		TagType type;
+		if ((type = tag_name_parse(line)) != TAG_NUM_OF_ITEM_TYPES) {
+			builder.AddItemUnchecked(type, value);
+		} else if (StringIsEqual(line, "Time")) {
+			builder.SetDuration(SignedSongTime::FromS(ParseDouble(value)));
+		} else if (StringIsEqual(line, "Playlist")) {
+			builder.SetHasPlaylist(StringIsEqual(value, "yes"));
+		} else if (StringIsEqual(line, "Format")) {
+			audio_format = ParseAudioFormat(value, false);
+		} else if (StringIsEqual(line, "size")) {
+			size = ParseUint64(value);
+		} else if (StringIsEqual(line, "inode")) {
+			inode = ParseUint64(value);
+		} else if (StringIsEqual(line, "mtime")) {
+			mtime = static_cast<std::time_t>(ParseUint64(value));
+		} else {
+			throw FmtRuntimeError("unknown line in scan cache: {}",
+					      line);
+		}
+	}
+
+	if (line == nullptr)
+		throw std::runtime_error("Unexpected end of scan cache");
+
+	builder.Commit(tag);
+}
+
+void
+UpdateScanCache::Load(LineReader &file)
+{
+	if (!CheckHeader(file)) {
+		FmtInfo(update_domain, "Discarding obsolete scan cache {}",
+			path);
+		dirty = true;
+		return;
+	}
+
+	const char *line;
+	while ((line = file.ReadLine()) != nullptr) {
+		const char *key = StringAfterPrefix(line, SCAN_CACHE_ENTRY);
+		if (key == nullptr)
+			throw FmtRuntimeError("unknown line in scan cache: {}",
+					      line);
+
+		/* the file is a journal; a later entry for the same
+		   URI replaces an earlier one */
+		auto &entry = map[key];
+		entry.audio_format = AudioFormat::Undefined();
+		LoadEntry(file, entry.size, entry.inode, entry.mtime,
+			  entry.audio_format, entry.tag);
+	}
+}
+
+void
+UpdateScanCache::Load() noexcept
+{
+	assert(!loaded);
+
+	loaded = true;
+
+	try {
+		FileLineReader file{path};
+		Load(file);
+	} catch (...) {
+		/* a missing file means there is no cache yet */
+		if (!IsFileNotFound(std::current_exception())) {
+			FmtError(update_domain,
+				 "Failed to load scan cache {}: {}",
+				 path, std::current_exception());
+			map.clear();
+			dirty = true;
+		}
+	}
+
+	/* entries stored before the file was loaded override the
+	   file contents */
+	for (auto &[key, entry] : pending)
+		map.insert_or_assign(std::move(key), std::move(entry));
+
+	if (!pending.empty()) {
+		pending.clear();
+		dirty = true;
+	}
+}
+
+bool
+UpdateScanCache::Lookup(const std::string &key, const StorageFileInfo &info,
+			Song &song) noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	if (!loaded)
+		Load();
+
+	auto i = map.find(key);
+	if (i == map.end()) {
+		++n_misses;
+		return false;
+	}
+
+	auto &entry = i->second;
+	entry.seen = true;
+
+	if (entry.size != info.size || entry.inode != info.inode ||
+	    entry.mtime != std::chrono::system_clock::to_time_t(info.mtime)) {
+		++n_misses;
+		return false;
+	}
+
+	++n_hits;
+	song.tag = Tag{entry.tag};
+	song.audio_format = entry.audio_format;
+	song.mtime = info.mtime;
+	return true;
+}
+
+void
+UpdateScanCache::Store(std::string &&key, const StorageFileInfo &info,
+		       const Song &song) noexcept
+try {
+	const std::scoped_lock lock{mutex};
+
+	if (loaded) {
+		Entry entry{info, song};
+		entry.seen = true;
+		map.insert_or_assign(std::move(key), std::move(entry));
+		dirty = true;
+	} else
+		pending.emplace_back(std::move(key), Entry{info, song});
+} catch (...) {
+	/* out of memory; this cache entry is not important */
+}
+
+void
+UpdateScanCache::Rewrite()
+{
+	FileOutputStream fos{path};
+	BufferedOutputStream bos{fos};
+
+	WriteHeader(bos);
+
+	for (const auto &[key, entry] : map)
+		SaveEntry(bos, key, entry);
+
+	for (const auto &[key, entry] : pending)
+		SaveEntry(bos, key, entry);
+
+	bos.Flush();
+	fos.Commit();
+}
+
+void
+UpdateScanCache::Append()
+{
+	assert(!loaded);
+
+	bool valid;
+	try {
+		FileLineReader file{path};
+		valid = CheckHeader(file);
+	} catch (const std::system_error &e) {
+		if (!IsFileNotFound(e))
+			throw;
+
+		valid = false;
+	}
+
+	if (!valid) {
+		Rewrite();
+		return;
+	}
+
+	FileOutputStream fos{path, FileOutputStream::Mode::APPEND_EXISTING};
+	BufferedOutputStream bos{fos};
+
+	for (const auto &[key, entry] : pending)
+		SaveEntry(bos, key, entry);
+
+	bos.Flush();
+	fos.Commit();
+}
+
+void
+UpdateScanCache::Flush(std::string_view prune_base)
+{
+	const std::scoped_lock lock{mutex};
+
+	if (loaded) {
+		if (!prune_base.empty())
+			dirty |= std::erase_if(map, [prune_base](const auto &i){
+				return !i.second.seen &&
+					i.first.starts_with(prune_base);
+			}) > 0;
+
+		if (!dirty)
+			return;
+
+		Rewrite();
+		dirty = false;
+	} else {
+		if (pending.empty())
+			return;
+
+		Append();
+		pending.clear();
+	}
+}
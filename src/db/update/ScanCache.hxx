@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "fs/AllocatedPath.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "tag/Tag.hxx"
+#include "thread/Mutex.hxx"
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct Song;
+struct StorageFileInfo;
+class BufferedOutputStream;
+class LineReader;
+
+/**
+ * A persistent cache of song file scan results.  Entries are keyed
+ * by the (absolute) storage URI and are only valid as long as the
+ * file's size, inode number and modification time are unchanged.
+ * This allows a "rescan" to skip the decoder plugins for files which
+ * have not been modified.
+ *
+ * The cache file is loaded lazily by the first Lookup() call.  New
+ * entries are appended to the file by Flush(), which rewrites the
+ * file only if it was loaded and modified.
+ *
+ * All methods are thread-safe.
+ */
+class UpdateScanCache final {
+	struct Entry {
+		uint_least64_t size = 0, inode = 0;
+		std::time_t mtime = 0;
+
+		Tag tag;
+		AudioFormat audio_format = AudioFormat::Undefined();
+
+		/**
+		 * Was this entry looked up by the current update?
+		 * Used by Flush() to prune entries of files which
+		 * have been deleted.
+		 */
+		bool seen = false;
+
+		Entry(const StorageFileInfo &info, const Song &song) noexcept;
+		Entry() noexcept = default;
+	};
+
+	const AllocatedPath path;
+
+	Mutex mutex;
+
+	std::unordered_map<std::string, Entry> map;
+
+	/**
+	 * Entries added by Store() while the file was not loaded;
+	 * they will be appended to the file by Flush().
+	 */
+	std::vector<std::pair<std::string, Entry>> pending;
+
+	/**
+	 * Has the file been loaded into #map?
+	 */
+	bool loaded = false;
+
+	/**
+	 * Does #map differ from the file contents?  If yes, then
+	 * Flush() rewrites the whole file.
+	 */
+	bool dirty = false;
+
+	unsigned n_hits = 0, n_misses = 0;
+
+public:
+	explicit UpdateScanCache(const AllocatedPath &_path) noexcept
+		:path(_path) {}
+
+	UpdateScanCache(const UpdateScanCache &) = delete;
+	UpdateScanCache &operator=(const UpdateScanCache &) = delete;
+
+	unsigned GetHits() const noexcept {
+		return n_hits;
+	}
+
+	unsigned GetMisses() const noexcept {
+		return n_misses;
+	}
+
+	/**
+	 * Look up a cache entry matching the given file.  On success,
+	 * the tag, audio format and modification time of the #Song
+	 * are set.
+	 *
+	 * @return true on success, false if the file needs to be
+	 * scanned
+	 */
+	bool Lookup(const std::string &key, const StorageFileInfo &info,
+		    Song &song) noexcept;
+
+	/**
+	 * Remember the result of a successful scan.
+	 */
+	void Store(std::string &&key, const StorageFileInfo &info,
+		   const Song &song) noexcept;
+
+	/**
+	 * Write all modifications to the cache file.
+	 *
+	 * Throws on error.
+	 *
+	 * @param prune_base if not empty, then remove all entries
+	 * below this URI (with a trailing slash) which have not been
+	 * looked up, because the whole directory was scanned and
+	 * these files do not exist anymore
+	 */
+	void Flush(std::string_view prune_base);
+
+private:
+	void Load() noexcept;
+	void Load(LineReader &file);
+
+	void Rewrite();
+	void Append();
+
+	static void SaveEntry(BufferedOutputStream &os,
+			      const std::string &key, const Entry &entry);
+};
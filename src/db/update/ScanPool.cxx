@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ScanPool.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+
+#include <cassert>
+
+UpdateScanPool::UpdateScanPool(unsigned n_threads)
+{
+	assert(n_threads > 0);
+
+	try {
+		for (unsigned i = 0; i < n_threads; ++i)
+			threads.emplace_front(BIND_THIS_METHOD(Run)).Start();
+	} catch (...) {
+		/* stop the threads which were already started */
+		Stop();
+		throw;
+	}
+}
+
+UpdateScanPool::~UpdateScanPool() noexcept
+{
+	Stop();
+}
+
+void
+UpdateScanPool::Stop() noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		quit = true;
+	}
+
+	cond.notify_all();
+
+	for (auto &thread : threads)
+		if (thread.IsDefined())
+			thread.Join();
+
+	threads.clear();
+}
+
+void
+UpdateScanPool::Submit(std::function<void()> &&job) noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		queue.emplace_back(std::move(job));
+	}
+
+	cond.notify_one();
+}
+
+void
+UpdateScanPool::WaitAll() noexcept
+{
+	std::unique_lock lock{mutex};
+
+	while (!queue.empty()) {
+		auto job = std::move(queue.front());
+		queue.pop_front();
+
+		lock.unlock();
+		job();
+		lock.lock();
+	}
+
+	while (busy > 0)
+		done_cond.wait(lock);
+}
+
+inline void
+UpdateScanPool::Run() noexcept
+{
+	SetThreadName("update_scan");
+	SetThreadIdlePriority();
+
+	std::unique_lock lock{mutex};
+
+	while (true) {
+		if (queue.empty()) {
+			if (quit)
+				break;
+
+			cond.wait(lock);
+			continue;
+		}
+
+		auto job = std::move(queue.front());
+		queue.pop_front();
+		++busy;
+
+		lock.unlock();
+		job();
+		lock.lock();
+
+		if (--busy == 0 && queue.empty())
+			done_cond.notify_all();
+	}
+}
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <deque>
+#include <forward_list>
+#include <functional>
+
+/**
+ * A pool of worker threads which scan song files on behalf of the
+ * database update thread.  The jobs must not modify the database;
+ * their results are applied by the update thread.
+ */
+class UpdateScanPool final {
+	Mutex mutex;
+
+	/**
+	 * Signalled when a job was submitted or when the pool shall
+	 * quit.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled when all jobs have finished.
+	 */
+	Cond done_cond;
+
+	std::deque<std::function<void()>> queue;
+
+	/**
+	 * The number of jobs currently being executed.
+	 */
+	unsigned busy = 0;
+
+	bool quit = false;
+
+	std::forward_list<Thread> threads;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param n_threads the number of worker threads to be
+	 * started
+	 */
+	explicit UpdateScanPool(unsigned n_threads);
+
+	~UpdateScanPool() noexcept;
+
+	UpdateScanPool(const UpdateScanPool &) = delete;
+	UpdateScanPool &operator=(const UpdateScanPool &) = delete;
+
+	/**
+	 * Enqueue a job.  It must not throw.
+	 */
+	void Submit(std::function<void()> &&job) noexcept;
+
+	/**
+	 * Wait until all submitted jobs have finished.  While
+	 * waiting, the calling thread helps executing them.
+	 */
+	void WaitAll() noexcept;
+
+private:
+	void Stop() noexcept;
+
+	void Run() noexcept;
+};
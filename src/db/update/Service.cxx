@@ -21,6 +21,7 @@
 #endif
 
 #include <cassert>
+#include <chrono>
 
 UpdateService::UpdateService(const ConfigData &_config,
 			     EventLoop &_loop, SimpleDatabase &_db,
@@ -61,7 +62,7 @@ UpdateService::CancelMount(const char *uri) noexcept
 
 	Directory::LookupResult lr;
 	{
-		const ScopeDatabaseLock protect;
+		const ScopeDatabaseSharedLock protect;
 		lr = db.GetRoot().LookupDirectory(uri);
 	}
 
@@ -107,12 +108,19 @@ UpdateService::Task() noexcept
 			      next.discard);
 
 	if (modified || !next.db->FileExists()) {
+		const auto start = std::chrono::steady_clock::now();
+
 		try {
 			next.db->Save();
 		} catch (...) {
 			LogError(std::current_exception(),
 				 "Failed to save database");
 		}
+
+		const std::chrono::duration<double> duration =
+			std::chrono::steady_clock::now() - start;
+		FmtInfo(update_domain, "saving the database took {:.3f}s",
+			duration.count());
 	}
 
 	if (!next.path_utf8.empty())
@@ -133,7 +141,9 @@ UpdateService::StartThread(UpdateQueueItem &&i)
 
 	next = std::move(i);
 	walk = std::make_unique<UpdateWalk>(config, GetEventLoop(), listener,
-					    *next.storage);
+					    *next.storage,
+					    next.db->GetTagIndex(),
+					    next.db->GetStatsIndex());
 
 	update_thread.Start();
 
@@ -162,7 +172,7 @@ UpdateService::Enqueue(std::string_view path, bool discard)
 
 	Directory::LookupResult lr;
 	{
-		const ScopeDatabaseLock protect;
+		const ScopeDatabaseSharedLock protect;
 		lr = db.GetRoot().LookupDirectory(path);
 	}
 
@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Walk.hxx"
+#include "Analyze.hxx"
+#include "ScanPool.hxx"
+#include "UpdateDomain.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "song/Analysis.hxx"
+#include "storage/StorageInterface.hxx"
+#include "tag/Tag.hxx"
+#include "Log.hxx"
+
+#include <list>
+#include <map>
+#include <set>
+
+/**
+ * Can this song be analyzed?  Songs inside archives and container
+ * files, ranges of other files (e.g. CUE tracks) and songs which
+ * point to other files are skipped.
+ */
+[[gnu::pure]]
+static bool
+IsAnalyzable(const Directory &directory, const Song &song) noexcept
+{
+	return !directory.IsReallyAFile() &&
+		song.target.empty() &&
+		song.start_time.IsZero() && song.end_time.IsZero();
+}
+
+void
+UpdateWalk::RunAnalysis(AnalysisJob &job) const noexcept
+{
+	const char *suffix = job.song.GetFilenameSuffix();
+
+	try {
+		job.result = std::make_shared<SongAnalysis>(
+			AnalyzeSongFile(job.path,
+					suffix != nullptr ? suffix : "",
+					job.album, cancel));
+	} catch (...) {
+		job.error = std::current_exception();
+	}
+}
+
+void
+UpdateWalk::AnalyzeDirectory(Directory &directory, bool recursive) noexcept
+{
+	/* read access in the update thread does not need the
+	   database lock */
+
+	/* the albums which have at least one new song; the album
+	   gain of all of their songs needs to be recalculated */
+	std::set<std::string_view> new_albums;
+
+	for (const auto &song : directory.songs) {
+		if (song.analysis != nullptr ||
+		    !IsAnalyzable(directory, song))
+			continue;
+
+		if (const char *album = song.tag.GetValue(TAG_ALBUM))
+			new_albums.emplace(album);
+	}
+
+	std::map<std::string_view, AlbumAnalyzer> albums;
+	std::list<AnalysisJob> jobs;
+
+	for (auto &song : directory.songs) {
+		if (cancel)
+			break;
+
+		if (!IsAnalyzable(directory, song))
+			continue;
+
+		const char *album = song.tag.GetValue(TAG_ALBUM);
+		if (album != nullptr && !new_albums.contains(album))
+			album = nullptr;
+
+		/* re-analyze songs which were analyzed previously
+		   only if they belong to a new album; but not if the
+		   file has its own ReplayGain tags */
+		if (song.analysis != nullptr &&
+		    (album == nullptr ||
+		     !song.analysis->replay_gain.track.IsDefined()))
+			continue;
+
+		auto path = storage.MapFS(song.GetURI());
+		if (path.IsNull())
+			/* not a local file */
+			continue;
+
+		auto &job = jobs.emplace_back(song, std::move(path),
+					      album != nullptr
+					      ? &albums[album]
+					      : nullptr);
+
+		if (scan_pool != nullptr)
+			scan_pool->Submit([this, &job]{ RunAnalysis(job); });
+		else
+			RunAnalysis(job);
+	}
+
+	if (scan_pool != nullptr)
+		scan_pool->WaitAll();
+
+	for (auto &job : jobs) {
+		if (cancel)
+			/* the analysis may be incomplete */
+			break;
+
+		if (job.error) {
+			FmtError(update_domain, "failed to analyze {}: {}",
+				 job.song.GetURI(), job.error);
+
+			/* remember the failure so the song does not
+			   get decoded again on every update */
+			job.result = std::make_shared<SongAnalysis>();
+		} else if (job.album != nullptr &&
+			   job.result->replay_gain.track.IsDefined())
+			job.result->replay_gain.album = job.album->GetTuple();
+
+		editor.LockSetAnalysis(job.song, std::move(job.result));
+		modified = true;
+		++timing.n_analyzed;
+	}
+
+	if (!recursive)
+		return;
+
+	for (auto &child : directory.children) {
+		if (cancel)
+			break;
+
+		if (!child.IsMount())
+			AnalyzeDirectory(child);
+	}
+}
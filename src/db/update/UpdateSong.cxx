@@ -2,6 +2,8 @@
 // Copyright The Music Player Daemon Project
 
 #include "Walk.hxx"
+#include "ScanPool.hxx"
+#include "ScanCache.hxx"
 #include "UpdateIO.hxx"
 #include "UpdateDomain.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
@@ -9,9 +11,12 @@
 #include "db/plugins/simple/Directory.hxx"
 #include "db/plugins/simple/Song.hxx"
 #include "decoder/DecoderList.hxx"
+#include "storage/StorageInterface.hxx"
 #include "storage/FileInfo.hxx"
 #include "Log.hxx"
 
+#include <cassert>
+
 #include <unistd.h>
 
 /**
@@ -26,6 +31,105 @@ CompareMtimeCoarse(std::chrono::system_clock::time_point info_mtime,
 	       std::chrono::system_clock::to_time_t(song_mtime);
 }
 
+void
+UpdateWalk::RunScan(ScanJob &job) const noexcept
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	try {
+		if (scan_cache != nullptr) {
+			auto song = std::make_unique<Song>(job.name,
+							   job.directory);
+			job.cache_key = storage.MapUTF8(song->GetURI());
+
+			/* consult the cache only if the file is
+			   likely to be in it: on "rescan" and for new
+			   files (e.g. after the database file has
+			   been deleted); modified files would always
+			   miss */
+			if ((walk_discard ||
+			     (job.song == nullptr && walk_full)) &&
+			    scan_cache->Lookup(job.cache_key, job.info,
+					       *song)) {
+				job.result = std::move(song);
+				job.cached = true;
+			}
+		}
+
+		if (!job.cached)
+			job.result = Song::LoadFile(storage, job.name,
+						    job.info, job.directory);
+	} catch (...) {
+		job.error = std::current_exception();
+	}
+
+	job.duration = std::chrono::steady_clock::now() - start;
+}
+
+void
+UpdateWalk::CommitScan(ScanJob &job) noexcept
+{
+	const auto start = std::chrono::steady_clock::now();
+	Directory &directory = job.directory;
+
+	++timing.n_scanned;
+	timing.scan += job.duration;
+
+	if (job.result && !job.cached && !job.cache_key.empty())
+		scan_cache->Store(std::move(job.cache_key), job.info,
+				  *job.result);
+
+	if (job.error) {
+		FmtError(update_domain,
+			 "error reading file {}/{}: {}",
+			 directory.GetPath(), job.name, job.error);
+	} else if (job.song == nullptr) {
+		if (!job.result) {
+			FmtDebug(update_domain,
+				 "ignoring unrecognized file {}/{}",
+				 directory.GetPath(), job.name);
+			return;
+		}
+
+		job.result->mark = true;
+		job.result->added = std::chrono::system_clock::now();
+
+		editor.LockAddSong(directory, std::move(job.result));
+
+		modified = true;
+		FmtNotice(update_domain, "added {}/{}",
+			  directory.GetPath(), job.name);
+	} else {
+		if (job.result) {
+			editor.LockUpdateSong(*job.song,
+					      std::move(*job.result));
+			job.song->mark = true;
+		} else
+			FmtDebug(update_domain,
+				 "deleting unrecognized file {}/{}",
+				 directory.GetPath(), job.name);
+
+		modified = true;
+	}
+
+	timing.commit += std::chrono::steady_clock::now() - start;
+}
+
+void
+UpdateWalk::FlushScanBatch(ScanBatch &batch) noexcept
+{
+	assert(scan_pool != nullptr);
+
+	const auto start = std::chrono::steady_clock::now();
+	scan_pool->WaitAll();
+	timing.wait += std::chrono::steady_clock::now() - start;
+
+	for (auto &job : batch)
+		CommitScan(job);
+
+	batch.clear();
+}
+
 inline void
 UpdateWalk::UpdateSongFile2(Directory &directory,
 			    std::string_view name, std::string_view suffix,
@@ -33,7 +137,7 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 try {
 	Song *song;
 	{
-		const ScopeDatabaseLock protect;
+		const ScopeDatabaseSharedLock protect;
 		song = directory.FindSong(name);
 	}
 
@@ -54,42 +158,25 @@ try {
 	if (song == nullptr) {
 		FmtDebug(update_domain, "reading {}/{}",
 			 directory.GetPath(), name);
-
-		auto new_song = Song::LoadFile(storage, name, info,
-					       directory);
-		if (!new_song) {
-			FmtDebug(update_domain,
-				 "ignoring unrecognized file {}/{}",
-				 directory.GetPath(), name);
-			return;
-		}
-
-		new_song->mark = true;
-		new_song->added = std::chrono::system_clock::now();
-
-		{
-			const ScopeDatabaseLock protect;
-			directory.AddSong(std::move(new_song));
-		}
-
-		modified = true;
-		FmtNotice(update_domain, "added {}/{}",
-			  directory.GetPath(), name);
 	} else if (!CompareMtimeCoarse(info.mtime, song->mtime) ||
 		   walk_discard) {
 		FmtNotice(update_domain, "updating {}/{}",
 			  directory.GetPath(), name);
-		if (song->UpdateFile(storage, info))
-			song->mark = true;
-		else
-			FmtDebug(update_domain,
-				 "deleting unrecognized file {}/{}",
-				 directory.GetPath(), name);
-
-		modified = true;
 	} else {
 		/* not modified */
 		song->mark = true;
+		return;
+	}
+
+	if (scan_batch != nullptr) {
+		/* scan in a worker thread, commit later */
+		auto &job = scan_batch->emplace_back(directory, song,
+						     name, info);
+		scan_pool->Submit([this, &job]{ RunScan(job); });
+	} else {
+		ScanJob job{directory, song, name, info};
+		RunScan(job);
+		CommitScan(job);
 	}
 } catch (...) {
 	FmtError(update_domain,
@@ -2,6 +2,8 @@
 // Copyright The Music Player Daemon Project
 
 #include "Walk.hxx"
+#include "ScanPool.hxx"
+#include "ScanCache.hxx"
 #include "UpdateIO.hxx"
 #include "Editor.hxx"
 #include "UpdateDomain.hxx"
@@ -26,21 +28,26 @@
 
 #include <cassert>
 #include <cerrno>
+#include <chrono>
 #include <exception>
 #include <memory>
+#include <utility>
 
 #include <string.h>
 #include <stdlib.h>
 
 UpdateWalk::UpdateWalk(const UpdateConfig &_config,
 		       EventLoop &_loop, DatabaseListener &_listener,
-		       Storage &_storage) noexcept
+		       Storage &_storage, TagIndex *_tag_index,
+		       StatsIndex *_stats_index) noexcept
 	:config(_config), cancel(false),
 	 storage(_storage),
-	 editor(_loop, _listener)
+	 editor(_loop, _listener, _tag_index, _stats_index)
 {
 }
 
+UpdateWalk::~UpdateWalk() noexcept = default;
+
 static void
 directory_set_stat(Directory &dir, const StorageFileInfo &info)
 {
@@ -124,6 +131,7 @@ UpdateWalk::PurgeDeletedFromDirectory(Directory &directory) noexcept
 		if (!i->mark) {
 			const ScopeDatabaseLock protect;
 			i = directory.playlists.erase(i);
+			directory.MarkModified();
 		} else
 			++i;
 	}
@@ -350,6 +358,13 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 
 	UnmarkAllIn(directory);
 
+	/* song files in this directory are scanned by the
+	   #scan_pool, and all results are committed before
+	   PurgeDeletedFromDirectory() */
+	ScanBatch batch;
+	ScanBatch *const parent_batch =
+		std::exchange(scan_batch, scan_pool ? &batch : nullptr);
+
 	const char *name_utf8;
 	while (!cancel && (name_utf8 = reader->Read()) != nullptr) {
 		if (!VerifySeenFilenameUTF8(name_utf8))
@@ -375,8 +390,17 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 		UpdateDirectoryChild(directory, child_exclude_list, name_utf8, info2);
 	}
 
+	scan_batch = parent_batch;
+	if (!batch.empty())
+		FlushScanBatch(batch);
+
 	PurgeDeletedFromDirectory(directory);
 
+	if (std::chrono::system_clock::to_time_t(directory.mtime) !=
+	    std::chrono::system_clock::to_time_t(info.mtime))
+		/* only seconds are stored in the database file */
+		directory.MarkModified();
+
 	directory.mtime = info.mtime;
 	directory.mark = true;
 
@@ -497,11 +521,64 @@ try {
 	LogError(std::current_exception());
 }
 
+/**
+ * Convert a duration to seconds for the log.
+ */
+static double
+ToSeconds(std::chrono::steady_clock::duration d) noexcept
+{
+	return std::chrono::duration_cast<std::chrono::duration<double>>(d).count();
+}
+
+void
+UpdateWalk::FlushScanCache() noexcept
+{
+	assert(scan_cache != nullptr);
+
+	FmtInfo(update_domain, "scan cache: {} hits, {} misses",
+		scan_cache->GetHits(), scan_cache->GetMisses());
+
+	/* a complete "rescan" has looked up all files which still
+	   exist; all other entries belonging to this storage are
+	   obsolete */
+	std::string prune_base;
+	if (walk_full && walk_discard && !cancel) {
+		prune_base = storage.MapUTF8("");
+		if (!prune_base.ends_with('/'))
+			prune_base.push_back('/');
+	}
+
+	try {
+		scan_cache->Flush(prune_base);
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to save the scan cache");
+	}
+}
+
 bool
 UpdateWalk::Walk(Directory &root, const char *path, bool discard) noexcept
 {
 	walk_discard = discard;
+	walk_full = path == nullptr || isRootDirectory(path);
 	modified = false;
+	timing = {};
+
+	if (config.n_threads > 1 && scan_pool == nullptr) {
+		/* the update thread helps scanning while it waits
+		   for the workers, so we need one thread less */
+		try {
+			scan_pool = std::make_unique<UpdateScanPool>(config.n_threads - 1);
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to start update threads");
+		}
+	}
+
+	if (!config.scan_cache_path.IsNull() && scan_cache == nullptr)
+		scan_cache = std::make_unique<UpdateScanCache>(config.scan_cache_path);
+
+	const auto start = std::chrono::steady_clock::now();
 
 	if (path != nullptr && !isRootDirectory(path)) {
 		UpdateUri(root, path);
@@ -521,11 +598,53 @@ UpdateWalk::Walk(Directory &root, const char *path, bool discard) noexcept
 		UpdateDirectory(root, exclude_list, info);
 	}
 
+	const auto walk_end = std::chrono::steady_clock::now();
+
 	{
 		const ScopeDatabaseLock protect;
 		root.ClearInPlaylist();
 		PurgeDanglingFromPlaylists(root);
 	}
 
+	const auto end = std::chrono::steady_clock::now();
+
+	FmtInfo(update_domain,
+		"walk took {:.3f}s: scanned {} files in {:.3f}s "
+		"with {} threads, waited {:.3f}s for scans, "
+		"committed in {:.3f}s; playlists took {:.3f}s",
+		ToSeconds(walk_end - start), timing.n_scanned,
+		ToSeconds(timing.scan),
+		scan_pool != nullptr ? config.n_threads : 1,
+		ToSeconds(timing.wait), ToSeconds(timing.commit),
+		ToSeconds(end - walk_end));
+
+	if (scan_cache != nullptr)
+		FlushScanCache();
+
+	if (config.analysis && !cancel) {
+		if (path != nullptr && !isRootDirectory(path)) {
+			/* analyze only what has just been updated; if
+			   it is a file, then analyze its directory,
+			   because the album gain is calculated per
+			   directory */
+			const auto lr = [&root, path]{
+				const ScopeDatabaseSharedLock protect;
+				return root.LookupDirectory(path);
+			}();
+
+			if (lr.rest.empty())
+				AnalyzeDirectory(*lr.directory);
+			else if (lr.rest.find('/') == lr.rest.npos)
+				AnalyzeDirectory(*lr.directory, false);
+			/* else: it has been deleted */
+		} else
+			AnalyzeDirectory(root);
+
+		FmtInfo(update_domain,
+			"analysis took {:.3f}s: analyzed {} files",
+			ToSeconds(std::chrono::steady_clock::now() - end),
+			timing.n_analyzed);
+	}
+
 	return modified;
 }
@@ -5,19 +5,32 @@
 
 #include "Config.hxx"
 #include "Editor.hxx"
+#include "db/plugins/simple/Ptr.hxx"
+#include "storage/FileInfo.hxx"
 #include "archive/Features.h" // for ENABLE_ARCHIVE
 
 #include <atomic>
+#include <chrono>
+#include <exception>
+#include <list>
+#include <memory>
+#include <string>
 #include <string_view>
 
-struct StorageFileInfo;
 struct Directory;
+struct Song;
 struct ArchivePlugin;
 struct PlaylistPlugin;
 class SongEnumerator;
 class ArchiveFile;
 class Storage;
 class ExcludeList;
+class TagIndex;
+class StatsIndex;
+class UpdateScanPool;
+class UpdateScanCache;
+class AlbumAnalyzer;
+struct SongAnalysis;
 
 class UpdateWalk final {
 #ifdef ENABLE_ARCHIVE
@@ -27,6 +40,13 @@ class UpdateWalk final {
 	const UpdateConfig config;
 
 	bool walk_discard;
+
+	/**
+	 * Is the whole music directory being updated (and not just a
+	 * sub directory)?
+	 */
+	bool walk_full;
+
 	bool modified;
 
 	/**
@@ -40,10 +60,117 @@ class UpdateWalk final {
 
 	DatabaseEditor editor;
 
+	/**
+	 * Worker threads for scanning song files; nullptr if
+	 * "update_threads" is 1 (or the threads could not be
+	 * started).
+	 */
+	std::unique_ptr<UpdateScanPool> scan_pool;
+
+	/**
+	 * nullptr if "scan_cache_file" is not configured.
+	 */
+	std::unique_ptr<UpdateScanCache> scan_cache;
+
+	/**
+	 * A song file which needs to be (re-)scanned.  The scan may
+	 * happen in a #scan_pool thread; its result is applied to the
+	 * database later by CommitScan().
+	 */
+	struct ScanJob {
+		Directory &directory;
+
+		/**
+		 * The existing song to be updated or nullptr if this
+		 * is a new file.
+		 */
+		Song *const song;
+
+		const std::string name;
+
+		const StorageFileInfo info;
+
+		/**
+		 * The new #Song object filled by RunScan(); nullptr
+		 * if the file was not recognized.
+		 */
+		SongPtr result;
+
+		std::exception_ptr error;
+
+		/**
+		 * The #scan_cache key; empty if the cache was not
+		 * used.
+		 */
+		std::string cache_key;
+
+		/**
+		 * Was #result obtained from the #scan_cache?
+		 */
+		bool cached = false;
+
+		std::chrono::steady_clock::duration duration{};
+
+		ScanJob(Directory &_directory, Song *_song,
+			std::string_view _name,
+			const StorageFileInfo &_info) noexcept
+			:directory(_directory), song(_song),
+			 name(_name), info(_info) {}
+	};
+
+	using ScanBatch = std::list<ScanJob>;
+
+	/**
+	 * The scan jobs submitted to #scan_pool for the directory
+	 * which is currently being updated; they are committed
+	 * before UpdateDirectory() returns.  nullptr if scans shall
+	 * be performed synchronously.
+	 */
+	ScanBatch *scan_batch = nullptr;
+
+	/**
+	 * A song file whose ReplayGain and MixRamp values shall be
+	 * calculated (see UpdateConfig::analysis).  The analysis may
+	 * happen in a #scan_pool thread; its result is applied to
+	 * the database by AnalyzeDirectory().
+	 */
+	struct AnalysisJob {
+		Song &song;
+
+		const AllocatedPath path;
+
+		/**
+		 * The album this song belongs to; nullptr if it has
+		 * no "Album" tag.
+		 */
+		AlbumAnalyzer *const album;
+
+		/**
+		 * The result of RunAnalysis().
+		 */
+		std::shared_ptr<SongAnalysis> result;
+
+		std::exception_ptr error;
+
+		AnalysisJob(Song &_song, AllocatedPath &&_path,
+			    AlbumAnalyzer *_album) noexcept
+			:song(_song), path(std::move(_path)), album(_album) {}
+	};
+
+	/**
+	 * Durations of the update phases, for the log.
+	 */
+	struct {
+		std::chrono::steady_clock::duration scan, wait, commit;
+		unsigned n_scanned, n_analyzed;
+	} timing;
+
 public:
 	UpdateWalk(const UpdateConfig &_config,
 		   EventLoop &_loop, DatabaseListener &_listener,
-		   Storage &_storage) noexcept;
+		   Storage &_storage, TagIndex *_tag_index,
+		   StatsIndex *_stats_index) noexcept;
+	~UpdateWalk() noexcept;
 
 	/**
 	 * Cancel the current update and quit the Walk() method as
@@ -77,6 +204,44 @@ private:
 	 */
 	void PurgeDanglingFromPlaylists(Directory &directory) noexcept;
 
+	/**
+	 * Load the song file described by the #ScanJob.  This may be
+	 * called in a #scan_pool thread and must not touch the
+	 * database.
+	 */
+	void RunScan(ScanJob &job) const noexcept;
+
+	/**
+	 * Apply the result of a RunScan() call to the database.
+	 */
+	void CommitScan(ScanJob &job) noexcept;
+
+	/**
+	 * Wait for all jobs in the given batch and commit them.
+	 */
+	void FlushScanBatch(ScanBatch &batch) noexcept;
+
+	/**
+	 * Write the #scan_cache to disk (logging errors).
+	 */
+	void FlushScanCache() noexcept;
+
+	/**
+	 * Decode the song file described by the #AnalysisJob.  This
+	 * may be called in a #scan_pool thread and must not touch
+	 * the database.
+	 */
+	void RunAnalysis(AnalysisJob &job) const noexcept;
+
+	/**
+	 * Calculate ReplayGain and MixRamp values for all songs in
+	 * the given directory which have not been analyzed yet.
+	 *
+	 * @param recursive analyze child directories, too?
+	 */
+	void AnalyzeDirectory(Directory &directory,
+			      bool recursive=true) noexcept;
+
 	void UpdateSongFile2(Directory &directory,
 			     std::string_view name, std::string_view suffix,
 			     const StorageFileInfo &info) noexcept;
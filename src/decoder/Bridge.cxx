@@ -13,6 +13,7 @@
 #include "MusicChunk.hxx"
 #include "tag/Tag.hxx"
 #include "Log.hxx"
+#include "thread/Stats.hxx"
 #include "input/InputStream.hxx"
 #include "input/LocalOpen.hxx"
 #include "input/cache/Manager.hxx"
@@ -135,6 +136,8 @@ DecoderBridge::FlushChunk() noexcept
 	if (!chunk->IsEmpty())
 		dc.pipe->Push(std::move(chunk));
 
+	ThreadStats::UpdateCurrent();
+
 	const std::lock_guard protect{dc.mutex};
 	dc.client_cond.notify_one();
 }
@@ -263,6 +266,11 @@ DecoderBridge::Ready(const AudioFormat audio_format,
 	{
 		const std::lock_guard protect{dc.mutex};
 		dc.SetReady(audio_format, seekable, duration);
+
+		/* this is done before the player gets notified,
+		   because the player calculates its thresholds from
+		   the new chunk size */
+		dc.buffer->Adapt(dc.out_audio_format);
 	}
 
 	if (dc.in_audio_format != dc.out_audio_format) {
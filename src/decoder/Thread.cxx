@@ -6,6 +6,7 @@
 #include "Bridge.hxx"
 #include "DecoderPlugin.hxx"
 #include "song/DetachedSong.hxx"
+#include "song/Analysis.hxx"
 #include "MusicPipe.hxx"
 #include "fs/Traits.hxx"
 #include "fs/AllocatedPath.hxx"
@@ -24,6 +25,7 @@
 #include "util/StringCompare.hxx"
 #include "util/UriQueryParser.hxx"
 #include "thread/Name.hxx"
+#include "thread/Stats.hxx"
 #include "tag/ApeReplayGain.hxx"
 #include "tag/ReplayGainParser.hxx"
 #include "Log.hxx"
@@ -577,6 +579,17 @@ decoder_run_song(DecoderControl &dc,
 				played it*/
 			     !SongHasVolatileTags(song) ? std::make_unique<Tag>(song.GetTag()) : nullptr);
 
+	if (const auto *analysis = song.GetAnalysis()) {
+		/* values calculated by the database update; decoder
+		   plugins which find ReplayGain/MixRamp tags in the
+		   file will override them */
+		if (analysis->replay_gain.IsDefined())
+			bridge.SubmitReplayGain(&analysis->replay_gain);
+
+		if (analysis->mix_ramp.IsDefined())
+			dc.SetMixRamp(MixRampInfo{analysis->mix_ramp});
+	}
+
 	dc.state = DecoderState::START;
 	dc.CommandFinishedLocked();
 
@@ -646,6 +659,7 @@ void
 DecoderControl::RunThread() noexcept
 {
 	SetThreadName("decoder");
+	ThreadStats thread_stats{"decoder"};
 
 	std::unique_lock lock{mutex};
 
@@ -26,6 +26,32 @@ protected:
 public:
 	using ssize_t = std::make_signed<size_t>::type;
 
+	enum class InputResult {
+		/**
+		 * The method was successful, and it is ready to
+		 * read more data.
+		 */
+		MORE,
+
+		/**
+		 * The method does not want to get more data for now.
+		 * It will call ResumeInput() when it's ready for
+		 * more.
+		 */
+		PAUSE,
+
+		/**
+		 * The method wants to be called again immediately, if
+		 * there's more data in the buffer.
+		 */
+		AGAIN,
+
+		/**
+		 * The method has closed the socket.
+		 */
+		CLOSED,
+	};
+
 	BufferedSocket(SocketDescriptor _fd, EventLoop &_loop) noexcept
 		:event(_loop, BIND_THIS_METHOD(OnSocketReady), _fd) {
 		event.ScheduleRead();
@@ -80,32 +106,6 @@ protected:
 		input.Consume(nbytes);
 	}
 
-	enum class InputResult {
-		/**
-		 * The method was successful, and it is ready to
-		 * read more data.
-		 */
-		MORE,
-
-		/**
-		 * The method does not want to get more data for now.
-		 * It will call ResumeInput() when it's ready for
-		 * more.
-		 */
-		PAUSE,
-
-		/**
-		 * The method wants to be called again immediately, if
-		 * there's more data in the buffer.
-		 */
-		AGAIN,
-
-		/**
-		 * The method has closed the socket.
-		 */
-		CLOSED,
-	};
-
 	/**
 	 * Data has been received on the socket.
 	 *
@@ -4,14 +4,40 @@
 #include "FullyBufferedSocket.hxx"
 #include "net/SocketError.hxx"
 
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
 #include <cassert>
 
 #include <string.h>
 
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/uio.h> // for struct iovec
+#endif
+
 inline FullyBufferedSocket::ssize_t
-FullyBufferedSocket::DirectWrite(std::span<const std::byte> src) noexcept
+FullyBufferedSocket::DirectWrite(std::span<const std::span<const std::byte>> src) noexcept
 {
-	const auto nbytes = GetSocket().WriteNoWait(src);
+	assert(!src.empty());
+
+#ifdef _WIN32
+	/* no sendmsg() on Windows */
+	const auto nbytes = GetSocket().WriteNoWait(src.front());
+#else
+	std::array<struct iovec, MAX_SEGMENTS> v;
+	assert(src.size() <= v.size());
+
+	for (std::size_t i = 0; i < src.size(); ++i)
+		v[i] = {const_cast<std::byte *>(src[i].data()), src[i].size()};
+
+	const auto nbytes = GetSocket().Send(std::span{v}.first(src.size()),
+					     MSG_DONTWAIT);
+#endif
+
+	++output_stats.writes;
+
 	if (nbytes < 0) [[unlikely]] {
 		const auto code = GetSocketError();
 		if (IsSocketErrorSendWouldBlock(code))
@@ -29,25 +55,101 @@ FullyBufferedSocket::DirectWrite(std::span<const std::byte> src) noexcept
 	return nbytes;
 }
 
+inline std::size_t
+FullyBufferedSocket::CollectOutput(std::span<std::span<const std::byte>, MAX_SEGMENTS> dest) const noexcept
+{
+	std::size_t n = 0;
+
+	auto buffered = output.ReadAll();
+	auto segment = buffered.begin();
+	uint_least64_t position = consumed_position;
+
+	for (auto ref = references.begin(); n < dest.size();) {
+		/* first the buffered data which was appended before
+		   the next reference */
+		const uint_least64_t limit = ref != references.end()
+			? ref->position
+			: appended_position;
+
+		while (position < limit && n < dest.size()) {
+			assert(segment != buffered.end());
+
+			if (segment->empty()) {
+				++segment;
+				continue;
+			}
+
+			const std::size_t size =
+				std::min<uint_least64_t>(segment->size(),
+							 limit - position);
+			dest[n++] = segment->first(size);
+			*segment = segment->subspan(size);
+			position += size;
+		}
+
+		if (ref == references.end() || n >= dest.size())
+			break;
+
+		dest[n++] = ref->data;
+		++ref;
+	}
+
+	return n;
+}
+
+inline void
+FullyBufferedSocket::ConsumeOutput(std::size_t nbytes) noexcept
+{
+	output_stats.sent += nbytes;
+
+	while (nbytes > 0) {
+		if (!references.empty() &&
+		    references.front().position == consumed_position) {
+			auto &ref = references.front();
+			const std::size_t n = std::min(nbytes, ref.data.size());
+			ref.data = ref.data.subspan(n);
+			referenced_size -= n;
+			output_stats.referenced += n;
+			nbytes -= n;
+
+			if (ref.data.empty())
+				references.pop_front();
+		} else {
+			const uint_least64_t limit = !references.empty()
+				? references.front().position
+				: appended_position;
+			const std::size_t n =
+				std::min<uint_least64_t>(nbytes,
+							 limit - consumed_position);
+			assert(n > 0);
+
+			output.Consume(n);
+			consumed_position += n;
+			nbytes -= n;
+		}
+	}
+}
+
 bool
 FullyBufferedSocket::Flush() noexcept
 {
 	assert(IsDefined());
 
-	const auto data = output.Read();
-	if (data.empty()) {
+	std::array<std::span<const std::byte>, MAX_SEGMENTS> segments;
+	const std::size_t n = CollectOutput(segments);
+	if (n == 0) {
 		idle_event.Cancel();
 		event.CancelWrite();
 		return true;
 	}
 
-	auto nbytes = DirectWrite(data);
+	auto nbytes = DirectWrite(std::span{segments}.first(n));
 	if (nbytes <= 0) [[unlikely]]
 		return nbytes == 0;
 
-	output.Consume(nbytes);
+	ConsumeOutput(nbytes);
 
-	if (output.empty()) {
+	if (IsOutputEmpty()) {
 		idle_event.Cancel();
 		event.CancelWrite();
 	}
@@ -55,6 +157,12 @@ FullyBufferedSocket::Flush() noexcept
 	return true;
 }
 
+void
+FullyBufferedSocket::OnOutputFull() noexcept
+{
+	OnSocketError(std::make_exception_ptr(std::runtime_error("Output buffer is full")));
+}
+
 bool
 FullyBufferedSocket::Write(const void *data, size_t length) noexcept
 {
@@ -63,15 +171,75 @@ FullyBufferedSocket::Write(const void *data, size_t length) noexcept
 	if (length == 0)
 		return true;
 
-	const bool was_empty = output.empty();
+	const bool was_empty = IsOutputEmpty();
 
 	if (!output.Append({(const std::byte *)data, length})) {
-		OnSocketError(std::make_exception_ptr(std::runtime_error("Output buffer is full")));
+		OnOutputFull();
 		return false;
 	}
 
-	if (was_empty)
-		idle_event.Schedule();
+	appended_position += length;
+	output_stats.copied += length;
+
+	OnOutputAppended(was_empty);
+	return true;
+}
+
+bool
+FullyBufferedSocket::VFmt(fmt::string_view format_str,
+			  fmt::format_args args) noexcept
+{
+	assert(IsDefined());
+
+	/* try to format directly into the output buffer */
+	const auto w = output.Write();
+	if (!w.empty()) {
+		const auto result = fmt::vformat_to_n((char *)w.data(), w.size(),
+						      format_str, args);
+		if (result.size <= w.size()) {
+			if (result.size == 0)
+				return true;
+
+			const bool was_empty = IsOutputEmpty();
+
+			output.Append(result.size);
+			appended_position += result.size;
+			output_stats.copied += result.size;
+
+			OnOutputAppended(was_empty);
+			return true;
+		}
+	}
+
+	/* doesn't fit: format into a temporary buffer and let
+	   Write() grow the peak buffer */
+	fmt::memory_buffer buffer;
+	fmt::vformat_to(std::back_inserter(buffer), format_str, args);
+	return Write(buffer.data(), buffer.size());
+}
+
+bool
+FullyBufferedSocket::WriteReference(std::span<const std::byte> data,
+				    std::shared_ptr<const void> owner) noexcept
+{
+	assert(IsDefined());
+
+	if (data.size() < MIN_REFERENCE_SIZE)
+		return Write(data.data(), data.size());
+
+	const std::size_t pending = appended_position - consumed_position +
+		referenced_size;
+	if (pending + data.size() > GetOutputMaxSize()) {
+		OnOutputFull();
+		return false;
+	}
+
+	const bool was_empty = IsOutputEmpty();
+
+	references.push_back({appended_position, data, std::move(owner)});
+	referenced_size += data.size();
+
+	OnOutputAppended(was_empty);
 	return true;
 }
 
@@ -79,7 +247,7 @@ void
 FullyBufferedSocket::OnSocketReady(unsigned flags) noexcept
 {
 	if (flags & SocketEvent::WRITE) {
-		assert(!output.empty());
+		assert(!IsOutputEmpty());
 		assert(!idle_event.IsPending());
 
 		if (!Flush())
@@ -92,6 +260,6 @@ FullyBufferedSocket::OnSocketReady(unsigned flags) noexcept
 void
 FullyBufferedSocket::OnIdle() noexcept
 {
-	if (Flush() && !output.empty())
+	if (Flush() && !IsOutputEmpty())
 		event.ScheduleWrite();
 }
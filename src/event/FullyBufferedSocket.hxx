@@ -7,17 +7,105 @@
 #include "IdleEvent.hxx"
 #include "util/PeakBuffer.hxx"
 
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
 #include <span>
 
 /**
  * A #BufferedSocket specialization that adds an output buffer.
+ *
+ * Small writes are copied to the output buffer.  Large blocks of
+ * immutable data may instead be passed by reference (see
+ * WriteReference()); they are sent directly from their owner's
+ * memory.  Both are flushed with a single sendmsg() call.
  */
 class FullyBufferedSocket : protected BufferedSocket {
+	/**
+	 * The maximum number of segments passed to one sendmsg()
+	 * call.
+	 */
+	static constexpr std::size_t MAX_SEGMENTS = 16;
+
 	IdleEvent idle_event;
 
 	PeakBuffer output;
 
+	/**
+	 * A block of data which is sent directly from its owner's
+	 * memory instead of being copied to the #output buffer.
+	 */
+	struct Reference {
+		/**
+		 * The value of #appended_position when this reference
+		 * was added: all data in the #output buffer before this
+		 * position must be sent first.
+		 */
+		uint_least64_t position;
+
+		/**
+		 * The portion of the block which has not yet been sent.
+		 */
+		std::span<const std::byte> data;
+
+		/**
+		 * Keeps #data alive.
+		 */
+		std::shared_ptr<const void> owner;
+	};
+
+	std::deque<Reference> references;
+
+	/**
+	 * The total number of bytes which were appended to and
+	 * consumed from the #output buffer.
+	 */
+	uint_least64_t appended_position = 0, consumed_position = 0;
+
+	/**
+	 * The number of bytes in #references which have not yet been
+	 * sent.
+	 */
+	std::size_t referenced_size = 0;
+
 public:
+	struct OutputStats {
+		/**
+		 * The number of bytes which were copied to the output
+		 * buffer.
+		 */
+		uint_least64_t copied = 0;
+
+		/**
+		 * The number of bytes which were sent directly from
+		 * referenced memory, without copying.
+		 */
+		uint_least64_t referenced = 0;
+
+		/**
+		 * The number of bytes which were sent to the socket.
+		 */
+		uint_least64_t sent = 0;
+
+		/**
+		 * The number of send system calls.
+		 */
+		uint_least64_t writes = 0;
+	};
+
+private:
+	OutputStats output_stats;
+
+public:
+	/**
+	 * Blocks smaller than this are copied by WriteReference(),
+	 * because an additional sendmsg() segment costs more than
+	 * copying them.
+	 */
+	static constexpr std::size_t MIN_REFERENCE_SIZE = 4096;
+
 	FullyBufferedSocket(SocketDescriptor _fd, EventLoop &_loop,
 			    size_t normal_size, size_t peak_size=0) noexcept
 		:BufferedSocket(_fd, _loop),
@@ -31,19 +119,53 @@ public:
 	void Close() noexcept {
 		idle_event.Cancel();
 		BufferedSocket::Close();
+		references.clear();
+		referenced_size = 0;
 	}
 
 	std::size_t GetOutputMaxSize() const noexcept {
 		return output.max_size();
 	}
 
+	const OutputStats &GetOutputStats() const noexcept {
+		return output_stats;
+	}
+
 private:
+	bool IsOutputEmpty() const noexcept {
+		return output.empty() && references.empty();
+	}
+
 	/**
 	 * @return the number of bytes written to the socket, 0 if the
 	 * socket isn't ready for writing, -1 on error (the socket has
 	 * been closed and probably destructed)
 	 */
-	ssize_t DirectWrite(std::span<const std::byte> src) noexcept;
+	ssize_t DirectWrite(std::span<const std::span<const std::byte>> src) noexcept;
+
+	/**
+	 * Collect the pending output (from #output and #references)
+	 * in the right order.
+	 *
+	 * @return the number of segments
+	 */
+	std::size_t CollectOutput(std::span<std::span<const std::byte>, MAX_SEGMENTS> dest) const noexcept;
+
+	/**
+	 * Remove data which has been sent from #output and
+	 * #references.
+	 */
+	void ConsumeOutput(std::size_t nbytes) noexcept;
+
+	/**
+	 * Data has been added to the output.
+	 */
+	void OnOutputAppended(bool was_empty) noexcept {
+		if (was_empty)
+			idle_event.Schedule();
+	}
+
+	void OnOutputFull() noexcept;
 
 protected:
 	/**
@@ -58,6 +180,23 @@ protected:
 	 */
 	bool Write(const void *data, size_t length) noexcept;
 
+	/**
+	 * Format a string directly into the output buffer.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	bool VFmt(fmt::string_view format_str, fmt::format_args args) noexcept;
+
+	/**
+	 * Send a block of memory without copying it.  The data must
+	 * not be modified until it has been sent; the #owner is
+	 * released after that (or when the socket is closed).
+	 *
+	 * @return false if the socket has been closed
+	 */
+	bool WriteReference(std::span<const std::byte> data,
+			    std::shared_ptr<const void> owner) noexcept;
+
 	void OnIdle() noexcept;
 
 	/* virtual methods from class BufferedSocket */
@@ -23,8 +23,13 @@ class ConvertFilter final : public Filter {
 	 */
 	std::unique_ptr<PcmConvert> state;
 
+	/**
+	 * @see PcmFormatConverter::Open()
+	 */
+	const bool dither_float;
+
 public:
-	explicit ConvertFilter(const AudioFormat &audio_format);
+	ConvertFilter(const AudioFormat &audio_format, bool _dither_float);
 
 	void Set(const AudioFormat &_out_audio_format);
 
@@ -43,7 +48,12 @@ public:
 };
 
 class PreparedConvertFilter final : public PreparedFilter {
+	const bool dither_float;
+
 public:
+	explicit PreparedConvertFilter(bool _dither_float) noexcept
+		:dither_float(_dither_float) {}
+
 	std::unique_ptr<Filter> Open(AudioFormat &af) override;
 };
 
@@ -66,13 +76,16 @@ ConvertFilter::Set(const AudioFormat &_out_audio_format)
 		return;
 
 	state = std::make_unique<PcmConvert>(in_audio_format,
-					     _out_audio_format);
+					     _out_audio_format,
+					     dither_float);
 
 	out_audio_format = _out_audio_format;
 }
 
-ConvertFilter::ConvertFilter(const AudioFormat &audio_format)
-	:Filter(audio_format), in_audio_format(audio_format)
+ConvertFilter::ConvertFilter(const AudioFormat &audio_format,
+			     bool _dither_float)
+	:Filter(audio_format), in_audio_format(audio_format),
+	 dither_float(_dither_float)
 {
 	assert(in_audio_format.IsValid());
 }
@@ -82,7 +95,7 @@ PreparedConvertFilter::Open(AudioFormat &audio_format)
 {
 	assert(audio_format.IsValid());
 
-	return std::make_unique<ConvertFilter>(audio_format);
+	return std::make_unique<ConvertFilter>(audio_format, dither_float);
 }
 
 std::span<const std::byte>
@@ -95,16 +108,16 @@ ConvertFilter::FilterPCM(std::span<const std::byte> src)
 }
 
 std::unique_ptr<PreparedFilter>
-convert_filter_prepare() noexcept
+convert_filter_prepare(bool dither_float) noexcept
 {
-	return std::make_unique<PreparedConvertFilter>();
+	return std::make_unique<PreparedConvertFilter>(dither_float);
 }
 
 std::unique_ptr<Filter>
 convert_filter_new(const AudioFormat in_audio_format,
 		   const AudioFormat out_audio_format)
 {
-	auto filter = std::make_unique<ConvertFilter>(in_audio_format);
+	auto filter = std::make_unique<ConvertFilter>(in_audio_format, false);
 	filter->Set(out_audio_format);
 	return filter;
 }
@@ -10,8 +10,12 @@ class PreparedFilter;
 class Filter;
 struct AudioFormat;
 
+/**
+ * @param dither_float dither floating point samples when converting
+ * them to 16 bit (see PcmFormatConverter::Open())
+ */
 std::unique_ptr<PreparedFilter>
-convert_filter_prepare() noexcept;
+convert_filter_prepare(bool dither_float=false) noexcept;
 
 std::unique_ptr<Filter>
 convert_filter_new(AudioFormat in_audio_format,
@@ -54,6 +54,7 @@ class ReplayGainFilter final : public Filter {
 
 public:
 	ReplayGainFilter(const ReplayGainConfig &_config, bool allow_convert,
+			 bool to_float,
 			 const AudioFormat &audio_format,
 			 Mixer *_mixer, unsigned _base)
 		:Filter(audio_format),
@@ -62,7 +63,7 @@ public:
 		info.Clear();
 
 		out_audio_format.format = pv.Open(out_audio_format.format,
-						  allow_convert);
+						  allow_convert, to_float);
 	}
 
 	void SetInfo(const ReplayGainInfo *_info) {
@@ -111,6 +112,11 @@ class PreparedReplayGainFilter final : public PreparedFilter {
 	 */
 	const bool allow_convert;
 
+	/**
+	 * Convert integer samples to floating point?
+	 */
+	const bool to_float;
+
 	/**
 	 * The base volume level for scale=1.0, between 1 and 100
 	 * (including).
@@ -119,8 +125,9 @@ class PreparedReplayGainFilter final : public PreparedFilter {
 
 public:
 	explicit PreparedReplayGainFilter(const ReplayGainConfig _config,
-					  bool _allow_convert)
-		:config(_config), allow_convert(_allow_convert) {}
+					  bool _allow_convert, bool _to_float)
+		:config(_config), allow_convert(_allow_convert),
+		 to_float(_to_float) {}
 
 	void SetMixer(Mixer *_mixer, unsigned _base) {
 		assert(_mixer == nullptr || (_base > 0 && _base <= 100));
@@ -170,25 +177,27 @@ ReplayGainFilter::Update()
 
 std::unique_ptr<PreparedFilter>
 NewReplayGainFilter(const ReplayGainConfig &config,
-		    bool allow_convert) noexcept
+		    bool allow_convert, bool to_float) noexcept
 {
 	return std::make_unique<PreparedReplayGainFilter>(config,
-							  allow_convert);
+							  allow_convert,
+							  to_float);
 }
 
 std::unique_ptr<Filter>
 PreparedReplayGainFilter::Open(AudioFormat &af)
 {
 	return std::make_unique<ReplayGainFilter>(config, allow_convert,
+						  to_float,
 						  af, mixer, base);
 }
 
 std::span<const std::byte>
 ReplayGainFilter::FilterPCM(std::span<const std::byte> src)
 {
-	return mixer != nullptr
-		? std::span<const std::byte>{src}
-		: pv.Apply(src);
+	/* with a hardware mixer, the PcmVolume stays at 100% and
+	   only converts the sample format (if enabled) */
+	return pv.Apply(src);
 }
 
 void
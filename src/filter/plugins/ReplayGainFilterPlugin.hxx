@@ -17,10 +17,12 @@ struct ReplayGainInfo;
 /**
  * @param allow_convert allow the class to convert to a different
  * #SampleFormat to preserve quality?
+ * @param to_float convert integer samples to floating point (see
+ * PcmVolume::Open())
  */
 std::unique_ptr<PreparedFilter>
 NewReplayGainFilter(const ReplayGainConfig &config,
-		    bool allow_convert) noexcept;
+		    bool allow_convert, bool to_float=false) noexcept;
 
 /**
  * Enables or disables the hardware mixer for applying replay gain.
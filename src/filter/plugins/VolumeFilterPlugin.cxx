@@ -11,10 +11,10 @@ class VolumeFilter final : public Filter {
 	PcmVolume pv;
 
 public:
-	explicit VolumeFilter(const AudioFormat &audio_format)
+	VolumeFilter(const AudioFormat &audio_format, bool to_float)
 		:Filter(audio_format) {
 		out_audio_format.format = pv.Open(out_audio_format.format,
-						  true);
+						  true, to_float);
 	}
 
 	[[nodiscard]] unsigned GetVolume() const noexcept {
@@ -30,7 +30,12 @@ public:
 };
 
 class PreparedVolumeFilter final : public PreparedFilter {
+	const bool to_float;
+
 public:
+	explicit PreparedVolumeFilter(bool _to_float) noexcept
+		:to_float(_to_float) {}
+
 	/* virtual methods from class Filter */
 	std::unique_ptr<Filter> Open(AudioFormat &af) override;
 };
@@ -38,7 +43,7 @@ public:
 std::unique_ptr<Filter>
 PreparedVolumeFilter::Open(AudioFormat &audio_format)
 {
-	return std::make_unique<VolumeFilter>(audio_format);
+	return std::make_unique<VolumeFilter>(audio_format, to_float);
 }
 
 std::span<const std::byte>
@@ -48,9 +53,9 @@ VolumeFilter::FilterPCM(std::span<const std::byte> src)
 }
 
 std::unique_ptr<PreparedFilter>
-volume_filter_prepare() noexcept
+volume_filter_prepare(bool to_float) noexcept
 {
-	return std::make_unique<PreparedVolumeFilter>();
+	return std::make_unique<PreparedVolumeFilter>(to_float);
 }
 
 unsigned
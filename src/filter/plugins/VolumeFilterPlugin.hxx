@@ -9,8 +9,12 @@
 class PreparedFilter;
 class Filter;
 
+/**
+ * @param to_float convert integer samples to floating point (see
+ * PcmVolume::Open())
+ */
 std::unique_ptr<PreparedFilter>
-volume_filter_prepare() noexcept;
+volume_filter_prepare(bool to_float=false) noexcept;
 
 unsigned
 volume_filter_get(const Filter *filter) noexcept;
@@ -4,6 +4,8 @@
 #ifndef MPD_ALSA_PERIOD_BUFFER_HXX
 #define MPD_ALSA_PERIOD_BUFFER_HXX
 
+#include "memory/AudioMemory.hxx"
+
 #include <alsa/asoundlib.h>
 
 #include <algorithm>
@@ -26,7 +28,12 @@ namespace Alsa {
 class PeriodBuffer {
 	size_t capacity, head, tail;
 
-	std::byte *buffer;
+	/**
+	 * This is locked into RAM if the "mlock_audio_memory"
+	 * feature is enabled, because it is accessed by the
+	 * real-time output thread.
+	 */
+	AudioMemory buffer;
 
 public:
 	PeriodBuffer() = default;
@@ -40,12 +47,12 @@ public:
 		   to be able to fill the buffer with silence,
 		   after moving an unfinished frame to the
 		   end */
-		buffer = new std::byte[capacity + frame_size - 1];
+		buffer = AudioMemory{capacity + frame_size - 1};
 		head = tail = 0;
 	}
 
 	void Free() noexcept {
-		delete[] buffer;
+		buffer = {};
 	}
 
 	/**
@@ -82,7 +89,7 @@ public:
 	std::byte *GetTail() noexcept {
 		assert(!IsFull());
 
-		return buffer + tail;
+		return buffer.data() + tail;
 	}
 
 	/**
@@ -123,7 +130,7 @@ public:
 		auto *dest = GetTail() - partial_frame;
 
 		/* move the partial frame to the end */
-		std::copy(dest, GetTail(), buffer + capacity);
+		std::copy(dest, GetTail(), buffer.data() + capacity);
 
 		size_t silence_size = capacity - tail - partial_frame;
 		std::copy_n(_silence, silence_size, dest);
@@ -138,7 +145,7 @@ public:
 	 * commit the operation.
 	 */
 	const std::byte *GetHead() const noexcept {
-		return buffer + head;
+		return buffer.data() + head;
 	}
 
 	/**
@@ -162,7 +169,7 @@ public:
 			tail -= head;
 			/* copy the partial frame (if any)
 			   back to the beginning */
-			std::copy_n(GetHead(), tail, buffer);
+			std::copy_n(GetHead(), tail, buffer.data());
 			head = 0;
 		}
 	}
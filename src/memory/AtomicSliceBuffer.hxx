@@ -0,0 +1,320 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "HugeArray.hxx"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <utility>
+
+/**
+ * A lock-free variant of #SliceBuffer: any number of threads may
+ * allocate and free slices concurrently.
+ *
+ * The size of a slice is chosen at runtime and may be larger than
+ * the object; the remaining bytes of each slice are available to
+ * the object (see SetSliceSize()).
+ *
+ * The free slices are kept in a Treiber stack.  Instead of storing
+ * the link in the slice itself, there is a separate array of atomic
+ * indices, so a thread which loses a race never reads memory which
+ * has meanwhile been handed out; the ABA problem is solved by a
+ * version number next to the index of the top-most slice.
+ */
+template<typename T>
+class AtomicSliceBuffer {
+	static constexpr uint32_t NIL = UINT32_MAX;
+
+	HugeArray<std::byte> buffer;
+
+	/**
+	 * The smallest allowed slice size, as passed to the
+	 * constructor.  It determines the size of #links.
+	 */
+	const std::size_t min_slice_size;
+
+	/**
+	 * For each slice in the "available" stack: the index of the
+	 * next one (or #NIL).
+	 */
+	const std::unique_ptr<std::atomic_uint32_t[]> links;
+
+	/**
+	 * The top of the "available" stack: the index of the first
+	 * free slice in the lower 32 bits, and a version number
+	 * which is incremented by each modification in the upper 32
+	 * bits.
+	 */
+	std::atomic_uint64_t available{NIL};
+
+	/**
+	 * The size of each slice in bytes.
+	 */
+	std::atomic_size_t slice_size;
+
+	/**
+	 * The number of slices which fit into the #buffer.
+	 */
+	std::atomic_uint capacity;
+
+	/**
+	 * The number of slices that are initialized.  This is used to
+	 * avoid page faulting on the new allocation, so the kernel
+	 * does not need to reserve physical memory pages.
+	 */
+	std::atomic_uint n_initialized{0};
+
+	/**
+	 * The number of slices currently allocated.
+	 */
+	std::atomic_uint n_allocated{0};
+
+	/**
+	 * If set, then this counter is incremented each time a
+	 * compare-and-swap fails because another thread has
+	 * modified the buffer at the same time.
+	 */
+	std::atomic_uint_least64_t *retry_counter = nullptr;
+
+public:
+	/**
+	 * @param nbytes the total size of the buffer
+	 * @param _slice_size the initial (and smallest) size of each
+	 * slice
+	 */
+	AtomicSliceBuffer(std::size_t nbytes, std::size_t _slice_size)
+		:buffer(nbytes),
+		 min_slice_size(_slice_size),
+		 links(std::make_unique<std::atomic_uint32_t[]>(nbytes / _slice_size)),
+		 slice_size(_slice_size),
+		 capacity(nbytes / _slice_size) {
+		assert(IsValidSliceSize(_slice_size));
+		assert(nbytes / _slice_size < NIL);
+
+		buffer.ForkCow(false);
+	}
+
+	~AtomicSliceBuffer() noexcept {
+		/* all slices must be freed explicitly, and this
+		   assertion checks for leaks */
+		assert(empty());
+	}
+
+	AtomicSliceBuffer(const AtomicSliceBuffer &other) = delete;
+	AtomicSliceBuffer &operator=(const AtomicSliceBuffer &other) = delete;
+
+	/**
+	 * Returns the total number of bytes in this buffer.
+	 */
+	std::size_t GetMemorySize() const noexcept {
+		return buffer.size();
+	}
+
+	/**
+	 * Returns the whole buffer memory, e.g. for locking it.
+	 */
+	std::span<std::byte> GetMemory() noexcept {
+		return {&buffer.front(), buffer.size()};
+	}
+
+	/**
+	 * Returns the number of slices which fit into this buffer.
+	 */
+	unsigned GetCapacity() const noexcept {
+		return capacity.load(std::memory_order_relaxed);
+	}
+
+	std::size_t GetSliceSize() const noexcept {
+		return slice_size.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Are no slices allocated?  If this returns true, then all
+	 * Free() calls have completed.
+	 */
+	bool empty() const noexcept {
+		return n_allocated.load(std::memory_order_acquire) == 0;
+	}
+
+	bool IsFull() const noexcept {
+		return n_allocated.load(std::memory_order_relaxed) == GetCapacity();
+	}
+
+	void SetName(const char *name) noexcept {
+		buffer.SetName(name);
+	}
+
+	void SetRetryCounter(std::atomic_uint_least64_t &counter) noexcept {
+		retry_counter = &counter;
+	}
+
+	void PopulateMemory() noexcept {
+		buffer.Populate();
+	}
+
+	/**
+	 * Give all memory allocations back to the kernel.
+	 *
+	 * This may only be called while no other thread accesses
+	 * this object.
+	 */
+	void DiscardMemory() noexcept {
+		assert(empty());
+
+		n_initialized.store(0, std::memory_order_relaxed);
+		buffer.Discard();
+		available.store(NIL, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Can the given slice size be passed to SetSliceSize()?
+	 */
+	constexpr bool IsValidSliceSize(std::size_t size) const noexcept {
+		return size >= sizeof(T) && size % alignof(T) == 0;
+	}
+
+	/**
+	 * Change the size of all slices.  This may only be called
+	 * while the buffer is empty and while no other thread calls
+	 * Allocate().
+	 */
+	void SetSliceSize(std::size_t size) noexcept {
+		assert(empty());
+		assert(IsValidSliceSize(size));
+		assert(size >= min_slice_size);
+
+		slice_size.store(size, std::memory_order_relaxed);
+		capacity.store(buffer.size() / size, std::memory_order_relaxed);
+		n_initialized.store(0, std::memory_order_relaxed);
+		available.store(NIL, std::memory_order_relaxed);
+	}
+
+	template<typename... Args>
+	T *Allocate(Args&&... args) {
+		std::byte *slice = Pop();
+		if (slice == nullptr) {
+			slice = Initialize();
+			if (slice == nullptr)
+				/* out of (internal) memory, buffer is
+				   full */
+				return nullptr;
+		}
+
+		n_allocated.fetch_add(1, std::memory_order_relaxed);
+
+		/* construct the object */
+		return ::new((void *)slice) T(std::forward<Args>(args)...);
+	}
+
+	void Free(T *value) noexcept {
+		assert(!empty());
+
+		std::byte *slice = reinterpret_cast<std::byte *>(value);
+		assert(slice >= &buffer.front() && slice <= &buffer.back());
+
+		/* destruct the object */
+		value->~T();
+
+		Push((slice - &buffer.front()) / GetSliceSize());
+
+		/* decrement after the slice has been returned, so
+		   empty() implies that all Free() calls have
+		   completed */
+		n_allocated.fetch_sub(1, std::memory_order_release);
+	}
+
+private:
+	std::byte *GetSlice(uint32_t i) noexcept {
+		return &buffer[i * GetSliceSize()];
+	}
+
+	static constexpr uint32_t GetIndex(uint64_t top) noexcept {
+		return static_cast<uint32_t>(top);
+	}
+
+	static constexpr uint64_t MakeTop(uint64_t old_top,
+					  uint32_t index) noexcept {
+		return ((old_top >> 32) + 1) << 32 | index;
+	}
+
+	void CountRetry() noexcept {
+		if (retry_counter != nullptr)
+			retry_counter->fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Remove the first slice from the "available" stack.
+	 *
+	 * @return the slice or nullptr if the stack is empty
+	 */
+	std::byte *Pop() noexcept {
+		uint64_t top = available.load(std::memory_order_acquire);
+
+		while (true) {
+			const uint32_t i = GetIndex(top);
+			if (i == NIL)
+				return nullptr;
+
+			/* if another thread pops this slice before us,
+			   this value may be bogus, but then the
+			   version number has changed and the
+			   compare-and-swap fails */
+			const uint32_t next =
+				links[i].load(std::memory_order_relaxed);
+
+			if (available.compare_exchange_weak(top,
+							    MakeTop(top, next),
+							    std::memory_order_acquire,
+							    std::memory_order_acquire))
+				return GetSlice(i);
+
+			CountRetry();
+		}
+	}
+
+	/**
+	 * Insert a slice at the top of the "available" stack.
+	 */
+	void Push(uint32_t i) noexcept {
+		uint64_t top = available.load(std::memory_order_relaxed);
+
+		while (true) {
+			links[i].store(GetIndex(top),
+				       std::memory_order_relaxed);
+
+			if (available.compare_exchange_weak(top,
+							    MakeTop(top, i),
+							    std::memory_order_release,
+							    std::memory_order_relaxed))
+				return;
+
+			CountRetry();
+		}
+	}
+
+	/**
+	 * Obtain a slice which has never been used before.
+	 *
+	 * @return the slice or nullptr if all slices are already
+	 * initialized
+	 */
+	std::byte *Initialize() noexcept {
+		const unsigned n = GetCapacity();
+		unsigned i = n_initialized.load(std::memory_order_relaxed);
+
+		do {
+			if (i == n)
+				return nullptr;
+		} while (!n_initialized.compare_exchange_weak(i, i + 1,
+							      std::memory_order_relaxed));
+
+		return GetSlice(i);
+	}
+};
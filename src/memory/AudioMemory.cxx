@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "AudioMemory.hxx"
+#include "HugeAllocator.hxx"
+
+AudioMemoryCounters audio_memory_counters;
+
+static bool audio_memory_lock_enabled = false;
+
+void
+EnableAudioMemoryLock() noexcept
+{
+	audio_memory_lock_enabled = true;
+}
+
+bool
+IsAudioMemoryLockEnabled() noexcept
+{
+	return audio_memory_lock_enabled;
+}
+
+bool
+LockAudioMemory(std::span<std::byte> p) noexcept
+{
+	if (!audio_memory_lock_enabled || p.empty())
+		return false;
+
+	if (!HugeLock(p)) {
+		audio_memory_counters.lock_failures.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	audio_memory_counters.locked.fetch_add(p.size(), std::memory_order_relaxed);
+	return true;
+}
+
+void
+UnlockAudioMemory(std::span<std::byte> p) noexcept
+{
+	HugeUnlock(p);
+	audio_memory_counters.locked.fetch_sub(p.size(), std::memory_order_relaxed);
+}
+
+AudioMemory::AudioMemory(std::size_t size)
+{
+	if (audio_memory_lock_enabled) {
+		/* use whole pages, so locking and unlocking does not
+		   affect other heap allocations */
+		buffer = HugeAllocate(size);
+		huge = true;
+		HugeSetName(buffer, "AudioMemory");
+		locked = LockAudioMemory(buffer);
+	} else
+		buffer = {new std::byte[size], size};
+}
+
+void
+AudioMemory::Free() noexcept
+{
+	if (buffer.data() == nullptr)
+		return;
+
+	if (huge) {
+		if (locked)
+			UnlockAudioMemory(buffer);
+
+		HugeFree(buffer);
+	} else
+		delete[] buffer.data();
+}
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+/**
+ * Counters for the "mlock_audio_memory" feature.
+ */
+struct AudioMemoryCounters {
+	/**
+	 * The number of bytes currently locked into RAM.
+	 */
+	std::atomic_size_t locked{0};
+
+	/**
+	 * The number of times locking memory has failed, e.g. because
+	 * RLIMIT_MEMLOCK is too low.
+	 */
+	std::atomic_uint_least64_t lock_failures{0};
+};
+
+extern AudioMemoryCounters audio_memory_counters;
+
+/**
+ * Enable the "mlock_audio_memory" feature: lock all audio buffers
+ * which are accessed by the player and output threads into physical
+ * RAM, so they never need to be faulted in (again) while playing.
+ *
+ * This must be called at startup, before audio memory gets
+ * allocated.
+ */
+void
+EnableAudioMemoryLock() noexcept;
+
+[[gnu::pure]]
+bool
+IsAudioMemoryLockEnabled() noexcept;
+
+/**
+ * If the "mlock_audio_memory" feature is enabled, then lock the
+ * given allocation (which was returned by HugeAllocate()) into RAM.
+ *
+ * @return true if the memory was locked and UnlockAudioMemory()
+ * needs to be called
+ */
+bool
+LockAudioMemory(std::span<std::byte> p) noexcept;
+
+/**
+ * Undo LockAudioMemory().
+ */
+void
+UnlockAudioMemory(std::span<std::byte> p) noexcept;
+
+/**
+ * An owning buffer for audio data which is accessed by the player
+ * and output threads.  If the "mlock_audio_memory" feature is
+ * enabled, then it is allocated with HugeAllocate() and locked into
+ * RAM; else it is allocated from the heap.
+ */
+class AudioMemory {
+	std::span<std::byte> buffer;
+
+	/**
+	 * Was this buffer allocated with HugeAllocate()?
+	 */
+	bool huge = false;
+
+	/**
+	 * Was this buffer locked with LockAudioMemory()?
+	 */
+	bool locked = false;
+
+public:
+	AudioMemory() noexcept = default;
+
+	/**
+	 * Throws std::bad_alloc on error.
+	 */
+	explicit AudioMemory(std::size_t size);
+
+	AudioMemory(AudioMemory &&src) noexcept
+		:buffer(std::exchange(src.buffer, {})),
+		 huge(src.huge), locked(src.locked) {}
+
+	~AudioMemory() noexcept {
+		Free();
+	}
+
+	AudioMemory &operator=(AudioMemory &&src) noexcept {
+		using std::swap;
+		swap(buffer, src.buffer);
+		swap(huge, src.huge);
+		swap(locked, src.locked);
+		return *this;
+	}
+
+	bool empty() const noexcept {
+		return buffer.empty();
+	}
+
+	/**
+	 * Returns the usable size, which may be larger than the size
+	 * passed to the constructor.
+	 */
+	std::size_t size() const noexcept {
+		return buffer.size();
+	}
+
+	std::byte *data() noexcept {
+		return buffer.data();
+	}
+
+	const std::byte *data() const noexcept {
+		return buffer.data();
+	}
+
+private:
+	void Free() noexcept;
+};
@@ -56,6 +56,18 @@ HugeDiscard(std::span<std::byte> p) noexcept
 	DiscardPages(AlignToPageSize(p));
 }
 
+bool
+HugeLock(std::span<std::byte> p) noexcept
+{
+	return LockPages(AlignToPageSize(p));
+}
+
+void
+HugeUnlock(std::span<std::byte> p) noexcept
+{
+	UnlockPages(AlignToPageSize(p));
+}
+
 #elif defined(_WIN32)
 
 std::span<std::byte>
@@ -60,6 +60,22 @@ HugePopulate(std::span<std::byte> p) noexcept;
 void
 HugeDiscard(std::span<std::byte> p) noexcept;
 
+/**
+ * Lock the allocation into physical RAM, faulting in all pages and
+ * preventing them from being swapped out.  Locked pages cannot be
+ * discarded with HugeDiscard().
+ *
+ * @return false on error (with errno set)
+ */
+bool
+HugeLock(std::span<std::byte> p) noexcept;
+
+/**
+ * Undo HugeLock().  HugeFree() unlocks implicitly.
+ */
+void
+HugeUnlock(std::span<std::byte> p) noexcept;
+
 #elif defined(_WIN32)
 #include <memoryapi.h>
 
@@ -94,6 +110,18 @@ HugeDiscard(std::span<std::byte> p) noexcept
 	VirtualAlloc(p.data(), p.size(), MEM_RESET, PAGE_NOACCESS);
 }
 
+static inline bool
+HugeLock(std::span<std::byte> p) noexcept
+{
+	return VirtualLock(p.data(), p.size());
+}
+
+static inline void
+HugeUnlock(std::span<std::byte> p) noexcept
+{
+	VirtualUnlock(p.data(), p.size());
+}
+
 #else
 
 /* not Linux: fall back to standard C calls */
@@ -132,4 +160,15 @@ HugeDiscard(std::span<std::byte>) noexcept
 {
 }
 
+static inline bool
+HugeLock(std::span<std::byte>) noexcept
+{
+	return false;
+}
+
+static inline void
+HugeUnlock(std::span<std::byte>) noexcept
+{
+}
+
 #endif
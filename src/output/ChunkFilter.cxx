@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ChunkFilter.hxx"
+#include "MusicChunk.hxx"
+#include "filter/Filter.hxx"
+#include "filter/Prepared.hxx"
+#include "filter/plugins/ReplayGainFilterPlugin.hxx"
+#include "pcm/Mix.hxx"
+#include "lib/fmt/AudioFormatFormatter.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+
+#include <string.h>
+
+ChunkFilter::ChunkFilter() noexcept = default;
+ChunkFilter::~ChunkFilter() noexcept = default;
+
+AudioFormat
+ChunkFilter::Open(AudioFormat audio_format,
+		  PreparedFilter *prepared_replay_gain_filter,
+		  PreparedFilter *prepared_other_replay_gain_filter,
+		  PreparedFilter &prepared_filter)
+try {
+	assert(audio_format.IsValid());
+	assert(!IsOpen());
+
+	in_audio_format = audio_format;
+
+	/* the replay_gain filter cannot fail here */
+	if (prepared_other_replay_gain_filter) {
+		other_replay_gain_serial = 0;
+		other_replay_gain_filter =
+			prepared_other_replay_gain_filter->Open(audio_format);
+	}
+
+	if (prepared_replay_gain_filter) {
+		replay_gain_serial = 0;
+		replay_gain_filter =
+			prepared_replay_gain_filter->Open(audio_format);
+
+		audio_format = replay_gain_filter->GetOutAudioFormat();
+
+		assert(replay_gain_filter->GetOutAudioFormat() ==
+		       other_replay_gain_filter->GetOutAudioFormat());
+	}
+
+	filter = prepared_filter.Open(audio_format);
+	return filter->GetOutAudioFormat();
+} catch (...) {
+	Close();
+	throw;
+}
+
+void
+ChunkFilter::Close() noexcept
+{
+	replay_gain_filter.reset();
+	other_replay_gain_filter.reset();
+	filter.reset();
+}
+
+void
+ChunkFilter::Reset() noexcept
+{
+	if (replay_gain_filter)
+		replay_gain_filter->Reset();
+
+	if (other_replay_gain_filter)
+		other_replay_gain_filter->Reset();
+
+	if (filter)
+		filter->Reset();
+}
+
+std::span<const std::byte>
+ChunkFilter::GetChunkData(const MusicChunk &chunk,
+			  Filter *current_replay_gain_filter,
+			  unsigned *replay_gain_serial_p,
+			  ReplayGainMode replay_gain_mode)
+{
+	assert(!chunk.IsEmpty());
+	assert(chunk.CheckFormat(in_audio_format));
+
+	auto data = chunk.ReadData();
+
+	assert(data.size() % in_audio_format.GetFrameSize() == 0);
+
+	if (!data.empty() && current_replay_gain_filter != nullptr) {
+		replay_gain_filter_set_mode(*current_replay_gain_filter,
+					    replay_gain_mode);
+
+		if (chunk.replay_gain_serial != *replay_gain_serial_p) {
+			replay_gain_filter_set_info(*current_replay_gain_filter,
+						    chunk.replay_gain_serial != 0
+						    ? &chunk.replay_gain_info
+						    : nullptr);
+			*replay_gain_serial_p = chunk.replay_gain_serial;
+		}
+
+		/* note: the ReplayGainFilter doesn't have a
+		   ReadMore() method */
+		data = current_replay_gain_filter->FilterPCM(data);
+	}
+
+	return data;
+}
+
+std::span<const std::byte>
+ChunkFilter::FilterChunk(const MusicChunk &chunk,
+			 ReplayGainMode replay_gain_mode)
+{
+	assert(IsOpen());
+
+	auto data = GetChunkData(chunk, replay_gain_filter.get(),
+				 &replay_gain_serial, replay_gain_mode);
+	if (data.empty())
+		return data;
+
+	/* cross-fade */
+
+	if (chunk.other != nullptr) {
+		auto other_data = GetChunkData(*chunk.other,
+					       other_replay_gain_filter.get(),
+					       &other_replay_gain_serial,
+					       replay_gain_mode);
+		if (other_data.empty())
+			return data;
+
+		/* if the "other" chunk is longer, then that trailer
+		   is used as-is, without mixing; it is part of the
+		   "next" song being faded in, and if there's a rest,
+		   it means cross-fading ends here */
+
+		if (data.size() > other_data.size())
+			data = data.first(other_data.size());
+
+		float mix_ratio = chunk.mix_ratio;
+		if (mix_ratio >= 0)
+			/* reverse the mix ratio (because the
+			   arguments to pcm_mix() are reversed), but
+			   only if the mix ratio is non-negative; a
+			   negative mix ratio is a MixRamp special
+			   case */
+			mix_ratio = 1.0f - mix_ratio;
+
+		void *dest = cross_fade_buffer.Get(other_data.size());
+		memcpy(dest, other_data.data(), other_data.size());
+		if (!pcm_mix(cross_fade_dither, dest, data.data(), data.size(),
+			     in_audio_format.format,
+			     mix_ratio))
+			throw FmtRuntimeError("Cannot cross-fade format {}",
+					      in_audio_format.format);
+
+		data = {(const std::byte *)dest, other_data.size()};
+	}
+
+	/* apply filter chain */
+
+	return filter->FilterPCM(data);
+}
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "pcm/AudioFormat.hxx"
+#include "pcm/Buffer.hxx"
+#include "pcm/Dither.hxx"
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+enum class ReplayGainMode : uint8_t;
+struct MusicChunk;
+class Filter;
+class PreparedFilter;
+
+/**
+ * Applies ReplayGain, cross-fading and a filter (chain) to
+ * #MusicChunk instances.  This is used by #AudioOutputSource and by
+ * #SharedConvertStage.
+ */
+class ChunkFilter {
+	/**
+	 * The #AudioFormat of the #MusicChunk instances.
+	 */
+	AudioFormat in_audio_format;
+
+	/**
+	 * The serial number of the last replay gain info.  0 means no
+	 * replay gain info was available.
+	 */
+	unsigned replay_gain_serial;
+
+	/**
+	 * The serial number of the last replay gain info by the
+	 * "other" chunk during cross-fading.
+	 */
+	unsigned other_replay_gain_serial;
+
+	/**
+	 * The replay_gain_filter_plugin instance.
+	 */
+	std::unique_ptr<Filter> replay_gain_filter;
+
+	/**
+	 * The replay_gain_filter_plugin instance to be applied to the
+	 * second chunk during cross-fading.
+	 */
+	std::unique_ptr<Filter> other_replay_gain_filter;
+
+	/**
+	 * The buffer used to allocate the cross-fading result.
+	 */
+	PcmBuffer cross_fade_buffer;
+
+	/**
+	 * The dithering state for cross-fading two streams.
+	 */
+	PcmDither cross_fade_dither;
+
+	/**
+	 * The filter object.  For audio outputs, this is an instance
+	 * of chain_filter_plugin.
+	 */
+	std::unique_ptr<Filter> filter;
+
+public:
+	ChunkFilter() noexcept;
+	~ChunkFilter() noexcept;
+
+	ChunkFilter(const ChunkFilter &) = delete;
+	ChunkFilter &operator=(const ChunkFilter &) = delete;
+
+	bool IsOpen() const noexcept {
+		return filter != nullptr;
+	}
+
+	Filter &GetFilter() noexcept {
+		assert(IsOpen());
+
+		return *filter;
+	}
+
+	/**
+	 * Throws on error.
+	 *
+	 * @return the #AudioFormat emitted by the filter
+	 */
+	AudioFormat Open(AudioFormat audio_format,
+			 PreparedFilter *prepared_replay_gain_filter,
+			 PreparedFilter *prepared_other_replay_gain_filter,
+			 PreparedFilter &prepared_filter);
+
+	void Close() noexcept;
+
+	/**
+	 * Reset all filters.  Not allowed after the filter has been
+	 * flushed.
+	 */
+	void Reset() noexcept;
+
+	/**
+	 * Apply ReplayGain, cross-fading and the filter to the given
+	 * chunk.  Call Filter::ReadMore() (via GetFilter()) to
+	 * obtain the rest of the filter output.
+	 *
+	 * Throws on error.
+	 */
+	std::span<const std::byte> FilterChunk(const MusicChunk &chunk,
+					       ReplayGainMode replay_gain_mode);
+
+private:
+	std::span<const std::byte> GetChunkData(const MusicChunk &chunk,
+						Filter *replay_gain_filter,
+						unsigned *replay_gain_serial_p,
+						ReplayGainMode replay_gain_mode);
+};
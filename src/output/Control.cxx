@@ -3,6 +3,7 @@
 
 #include "Control.hxx"
 #include "Filtered.hxx"
+#include "SharedConvert.hxx"
 #include "Client.hxx"
 #include "Domain.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
@@ -60,7 +61,14 @@ AudioOutputControl::GetMixer() const noexcept
 std::map<std::string, std::string, std::less<>>
 AudioOutputControl::GetAttributes() const noexcept
 {
-	return output->GetAttributes();
+	auto attributes = output->GetAttributes();
+
+	const std::lock_guard lock{mutex};
+	if (const auto *stage = source.GetSharedConvert();
+	    stage != nullptr && stage->IsShared())
+		attributes.emplace("shared_convert", stage->GetMemberNames());
+
+	return attributes;
 }
 
 void
@@ -183,7 +191,8 @@ AudioOutputControl::EnableDisableAsync()
 inline bool
 AudioOutputControl::Open(std::unique_lock<Mutex> &&lock,
 			 const AudioFormat audio_format,
-			 const MusicPipe &mp) noexcept
+			 const MusicPipe &mp,
+			 SharedConvertStages &shared_convert) noexcept
 {
 	assert(allow_play);
 	assert(audio_format.IsValid());
@@ -201,6 +210,7 @@ AudioOutputControl::Open(std::unique_lock<Mutex> &&lock,
 
 	request.audio_format = audio_format;
 	request.pipe = &mp;
+	request.shared_convert = &shared_convert;
 
 	if (!thread.IsDefined()) {
 		try {
@@ -248,6 +258,7 @@ AudioOutputControl::CloseWait(std::unique_lock<Mutex> &lock) noexcept
 bool
 AudioOutputControl::LockUpdate(const AudioFormat audio_format,
 			       const MusicPipe &mp,
+			       SharedConvertStages &shared_convert,
 			       bool force) noexcept
 {
 	std::unique_lock lock{mutex};
@@ -255,7 +266,8 @@ AudioOutputControl::LockUpdate(const AudioFormat audio_format,
 	if (enabled && really_enabled) {
 		if (force || !fail_timer.IsDefined() ||
 		    fail_timer.Check(REOPEN_AFTER)) {
-			return Open(std::move(lock), audio_format, mp);
+			return Open(std::move(lock), audio_format, mp,
+				    shared_convert);
 		}
 	} else if (IsOpen())
 		CloseWait(lock);
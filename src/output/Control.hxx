@@ -26,6 +26,7 @@ struct ConfigBlock;
 class MusicPipe;
 class Mixer;
 class AudioOutputClient;
+class SharedConvertStages;
 
 /**
  * Controller for an #AudioOutput and its output thread.
@@ -98,6 +99,12 @@ class AudioOutputControl final : public IntrusiveListHook<>, MixerListener {
 		 * The #MusicPipe passed to #Command::OPEN.
 		 */
 		const MusicPipe *pipe;
+
+		/**
+		 * The #SharedConvertStages passed to
+		 * #Command::OPEN.
+		 */
+		SharedConvertStages *shared_convert;
 	} request;
 
 	/**
@@ -485,17 +492,21 @@ public:
 	 * Caller must lock the mutex.
 	 */
 	bool Open(std::unique_lock<Mutex> &&lock,
-		  AudioFormat audio_format, const MusicPipe &mp) noexcept;
+		  AudioFormat audio_format, const MusicPipe &mp,
+		  SharedConvertStages &shared_convert) noexcept;
 
 	/**
 	 * Opens or closes the device, depending on the "enabled"
 	 * flag.
 	 *
+	 * @param shared_convert conversion stages which may be shared
+	 * with other outputs playing the same #MusicPipe
 	 * @param force true to ignore the #fail_timer
 	 * @return true if the device is open
 	 */
 	bool LockUpdate(AudioFormat audio_format,
 			const MusicPipe &mp,
+			SharedConvertStages &shared_convert,
 			bool force) noexcept;
 
 	/**
@@ -582,7 +593,27 @@ private:
 	 * Handles exceptions.
 	 */
 	void InternalOpen(AudioFormat audio_format,
-			  const MusicPipe &pipe) noexcept;
+			  const MusicPipe &pipe,
+			  SharedConvertStages &shared_convert) noexcept;
+
+	/**
+	 * Let #source use a #SharedConvertStage if this output's
+	 * filter chain allows it.
+	 *
+	 * Runs inside the OutputThread.
+	 * Caller must lock the mutex.
+	 * Handles exceptions.
+	 */
+	void InternalJoinSharedConvert(AudioFormat in_audio_format,
+				       SharedConvertStages &shared_convert) noexcept;
+
+	/**
+	 * Undo InternalJoinSharedConvert().
+	 *
+	 * Runs inside the OutputThread.
+	 * Caller must lock the mutex.
+	 */
+	void InternalLeaveSharedConvert() noexcept;
 
 	/**
 	 * Runs inside the OutputThread.
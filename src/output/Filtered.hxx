@@ -113,6 +113,13 @@ public:
 	 */
 	FilterObserver convert_filter;
 
+	/**
+	 * Does the filter chain consist of nothing but software
+	 * ReplayGain and #convert_filter?  Then the conversion may be
+	 * shared with other outputs (see #SharedConvertStage).
+	 */
+	bool can_share_convert = false;
+
 	/**
 	 * Throws on error.
 	 */
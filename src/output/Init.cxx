@@ -96,6 +96,7 @@ audio_output_load_mixer(EventLoop &event_loop, FilteredAudioOutput &ao,
 			const ConfigBlock &block,
 			const MixerType mixer_type,
 			const MixerPlugin *plugin,
+			bool float_pipeline,
 			std::unique_ptr<PreparedFilter> &filter_chain)
 {
 	Mixer *mixer;
@@ -124,7 +125,7 @@ audio_output_load_mixer(EventLoop &event_loop, FilteredAudioOutput &ao,
 		assert(mixer != nullptr);
 
 		filter_chain = ChainFilters(std::move(filter_chain),
-					    ao.volume_filter.Set(volume_filter_prepare()),
+					    ao.volume_filter.Set(volume_filter_prepare(float_pipeline)),
 					    "software_mixer");
 		return mixer;
 	}
@@ -190,6 +191,13 @@ FilteredAudioOutput::Setup(EventLoop &event_loop,
 
 	const auto mixer_type = audio_output_mixer_type(block, defaults);
 
+	/* in the "float pipeline" mode, the first software volume
+	   stage (ReplayGain or the software mixer) converts to
+	   floating point, and only the "convert" filter quantizes
+	   again */
+	const bool float_pipeline = block.GetBlockValue("float_pipeline",
+							 false);
+
 	/* create the replay_gain filter */
 
 	const char *replay_gain_handler =
@@ -203,11 +211,13 @@ FilteredAudioOutput::Setup(EventLoop &event_loop,
 		const bool allow_convert = mixer_type == MixerType::SOFTWARE;
 
 		prepared_replay_gain_filter =
-			NewReplayGainFilter(replay_gain_config, allow_convert);
+			NewReplayGainFilter(replay_gain_config, allow_convert,
+					    float_pipeline);
 		assert(prepared_replay_gain_filter != nullptr);
 
 		prepared_other_replay_gain_filter =
-			NewReplayGainFilter(replay_gain_config, allow_convert);
+			NewReplayGainFilter(replay_gain_config, allow_convert,
+					    float_pipeline);
 		assert(prepared_other_replay_gain_filter != nullptr);
 	}
 
@@ -217,6 +227,7 @@ FilteredAudioOutput::Setup(EventLoop &event_loop,
 		mixer = audio_output_load_mixer(event_loop, *this, block,
 						mixer_type,
 						mixer_plugin,
+						float_pipeline,
 						prepared_filter);
 	} catch (...) {
 		FmtError(output_domain,
@@ -238,10 +249,18 @@ FilteredAudioOutput::Setup(EventLoop &event_loop,
 		throw std::runtime_error("Invalid \"replay_gain_handler\" value");
 	}
 
+	/* without other filters, the conversion of this output is
+	   equivalent to that of other outputs with the same output
+	   format (the shared stage does not use the float
+	   pipeline) */
+	can_share_convert = prepared_filter == nullptr &&
+		!float_pipeline &&
+		!StringIsEqual(replay_gain_handler, "mixer");
+
 	/* the "convert" filter must be the last one in the chain */
 
 	prepared_filter = ChainFilters(std::move(prepared_filter),
-				       convert_filter.Set(convert_filter_prepare()),
+				       convert_filter.Set(convert_filter_prepare(float_pipeline)),
 				       "convert");
 }
 
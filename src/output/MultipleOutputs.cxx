@@ -130,7 +130,8 @@ MultipleOutputs::_Update(bool force) noexcept
 		return false;
 
 	for (auto &ao : outputs)
-		ret = ao.LockUpdate(input_audio_format, *pipe, force)
+		ret = ao.LockUpdate(input_audio_format, *pipe,
+				    shared_convert, force)
 			|| ret;
 
 	return ret;
@@ -255,7 +256,8 @@ MultipleOutputs::CheckPipe() noexcept
 			   provides a defined value */
 			elapsed_time = chunk->time;
 
-		const bool is_tail = chunk->next == nullptr;
+		const bool is_tail =
+			chunk->next.load(std::memory_order_relaxed) == nullptr;
 		if (is_tail) {
 			/* this is the tail of the pipe - clear the
 			   chunk reference in all outputs */
@@ -264,6 +266,9 @@ MultipleOutputs::CheckPipe() noexcept
 				ao.LockClearTailChunk(*chunk);
 		}
 
+		/* free the shared conversion result */
+		shared_convert.Release(*chunk);
+
 		/* remove the chunk from the pipe */
 		const auto shifted = pipe->Shift();
 		assert(shifted.get() == chunk);
@@ -323,6 +328,8 @@ MultipleOutputs::Cancel() noexcept
 	if (pipe != nullptr)
 		pipe->Clear();
 
+	shared_convert.Clear();
+
 	/* the audio outputs are now waiting for a signal, to
 	   synchronize the cleared music pipe */
 
@@ -340,6 +347,7 @@ MultipleOutputs::_Close() noexcept
 		ao.LockCloseWait();
 
 	pipe.reset();
+	shared_convert.Clear();
 
 	input_audio_format.Clear();
 
@@ -363,6 +371,7 @@ MultipleOutputs::Release() noexcept
 	}
 
 	pipe.reset();
+	shared_convert.Clear();
 
 	input_audio_format.Clear();
 
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "MusicChunkPtr.hxx"
+#include "SharedConvert.hxx"
 #include "player/Outputs.hxx"
 #include "pcm/AudioFormat.hxx"
 #include "thread/Mutex.hxx"
@@ -56,6 +57,12 @@ class MultipleOutputs final : public PlayerOutputs {
 	 */
 	std::unique_ptr<MusicPipe> pipe;
 
+	/**
+	 * Conversion stages shared by outputs with equivalent filter
+	 * chains.
+	 */
+	SharedConvertStages shared_convert;
+
 	/**
 	 * The "elapsed_time" stamp of the most recently finished
 	 * chunk.
@@ -0,0 +1,263 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "SharedConvert.hxx"
+#include "filter/Filter.hxx"
+#include "filter/Prepared.hxx"
+#include "filter/plugins/ConvertFilterPlugin.hxx"
+
+#include <algorithm>
+#include <cassert>
+
+SharedConvertStage::SharedConvertStage(AudioFormat _out_audio_format,
+				       bool _replay_gain) noexcept
+	:out_audio_format(_out_audio_format),
+	 replay_gain(_replay_gain),
+	 prepared_convert_filter(convert_filter_prepare())
+{
+}
+
+SharedConvertStage::~SharedConvertStage() noexcept
+{
+	assert(members.empty());
+}
+
+bool
+SharedConvertStage::IsShared() const noexcept
+{
+	const std::lock_guard lock{mutex};
+	return members.size() >= 2;
+}
+
+std::string
+SharedConvertStage::GetMemberNames() const noexcept
+{
+	const std::lock_guard lock{mutex};
+
+	std::string result;
+	for (const char *name : members) {
+		if (!result.empty())
+			result.append(", ");
+		result.append(name);
+	}
+
+	return result;
+}
+
+void
+SharedConvertStage::Join(const char *name, AudioFormat _in_audio_format,
+			 PreparedFilter *prepared_replay_gain_filter,
+			 PreparedFilter *prepared_other_replay_gain_filter)
+{
+	assert(_in_audio_format != out_audio_format);
+
+	const std::lock_guard lock{mutex};
+
+	if (chunk_filter.IsOpen() &&
+	    (flushed || _in_audio_format != in_audio_format)) {
+		/* the input format has changed or the stream has
+		   ended; the pipe is empty at this point, so nobody
+		   can be using the old entries */
+		chunk_filter.Close();
+		entries.clear();
+		last_chunk = nullptr;
+	}
+
+	if (!chunk_filter.IsOpen()) {
+		chunk_filter.Open(_in_audio_format,
+				  prepared_replay_gain_filter,
+				  prepared_other_replay_gain_filter,
+				  *prepared_convert_filter);
+
+		try {
+			convert_filter_set(&chunk_filter.GetFilter(),
+					   out_audio_format);
+		} catch (...) {
+			chunk_filter.Close();
+			throw;
+		}
+
+		in_audio_format = _in_audio_format;
+		flushed = false;
+		flush_data.clear();
+	}
+
+	members.push_back(name);
+}
+
+void
+SharedConvertStage::Leave(const char *name) noexcept
+{
+	const std::lock_guard lock{mutex};
+
+	const auto i = std::find(members.begin(), members.end(), name);
+	assert(i != members.end());
+	members.erase(i);
+}
+
+bool
+SharedConvertStage::Bind(const MusicChunk *previous,
+			 const MusicChunk &chunk) noexcept
+{
+	const std::lock_guard lock{mutex};
+
+	if (!chunk_filter.IsOpen() || flushed || members.size() < 2)
+		return false;
+
+	if (last_chunk != nullptr && last_chunk != previous &&
+	    std::none_of(entries.begin(), entries.end(), [&chunk](const auto &i){
+		    return i.chunk == &chunk;
+	    }))
+		/* this chunk is neither cached nor the successor of
+		   the last one; the caller is out of step with the
+		   other members */
+		return false;
+
+	++n_bound;
+	return true;
+}
+
+void
+SharedConvertStage::Unbind() noexcept
+{
+	const std::lock_guard lock{mutex};
+
+	assert(n_bound > 0);
+	if (--n_bound == 0)
+		/* start over with whichever chunk the next bound
+		   member submits */
+		ResetChain();
+}
+
+void
+SharedConvertStage::ResetChain() noexcept
+{
+	entries.clear();
+	last_chunk = nullptr;
+
+	if (chunk_filter.IsOpen() && !flushed)
+		chunk_filter.Reset();
+}
+
+std::optional<std::span<const std::byte>>
+SharedConvertStage::FilterChunk(const MusicChunk *previous,
+				const MusicChunk &chunk,
+				ReplayGainMode replay_gain_mode)
+{
+	const std::lock_guard lock{mutex};
+
+	assert(n_bound > 0);
+
+	/* search backwards, because the slowest output is usually
+	   only a few chunks behind */
+	for (auto i = entries.rbegin(); i != entries.rend(); ++i)
+		if (i->chunk == &chunk)
+			return i->data;
+
+	if (!chunk_filter.IsOpen() || flushed)
+		return std::nullopt;
+
+	if (last_chunk != nullptr && last_chunk != previous)
+		/* this chunk does not follow the last one; this can
+		   only happen after an error */
+		return std::nullopt;
+
+	auto &entry = entries.emplace_back(chunk);
+
+	try {
+		for (auto data = chunk_filter.FilterChunk(chunk, replay_gain_mode);
+		     !data.empty();
+		     data = chunk_filter.GetFilter().ReadMore())
+			entry.data.insert(entry.data.end(),
+					  data.begin(), data.end());
+	} catch (...) {
+		entries.pop_back();
+
+		/* start over with the next chunk */
+		chunk_filter.Reset();
+		last_chunk = nullptr;
+		throw;
+	}
+
+	last_chunk = &chunk;
+	return entry.data;
+}
+
+std::optional<std::span<const std::byte>>
+SharedConvertStage::Flush(const MusicChunk *previous)
+{
+	const std::lock_guard lock{mutex};
+
+	if (!chunk_filter.IsOpen() || last_chunk == nullptr ||
+	    last_chunk != previous)
+		/* the caller has not used this stage for the last
+		   chunk; it needs to flush its own filter */
+		return std::nullopt;
+
+	if (!flushed) {
+		flushed = true;
+
+		auto &filter = chunk_filter.GetFilter();
+		for (auto data = filter.Flush(); !data.empty();
+		     data = filter.Flush())
+			flush_data.insert(flush_data.end(),
+					  data.begin(), data.end());
+	}
+
+	return flush_data;
+}
+
+void
+SharedConvertStage::Release(const MusicChunk &chunk) noexcept
+{
+	const std::lock_guard lock{mutex};
+
+	std::erase_if(entries, [&chunk](const auto &i){
+		return i.chunk == &chunk;
+	});
+}
+
+void
+SharedConvertStage::Clear() noexcept
+{
+	const std::lock_guard lock{mutex};
+
+	ResetChain();
+}
+
+std::shared_ptr<SharedConvertStage>
+SharedConvertStages::Get(AudioFormat out_audio_format,
+			 bool replay_gain) noexcept
+{
+	const std::lock_guard lock{mutex};
+
+	/* dispose stages which are not used by any output */
+	stages.remove_if([](const auto &i){
+		return i.use_count() == 1;
+	});
+
+	for (const auto &i : stages)
+		if (i->Matches(out_audio_format, replay_gain))
+			return i;
+
+	return stages.emplace_front(std::make_shared<SharedConvertStage>(out_audio_format,
+									 replay_gain));
+}
+
+void
+SharedConvertStages::Release(const MusicChunk &chunk) noexcept
+{
+	const std::lock_guard lock{mutex};
+
+	for (const auto &i : stages)
+		i->Release(chunk);
+}
+
+void
+SharedConvertStages::Clear() noexcept
+{
+	const std::lock_guard lock{mutex};
+
+	for (const auto &i : stages)
+		i->Clear();
+}
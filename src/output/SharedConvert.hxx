@@ -0,0 +1,248 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "ChunkFilter.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "thread/Mutex.hxx"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <forward_list>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+enum class ReplayGainMode : uint8_t;
+struct MusicChunk;
+class PreparedFilter;
+
+/**
+ * A conversion stage (ReplayGain, cross-fading and #ConvertFilter)
+ * shared by all audio outputs of a #MultipleOutputs instance which
+ * have no other filters and the same output #AudioFormat.  Without
+ * it, each output thread would perform the very same (possibly
+ * expensive, e.g. resampling) calculation on each #MusicChunk.
+ *
+ * The first output thread which reaches a #MusicChunk converts it,
+ * and the result is kept until the chunk gets removed from the
+ * #MusicPipe (see Release()), so the other outputs can reuse it.
+ *
+ * An output decides at the beginning of each stream whether it uses
+ * this stage (see Bind()), and sticks to that decision until the
+ * stream ends or is cancelled; switching between this stage and its
+ * own filter in the middle of a stream would break the filter
+ * state (e.g. resampler history) of both.
+ *
+ * All methods are thread-safe.
+ */
+class SharedConvertStage {
+	const AudioFormat out_audio_format;
+
+	/**
+	 * Is ReplayGain applied?  Outputs with "replay_gain_handler"
+	 * set to "none" cannot share a stage with those which have
+	 * the default "software".
+	 */
+	const bool replay_gain;
+
+	const std::unique_ptr<PreparedFilter> prepared_convert_filter;
+
+	mutable Mutex mutex;
+
+	/**
+	 * The names of the audio outputs which use this stage.
+	 */
+	std::vector<const char *> members;
+
+	/**
+	 * The number of members which have called Bind() (and not
+	 * yet Unbind()).  As long as this is non-zero, each chunk
+	 * in the #MusicPipe up to #last_chunk has an entry.
+	 */
+	unsigned n_bound = 0;
+
+	AudioFormat in_audio_format = AudioFormat::Undefined();
+
+	ChunkFilter chunk_filter;
+
+	struct Entry {
+		const MusicChunk *chunk;
+
+		/**
+		 * The complete filter output for this chunk.
+		 */
+		std::vector<std::byte> data;
+
+		explicit Entry(const MusicChunk &_chunk) noexcept
+			:chunk(&_chunk) {}
+	};
+
+	/**
+	 * The converted chunks which may still be needed by one of
+	 * the members, in #MusicPipe order.
+	 */
+	std::deque<Entry> entries;
+
+	/**
+	 * The most recently converted chunk.  The next chunk can
+	 * only be converted by this stage if it is its successor;
+	 * otherwise the filter state would be wrong.  This pointer
+	 * is only compared and never dereferenced, because the chunk
+	 * may have been freed already.
+	 */
+	const MusicChunk *last_chunk = nullptr;
+
+	/**
+	 * Has #chunk_filter been flushed?  It needs to be reopened by
+	 * Join() before it can be used again.
+	 */
+	bool flushed = false;
+
+	/**
+	 * The complete output of Filter::Flush().
+	 */
+	std::vector<std::byte> flush_data;
+
+public:
+	SharedConvertStage(AudioFormat _out_audio_format,
+			   bool _replay_gain) noexcept;
+	~SharedConvertStage() noexcept;
+
+	SharedConvertStage(const SharedConvertStage &) = delete;
+	SharedConvertStage &operator=(const SharedConvertStage &) = delete;
+
+	bool Matches(AudioFormat _out_audio_format,
+		     bool _replay_gain) const noexcept {
+		return _out_audio_format == out_audio_format &&
+			_replay_gain == replay_gain;
+	}
+
+	const AudioFormat &GetOutAudioFormat() const noexcept {
+		return out_audio_format;
+	}
+
+	/**
+	 * Is this stage used by more than one audio output?
+	 */
+	[[gnu::pure]]
+	bool IsShared() const noexcept;
+
+	/**
+	 * @return a comma-separated list of the names of the audio
+	 * outputs using this stage
+	 */
+	[[gnu::pure]]
+	std::string GetMemberNames() const noexcept;
+
+	/**
+	 * Register an audio output which is going to use this stage.
+	 * If the #AudioFormat of the input has changed, the stage is
+	 * reopened.
+	 *
+	 * Throws on error.
+	 *
+	 * @param name the name of the audio output; the pointer must
+	 * remain valid until Leave() is called
+	 */
+	void Join(const char *name, AudioFormat _in_audio_format,
+		  PreparedFilter *prepared_replay_gain_filter,
+		  PreparedFilter *prepared_other_replay_gain_filter);
+
+	void Leave(const char *name) noexcept;
+
+	/**
+	 * Attempt to use this stage for the current stream of the
+	 * caller, beginning with the given chunk.  This succeeds
+	 * only if there is another member to share with and if this
+	 * stage is able to provide all chunks from here on.  On
+	 * success, the caller must call Unbind() at the end of the
+	 * stream.
+	 *
+	 * @param previous the chunk which was previously passed to
+	 * FilterChunk() by the caller (or nullptr)
+	 */
+	bool Bind(const MusicChunk *previous,
+		  const MusicChunk &chunk) noexcept;
+
+	/**
+	 * Undo Bind().  After the last member has unbound, the stage
+	 * is reset.
+	 */
+	void Unbind() noexcept;
+
+	/**
+	 * Obtain the converted data of the given chunk, and convert
+	 * it if no other output has done so already.  The caller must
+	 * be bound (see Bind()).
+	 *
+	 * Throws on error.
+	 *
+	 * @param previous the chunk which was previously passed to
+	 * this method by the caller (or nullptr)
+	 * @return the complete filter output or std::nullopt if this
+	 * stage cannot provide it (only after an error)
+	 */
+	std::optional<std::span<const std::byte>> FilterChunk(const MusicChunk *previous,
+							      const MusicChunk &chunk,
+							      ReplayGainMode replay_gain_mode);
+
+	/**
+	 * Flush the filter (or return the result of a previous
+	 * flush).
+	 *
+	 * Throws on error.
+	 *
+	 * @param previous the chunk which was previously passed to
+	 * FilterChunk() by the caller (or nullptr)
+	 * @return the complete output of Filter::Flush() or
+	 * std::nullopt if this stage cannot provide it
+	 */
+	std::optional<std::span<const std::byte>> Flush(const MusicChunk *previous);
+
+	/**
+	 * The given chunk is about to be removed from the
+	 * #MusicPipe, because all outputs have consumed it.  Free its
+	 * conversion result.
+	 */
+	void Release(const MusicChunk &chunk) noexcept;
+
+	/**
+	 * The #MusicPipe has been cleared; reset the stage.
+	 */
+	void Clear() noexcept;
+
+private:
+	void ResetChain() noexcept;
+};
+
+/**
+ * A container for all #SharedConvertStage instances of a
+ * #MultipleOutputs object.
+ */
+class SharedConvertStages {
+	Mutex mutex;
+
+	std::forward_list<std::shared_ptr<SharedConvertStage>> stages;
+
+public:
+	/**
+	 * Find a matching #SharedConvertStage or create a new one.
+	 */
+	std::shared_ptr<SharedConvertStage> Get(AudioFormat out_audio_format,
+						bool replay_gain) noexcept;
+
+	/**
+	 * @see SharedConvertStage::Release()
+	 */
+	void Release(const MusicChunk &chunk) noexcept;
+
+	/**
+	 * @see SharedConvertStage::Clear()
+	 */
+	void Clear() noexcept;
+};
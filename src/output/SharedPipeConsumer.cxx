@@ -12,11 +12,13 @@ SharedPipeConsumer::Get() noexcept
 		if (!consumed)
 			return chunk;
 
-		if (chunk->next == nullptr)
+		const MusicChunk *next =
+			chunk->next.load(std::memory_order_acquire);
+		if (next == nullptr)
 			return nullptr;
 
 		consumed = false;
-		return chunk = chunk->next.get();
+		return chunk = next;
 	} else {
 		/* get the first chunk from the pipe */
 		consumed = false;
@@ -33,9 +35,10 @@ SharedPipeConsumer::IsConsumed(const MusicChunk &_chunk) const noexcept
 	assert(&_chunk == chunk || pipe->Contains(chunk));
 
 	if (&_chunk != chunk) {
-		assert(_chunk.next != nullptr);
+		assert(_chunk.next.load(std::memory_order_relaxed) != nullptr);
 		return true;
 	}
 
-	return consumed && _chunk.next == nullptr;
+	return consumed &&
+		_chunk.next.load(std::memory_order_acquire) == nullptr;
 }
@@ -2,18 +2,12 @@
 // Copyright The Music Player Daemon Project
 
 #include "Source.hxx"
+#include "SharedConvert.hxx"
 #include "MusicChunk.hxx"
 #include "filter/Filter.hxx"
-#include "filter/Prepared.hxx"
-#include "filter/plugins/ReplayGainFilterPlugin.hxx"
-#include "pcm/Mix.hxx"
-#include "lib/fmt/AudioFormatFormatter.hxx"
-#include "lib/fmt/RuntimeError.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/ScopeUnlock.hxx"
 
-#include <string.h>
-
 AudioOutputSource::AudioOutputSource() noexcept = default;
 AudioOutputSource::~AudioOutputSource() noexcept = default;
 
@@ -27,184 +21,116 @@ AudioOutputSource::Open(const AudioFormat audio_format, const MusicPipe &_pipe,
 
 	if (!IsOpen() || &_pipe != &pipe.GetPipe()) {
 		current_chunk = nullptr;
+		previous_chunk = nullptr;
 		pipe.Init(_pipe);
 	}
 
 	/* (re)open the filter */
 
-	if (filter && (filter_flushed || audio_format != in_audio_format))
+	if (chunk_filter.IsOpen() &&
+	    (filter_flushed || audio_format != in_audio_format))
 		/* the filter must be reopened on all input format
 		   changes */
-		CloseFilter();
+		chunk_filter.Close();
 
-	if (filter == nullptr)
+	if (!chunk_filter.IsOpen()) {
 		/* open the filter */
-		OpenFilter(audio_format,
-			   prepared_replay_gain_filter,
-			   prepared_other_replay_gain_filter,
-			   prepared_filter);
+		chunk_filter.Open(audio_format,
+				  prepared_replay_gain_filter,
+				  prepared_other_replay_gain_filter,
+				  prepared_filter);
+		filter_flushed = false;
+		shared_flushed = false;
+	}
 
 	in_audio_format = audio_format;
-	return filter->GetOutAudioFormat();
+	return chunk_filter.GetFilter().GetOutAudioFormat();
 }
 
 void
 AudioOutputSource::Close() noexcept
 {
 	assert(in_audio_format.IsValid());
+	assert(shared_convert == nullptr);
+
 	in_audio_format.Clear();
 
-	CloseFilter();
+	chunk_filter.Close();
 
 	Cancel();
 }
 
-void
-AudioOutputSource::Cancel() noexcept
+std::shared_ptr<SharedConvertStage>
+AudioOutputSource::SetSharedConvert(std::shared_ptr<SharedConvertStage> _shared_convert) noexcept
 {
-	current_chunk = nullptr;
-	pipe.Cancel();
-
-	if (replay_gain_filter)
-		replay_gain_filter->Reset();
-
-	if (other_replay_gain_filter)
-		other_replay_gain_filter->Reset();
-
-	if (filter && !filter_flushed)
-		filter->Reset();
-}
-
-inline void
-AudioOutputSource::OpenFilter(AudioFormat audio_format,
-			      PreparedFilter *prepared_replay_gain_filter,
-			      PreparedFilter *prepared_other_replay_gain_filter,
-			      PreparedFilter &prepared_filter)
-try {
-	assert(audio_format.IsValid());
-
-	/* the replay_gain filter cannot fail here */
-	if (prepared_other_replay_gain_filter) {
-		other_replay_gain_serial = 0;
-		other_replay_gain_filter =
-			prepared_other_replay_gain_filter->Open(audio_format);
-	}
-
-	if (prepared_replay_gain_filter) {
-		replay_gain_serial = 0;
-		replay_gain_filter =
-			prepared_replay_gain_filter->Open(audio_format);
-
-		audio_format = replay_gain_filter->GetOutAudioFormat();
-
-		assert(replay_gain_filter->GetOutAudioFormat() ==
-		       other_replay_gain_filter->GetOutAudioFormat());
-	}
-
-	filter = prepared_filter.Open(audio_format);
-	filter_flushed = false;
-} catch (...) {
-	CloseFilter();
-	throw;
+	Unbind();
+	return std::exchange(shared_convert, std::move(_shared_convert));
 }
 
 void
-AudioOutputSource::CloseFilter() noexcept
+AudioOutputSource::Unbind() noexcept
 {
-	replay_gain_filter.reset();
-	other_replay_gain_filter.reset();
-	filter.reset();
+	if (chain == Chain::SHARED)
+		shared_convert->Unbind();
+
+	chain = Chain::UNDECIDED;
 }
 
-std::span<const std::byte>
-AudioOutputSource::GetChunkData(const MusicChunk &chunk,
-				Filter *current_replay_gain_filter,
-				unsigned *replay_gain_serial_p)
+void
+AudioOutputSource::Cancel() noexcept
 {
-	assert(!chunk.IsEmpty());
-	assert(chunk.CheckFormat(in_audio_format));
-
-	auto data = chunk.ReadData();
-
-	assert(data.size() % in_audio_format.GetFrameSize() == 0);
-
-	if (!data.empty() && current_replay_gain_filter != nullptr) {
-		replay_gain_filter_set_mode(*current_replay_gain_filter,
-					    replay_gain_mode);
-
-		if (chunk.replay_gain_serial != *replay_gain_serial_p) {
-			replay_gain_filter_set_info(*current_replay_gain_filter,
-						    chunk.replay_gain_serial != 0
-						    ? &chunk.replay_gain_info
-						    : nullptr);
-			*replay_gain_serial_p = chunk.replay_gain_serial;
-		}
+	current_chunk = nullptr;
+	previous_chunk = nullptr;
+	pipe.Cancel();
 
-		/* note: the ReplayGainFilter doesn't have a
-		   ReadMore() method */
-		data = current_replay_gain_filter->FilterPCM(data);
-	}
+	/* the pipe will be consumed from the beginning, which
+	   starts a new stream */
+	Unbind();
 
-	return data;
+	if (chunk_filter.IsOpen() && !filter_flushed)
+		chunk_filter.Reset();
 }
 
 inline std::span<const std::byte>
 AudioOutputSource::FilterChunk(const MusicChunk &chunk)
 {
-	assert(filter);
+	assert(chunk_filter.IsOpen());
 	assert(!filter_flushed);
 
-	auto data = GetChunkData(chunk, replay_gain_filter.get(),
-				 &replay_gain_serial);
-	if (data.empty())
-		return data;
-
-	/* cross-fade */
-
-	if (chunk.other != nullptr) {
-		auto other_data = GetChunkData(*chunk.other,
-					       other_replay_gain_filter.get(),
-					       &other_replay_gain_serial);
-		if (other_data.empty())
-			return data;
-
-		/* if the "other" chunk is longer, then that trailer
-		   is used as-is, without mixing; it is part of the
-		   "next" song being faded in, and if there's a rest,
-		   it means cross-fading ends here */
-
-		if (data.size() > other_data.size())
-			data = data.first(other_data.size());
-
-		float mix_ratio = chunk.mix_ratio;
-		if (mix_ratio >= 0)
-			/* reverse the mix ratio (because the
-			   arguments to pcm_mix() are reversed), but
-			   only if the mix ratio is non-negative; a
-			   negative mix ratio is a MixRamp special
-			   case */
-			mix_ratio = 1.0f - mix_ratio;
-
-		void *dest = cross_fade_buffer.Get(other_data.size());
-		memcpy(dest, other_data.data(), other_data.size());
-		if (!pcm_mix(cross_fade_dither, dest, data.data(), data.size(),
-			     in_audio_format.format,
-			     mix_ratio))
-			throw FmtRuntimeError("Cannot cross-fade format {}",
-					      in_audio_format.format);
-
-		data = {(const std::byte *)dest, other_data.size()};
-	}
+	const MusicChunk *previous = std::exchange(previous_chunk, &chunk);
+
+	if (chain == Chain::UNDECIDED)
+		chain = shared_convert != nullptr &&
+			shared_convert->Bind(previous, chunk)
+			? Chain::SHARED
+			: Chain::OWN;
+
+	if (chain == Chain::SHARED) {
+		/* use the result of another output which has
+		   already converted this chunk (or convert it for
+		   the others) */
+		const auto data = shared_convert->FilterChunk(previous, chunk,
+							      replay_gain_mode);
+		if (data) {
+			shared_data = true;
+			return *data;
+		}
 
-	/* apply filter chain */
+		/* the stage has lost track after an error; our own
+		   filter has not seen this stream yet, so it can
+		   take over from here */
+		shared_convert->Unbind();
+		chain = Chain::OWN;
+	}
 
-	return filter->FilterPCM(data);
+	shared_data = false;
+	return chunk_filter.FilterChunk(chunk, replay_gain_mode);
 }
 
 bool
 AudioOutputSource::Fill(Mutex &mutex)
 {
-	assert(filter);
+	assert(chunk_filter.IsOpen());
 	assert(!filter_flushed);
 
 	if (current_chunk != nullptr && pending_tag == nullptr &&
@@ -237,15 +163,17 @@ AudioOutputSource::Fill(Mutex &mutex)
 void
 AudioOutputSource::ConsumeData(size_t nbytes) noexcept
 {
-	assert(filter);
+	assert(chunk_filter.IsOpen());
 	assert(!filter_flushed);
 
 	pending_data = pending_data.subspan(nbytes);
 
 	if (pending_data.empty()) {
 		/* give the filter a chance to return more data in
-		   another buffer */
-		pending_data = filter->ReadMore();
+		   another buffer (the #SharedConvertStage returns
+		   everything at once) */
+		if (!shared_data)
+			pending_data = chunk_filter.GetFilter().ReadMore();
 
 		if (pending_data.empty())
 			DropCurrentChunk();
@@ -255,8 +183,22 @@ AudioOutputSource::ConsumeData(size_t nbytes) noexcept
 std::span<const std::byte>
 AudioOutputSource::Flush()
 {
-	assert(filter);
+	assert(chunk_filter.IsOpen());
+
+	if (shared_flushed)
+		/* the #SharedConvertStage has returned everything
+		   in the first call */
+		return {};
+
+	if (chain == Chain::SHARED && !filter_flushed) {
+		filter_flushed = true;
+
+		if (const auto data = shared_convert->Flush(previous_chunk)) {
+			shared_flushed = true;
+			return *data;
+		}
+	}
 
 	filter_flushed = true;
-	return filter->Flush();
+	return chunk_filter.GetFilter().Flush();
 }
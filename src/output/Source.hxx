@@ -5,10 +5,9 @@
 #define AUDIO_OUTPUT_SOURCE_HXX
 
 #include "SharedPipeConsumer.hxx"
+#include "ChunkFilter.hxx"
 #include "ReplayGainMode.hxx"
 #include "pcm/AudioFormat.hxx"
-#include "pcm/Buffer.hxx"
-#include "pcm/Dither.hxx"
 #include "thread/Mutex.hxx"
 
 #include <cassert>
@@ -19,8 +18,8 @@
 
 struct MusicChunk;
 struct Tag;
-class Filter;
 class PreparedFilter;
+class SharedConvertStage;
 
 /**
  * Source of audio data to be played by an #AudioOutput.  It receives
@@ -43,45 +42,47 @@ class AudioOutputSource {
 	SharedPipeConsumer pipe;
 
 	/**
-	 * The serial number of the last replay gain info.  0 means no
-	 * replay gain info was available.
+	 * ReplayGain, cross-fading and the configured filters of this
+	 * audio output.
 	 */
-	unsigned replay_gain_serial;
+	ChunkFilter chunk_filter;
 
 	/**
-	 * The serial number of the last replay gain info by the
-	 * "other" chunk during cross-fading.
+	 * If not nullptr, then the conversion of chunks may be shared
+	 * with other audio outputs (see #chain).
 	 */
-	unsigned other_replay_gain_serial;
+	std::shared_ptr<SharedConvertStage> shared_convert;
 
 	/**
-	 * The replay_gain_filter_plugin instance of this audio
-	 * output.
+	 * Which filter chain converts the chunks of the current
+	 * stream?  This is decided when the first chunk after
+	 * Open() or Cancel() arrives, and remains unchanged until the
+	 * stream ends.
 	 */
-	std::unique_ptr<Filter> replay_gain_filter;
+	enum class Chain : uint8_t {
+		/**
+		 * Not yet decided.
+		 */
+		UNDECIDED,
 
-	/**
-	 * The replay_gain_filter_plugin instance of this audio
-	 * output, to be applied to the second chunk during
-	 * cross-fading.
-	 */
-	std::unique_ptr<Filter> other_replay_gain_filter;
-
-	/**
-	 * The buffer used to allocate the cross-fading result.
-	 */
-	PcmBuffer cross_fade_buffer;
+		/**
+		 * Our own #chunk_filter.
+		 */
+		OWN,
 
-	/**
-	 * The dithering state for cross-fading two streams.
-	 */
-	PcmDither cross_fade_dither;
+		/**
+		 * #shared_convert (we are bound to it).
+		 */
+		SHARED,
+	} chain = Chain::UNDECIDED;
 
 	/**
-	 * The filter object of this audio output.  This is an
-	 * instance of chain_filter_plugin.
+	 * The #MusicChunk which was processed before #current_chunk.
+	 * This is only used to compare pointers (it may have been
+	 * freed already) and helps #SharedConvertStage to detect
+	 * discontinuities.
 	 */
-	std::unique_ptr<Filter> filter;
+	const MusicChunk *previous_chunk = nullptr;
 
 	/**
 	 * The #MusicChunk currently being processed (see
@@ -102,11 +103,21 @@ class AudioOutputSource {
 	std::span<const std::byte> pending_data;
 
 	/**
-	 * Has #filter been flushed?  If true, then no method calls
+	 * Was #pending_data obtained from #shared_convert?
+	 */
+	bool shared_data;
+
+	/**
+	 * Was Flush() served by #shared_convert?
+	 */
+	bool shared_flushed;
+
+	/**
+	 * Has #chunk_filter been flushed?  If true, then no method calls
 	 * (other than Flush()) are allowed on this #Filter according
 	 * to the API definition.
 	 *
-	 * This field is only initialized if #filter is not nullptr.
+	 * This field is only initialized if #chunk_filter is open.
 	 */
 	bool filter_flushed;
 
@@ -136,6 +147,18 @@ public:
 	void Close() noexcept;
 	void Cancel() noexcept;
 
+	const SharedConvertStage *GetSharedConvert() const noexcept {
+		return shared_convert.get();
+	}
+
+	/**
+	 * Attach this object to a #SharedConvertStage (or detach it
+	 * by passing nullptr).
+	 *
+	 * @return the previous #SharedConvertStage
+	 */
+	std::shared_ptr<SharedConvertStage> SetSharedConvert(std::shared_ptr<SharedConvertStage> _shared_convert) noexcept;
+
 	/**
 	 * Ensure that ReadTag() or PeekData() return any input.
 	 *
@@ -192,16 +215,11 @@ public:
 	std::span<const std::byte> Flush();
 
 private:
-	void OpenFilter(AudioFormat audio_format,
-			PreparedFilter *prepared_replay_gain_filter,
-			PreparedFilter *prepared_other_replay_gain_filter,
-			PreparedFilter &prepared_filter);
-
-	void CloseFilter() noexcept;
-
-	std::span<const std::byte> GetChunkData(const MusicChunk &chunk,
-						Filter *replay_gain_filter,
-						unsigned *replay_gain_serial_p);
+	/**
+	 * Stop using #shared_convert for the current stream (if we
+	 * did); the next chunk will decide again.
+	 */
+	void Unbind() noexcept;
 
 	std::span<const std::byte> FilterChunk(const MusicChunk &chunk);
 
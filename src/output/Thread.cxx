@@ -4,6 +4,7 @@
 #include "Control.hxx"
 #include "Error.hxx"
 #include "Filtered.hxx"
+#include "SharedConvert.hxx"
 #include "Client.hxx"
 #include "Domain.hxx"
 #include "lib/fmt/AudioFormatFormatter.hxx"
@@ -13,6 +14,7 @@
 #include "thread/ScopeUnlock.hxx"
 #include "thread/Slack.hxx"
 #include "thread/Name.hxx"
+#include "thread/Stats.hxx"
 #include "util/StringBuffer.hxx"
 #include "util/ScopeExit.hxx"
 #include "Log.hxx"
@@ -106,12 +108,59 @@ AudioOutputControl::InternalDisable() noexcept
 	output->Disable();
 }
 
+inline void
+AudioOutputControl::InternalJoinSharedConvert(const AudioFormat in_audio_format,
+					      SharedConvertStages &shared_convert) noexcept
+{
+	assert(source.GetSharedConvert() == nullptr);
+
+	if (!output->can_share_convert ||
+	    in_audio_format == output->out_audio_format)
+		/* other filters are configured, or there is nothing
+		   to convert */
+		return;
+
+	auto stage = shared_convert.Get(output->out_audio_format,
+					output->prepared_replay_gain_filter != nullptr);
+
+	try {
+		stage->Join(GetName(), in_audio_format,
+			    output->prepared_replay_gain_filter.get(),
+			    output->prepared_other_replay_gain_filter.get());
+	} catch (...) {
+		FmtError(output_domain,
+			 "Failed to open shared conversion for {}: {}",
+			 GetLogName(), std::current_exception());
+		return;
+	}
+
+	if (stage->IsShared())
+		FmtInfo(output_domain,
+			"Outputs sharing conversion {} -> {}: {}",
+			in_audio_format, stage->GetOutAudioFormat(),
+			stage->GetMemberNames());
+
+	source.SetSharedConvert(std::move(stage));
+}
+
+inline void
+AudioOutputControl::InternalLeaveSharedConvert() noexcept
+{
+	if (const auto stage = source.SetSharedConvert(nullptr))
+		stage->Leave(GetName());
+}
+
 inline void
 AudioOutputControl::InternalOpen(const AudioFormat in_audio_format,
-				 const MusicPipe &pipe) noexcept
+				 const MusicPipe &pipe,
+				 SharedConvertStages &shared_convert) noexcept
 {
 	should_reopen = false;
 
+	/* the input format may have changed; join again after the
+	   output has been opened */
+	InternalLeaveSharedConvert();
+
 	/* enable the device (just in case the last enable has failed) */
 	if (!InternalEnable())
 		return;
@@ -152,6 +201,8 @@ AudioOutputControl::InternalOpen(const AudioFormat in_audio_format,
 	if (f != in_audio_format || f != output->out_audio_format)
 		FmtDebug(output_domain, "converting in={} -> f={} -> out={}",
 			 in_audio_format, f, output->out_audio_format);
+
+	InternalJoinSharedConvert(in_audio_format, shared_convert);
 }
 
 inline void
@@ -177,6 +228,8 @@ AudioOutputControl::InternalClose(bool drain) noexcept
 		output->Close(drain);
 	}
 
+	InternalLeaveSharedConvert();
+
 	source_state = SourceState::CLOSED;
 	source.Close();
 }
@@ -433,6 +486,7 @@ void
 AudioOutputControl::Task() noexcept
 {
 	FmtThreadName("output:{}", GetName());
+	ThreadStats thread_stats{fmt::format("output:{}", GetName())};
 
 	try {
 		SetThreadRealtime();
@@ -447,6 +501,8 @@ AudioOutputControl::Task() noexcept
 	std::unique_lock lock{mutex};
 
 	while (true) {
+		ThreadStats::UpdateCurrent();
+
 		switch (command) {
 		case Command::NONE:
 			/* no pending command: play (or wait for a
@@ -474,7 +530,8 @@ AudioOutputControl::Task() noexcept
 			break;
 
 		case Command::OPEN:
-			InternalOpen(request.audio_format, *request.pipe);
+			InternalOpen(request.audio_format, *request.pipe,
+				     *request.shared_convert);
 			CommandFinished();
 			break;
 
@@ -3,6 +3,11 @@
 
 #include "Buffer.hxx"
 
+/**
+ * Always allocate multiples of this number of bytes.
+ */
+static constexpr size_t GRANULARITY = 8192;
+
 void *
 PcmBuffer::Get(size_t new_size) noexcept
 {
@@ -11,5 +16,11 @@ PcmBuffer::Get(size_t new_size) noexcept
 		   assumed to be an error condition */
 		new_size = 1;
 
-	return buffer.Get(new_size);
+	if (new_size > buffer.size()) [[unlikely]] {
+		/* too small: grow */
+		buffer = {};
+		buffer = AudioMemory{((new_size - 1) | (GRANULARITY - 1)) + 1};
+	}
+
+	return buffer.data();
 }
@@ -4,7 +4,7 @@
 #ifndef PCM_BUFFER_HXX
 #define PCM_BUFFER_HXX
 
-#include "util/ReusableArray.hxx"
+#include "memory/AudioMemory.hxx"
 
 #include <cstddef>
 
@@ -12,13 +12,16 @@
  * Manager for a temporary buffer which grows as needed.  We could
  * allocate a new buffer every time pcm_convert() is called, but that
  * would put too much stress on the allocator.
+ *
+ * The memory is locked into RAM if the "mlock_audio_memory" feature
+ * is enabled (see #AudioMemory).
  */
 class PcmBuffer {
-	ReusableArray<std::byte, 8192> buffer;
+	AudioMemory buffer;
 
 public:
 	void Clear() noexcept {
-		buffer.Clear();
+		buffer = {};
 	}
 
 	/**
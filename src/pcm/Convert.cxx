@@ -15,7 +15,8 @@ pcm_convert_global_init(const ConfigData &config)
 }
 
 PcmConvert::PcmConvert(const AudioFormat _src_format,
-		       const AudioFormat dest_format)
+		       const AudioFormat dest_format,
+		       bool dither_float)
 	:src_format(_src_format)
 {
 	assert(src_format.IsValid());
@@ -47,7 +48,8 @@ PcmConvert::PcmConvert(const AudioFormat _src_format,
 	if (enable_format) {
 		try {
 			format_converter.Open(format.format,
-					      dest_format.format);
+					      dest_format.format,
+					      dither_float);
 		} catch (...) {
 			if (enable_resampler)
 				resampler.Close();
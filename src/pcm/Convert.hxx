@@ -44,8 +44,11 @@ public:
 
 	/**
 	 * Throws on error.
+	 *
+	 * @param dither_float see PcmFormatConverter::Open()
 	 */
-	PcmConvert(AudioFormat _src_format, AudioFormat _dest_format);
+	PcmConvert(AudioFormat _src_format, AudioFormat _dest_format,
+		   bool dither_float=false);
 
 	~PcmConvert() noexcept;
 
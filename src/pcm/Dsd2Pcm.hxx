@@ -41,18 +41,19 @@ or implied, of Sebastian Gesemann.
  * A "dsd2pcm engine" for one channel.
  */
 class Dsd2Pcm {
-	friend class MultiDsd2Pcm;
-
 public:
-	/* must be a power of two */
-	static constexpr size_t FIFOSIZE = 16;
+	/**
+	 * The number of past octets needed (in addition to the
+	 * current one) to calculate one output sample.
+	 */
+	static constexpr size_t HISTORY = 11;
 
 private:
-	/** bit mask for FIFO offsets */
-	static constexpr size_t FIFOMASK = FIFOSIZE - 1;
-
-	std::array<std::byte, FIFOSIZE> fifo;
-	size_t fifopos;
+	/**
+	 * The most recent #HISTORY input octets in chronological
+	 * order (not bit-reversed).
+	 */
+	std::array<std::byte, HISTORY> history;
 
 public:
 	Dsd2Pcm() noexcept {
@@ -83,24 +84,24 @@ public:
 			  int32_t *dst, ptrdiff_t dst_stride) noexcept;
 
 private:
-	void ApplySample(size_t ffp, std::byte src) noexcept;
-	float CalcOutputSample(size_t ffp) const noexcept;
-	float TranslateSample(size_t ffp, std::byte src) noexcept;
-
-	int32_t CalcOutputSampleS24(size_t ffp) const noexcept;
-	int32_t TranslateSampleS24(size_t ffp, std::byte src) noexcept;
+	/**
+	 * Copy input octets to a linear buffer (after the history)
+	 * and let #calc convert a contiguous run of them.
+	 */
+	template<typename T, typename F>
+	void Translate(size_t samples,
+		       const std::byte *src, ptrdiff_t src_stride,
+		       T *dst, ptrdiff_t dst_stride,
+		       F &&calc) noexcept;
 };
 
 class MultiDsd2Pcm {
 	std::array<Dsd2Pcm, MAX_CHANNELS> per_channel;
 
-	size_t fifopos = 0;
-
 public:
 	void Reset() noexcept {
 		for (auto &i : per_channel)
 			i.Reset();
-		fifopos = 0;
 	}
 
 	void Translate(unsigned channels, size_t n_frames,
@@ -108,16 +109,6 @@ public:
 
 	void TranslateS24(unsigned channels, size_t n_frames,
 			  const std::byte *src, int32_t *dest) noexcept;
-
-private:
-	/**
-	 * Optimized implementation for the common case.
-	 */
-	void TranslateStereo(size_t n_frames,
-			     const std::byte *src, float *dest) noexcept;
-
-	void TranslateStereoS24(size_t n_frames,
-				const std::byte *src, int32_t *dest) noexcept;
 };
 
 #endif /* include guard DSD2PCM_H_INCLUDED */
@@ -5,12 +5,15 @@
 #include "Order.hxx"
 #include "Pack.hxx"
 #include "Silence.hxx"
+#include "util/ByteOrder.hxx"
 #include "util/ByteReverse.hxx"
 #include "util/SpanCast.hxx"
 
 #include <algorithm>
 #include <cassert>
 
+#include <string.h>
+
 void
 PcmExport::Open(SampleFormat sample_format, unsigned _channels,
 		Params params) noexcept
@@ -75,6 +78,27 @@ PcmExport::Open(SampleFormat sample_format, unsigned _channels,
 			reverse_endian = sample_size;
 	}
 
+	const uint8_t *alsa_channel_map = alsa_channel_order &&
+		sample_format_size(src_sample_format) > 1
+		? GetAlsaChannelMap(channels)
+		: nullptr;
+
+	/* combining several of these steps saves one pass over the
+	   data (and one buffer) for each additional step */
+	fused = (alsa_channel_map != nullptr) + (shift8 || pack24) +
+		(reverse_endian > 0) >= 2;
+#ifdef ENABLE_DSD
+	if (dsd_mode != DsdMode::NONE)
+		fused = false;
+#endif
+
+	if (fused) {
+		for (unsigned i = 0; i < channels; ++i)
+			channel_map[i] = alsa_channel_map != nullptr
+				? alsa_channel_map[i]
+				: i;
+	}
+
 	/* prepare a moment of silence for GetSilence() */
 	std::byte buffer[sizeof(silence_buffer)];
 	const size_t buffer_size = GetInputBlockSize();
@@ -245,9 +269,116 @@ PcmExport::Params::CalcInputSampleRate(unsigned sample_rate) const noexcept
 	return sample_rate;
 }
 
+/**
+ * Copy frames in the given channel order, passing each sample to the
+ * #write function which writes it to #dest (and returns the new
+ * #dest pointer).
+ */
+template<typename T, typename W>
+static void
+ExportFrames(std::byte *dest, const T *src, std::size_t n_frames,
+	     unsigned channels, const uint8_t *channel_map,
+	     W &&write) noexcept
+{
+	for (std::size_t i = 0; i < n_frames; ++i, src += channels)
+		for (unsigned c = 0; c < channels; ++c)
+			dest = write(dest, src[channel_map[c]]);
+}
+
+template<typename T>
+static std::byte *
+WriteSample(std::byte *dest, T value) noexcept
+{
+	memcpy(dest, &value, sizeof(value));
+	return dest + sizeof(value);
+}
+
+/**
+ * Write the lower 24 bits of the given sample (3 bytes).
+ */
+template<bool little_endian>
+static std::byte *
+WritePacked24(std::byte *dest, uint32_t value) noexcept
+{
+	if constexpr (little_endian) {
+		dest[0] = std::byte(value);
+		dest[1] = std::byte(value >> 8);
+		dest[2] = std::byte(value >> 16);
+	} else {
+		dest[0] = std::byte(value >> 16);
+		dest[1] = std::byte(value >> 8);
+		dest[2] = std::byte(value);
+	}
+
+	return dest + 3;
+}
+
+std::span<const std::byte>
+PcmExport::ExportFused(std::span<const std::byte> data) noexcept
+{
+	const std::size_t n_frames = data.size() / GetInputFrameSize();
+	const std::size_t dest_size = n_frames * GetOutputFrameSize();
+	auto *dest = (std::byte *)pack_buffer.Get(dest_size);
+	assert(dest != nullptr);
+
+	const bool reverse = reverse_endian > 0;
+
+	if (sample_format_size(src_sample_format) == 2) {
+		assert(!shift8 && !pack24);
+
+		const auto *src = (const uint16_t *)data.data();
+		if (reverse)
+			ExportFrames(dest, src, n_frames, channels, channel_map,
+				     [](std::byte *d, uint16_t x){
+					     return WriteSample(d, ByteSwap16(x));
+				     });
+		else
+			ExportFrames(dest, src, n_frames, channels, channel_map,
+				     WriteSample<uint16_t>);
+	} else {
+		assert(sample_format_size(src_sample_format) == 4);
+
+		const auto *src = (const uint32_t *)data.data();
+		if (pack24) {
+			/* pcm_pack_24() writes host byte order */
+			if (IsLittleEndian() != reverse)
+				ExportFrames(dest, src, n_frames, channels,
+					     channel_map, WritePacked24<true>);
+			else
+				ExportFrames(dest, src, n_frames, channels,
+					     channel_map, WritePacked24<false>);
+		} else if (shift8) {
+			if (reverse)
+				ExportFrames(dest, src, n_frames, channels, channel_map,
+					     [](std::byte *d, uint32_t x){
+						     return WriteSample(d, ByteSwap32(x << 8));
+					     });
+			else
+				ExportFrames(dest, src, n_frames, channels, channel_map,
+					     [](std::byte *d, uint32_t x){
+						     return WriteSample(d, x << 8);
+					     });
+		} else {
+			if (reverse)
+				ExportFrames(dest, src, n_frames, channels, channel_map,
+					     [](std::byte *d, uint32_t x){
+						     return WriteSample(d, ByteSwap32(x));
+					     });
+			else
+				ExportFrames(dest, src, n_frames, channels, channel_map,
+					     WriteSample<uint32_t>);
+		}
+	}
+
+	return {dest, dest_size};
+}
+
 std::span<const std::byte>
 PcmExport::Export(std::span<const std::byte> data) noexcept
 {
+	if (fused)
+		return ExportFused(data);
+
 	if (alsa_channel_order)
 		data = ToAlsaChannelOrder(order_buffer, data,
 					  src_sample_format, channels);
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "SampleFormat.hxx"
+#include "ChannelDefs.hxx"
 #include "Buffer.hxx"
 #include "pcm/Features.h" // for ENABLE_DSD
 
@@ -126,6 +127,20 @@ private:
 	 */
 	uint8_t reverse_endian;
 
+	/**
+	 * Are at least two of #alsa_channel_order, #shift8/#pack24
+	 * and #reverse_endian in effect?  Then Export() does all of
+	 * them in one pass over the data (see ExportFused()) instead
+	 * of one pass each.
+	 */
+	bool fused;
+
+	/**
+	 * For the fused export: the source channel of each output
+	 * channel.
+	 */
+	uint8_t channel_map[MAX_CHANNELS];
+
 public:
 	struct Params {
 		bool alsa_channel_order = false;
@@ -228,4 +243,7 @@ public:
 	 */
 	[[gnu::pure]]
 	size_t CalcInputSize(size_t dest_size) const noexcept;
+
+private:
+	std::span<const std::byte> ExportFused(std::span<const std::byte> src) noexcept;
 };
@@ -5,12 +5,14 @@
 #include "PcmFormat.hxx"
 #include "lib/fmt/AudioFormatFormatter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
+#include "util/SpanCast.hxx"
 
 #include <cassert>
 #include <utility> // for std::unreachable()
 
 void
-PcmFormatConverter::Open(SampleFormat _src_format, SampleFormat _dest_format)
+PcmFormatConverter::Open(SampleFormat _src_format, SampleFormat _dest_format,
+			 bool _dither_float)
 {
 	assert(_src_format != SampleFormat::UNDEFINED);
 	assert(_dest_format != SampleFormat::UNDEFINED);
@@ -33,6 +35,7 @@ PcmFormatConverter::Open(SampleFormat _src_format, SampleFormat _dest_format)
 
 	src_format = _src_format;
 	dest_format = _dest_format;
+	dither_float = _dither_float;
 }
 
 void
@@ -54,6 +57,13 @@ PcmFormatConverter::Convert(std::span<const std::byte> src) noexcept
 		std::unreachable();
 
 	case SampleFormat::S16:
+		if (dither_float && src_format == SampleFormat::FLOAT)
+			/* this is the last quantization step of the
+			   "float_pipeline"; dither it just like 24/32
+			   bit integer samples */
+			return std::as_bytes(pcm_dither_float_to_16(buffer, dither,
+								    FromBytesStrict<const float>(src)));
+
 		return std::as_bytes(pcm_convert_to_16(buffer, dither,
 						       src_format,
 						       src));
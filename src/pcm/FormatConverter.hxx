@@ -20,6 +20,12 @@
 class PcmFormatConverter {
 	SampleFormat src_format, dest_format;
 
+	/**
+	 * Dither floating point samples when converting them to 16
+	 * bit?  See Open().
+	 */
+	bool dither_float;
+
 	PcmBuffer buffer;
 	PcmDither dither;
 
@@ -42,8 +48,13 @@ public:
 	 *
 	 * @param src_format the sample format of incoming data
 	 * @param dest_format the sample format of outgoing data
+	 * @param dither_float dither floating point samples when
+	 * converting them to 16 bit (slower than the plain SIMD
+	 * conversion, but used by the "float_pipeline" mode, where this
+	 * is the only quantization step)
 	 */
-	void Open(SampleFormat src_format, SampleFormat dest_format);
+	void Open(SampleFormat src_format, SampleFormat dest_format,
+		  bool dither_float=false);
 
 	/**
 	 * Closes the object.  After that, you may call Open() again.
@@ -3,6 +3,7 @@
 
 #include "Mix.hxx"
 #include "Volume.hxx"
+#include "SimdVolume.hxx"
 #include "Clamp.hxx"
 #include "Traits.hxx"
 #include "util/Clamp.hxx"
@@ -59,6 +60,12 @@ static void
 pcm_add_vol_float(float *buffer1, const float *buffer2,
 		  unsigned num_samples, float volume1, float volume2) noexcept
 {
+	const unsigned done = SimdAddVolumeFloat(buffer1, buffer2, num_samples,
+						 volume1, volume2);
+	buffer1 += done;
+	buffer2 += done;
+	num_samples -= done;
+
 	while (num_samples > 0) {
 		float sample1 = *buffer1;
 		float sample2 = *buffer2++;
@@ -146,10 +153,29 @@ PcmAddVoid(void *a, const void *b, size_t size) noexcept
 			  size / sample_size);
 }
 
+static void
+PcmAdd16(void *_a, const void *_b, size_t size) noexcept
+{
+	using Traits = SampleTraits<SampleFormat::S16>;
+	assert(size % Traits::SAMPLE_SIZE == 0);
+
+	const auto a = Traits::pointer(_a);
+	const auto b = Traits::const_pointer(_b);
+	const size_t n = size / Traits::SAMPLE_SIZE;
+
+	const size_t done = SimdAdd16(a, b, n);
+	PcmAdd<SampleFormat::S16>(a + done, b + done, n - done);
+}
+
 static void
 pcm_add_float(float *buffer1, const float *buffer2,
 	      unsigned num_samples) noexcept
 {
+	const unsigned done = SimdAddFloat(buffer1, buffer2, num_samples);
+	buffer1 += done;
+	buffer2 += done;
+	num_samples -= done;
+
 	while (num_samples > 0) {
 		float sample1 = *buffer1;
 		float sample2 = *buffer2++;
@@ -173,7 +199,7 @@ pcm_add(void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::S16:
-		PcmAddVoid<SampleFormat::S16>(buffer1, buffer2, size);
+		PcmAdd16(buffer1, buffer2, size);
 		return true;
 
 	case SampleFormat::S24_P32:
@@ -12,9 +12,10 @@
 
 #include <stdio.h>
 
-static std::string
-StartToString(const MixRampArray &a) noexcept
+std::string
+MixRampStartToString(const MixRampData &data) noexcept
 {
+	const auto &a = data.start;
 	std::string s;
 
 	MixRampItem last{};
@@ -32,9 +33,10 @@ StartToString(const MixRampArray &a) noexcept
 	return s;
 }
 
-static std::string
-EndToString(const MixRampArray &a, FloatDuration total_time) noexcept
+std::string
+MixRampEndToString(const MixRampData &data, FloatDuration total_time) noexcept
 {
+	const auto &a = data.end;
 	std::string s;
 
 	MixRampItem last{};
@@ -59,10 +61,10 @@ ToString(const MixRampData &mr, FloatDuration total_time,
 {
 	switch (direction) {
 	case MixRampDirection::START:
-		return StartToString(mr.start);
+		return MixRampStartToString(mr);
 
 	case MixRampDirection::END:
-		return EndToString(mr.end, total_time);
+		return MixRampEndToString(mr, total_time);
 	}
 
 	std::unreachable();
@@ -84,8 +86,8 @@ AnalyzeMixRamp(const MusicPipe &pipe, const AudioFormat &audio_format,
 
 	MixRampAnalyzer a;
 	do {
-		a.Process(FromBytesStrict<const ReplayGainAnalyzer::Frame>({chunk->data, chunk->length}));
-	} while ((chunk = chunk->next.get()) != nullptr);
+		a.Process(FromBytesStrict<const ReplayGainAnalyzer::Frame>(chunk->ReadData()));
+	} while ((chunk = chunk->next.load(std::memory_order_acquire)) != nullptr);
 
 	return ToString(a.GetResult(), a.GetTime(), direction);
 }
@@ -3,9 +3,12 @@
 
 #pragma once
 
+#include "Chrono.hxx"
+
 #include <string>
 
 struct AudioFormat;
+struct MixRampData;
 class MusicPipe;
 
 enum class MixRampDirection {
@@ -16,3 +19,19 @@ enum class MixRampDirection {
 std::string
 AnalyzeMixRamp(const MusicPipe &pipe, const AudioFormat &audio_format,
 	       MixRampDirection direction) noexcept;
+
+/**
+ * Format the "start" ramp in the syntax of the MIXRAMP_START tag.
+ */
+[[gnu::pure]]
+std::string
+MixRampStartToString(const MixRampData &data) noexcept;
+
+/**
+ * Format the "end" ramp in the syntax of the MIXRAMP_END tag.
+ *
+ * @param total_time the duration of the analyzed song
+ */
+[[gnu::pure]]
+std::string
+MixRampEndToString(const MixRampData &data, FloatDuration total_time) noexcept;
@@ -204,3 +204,30 @@ ToAlsaChannelOrder(PcmBuffer &buffer, std::span<const std::byte> src,
 
 	std::unreachable();
 }
+
+const uint8_t *
+GetAlsaChannelMap(unsigned channels) noexcept
+{
+	/* these tables must match the TwoPointers methods above */
+	static constexpr uint8_t alsa50[] = { 0, 1, 3, 4, 2 };
+	static constexpr uint8_t alsa51[] = { 0, 1, 4, 5, 2, 3 };
+	static constexpr uint8_t alsa70[] = { 0, 1, 5, 6, 2, 3, 4 };
+	static constexpr uint8_t alsa71[] = { 0, 1, 4, 5, 2, 3, 6, 7 };
+
+	switch (channels) {
+	case 5: // 5.0
+		return alsa50;
+
+	case 6: // 5.1
+		return alsa51;
+
+	case 7: // 7.0
+		return alsa70;
+
+	case 8: // 7.1
+		return alsa71;
+
+	default:
+		return nullptr;
+	}
+}
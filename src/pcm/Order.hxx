@@ -6,6 +6,7 @@
 
 #include "SampleFormat.hxx"
 
+#include <cstdint>
 #include <span>
 
 class PcmBuffer;
@@ -18,4 +19,15 @@ std::span<const std::byte>
 ToAlsaChannelOrder(PcmBuffer &buffer, std::span<const std::byte> src,
 		   SampleFormat sample_format, unsigned channels) noexcept;
 
+/**
+ * Describe the channel reordering done by ToAlsaChannelOrder() as a
+ * table: output channel i is copied from source channel map[i].
+ *
+ * @return a table with #channels entries, or nullptr if the channel
+ * order is not modified
+ */
+[[gnu::const]]
+const uint8_t *
+GetAlsaChannelMap(unsigned channels) noexcept;
+
 #endif
@@ -10,6 +10,8 @@
 #include "util/SpanCast.hxx"
 #include "util/TransformN.hxx"
 
+#include <algorithm> // for std::min()
+
 #include "Dither.cxx" // including the .cxx file to get inlined templates
 
 /**
@@ -28,9 +30,28 @@ struct PerSampleConvert : C {
 	}
 };
 
-struct Convert8To16
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S8,
-						  SampleFormat::S16>> {};
+template<SampleFormat SF, SampleFormat DF>
+struct PortableLeftShift
+	: PerSampleConvert<LeftShiftSampleConvert<SF, DF>> {};
+
+template<SampleFormat SF, SampleFormat DF>
+struct LeftShift : PortableLeftShift<SF, DF> {};
+
+template<SampleFormat SF, SampleFormat DF>
+struct PortableRightShift
+	: PerSampleConvert<RightShiftSampleConvert<SF, DF>> {};
+
+template<SampleFormat SF, SampleFormat DF>
+struct RightShift : PortableRightShift<SF, DF> {};
+
+template<SampleFormat F>
+struct PortableIntegerToFloat
+	: PerSampleConvert<IntegerToFloatSampleConvert<F>> {};
+
+template<SampleFormat F>
+struct IntegerToFloat : PortableIntegerToFloat<F> {};
+
+struct Convert8To16 : LeftShift<SampleFormat::S8, SampleFormat::S16> {};
 
 struct Convert24To16 {
 	using SrcTraits = SampleTraits<SampleFormat::S24_P32>;
@@ -99,6 +120,89 @@ struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
 
 #endif
 
+#ifdef __SSE2__
+#include "X86Convert.hxx"
+
+template<>
+struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
+	: GlueOptimizedConvert<X86Convert<SampleFormat::FLOAT, SampleFormat::S16>,
+			       PortableFloatToInteger<SampleFormat::S16>> {};
+
+template<>
+struct FloatToInteger<SampleFormat::S24_P32, SampleTraits<SampleFormat::S24_P32>>
+	: GlueOptimizedConvert<X86Convert<SampleFormat::FLOAT, SampleFormat::S24_P32>,
+			       PortableFloatToInteger<SampleFormat::S24_P32>> {};
+
+template<>
+struct FloatToInteger<SampleFormat::S32, SampleTraits<SampleFormat::S32>>
+	: GlueOptimizedConvert<X86Convert<SampleFormat::FLOAT, SampleFormat::S32>,
+			       PortableFloatToInteger<SampleFormat::S32>> {};
+
+template<>
+struct IntegerToFloat<SampleFormat::S16>
+	: GlueOptimizedConvert<X86Convert<SampleFormat::S16, SampleFormat::FLOAT>,
+			       PortableIntegerToFloat<SampleFormat::S16>> {};
+
+template<>
+struct IntegerToFloat<SampleFormat::S24_P32>
+	: GlueOptimizedConvert<X86Convert<SampleFormat::S24_P32, SampleFormat::FLOAT>,
+			       PortableIntegerToFloat<SampleFormat::S24_P32>> {};
+
+template<>
+struct IntegerToFloat<SampleFormat::S32>
+	: GlueOptimizedConvert<X86Convert<SampleFormat::S32, SampleFormat::FLOAT>,
+			       PortableIntegerToFloat<SampleFormat::S32>> {};
+
+template<>
+struct LeftShift<SampleFormat::S16, SampleFormat::S24_P32>
+	: GlueOptimizedConvert<X86Convert<SampleFormat::S16, SampleFormat::S24_P32>,
+			       PortableLeftShift<SampleFormat::S16, SampleFormat::S24_P32>> {};
+
+template<>
+struct LeftShift<SampleFormat::S16, SampleFormat::S32>
+	: GlueOptimizedConvert<X86Convert<SampleFormat::S16, SampleFormat::S32>,
+			       PortableLeftShift<SampleFormat::S16, SampleFormat::S32>> {};
+
+template<>
+struct LeftShift<SampleFormat::S24_P32, SampleFormat::S32>
+	: GlueOptimizedConvert<X86Convert<SampleFormat::S24_P32, SampleFormat::S32>,
+			       PortableLeftShift<SampleFormat::S24_P32, SampleFormat::S32>> {};
+
+template<>
+struct RightShift<SampleFormat::S32, SampleFormat::S24_P32>
+	: GlueOptimizedConvert<X86Convert<SampleFormat::S32, SampleFormat::S24_P32>,
+			       PortableRightShift<SampleFormat::S32, SampleFormat::S24_P32>> {};
+
+#endif
+
+/**
+ * Convert floating point samples to 24 bit and dither them down to
+ * 16 bit, in blocks which fit on the stack.
+ */
+struct ConvertFloatTo16Dither {
+	using SrcTraits = SampleTraits<SampleFormat::FLOAT>;
+	using DstTraits = SampleTraits<SampleFormat::S16>;
+
+	PcmDither &dither;
+
+	explicit ConvertFloatTo16Dither(PcmDither &_dither):dither(_dither) {}
+
+	void Convert(int16_t *out, const float *in, size_t n) {
+		static constexpr size_t BLOCK_SIZE = 256;
+		int32_t tmp[BLOCK_SIZE];
+
+		while (n > 0) {
+			const size_t m = std::min(n, BLOCK_SIZE);
+			FloatToInteger<SampleFormat::S24_P32>().Convert(tmp, in, m);
+			dither.Dither24To16(out, tmp, tmp + m);
+
+			out += m;
+			in += m;
+			n -= m;
+		}
+	}
+};
+
 template<class C>
 static std::span<const typename C::DstTraits::value_type>
 AllocateConvert(PcmBuffer &buffer, C convert,
@@ -174,13 +278,16 @@ pcm_convert_to_16(PcmBuffer &buffer, PcmDither &dither,
 	return {};
 }
 
-struct Convert8To24
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S8,
-						  SampleFormat::S24_P32>> {};
+std::span<const int16_t>
+pcm_dither_float_to_16(PcmBuffer &buffer, PcmDither &dither,
+		       std::span<const float> src) noexcept
+{
+	return AllocateConvert(buffer, ConvertFloatTo16Dither(dither), src);
+}
+
+struct Convert8To24 : LeftShift<SampleFormat::S8, SampleFormat::S24_P32> {};
 
-struct Convert16To24
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
-						  SampleFormat::S24_P32>> {};
+struct Convert16To24 : LeftShift<SampleFormat::S16, SampleFormat::S24_P32> {};
 
 static std::span<const int32_t>
 pcm_allocate_8_to_24(PcmBuffer &buffer, std::span<const int8_t> src)
@@ -194,9 +301,7 @@ pcm_allocate_16_to_24(PcmBuffer &buffer, std::span<const int16_t> src)
 	return AllocateConvert(buffer, Convert16To24(), src);
 }
 
-struct Convert32To24
-	: PerSampleConvert<RightShiftSampleConvert<SampleFormat::S32,
-						   SampleFormat::S24_P32>> {};
+struct Convert32To24 : RightShift<SampleFormat::S32, SampleFormat::S24_P32> {};
 
 static std::span<const int32_t>
 pcm_allocate_32_to_24(PcmBuffer &buffer, std::span<const int32_t> src)
@@ -242,17 +347,11 @@ pcm_convert_to_24(PcmBuffer &buffer,
 	return {};
 }
 
-struct Convert8To32
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S8,
-						  SampleFormat::S32>> {};
+struct Convert8To32 : LeftShift<SampleFormat::S8, SampleFormat::S32> {};
 
-struct Convert16To32
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
-						  SampleFormat::S32>> {};
+struct Convert16To32 : LeftShift<SampleFormat::S16, SampleFormat::S32> {};
 
-struct Convert24To32
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S24_P32,
-						  SampleFormat::S32>> {};
+struct Convert24To32 : LeftShift<SampleFormat::S24_P32, SampleFormat::S32> {};
 
 static std::span<const int32_t>
 pcm_allocate_8_to_32(PcmBuffer &buffer, std::span<const int8_t> src)
@@ -310,17 +409,13 @@ pcm_convert_to_32(PcmBuffer &buffer,
 	return {};
 }
 
-struct Convert8ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S8>> {};
+struct Convert8ToFloat : IntegerToFloat<SampleFormat::S8> {};
 
-struct Convert16ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S16>> {};
+struct Convert16ToFloat : IntegerToFloat<SampleFormat::S16> {};
 
-struct Convert24ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S24_P32>> {};
+struct Convert24ToFloat : IntegerToFloat<SampleFormat::S24_P32> {};
 
-struct Convert32ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S32>> {};
+struct Convert32ToFloat : IntegerToFloat<SampleFormat::S32> {};
 
 static std::span<const float>
 pcm_allocate_8_to_float(PcmBuffer &buffer, std::span<const int8_t> src)
@@ -26,6 +26,21 @@ std::span<const int16_t>
 pcm_convert_to_16(PcmBuffer &buffer, PcmDither &dither,
 		  SampleFormat src_format, std::span<const std::byte> src) noexcept;
 
+/**
+ * Converts floating point samples to 16 bit with dithering (unlike
+ * pcm_convert_to_16(), which rounds them).  This is used for the
+ * final quantization of a floating point pipeline.
+ *
+ * @param buffer a #PcmBuffer object
+ * @param dither a #PcmDither object
+ * @param src the source PCM buffer
+ * @return the destination buffer
+ */
+[[gnu::pure]]
+std::span<const int16_t>
+pcm_dither_float_to_16(PcmBuffer &buffer, PcmDither &dither,
+		       std::span<const float> src) noexcept;
+
 /**
  * Converts PCM samples to 24 bit (32 bit alignment).
  *
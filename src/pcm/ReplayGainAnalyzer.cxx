@@ -32,6 +32,11 @@
 #include <functional>
 #include <numeric>
 
+#ifdef __SSE2__
+#include "X86Cpu.hxx"
+#include <immintrin.h>
+#endif
+
 ReplayGainAnalyzer::ReplayGainAnalyzer() noexcept
 {
 }
@@ -39,12 +44,113 @@ ReplayGainAnalyzer::ReplayGainAnalyzer() noexcept
 /*
  * Find the largest absolute sample value.
  */
+#ifdef __SSE2__
+
+[[gnu::const]]
+static float
+HorizontalMax(__m128 v) noexcept
+{
+	v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+[[gnu::const]]
+static double
+HorizontalSum(__m128d v) noexcept
+{
+	return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+static std::size_t
+FindPeakSse2(const float *samples, std::size_t n, float &peak) noexcept
+{
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	__m128 max = _mm_set1_ps(peak);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		max = _mm_max_ps(max, _mm_andnot_ps(sign,
+						    _mm_loadu_ps(samples + i)));
+
+	peak = HorizontalMax(max);
+	return i;
+}
+
+[[gnu::target("avx2")]]
+static std::size_t
+FindPeakAvx2(const float *samples, std::size_t n, float &peak) noexcept
+{
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	__m256 max = _mm256_set1_ps(peak);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		max = _mm256_max_ps(max, _mm256_andnot_ps(sign,
+							  _mm256_loadu_ps(samples + i)));
+
+	peak = HorizontalMax(_mm_max_ps(_mm256_castps256_ps128(max),
+					_mm256_extractf128_ps(max, 1)));
+	return i;
+}
+
+/**
+ * Add the squares of all samples (converted to double) to #sum.
+ */
+static std::size_t
+SumSquaresSse2(const float *samples, std::size_t n, double &sum) noexcept
+{
+	__m128d a = _mm_set_sd(sum), b = _mm_setzero_pd();
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128 x = _mm_loadu_ps(samples + i);
+		const __m128d lo = _mm_cvtps_pd(x);
+		const __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(x, x));
+		a = _mm_add_pd(a, _mm_mul_pd(lo, lo));
+		b = _mm_add_pd(b, _mm_mul_pd(hi, hi));
+	}
+
+	sum = HorizontalSum(_mm_add_pd(a, b));
+	return i;
+}
+
+[[gnu::target("avx2")]]
+static std::size_t
+SumSquaresAvx2(const float *samples, std::size_t n, double &sum) noexcept
+{
+	__m256d a = _mm256_set_pd(0, 0, 0, sum), b = _mm256_setzero_pd();
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256d lo = _mm256_cvtps_pd(_mm_loadu_ps(samples + i));
+		const __m256d hi = _mm256_cvtps_pd(_mm_loadu_ps(samples + i + 4));
+		a = _mm256_add_pd(a, _mm256_mul_pd(lo, lo));
+		b = _mm256_add_pd(b, _mm256_mul_pd(hi, hi));
+	}
+
+	a = _mm256_add_pd(a, b);
+	sum = HorizontalSum(_mm_add_pd(_mm256_castpd256_pd128(a),
+				       _mm256_extractf128_pd(a, 1)));
+	return i;
+}
+
+#endif
+
 [[gnu::pure]] [[gnu::hot]]
 static float
 FindPeak(const float *samples, std::size_t n) noexcept
 {
 	float peak = 0.0;
 
+#ifdef __SSE2__
+	const std::size_t done = X86PcmIsAvx2Enabled()
+		? FindPeakAvx2(samples, n, peak)
+		: FindPeakSse2(samples, n, peak);
+	samples += done;
+	n -= done;
+#endif
+
 	while (n-- > 0) {
 		float value = std::fabs(*samples++);
 		if (value > peak)
@@ -77,11 +183,25 @@ SquareHypot(ReplayGainAnalyzer::Frame f) noexcept
 static double
 CalcStereoRMS(std::span<const ReplayGainAnalyzer::Frame> src) noexcept
 {
+	double sum = 1e-16;
+
+#ifdef __SSE2__
+	const float *samples = src.front().data();
+	const std::size_t n = src.size() * src.front().size();
+	const std::size_t done = X86PcmIsAvx2Enabled()
+		? SumSquaresAvx2(samples, n, sum)
+		: SumSquaresSse2(samples, n, sum);
+	assert(done % ReplayGainAnalyzer::CHANNELS == 0);
+	const auto rest = src.subspan(done / ReplayGainAnalyzer::CHANNELS);
+#else
+	const auto rest = src;
+#endif
+
 	/* proper C++17 */
-	double sum = std::transform_reduce(src.begin(), src.end(),
-					   1e-16,
-					   std::plus<double>{},
-					   SquareHypot);
+	sum = std::transform_reduce(rest.begin(), rest.end(),
+				    sum,
+				    std::plus<double>{},
+				    SquareHypot);
 
 	return 10 * std::log10(sum / src.size()) + 90.0 - 3.0;
 }
@@ -164,6 +284,41 @@ ApplyFilter(ReplayGainAnalyzer::Frame src, std::size_t i,
 	    const std::array<double, ORDER + 1> &coeff_a,
 	    const std::array<double, ORDER + 1> &coeff_b) noexcept
 {
+#ifdef __SSE2__
+	if constexpr (ReplayGainAnalyzer::CHANNELS == 2) {
+		/* filter both channels in one SSE2 register; this
+		   performs the same operations as the portable
+		   code below, therefore the result is the same */
+
+		const auto load = [](const ReplayGainAnalyzer::Frame &f){
+			return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)f.data())));
+		};
+
+		/* the portable operator*() converts the
+		   coefficients to float */
+		const auto coeff = [](double c){
+			return _mm_set1_pd(float(c));
+		};
+
+		hist_b[i] = src;
+		__m128d frame = _mm_mul_pd(load(src), coeff(coeff_b[0]));
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC unroll 100
+#endif
+		for (std::size_t j = 1; j <= ORDER; ++j)
+			frame = _mm_add_pd(frame,
+					   _mm_sub_pd(_mm_mul_pd(load(hist_b[i - j]),
+								 coeff(coeff_b[j])),
+						      _mm_mul_pd(load(hist_a[i - j]),
+								 coeff(coeff_a[j]))));
+
+		_mm_storel_epi64((__m128i *)hist_a[i].data(),
+				 _mm_castps_si128(_mm_cvtpd_ps(frame)));
+		return hist_a[i];
+	}
+#endif
+
 	ReplayGainAnalyzer::DoubleFrame frame = (hist_b[i] = src) * coeff_b[0];
 
 #if defined(__GNUC__) && !defined(__clang__)
@@ -284,6 +439,23 @@ FindHistogramPercentile95(const std::array<uint_least32_t, size> &histogram) noe
 	return i;
 }
 
+bool
+ReplayGainAnalyzer::IsDefined() const noexcept
+{
+	return std::any_of(histogram.begin(), histogram.end(),
+			   [](auto n){ return n > 0; });
+}
+
+void
+ReplayGainAnalyzer::Merge(const ReplayGainAnalyzer &other) noexcept
+{
+	std::transform(histogram.begin(), histogram.end(),
+		       other.histogram.begin(), histogram.begin(),
+		       std::plus<uint_least32_t>{});
+
+	peak = std::max(peak, other.peak);
+}
+
 float
 ReplayGainAnalyzer::GetGain() const noexcept
 {
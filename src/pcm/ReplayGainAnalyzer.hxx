@@ -117,6 +117,19 @@ public:
 		return peak;
 	}
 
+	/**
+	 * Has Process() been called at least once?
+	 */
+	[[gnu::pure]]
+	bool IsDefined() const noexcept;
+
+	/**
+	 * Add the loudness histogram and the peak of another
+	 * analyzer to this one.  This can be used to calculate the
+	 * album gain from the analyzers of all of its tracks.
+	 */
+	void Merge(const ReplayGainAnalyzer &other) noexcept;
+
 	[[gnu::pure]]
 	float GetGain() const noexcept;
 };
@@ -0,0 +1,343 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "SimdVolume.hxx"
+#include "Volume.hxx"
+#include "Traits.hxx"
+
+#include <cstdint>
+
+#ifdef __SSE2__
+#include "X86Cpu.hxx"
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/**
+ * The number of bits PcmVolumeConvert() shifts to the right when
+ * converting S16 to S24_P32.
+ */
+static constexpr int VOLUME_16_TO_24_SHIFT =
+	SampleTraits<SampleFormat::S16>::BITS + PCM_VOLUME_BITS -
+	SampleTraits<SampleFormat::S24_P32>::BITS;
+
+static_assert(VOLUME_16_TO_24_SHIFT > 0);
+
+#ifdef __SSE2__
+
+/*
+ * SSE2
+ *
+ */
+
+static std::size_t
+VolumeFloatSse2(float *dest, const float *src, std::size_t n,
+		float volume) noexcept
+{
+	const __m128 v = _mm_set1_ps(volume);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(dest + i, _mm_mul_ps(_mm_loadu_ps(src + i), v));
+	return i;
+}
+
+static std::size_t
+Volume16To24Sse2(int32_t *dest, const int16_t *src, std::size_t n,
+		 int volume) noexcept
+{
+	const __m128i v = _mm_set1_epi16(int16_t(volume));
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+
+		/* SSE2 has no 32 bit multiplication; combine the
+		   lower and upper halves of the 16 bit products */
+		const __m128i lo = _mm_mullo_epi16(x, v);
+		const __m128i hi = _mm_mulhi_epi16(x, v);
+
+		_mm_storeu_si128((__m128i *)(dest + i),
+				 _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi),
+						VOLUME_16_TO_24_SHIFT));
+		_mm_storeu_si128((__m128i *)(dest + i + 4),
+				 _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi),
+						VOLUME_16_TO_24_SHIFT));
+	}
+
+	return i;
+}
+
+static std::size_t
+AddVolumeFloatSse2(float *a, const float *b, std::size_t n,
+		   float volume1, float volume2) noexcept
+{
+	const __m128 v1 = _mm_set1_ps(volume1), v2 = _mm_set1_ps(volume2);
+
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(a + i,
+			      _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + i), v1),
+					 _mm_mul_ps(_mm_loadu_ps(b + i), v2)));
+	return i;
+}
+
+static std::size_t
+AddFloatSse2(float *a, const float *b, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(a + i, _mm_add_ps(_mm_loadu_ps(a + i),
+						_mm_loadu_ps(b + i)));
+	return i;
+}
+
+static std::size_t
+Add16Sse2(int16_t *a, const int16_t *b, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		const __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+		_mm_storeu_si128((__m128i *)(a + i), _mm_adds_epi16(x, y));
+	}
+
+	return i;
+}
+
+/*
+ * AVX2
+ *
+ */
+
+[[gnu::target("avx2")]]
+static std::size_t
+VolumeFloatAvx2(float *dest, const float *src, std::size_t n,
+		float volume) noexcept
+{
+	const __m256 v = _mm256_set1_ps(volume);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(dest + i,
+				 _mm256_mul_ps(_mm256_loadu_ps(src + i), v));
+	return i;
+}
+
+[[gnu::target("avx2")]]
+static std::size_t
+Volume16To24Avx2(int32_t *dest, const int16_t *src, std::size_t n,
+		 int volume) noexcept
+{
+	const __m256i v = _mm256_set1_epi32(volume);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x =
+			_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+		_mm256_storeu_si256((__m256i *)(dest + i),
+				    _mm256_srai_epi32(_mm256_mullo_epi32(x, v),
+						      VOLUME_16_TO_24_SHIFT));
+	}
+
+	return i;
+}
+
+[[gnu::target("avx2")]]
+static std::size_t
+AddVolumeFloatAvx2(float *a, const float *b, std::size_t n,
+		   float volume1, float volume2) noexcept
+{
+	const __m256 v1 = _mm256_set1_ps(volume1);
+	const __m256 v2 = _mm256_set1_ps(volume2);
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(a + i,
+				 _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(a + i), v1),
+					       _mm256_mul_ps(_mm256_loadu_ps(b + i), v2)));
+	return i;
+}
+
+[[gnu::target("avx2")]]
+static std::size_t
+AddFloatAvx2(float *a, const float *b, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(a + i, _mm256_add_ps(_mm256_loadu_ps(a + i),
+						      _mm256_loadu_ps(b + i)));
+	return i;
+}
+
+[[gnu::target("avx2")]]
+static std::size_t
+Add16Avx2(int16_t *a, const int16_t *b, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+		const __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+		_mm256_storeu_si256((__m256i *)(a + i), _mm256_adds_epi16(x, y));
+	}
+
+	return i;
+}
+
+std::size_t
+SimdVolumeFloat(float *dest, const float *src, std::size_t n,
+		float volume) noexcept
+{
+	return X86PcmIsAvx2Enabled()
+		? VolumeFloatAvx2(dest, src, n, volume)
+		: VolumeFloatSse2(dest, src, n, volume);
+}
+
+std::size_t
+SimdVolume16To24(int32_t *dest, const int16_t *src, std::size_t n,
+		 int volume) noexcept
+{
+	if (volume > INT16_MAX)
+		/* the SSE2 implementation uses 16 bit
+		   multiplication; this volume is unusual enough to
+		   not deserve an optimization */
+		return 0;
+
+	return X86PcmIsAvx2Enabled()
+		? Volume16To24Avx2(dest, src, n, volume)
+		: Volume16To24Sse2(dest, src, n, volume);
+}
+
+std::size_t
+SimdAddVolumeFloat(float *a, const float *b, std::size_t n,
+		   float volume1, float volume2) noexcept
+{
+	return X86PcmIsAvx2Enabled()
+		? AddVolumeFloatAvx2(a, b, n, volume1, volume2)
+		: AddVolumeFloatSse2(a, b, n, volume1, volume2);
+}
+
+std::size_t
+SimdAddFloat(float *a, const float *b, std::size_t n) noexcept
+{
+	return X86PcmIsAvx2Enabled()
+		? AddFloatAvx2(a, b, n)
+		: AddFloatSse2(a, b, n);
+}
+
+std::size_t
+SimdAdd16(int16_t *a, const int16_t *b, std::size_t n) noexcept
+{
+	return X86PcmIsAvx2Enabled()
+		? Add16Avx2(a, b, n)
+		: Add16Sse2(a, b, n);
+}
+
+#elif defined(__ARM_NEON)
+
+/*
+ * NEON
+ *
+ */
+
+std::size_t
+SimdVolumeFloat(float *dest, const float *src, std::size_t n,
+		float volume) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		vst1q_f32(dest + i, vmulq_n_f32(vld1q_f32(src + i), volume));
+	return i;
+}
+
+std::size_t
+SimdVolume16To24(int32_t *dest, const int16_t *src, std::size_t n,
+		 int volume) noexcept
+{
+	if (volume > INT16_MAX)
+		/* vmull_n_s16() needs a 16 bit factor; this volume
+		   is unusual enough to not deserve an
+		   optimization */
+		return 0;
+
+	const int16_t v = volume;
+
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const int16x8_t x = vld1q_s16(src + i);
+		const int32x4_t lo = vmull_n_s16(vget_low_s16(x), v);
+		const int32x4_t hi = vmull_n_s16(vget_high_s16(x), v);
+		vst1q_s32(dest + i, vshrq_n_s32(lo, VOLUME_16_TO_24_SHIFT));
+		vst1q_s32(dest + i + 4, vshrq_n_s32(hi, VOLUME_16_TO_24_SHIFT));
+	}
+
+	return i;
+}
+
+std::size_t
+SimdAddVolumeFloat(float *a, const float *b, std::size_t n,
+		   float volume1, float volume2) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		vst1q_f32(a + i,
+			  vaddq_f32(vmulq_n_f32(vld1q_f32(a + i), volume1),
+				    vmulq_n_f32(vld1q_f32(b + i), volume2)));
+	return i;
+}
+
+std::size_t
+SimdAddFloat(float *a, const float *b, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		vst1q_f32(a + i, vaddq_f32(vld1q_f32(a + i),
+					   vld1q_f32(b + i)));
+	return i;
+}
+
+std::size_t
+SimdAdd16(int16_t *a, const int16_t *b, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		vst1q_s16(a + i, vqaddq_s16(vld1q_s16(a + i),
+					    vld1q_s16(b + i)));
+	return i;
+}
+
+#else
+
+std::size_t
+SimdVolumeFloat(float *, const float *, std::size_t, float) noexcept
+{
+	return 0;
+}
+
+std::size_t
+SimdVolume16To24(int32_t *, const int16_t *, std::size_t, int) noexcept
+{
+	return 0;
+}
+
+std::size_t
+SimdAddVolumeFloat(float *, const float *, std::size_t,
+		   float, float) noexcept
+{
+	return 0;
+}
+
+std::size_t
+SimdAddFloat(float *, const float *, std::size_t) noexcept
+{
+	return 0;
+}
+
+std::size_t
+SimdAdd16(int16_t *, const int16_t *, std::size_t) noexcept
+{
+	return 0;
+}
+
+#endif
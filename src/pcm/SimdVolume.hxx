@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * SIMD kernels for PcmVolume and pcm_mix() (SSE2/AVX2 on x86, NEON
+ * on ARM).  Each function processes only a multiple of a
+ * CPU-specific block size and returns the number of samples it has
+ * processed; the caller is responsible for the rest.  On CPUs
+ * without a SIMD implementation, they do nothing and return 0.
+ *
+ * The results are the same as those of the portable
+ * implementations.  Only the conversions which do not need
+ * dithering are implemented here, because the noise shaping
+ * performed by #PcmDither depends on the previous sample.
+ */
+
+/**
+ * Multiply each sample with the given volume.
+ */
+std::size_t
+SimdVolumeFloat(float *dest, const float *src, std::size_t n,
+		float volume) noexcept;
+
+/**
+ * Apply the integer volume (see #PCM_VOLUME_1) to S16 samples and
+ * convert them to S24_P32.
+ */
+std::size_t
+SimdVolume16To24(int32_t *dest, const int16_t *src, std::size_t n,
+		 int volume) noexcept;
+
+/**
+ * Calculate "a * volume1 + b * volume2" and store the result in
+ * #a.
+ */
+std::size_t
+SimdAddVolumeFloat(float *a, const float *b, std::size_t n,
+		   float volume1, float volume2) noexcept;
+
+/**
+ * Calculate "a + b" and store the result in #a.
+ */
+std::size_t
+SimdAddFloat(float *a, const float *b, std::size_t n) noexcept;
+
+/**
+ * Calculate "a + b" (with saturation) and store the result in #a.
+ */
+std::size_t
+SimdAdd16(int16_t *a, const int16_t *b, std::size_t n) noexcept;
@@ -2,6 +2,8 @@
 // Copyright The Music Player Daemon Project
 
 #include "Volume.hxx"
+#include "SimdVolume.hxx"
+#include "PcmFormat.hxx"
 #include "Silence.hxx"
 #include "Traits.hxx"
 #include "lib/fmt/AudioFormatFormatter.hxx"
@@ -98,6 +100,11 @@ static void
 PcmVolumeChange16to32(int32_t *dest, const int16_t *src, size_t n,
 		      int volume) noexcept
 {
+	const size_t done = SimdVolume16To24(dest, src, n, volume);
+	dest += done;
+	src += done;
+	n -= done;
+
 	transform_n(src, n, dest,
 		    [volume](auto x){
 			    return PcmVolumeConvert<SampleFormat::S16,
@@ -127,16 +134,32 @@ static void
 pcm_volume_change_float(float *dest, const float *src, size_t n,
 			float volume) noexcept
 {
+	const size_t done = SimdVolumeFloat(dest, src, n, volume);
+	dest += done;
+	src += done;
+	n -= done;
+
 	transform_n(src, n, dest,
 		    [volume](float x){ return x * volume; });
 }
 
 SampleFormat
-PcmVolume::Open(SampleFormat _format, bool allow_convert)
+PcmVolume::Open(SampleFormat _format, bool allow_convert, bool _to_float)
 {
 	assert(format == SampleFormat::UNDEFINED);
 
 	convert = false;
+	to_float = false;
+
+	if (_to_float &&
+	    (_format == SampleFormat::S8 ||
+	     _format == SampleFormat::S16 ||
+	     _format == SampleFormat::S24_P32 ||
+	     _format == SampleFormat::S32)) {
+		format = _format;
+		to_float = true;
+		return SampleFormat::FLOAT;
+	}
 
 	switch (_format) {
 	case SampleFormat::UNDEFINED:
@@ -173,6 +196,30 @@ PcmVolume::Open(SampleFormat _format, bool allow_convert)
 std::span<const std::byte>
 PcmVolume::Apply(std::span<const std::byte> src) noexcept
 {
+	if (to_float) {
+		if (volume == 0) {
+			/* optimized special case: 0% volume =
+			   silence */
+			const std::size_t dest_size = src.size() /
+				sample_format_size(format) * sizeof(float);
+			void *data = buffer.Get(dest_size);
+			PcmSilence(std::span{(std::byte *)data, dest_size},
+				   SampleFormat::FLOAT);
+			return { (const std::byte *)data, dest_size };
+		}
+
+		/* convert with the (SIMD-optimized) converter and
+		   then apply the volume in-place */
+		const auto f = pcm_convert_to_float(buffer, format, src);
+		if (volume != PCM_VOLUME_1) {
+			auto *data = const_cast<float *>(f.data());
+			pcm_volume_change_float(data, data, f.size(),
+						pcm_volume_to_float(volume));
+		}
+
+		return std::as_bytes(f);
+	}
+
 	if (volume == PCM_VOLUME_1 && !convert)
 		return src;
 
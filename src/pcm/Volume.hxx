@@ -54,6 +54,12 @@ class PcmVolume {
 	 */
 	bool convert;
 
+	/**
+	 * Are we converting integer samples to floating point?  This
+	 * is set by Open().
+	 */
+	bool to_float;
+
 	unsigned volume;
 
 	PcmBuffer buffer;
@@ -88,9 +94,13 @@ public:
 	 * @param format the input sample format
 	 * @param allow_convert allow the class to convert to a
 	 * different #SampleFormat to preserve quality?
+	 * @param to_float convert integer samples to
+	 * #SampleFormat::FLOAT (in the same pass which applies the
+	 * volume), so later stages don't need to quantize again
 	 * @return the output sample format
 	 */
-	SampleFormat Open(SampleFormat format, bool allow_convert);
+	SampleFormat Open(SampleFormat format, bool allow_convert,
+			  bool to_float=false);
 
 	/**
 	 * Closes the object.  After that, you may call Open() again.
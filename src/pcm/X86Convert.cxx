@@ -0,0 +1,427 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "X86Convert.hxx"
+#include "X86Cpu.hxx"
+#include "FloatConvert.hxx"
+
+#include <immintrin.h>
+
+template<SampleFormat F>
+static constexpr float float_factor =
+	FloatToIntegerSampleConvert<F>::factor;
+
+template<SampleFormat F>
+static constexpr float float_min = SampleTraits<F>::MIN;
+
+template<SampleFormat F>
+static constexpr float float_max = SampleTraits<F>::MAX;
+
+/* "2^31" is the first value which does not fit into a signed 32 bit
+   integer; "float(MAX)" would round to it */
+static constexpr float s32_overflow = float_factor<SampleFormat::S32>;
+
+/*
+ * SSE2
+ *
+ */
+
+/**
+ * Multiply with the factor and clamp to the given range before
+ * truncating to integer, which gives the same result as
+ * FloatToIntegerSampleConvert, which truncates before clamping.
+ */
+static inline __m128i
+FloatToIntegerSse2(__m128 x, __m128 factor, __m128 min, __m128 max) noexcept
+{
+	x = _mm_mul_ps(x, factor);
+	x = _mm_min_ps(_mm_max_ps(x, min), max);
+	return _mm_cvttps_epi32(x);
+}
+
+/**
+ * Like FloatToIntegerSse2(), but for #SampleFormat::S32, whose
+ * maximum cannot be represented as float.  Instead, values which
+ * overflow are fixed up: _mm_cvttps_epi32() returns 0x80000000 for
+ * them, which is inverted to 0x7fffffff.  Negative overflows are
+ * already clamped to 0x80000000 by _mm_cvttps_epi32().
+ */
+static inline __m128i
+FloatToS32Sse2(__m128 x) noexcept
+{
+	x = _mm_mul_ps(x, _mm_set1_ps(float_factor<SampleFormat::S32>));
+	const __m128 overflow = _mm_cmpge_ps(x, _mm_set1_ps(s32_overflow));
+	return _mm_xor_si128(_mm_cvttps_epi32(x), _mm_castps_si128(overflow));
+}
+
+/**
+ * Sign-extend the lower four 16 bit integers to 32 bit.
+ */
+static inline __m128i
+Extend16LoSse2(__m128i x) noexcept
+{
+	return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+}
+
+/**
+ * Sign-extend the upper four 16 bit integers to 32 bit.
+ */
+static inline __m128i
+Extend16HiSse2(__m128i x) noexcept
+{
+	return _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+}
+
+static void
+FloatTo16Sse2(int16_t *dst, const float *src, std::size_t n_blocks) noexcept
+{
+	constexpr auto F = SampleFormat::S16;
+	const __m128 factor = _mm_set1_ps(float_factor<F>);
+	const __m128 min = _mm_set1_ps(float_min<F>);
+	const __m128 max = _mm_set1_ps(float_max<F>);
+
+	for (std::size_t i = 0; i < n_blocks * 2; ++i, src += 8, dst += 8) {
+		const __m128i a = FloatToIntegerSse2(_mm_loadu_ps(src),
+						     factor, min, max);
+		const __m128i b = FloatToIntegerSse2(_mm_loadu_ps(src + 4),
+						     factor, min, max);
+
+		/* the values have already been clamped, so the
+		   saturation doesn't change anything */
+		_mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(a, b));
+	}
+}
+
+static void
+FloatTo24Sse2(int32_t *dst, const float *src, std::size_t n_blocks) noexcept
+{
+	constexpr auto F = SampleFormat::S24_P32;
+	const __m128 factor = _mm_set1_ps(float_factor<F>);
+	const __m128 min = _mm_set1_ps(float_min<F>);
+	const __m128 max = _mm_set1_ps(float_max<F>);
+
+	for (std::size_t i = 0; i < n_blocks * 4; ++i, src += 4, dst += 4)
+		_mm_storeu_si128((__m128i *)dst,
+				 FloatToIntegerSse2(_mm_loadu_ps(src),
+						    factor, min, max));
+}
+
+static void
+FloatTo32Sse2(int32_t *dst, const float *src, std::size_t n_blocks) noexcept
+{
+	for (std::size_t i = 0; i < n_blocks * 4; ++i, src += 4, dst += 4)
+		_mm_storeu_si128((__m128i *)dst,
+				 FloatToS32Sse2(_mm_loadu_ps(src)));
+}
+
+static void
+S16ToFloatSse2(float *dst, const int16_t *src, std::size_t n_blocks) noexcept
+{
+	const __m128 factor =
+		_mm_set1_ps(IntegerToFloatSampleConvert<SampleFormat::S16>::factor);
+
+	for (std::size_t i = 0; i < n_blocks * 2; ++i, src += 8, dst += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(Extend16LoSse2(x)),
+					      factor));
+		_mm_storeu_ps(dst + 4,
+			      _mm_mul_ps(_mm_cvtepi32_ps(Extend16HiSse2(x)),
+					 factor));
+	}
+}
+
+template<SampleFormat F>
+static void
+S32ToFloatSse2(float *dst, const int32_t *src, std::size_t n_blocks) noexcept
+{
+	const __m128 factor =
+		_mm_set1_ps(IntegerToFloatSampleConvert<F>::factor);
+
+	for (std::size_t i = 0; i < n_blocks * 4; ++i, src += 4, dst += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(x), factor));
+	}
+}
+
+template<int shift>
+static void
+S16ToS32Sse2(int32_t *dst, const int16_t *src, std::size_t n_blocks) noexcept
+{
+	for (std::size_t i = 0; i < n_blocks * 2; ++i, src += 8, dst += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_si128((__m128i *)dst,
+				 _mm_slli_epi32(Extend16LoSse2(x), shift));
+		_mm_storeu_si128((__m128i *)(dst + 4),
+				 _mm_slli_epi32(Extend16HiSse2(x), shift));
+	}
+}
+
+static void
+S24ToS32Sse2(int32_t *dst, const int32_t *src, std::size_t n_blocks) noexcept
+{
+	for (std::size_t i = 0; i < n_blocks * 4; ++i, src += 4, dst += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_si128((__m128i *)dst, _mm_slli_epi32(x, 8));
+	}
+}
+
+static void
+S32ToS24Sse2(int32_t *dst, const int32_t *src, std::size_t n_blocks) noexcept
+{
+	for (std::size_t i = 0; i < n_blocks * 4; ++i, src += 4, dst += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_si128((__m128i *)dst, _mm_srai_epi32(x, 8));
+	}
+}
+
+/*
+ * AVX2
+ *
+ */
+
+[[gnu::target("avx2")]]
+static inline __m256i
+FloatToIntegerAvx2(__m256 x, __m256 factor, __m256 min, __m256 max) noexcept
+{
+	x = _mm256_mul_ps(x, factor);
+	x = _mm256_min_ps(_mm256_max_ps(x, min), max);
+	return _mm256_cvttps_epi32(x);
+}
+
+[[gnu::target("avx2")]]
+static inline __m256i
+FloatToS32Avx2(__m256 x) noexcept
+{
+	x = _mm256_mul_ps(x, _mm256_set1_ps(float_factor<SampleFormat::S32>));
+	const __m256 overflow = _mm256_cmp_ps(x, _mm256_set1_ps(s32_overflow),
+					      _CMP_GE_OQ);
+	return _mm256_xor_si256(_mm256_cvttps_epi32(x),
+				_mm256_castps_si256(overflow));
+}
+
+/**
+ * Load eight 16 bit integers and sign-extend them to 32 bit.
+ */
+[[gnu::target("avx2")]]
+static inline __m256i
+Load16Avx2(const int16_t *src) noexcept
+{
+	return _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)src));
+}
+
+[[gnu::target("avx2")]]
+static void
+FloatTo16Avx2(int16_t *dst, const float *src, std::size_t n_blocks) noexcept
+{
+	constexpr auto F = SampleFormat::S16;
+	const __m256 factor = _mm256_set1_ps(float_factor<F>);
+	const __m256 min = _mm256_set1_ps(float_min<F>);
+	const __m256 max = _mm256_set1_ps(float_max<F>);
+
+	for (std::size_t i = 0; i < n_blocks; ++i, src += 16, dst += 16) {
+		const __m256i a = FloatToIntegerAvx2(_mm256_loadu_ps(src),
+						     factor, min, max);
+		const __m256i b = FloatToIntegerAvx2(_mm256_loadu_ps(src + 8),
+						     factor, min, max);
+
+		/* _mm256_packs_epi32() works on each 128 bit lane
+		   separately; the permutation restores the order */
+		const __m256i packed =
+			_mm256_permute4x64_epi64(_mm256_packs_epi32(a, b),
+						 0xd8);
+		_mm256_storeu_si256((__m256i *)dst, packed);
+	}
+}
+
+[[gnu::target("avx2")]]
+static void
+FloatTo24Avx2(int32_t *dst, const float *src, std::size_t n_blocks) noexcept
+{
+	constexpr auto F = SampleFormat::S24_P32;
+	const __m256 factor = _mm256_set1_ps(float_factor<F>);
+	const __m256 min = _mm256_set1_ps(float_min<F>);
+	const __m256 max = _mm256_set1_ps(float_max<F>);
+
+	for (std::size_t i = 0; i < n_blocks * 2; ++i, src += 8, dst += 8)
+		_mm256_storeu_si256((__m256i *)dst,
+				    FloatToIntegerAvx2(_mm256_loadu_ps(src),
+						       factor, min, max));
+}
+
+[[gnu::target("avx2")]]
+static void
+FloatTo32Avx2(int32_t *dst, const float *src, std::size_t n_blocks) noexcept
+{
+	for (std::size_t i = 0; i < n_blocks * 2; ++i, src += 8, dst += 8)
+		_mm256_storeu_si256((__m256i *)dst,
+				    FloatToS32Avx2(_mm256_loadu_ps(src)));
+}
+
+[[gnu::target("avx2")]]
+static void
+S16ToFloatAvx2(float *dst, const int16_t *src, std::size_t n_blocks) noexcept
+{
+	const __m256 factor =
+		_mm256_set1_ps(IntegerToFloatSampleConvert<SampleFormat::S16>::factor);
+
+	for (std::size_t i = 0; i < n_blocks * 2; ++i, src += 8, dst += 8)
+		_mm256_storeu_ps(dst,
+				 _mm256_mul_ps(_mm256_cvtepi32_ps(Load16Avx2(src)),
+					       factor));
+}
+
+template<SampleFormat F>
+[[gnu::target("avx2")]]
+static void
+S32ToFloatAvx2(float *dst, const int32_t *src, std::size_t n_blocks) noexcept
+{
+	const __m256 factor =
+		_mm256_set1_ps(IntegerToFloatSampleConvert<F>::factor);
+
+	for (std::size_t i = 0; i < n_blocks * 2; ++i, src += 8, dst += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)src);
+		_mm256_storeu_ps(dst, _mm256_mul_ps(_mm256_cvtepi32_ps(x),
+						    factor));
+	}
+}
+
+template<int shift>
+[[gnu::target("avx2")]]
+static void
+S16ToS32Avx2(int32_t *dst, const int16_t *src, std::size_t n_blocks) noexcept
+{
+	for (std::size_t i = 0; i < n_blocks * 2; ++i, src += 8, dst += 8)
+		_mm256_storeu_si256((__m256i *)dst,
+				    _mm256_slli_epi32(Load16Avx2(src), shift));
+}
+
+[[gnu::target("avx2")]]
+static void
+S24ToS32Avx2(int32_t *dst, const int32_t *src, std::size_t n_blocks) noexcept
+{
+	for (std::size_t i = 0; i < n_blocks * 2; ++i, src += 8, dst += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)src);
+		_mm256_storeu_si256((__m256i *)dst, _mm256_slli_epi32(x, 8));
+	}
+}
+
+[[gnu::target("avx2")]]
+static void
+S32ToS24Avx2(int32_t *dst, const int32_t *src, std::size_t n_blocks) noexcept
+{
+	for (std::size_t i = 0; i < n_blocks * 2; ++i, src += 8, dst += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)src);
+		_mm256_storeu_si256((__m256i *)dst, _mm256_srai_epi32(x, 8));
+	}
+}
+
+/*
+ * dispatch
+ *
+ */
+
+template<typename D, typename S>
+static inline void
+Dispatch(void (*sse2)(D *, const S *, std::size_t),
+	 void (*avx2)(D *, const S *, std::size_t),
+	 D *dst, const S *src, std::size_t n_blocks) noexcept
+{
+	if (X86PcmIsAvx2Enabled())
+		avx2(dst, src, n_blocks);
+	else
+		sse2(dst, src, n_blocks);
+}
+
+template<>
+void
+X86Convert<SampleFormat::FLOAT, SampleFormat::S16>::Convert(int16_t *dst,
+							    const float *src,
+							    std::size_t n) const noexcept
+{
+	Dispatch(FloatTo16Sse2, FloatTo16Avx2, dst, src, n / BLOCK_SIZE);
+}
+
+template<>
+void
+X86Convert<SampleFormat::FLOAT, SampleFormat::S24_P32>::Convert(int32_t *dst,
+								const float *src,
+								std::size_t n) const noexcept
+{
+	Dispatch(FloatTo24Sse2, FloatTo24Avx2, dst, src, n / BLOCK_SIZE);
+}
+
+template<>
+void
+X86Convert<SampleFormat::FLOAT, SampleFormat::S32>::Convert(int32_t *dst,
+							    const float *src,
+							    std::size_t n) const noexcept
+{
+	Dispatch(FloatTo32Sse2, FloatTo32Avx2, dst, src, n / BLOCK_SIZE);
+}
+
+template<>
+void
+X86Convert<SampleFormat::S16, SampleFormat::FLOAT>::Convert(float *dst,
+							    const int16_t *src,
+							    std::size_t n) const noexcept
+{
+	Dispatch(S16ToFloatSse2, S16ToFloatAvx2, dst, src, n / BLOCK_SIZE);
+}
+
+template<>
+void
+X86Convert<SampleFormat::S24_P32, SampleFormat::FLOAT>::Convert(float *dst,
+								const int32_t *src,
+								std::size_t n) const noexcept
+{
+	Dispatch(S32ToFloatSse2<SampleFormat::S24_P32>,
+		 S32ToFloatAvx2<SampleFormat::S24_P32>,
+		 dst, src, n / BLOCK_SIZE);
+}
+
+template<>
+void
+X86Convert<SampleFormat::S32, SampleFormat::FLOAT>::Convert(float *dst,
+							    const int32_t *src,
+							    std::size_t n) const noexcept
+{
+	Dispatch(S32ToFloatSse2<SampleFormat::S32>,
+		 S32ToFloatAvx2<SampleFormat::S32>,
+		 dst, src, n / BLOCK_SIZE);
+}
+
+template<>
+void
+X86Convert<SampleFormat::S16, SampleFormat::S24_P32>::Convert(int32_t *dst,
+							      const int16_t *src,
+							      std::size_t n) const noexcept
+{
+	Dispatch(S16ToS32Sse2<8>, S16ToS32Avx2<8>, dst, src, n / BLOCK_SIZE);
+}
+
+template<>
+void
+X86Convert<SampleFormat::S16, SampleFormat::S32>::Convert(int32_t *dst,
+							  const int16_t *src,
+							  std::size_t n) const noexcept
+{
+	Dispatch(S16ToS32Sse2<16>, S16ToS32Avx2<16>, dst, src, n / BLOCK_SIZE);
+}
+
+template<>
+void
+X86Convert<SampleFormat::S24_P32, SampleFormat::S32>::Convert(int32_t *dst,
+							      const int32_t *src,
+							      std::size_t n) const noexcept
+{
+	Dispatch(S24ToS32Sse2, S24ToS32Avx2, dst, src, n / BLOCK_SIZE);
+}
+
+template<>
+void
+X86Convert<SampleFormat::S32, SampleFormat::S24_P32>::Convert(int32_t *dst,
+							      const int32_t *src,
+							      std::size_t n) const noexcept
+{
+	Dispatch(S32ToS24Sse2, S32ToS24Avx2, dst, src, n / BLOCK_SIZE);
+}
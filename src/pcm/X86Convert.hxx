@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Traits.hxx"
+
+#include <cstddef>
+
+/*
+ * Sample format converters for x86 CPUs using SSE2 (which is always
+ * available on x86-64).  On CPUs which support AVX2, the AVX2
+ * implementation is selected at runtime (see X86Cpu.hxx).
+ *
+ * The results are bit-exact with the portable implementations in
+ * FloatConvert.hxx and ShiftConvert.hxx (for finite floating point
+ * samples).
+ */
+
+/**
+ * Converts only full blocks of #BLOCK_SIZE samples; use
+ * GlueOptimizedConvert to convert the rest with a portable
+ * implementation.
+ */
+template<SampleFormat SF, SampleFormat DF>
+struct X86Convert {
+	using SrcTraits = SampleTraits<SF>;
+	using DstTraits = SampleTraits<DF>;
+
+	static constexpr std::size_t BLOCK_SIZE = 16;
+
+	void Convert(typename DstTraits::pointer dst,
+		     typename SrcTraits::const_pointer src,
+		     std::size_t n) const noexcept;
+};
+
+template<>
+void
+X86Convert<SampleFormat::FLOAT, SampleFormat::S16>::Convert(int16_t *dst,
+							    const float *src,
+							    std::size_t n) const noexcept;
+
+template<>
+void
+X86Convert<SampleFormat::FLOAT, SampleFormat::S24_P32>::Convert(int32_t *dst,
+								const float *src,
+								std::size_t n) const noexcept;
+
+template<>
+void
+X86Convert<SampleFormat::FLOAT, SampleFormat::S32>::Convert(int32_t *dst,
+							    const float *src,
+							    std::size_t n) const noexcept;
+
+template<>
+void
+X86Convert<SampleFormat::S16, SampleFormat::FLOAT>::Convert(float *dst,
+							    const int16_t *src,
+							    std::size_t n) const noexcept;
+
+template<>
+void
+X86Convert<SampleFormat::S24_P32, SampleFormat::FLOAT>::Convert(float *dst,
+								const int32_t *src,
+								std::size_t n) const noexcept;
+
+template<>
+void
+X86Convert<SampleFormat::S32, SampleFormat::FLOAT>::Convert(float *dst,
+							    const int32_t *src,
+							    std::size_t n) const noexcept;
+
+template<>
+void
+X86Convert<SampleFormat::S16, SampleFormat::S24_P32>::Convert(int32_t *dst,
+							      const int16_t *src,
+							      std::size_t n) const noexcept;
+
+template<>
+void
+X86Convert<SampleFormat::S16, SampleFormat::S32>::Convert(int32_t *dst,
+							  const int16_t *src,
+							  std::size_t n) const noexcept;
+
+template<>
+void
+X86Convert<SampleFormat::S24_P32, SampleFormat::S32>::Convert(int32_t *dst,
+							      const int32_t *src,
+							      std::size_t n) const noexcept;
+
+template<>
+void
+X86Convert<SampleFormat::S32, SampleFormat::S24_P32>::Convert(int32_t *dst,
+							      const int32_t *src,
+							      std::size_t n) const noexcept;
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "X86Cpu.hxx"
+
+static bool
+DetectAvx2() noexcept
+{
+	/* this may run before the libgcc constructor which
+	   initializes the CPU model */
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+
+static const bool have_avx2 = DetectAvx2();
+static bool use_avx2 = have_avx2;
+
+bool
+X86PcmIsAvx2Enabled() noexcept
+{
+	return use_avx2;
+}
+
+void
+X86PcmSetAvx2(bool enable) noexcept
+{
+	use_avx2 = enable && have_avx2;
+}
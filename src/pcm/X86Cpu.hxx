@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+/*
+ * Runtime selection of the x86 SIMD implementations.  SSE2 is
+ * always available on x86-64; AVX2 is used if the CPU supports it.
+ */
+
+/**
+ * Shall the AVX2 implementations be used?
+ */
+[[gnu::pure]]
+bool
+X86PcmIsAvx2Enabled() noexcept;
+
+/**
+ * Enable or disable the AVX2 implementations.  They cannot be
+ * enabled if the CPU does not support AVX2.  This is only meant to
+ * be used by unit tests and benchmarks.
+ */
+void
+X86PcmSetAvx2(bool enable) noexcept;
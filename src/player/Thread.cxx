@@ -32,6 +32,7 @@
 #include "tag/Tag.hxx"
 #include "util/Domain.hxx"
 #include "thread/Name.hxx"
+#include "thread/Stats.hxx"
 #include "thread/ScopeUnlock.hxx"
 #include "Log.hxx"
 
@@ -74,16 +75,6 @@ class Player {
 	 */
 	unsigned buffer_before_play;
 
-	/**
-	 * If the decoder pipe gets consumed below this threshold,
-	 * it's time to wake up the decoder.
-	 *
-	 * It is calculated in a way which should prevent a wakeup
-	 * after each single consumed chunk; it is more efficient to
-	 * make the decoder decode a larger block at a time.
-	 */
-	const unsigned decoder_wakeup_threshold;
-
 	/**
 	 * Are we waiting for #buffer_before_play?
 	 */
@@ -180,8 +171,7 @@ class Player {
 public:
 	Player(PlayerControl &_pc, DecoderControl &_dc,
 	       MusicBuffer &_buffer) noexcept
-		:pc(_pc), dc(_dc), buffer(_buffer),
-		 decoder_wakeup_threshold(buffer.GetSize() * 3 / 4)
+		:pc(_pc), dc(_dc), buffer(_buffer)
 	{
 	}
 
@@ -509,9 +499,10 @@ Player::MixRampScannerReady() noexcept
 	if (dc.GetMixRampStart() == nullptr) {
 		const std::size_t want_pipe_bytes =
 			dc.out_audio_format.TimeToSize(std::chrono::seconds{20});
+		const std::size_t chunk_capacity = buffer.GetChunkCapacity();
 		const std::size_t want_pipe_chunks =
-			std::min((want_pipe_bytes + sizeof(MusicChunk::data) - 1)
-				 / sizeof(MusicChunk::data),
+			std::min((want_pipe_bytes + chunk_capacity - 1)
+				 / chunk_capacity,
 				 buffer.GetSize() / std::size_t{3});
 
 		if (dc.pipe->GetSize() < want_pipe_chunks) {
@@ -593,11 +584,14 @@ Player::CheckDecoderStartup(std::unique_lock<Mutex> &lock) noexcept
 		play_audio_format = dc.out_audio_format;
 		decoder_starting = false;
 
+		/* the decoder has chosen the chunk size for this
+		   audio format (see MusicBuffer::Adapt()) */
+		const size_t chunk_capacity = buffer.GetChunkCapacity();
 		const size_t buffer_before_play_size =
 			play_audio_format.TimeToSize(buffer_before_play_duration);
 		buffer_before_play =
-			(buffer_before_play_size + sizeof(MusicChunk::data) - 1)
-			/ sizeof(MusicChunk::data);
+			(buffer_before_play_size + chunk_capacity - 1)
+			/ chunk_capacity;
 
 		pc.listener.OnPlayerStateChanged();
 
@@ -893,6 +887,7 @@ Player::CheckCrossFade() noexcept
 					dc.GetMixRampStart(),
 					dc.GetMixRampPreviousEnd(),
 					play_audio_format,
+					buffer.GetChunkCapacity(),
 					buffer.GetSize() -
 					buffer_before_play);
 	if (cross_fade_chunks > 0)
@@ -1067,6 +1062,7 @@ Player::PlayNextChunk() noexcept
 	/* this formula should prevent that the decoder gets woken up
 	   with each chunk; it is more efficient to make it decode a
 	   larger block at a time */
+	const unsigned decoder_wakeup_threshold = buffer.GetSize() * 3 / 4;
 	if (!dc.IsIdle() && dc.pipe->GetSize() <= decoder_wakeup_threshold) {
 		if (!decoder_woken) {
 			decoder_woken = true;
@@ -1126,6 +1122,8 @@ Player::Run() noexcept
 	pc.CommandFinished();
 
 	while (ProcessCommand(lock)) {
+		ThreadStats::UpdateCurrent();
+
 		if (decoder_starting) {
 			/* wait until the decoder is initialized completely */
 
@@ -1259,6 +1257,7 @@ void
 PlayerControl::RunThread() noexcept
 try {
 	SetThreadName("player");
+	ThreadStats thread_stats{"player"};
 
 	DecoderControl dc(mutex, cond,
 			  input_cache,
@@ -1266,7 +1265,7 @@ try {
 			  config.replay_gain);
 	dc.StartThread();
 
-	MusicBuffer buffer{config.buffer_chunks};
+	MusicBuffer buffer{config.buffer_size, config.chunk_time};
 
 	std::unique_lock lock{mutex};
 
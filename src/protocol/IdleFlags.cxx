@@ -7,7 +7,9 @@
  */
 
 #include "protocol/IdleFlags.hxx"
+#include "protocol/ArgParser.hxx"
 #include "util/ASCII.hxx"
+#include "util/StringAPI.hxx"
 
 #include <cassert>
 
@@ -49,3 +51,18 @@ idle_parse_name(const char *name) noexcept
 
 	return 0;
 }
+
+std::chrono::milliseconds
+idle_parse_debounce(std::span<const char *const> &args)
+{
+	if (args.size() < 2 || !StringIsEqual(args[args.size() - 2], "debounce"))
+		return std::chrono::milliseconds::zero();
+
+	const std::chrono::milliseconds debounce{
+		ParseCommandArgUnsigned(args.back(),
+					IDLE_MAX_DEBOUNCE.count()),
+	};
+
+	args = args.first(args.size() - 2);
+	return debounce;
+}
@@ -9,6 +9,9 @@
 #ifndef MPD_IDLE_FLAGS_HXX
 #define MPD_IDLE_FLAGS_HXX
 
+#include <chrono>
+#include <span>
+
 /** song database has been updated*/
 static constexpr unsigned IDLE_DATABASE = 0x1;
 
@@ -67,4 +70,21 @@ idle_get_names() noexcept;
 unsigned
 idle_parse_name(const char *name) noexcept;
 
+/**
+ * The maximum value of the "debounce" option of the "idle" command.
+ */
+static constexpr std::chrono::milliseconds IDLE_MAX_DEBOUNCE{60000};
+
+/**
+ * Parse the optional "debounce MILLISECONDS" at the end of the
+ * arguments of the "idle" command and remove it from the span.
+ *
+ * Throws #ProtocolError if the value is malformed or larger than
+ * #IDLE_MAX_DEBOUNCE.
+ *
+ * @return the duration, or zero if the option was not specified
+ */
+std::chrono::milliseconds
+idle_parse_debounce(std::span<const char *const> &args);
+
 #endif
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "tag/ReplayGainInfo.hxx"
+#include "tag/MixRampInfo.hxx"
+
+/**
+ * ReplayGain and MixRamp values which were calculated by the
+ * database update (see option "update_analysis") for a song file
+ * which does not have the corresponding tags.
+ *
+ * The existence of this object means that the song has been
+ * analyzed; if the file has its own ReplayGain and MixRamp tags,
+ * then all attributes are undefined.
+ */
+struct SongAnalysis {
+	ReplayGainInfo replay_gain = ReplayGainInfo::Undefined();
+
+	MixRampInfo mix_ramp;
+};
@@ -3,6 +3,7 @@
 
 #include "song/DetachedSong.hxx"
 #include "song/LightSong.hxx"
+#include "song/Analysis.hxx"
 #include "util/UriExtract.hxx"
 #include "fs/Traits.hxx"
 
@@ -14,7 +15,10 @@ DetachedSong::DetachedSong(const LightSong &other) noexcept
 	 added(other.added),
 	 start_time(other.start_time),
 	 end_time(other.end_time),
-	 audio_format(other.audio_format) {}
+	 audio_format(other.audio_format),
+	 analysis(other.analysis != nullptr
+		  ? std::make_shared<const SongAnalysis>(*other.analysis)
+		  : nullptr) {}
 
 DetachedSong::operator LightSong() const noexcept
 {
@@ -25,6 +29,7 @@ DetachedSong::operator LightSong() const noexcept
 	result.added = added;
 	result.start_time = start_time;
 	result.end_time = end_time;
+	result.analysis = analysis.get();
 	return result;
 }
 
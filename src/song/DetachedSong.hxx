@@ -10,10 +10,12 @@
 #include "time/ChronoUtil.hxx"
 
 #include <chrono>
+#include <memory>
 #include <string>
 #include <utility>
 
 struct LightSong;
+struct SongAnalysis;
 class Storage;
 class Path;
 
@@ -83,6 +85,12 @@ class DetachedSong {
 	 */
 	AudioFormat audio_format = AudioFormat::Undefined();
 
+	/**
+	 * ReplayGain and MixRamp values calculated by the database
+	 * update; nullptr if the song has not been analyzed.
+	 */
+	std::shared_ptr<const SongAnalysis> analysis;
+
 public:
 	explicit DetachedSong(const char *_uri) noexcept
 		:uri(_uri) {}
@@ -257,6 +265,18 @@ public:
 		audio_format = src;
 	}
 
+	const SongAnalysis *GetAnalysis() const noexcept {
+		return analysis.get();
+	}
+
+	std::shared_ptr<const SongAnalysis> &WritableAnalysis() noexcept {
+		return analysis;
+	}
+
+	void SetAnalysis(std::shared_ptr<const SongAnalysis> &&src) noexcept {
+		analysis = std::move(src);
+	}
+
 	/**
 	 * Update the #tag and #mtime.
 	 *
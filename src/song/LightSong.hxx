@@ -11,6 +11,7 @@
 #include <chrono>
 
 struct Tag;
+struct SongAnalysis;
 
 /**
  * A reference to a song file.  Unlike the other "Song" classes in the
@@ -74,6 +75,12 @@ struct LightSong {
 	 */
 	AudioFormat audio_format = AudioFormat::Undefined();
 
+	/**
+	 * ReplayGain and MixRamp values calculated by the database
+	 * update; nullptr if the song has not been analyzed.
+	 */
+	const SongAnalysis *analysis = nullptr;
+
 	/**
 	 * Copy of Queue::Item::priority.
 	 */
@@ -93,7 +100,8 @@ struct LightSong {
 		 tag(_tag),
 		 mtime(src.mtime),
 		 start_time(src.start_time), end_time(src.end_time),
-		 audio_format(src.audio_format) {}
+		 audio_format(src.audio_format),
+		 analysis(src.analysis) {}
 
 	[[gnu::pure]]
 	std::string GetURI() const noexcept;
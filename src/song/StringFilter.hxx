@@ -81,6 +81,18 @@ public:
 		return icu_compare.GetFoldCase();
 	}
 
+	Position GetPosition() const noexcept {
+		return position;
+	}
+
+	/**
+	 * Does this filter compare strings byte by byte, i.e. without
+	 * case folding, diacritics stripping or regular expression?
+	 */
+	bool IsBytewise() const noexcept {
+		return !icu_compare && !IsRegex();
+	}
+
 	bool IsNegated() const noexcept {
 		return negated;
 	}
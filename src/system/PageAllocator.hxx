@@ -114,3 +114,25 @@ PagesPopulateWrite(std::span<std::byte> p) noexcept
 	(void)p;
 #endif
 }
+
+/**
+ * Lock the specified pages into RAM, faulting them in and preventing
+ * them from being swapped out.
+ *
+ * @return false on error (with errno set), e.g. if RLIMIT_MEMLOCK
+ * is too low
+ */
+static inline bool
+LockPages(std::span<std::byte> p) noexcept
+{
+	return mlock(p.data(), p.size()) == 0;
+}
+
+/**
+ * Undo LockPages().
+ */
+static inline void
+UnlockPages(std::span<std::byte> p) noexcept
+{
+	munlock(p.data(), p.size());
+}
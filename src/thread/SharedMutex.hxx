@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#ifdef _WIN32
+
+#include "SlimReaderWriterLock.hxx"
+using SharedMutex = SlimReaderWriterLock;
+
+#else
+
+#include <shared_mutex>
+using SharedMutex = std::shared_mutex;
+
+#endif
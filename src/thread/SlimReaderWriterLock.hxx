@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <synchapi.h>
+
+/**
+ * Wrapper for a SRWLOCK, backend for the SharedMutex class.
+ */
+class SlimReaderWriterLock {
+	SRWLOCK lock_ = SRWLOCK_INIT;
+
+public:
+	SlimReaderWriterLock() noexcept = default;
+
+	SlimReaderWriterLock(const SlimReaderWriterLock &other) = delete;
+	SlimReaderWriterLock &operator=(const SlimReaderWriterLock &other) = delete;
+
+	void lock() noexcept {
+		::AcquireSRWLockExclusive(&lock_);
+	}
+
+	bool try_lock() noexcept {
+		return ::TryAcquireSRWLockExclusive(&lock_) != 0;
+	}
+
+	void unlock() noexcept {
+		::ReleaseSRWLockExclusive(&lock_);
+	}
+
+	void lock_shared() noexcept {
+		::AcquireSRWLockShared(&lock_);
+	}
+
+	bool try_lock_shared() noexcept {
+		return ::TryAcquireSRWLockShared(&lock_) != 0;
+	}
+
+	void unlock_shared() noexcept {
+		::ReleaseSRWLockShared(&lock_);
+	}
+};
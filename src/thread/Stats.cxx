@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Stats.hxx"
+
+#include <cassert>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+Mutex ThreadStats::mutex;
+IntrusiveList<ThreadStats> ThreadStats::list;
+
+/**
+ * The #ThreadStats instance of the current thread.
+ */
+static thread_local ThreadStats *current_thread_stats = nullptr;
+
+ThreadStats::ThreadStats(std::string &&_name) noexcept
+	:name(std::move(_name))
+{
+	assert(current_thread_stats == nullptr);
+	current_thread_stats = this;
+
+	Update();
+
+	const std::scoped_lock lock{mutex};
+	list.push_back(*this);
+}
+
+ThreadStats::~ThreadStats() noexcept
+{
+	assert(current_thread_stats == this);
+	current_thread_stats = nullptr;
+
+	const std::scoped_lock lock{mutex};
+	list.erase(list.iterator_to(*this));
+}
+
+inline void
+ThreadStats::Update() noexcept
+{
+	next_update = std::chrono::steady_clock::now() + std::chrono::seconds{1};
+
+#ifdef RUSAGE_THREAD
+	struct rusage usage;
+	if (getrusage(RUSAGE_THREAD, &usage) < 0)
+		return;
+
+	minor_faults.store(usage.ru_minflt, std::memory_order_relaxed);
+	major_faults.store(usage.ru_majflt, std::memory_order_relaxed);
+#endif
+}
+
+void
+ThreadStats::UpdateCurrent() noexcept
+{
+	if (current_thread_stats != nullptr &&
+	    std::chrono::steady_clock::now() >= current_thread_stats->next_update)
+		current_thread_stats->Update();
+}
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Mutex.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * Resource usage statistics of one thread.  The thread creates an
+ * instance (usually on its stack), which registers it in a global
+ * list, and calls UpdateCurrent() from time to time.  Other threads may
+ * read the values at any time with ForEach().
+ *
+ * This is used to find out whether real-time threads get delayed by
+ * page faults.
+ */
+class ThreadStats final : public IntrusiveListHook<> {
+	const std::string name;
+
+	/**
+	 * The number of page faults of this thread, as reported by
+	 * getrusage(RUSAGE_THREAD).  "Major" page faults required
+	 * I/O (e.g. from swap), "minor" page faults did not.
+	 */
+	std::atomic_uint_least64_t minor_faults{0}, major_faults{0};
+
+	/**
+	 * UpdateCurrent() does nothing until this time; this limits
+	 * the number of getrusage() calls.  Only accessed by the
+	 * owning thread.
+	 */
+	std::chrono::steady_clock::time_point next_update;
+
+public:
+	/**
+	 * Register the current thread.  Only one instance may exist
+	 * per thread.
+	 */
+	explicit ThreadStats(std::string &&_name) noexcept;
+	~ThreadStats() noexcept;
+
+	ThreadStats(const ThreadStats &) = delete;
+	ThreadStats &operator=(const ThreadStats &) = delete;
+
+	const std::string &GetName() const noexcept {
+		return name;
+	}
+
+	uint_least64_t GetMinorFaults() const noexcept {
+		return minor_faults.load(std::memory_order_relaxed);
+	}
+
+	uint_least64_t GetMajorFaults() const noexcept {
+		return major_faults.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Update the statistics of the current thread.  This is a
+	 * no-op if no #ThreadStats instance was registered for it or
+	 * if it was already updated during the past second, so it
+	 * is cheap enough to be called for each chunk.
+	 */
+	static void UpdateCurrent() noexcept;
+
+	/**
+	 * Invoke the given function for each registered
+	 * #ThreadStats.  A global mutex is held meanwhile.
+	 */
+	template<typename F>
+	static void ForEach(F &&f) {
+		const std::scoped_lock lock{mutex};
+		for (const auto &i : list)
+			f(i);
+	}
+
+private:
+	void Update() noexcept;
+
+	/**
+	 * Protects #list.
+	 */
+	static Mutex mutex;
+
+	static IntrusiveList<ThreadStats> list;
+};
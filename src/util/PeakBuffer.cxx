@@ -38,15 +38,35 @@ PeakBuffer::Read() const noexcept
 	return {};
 }
 
+std::array<std::span<std::byte>, 2>
+PeakBuffer::ReadAll() const noexcept
+{
+	std::array<std::span<std::byte>, 2> result;
+
+	if (normal_buffer != nullptr)
+		result[0] = normal_buffer->Read();
+
+	if (peak_buffer != nullptr)
+		result[1] = peak_buffer->Read();
+
+	return result;
+}
+
 void
 PeakBuffer::Consume(std::size_t length) noexcept
 {
 	if (normal_buffer != nullptr && !normal_buffer->empty()) {
-		normal_buffer->Consume(length);
-		return;
+		const std::size_t n = std::min(length,
+					       normal_buffer->GetAvailable());
+		normal_buffer->Consume(n);
+		length -= n;
+		if (length == 0)
+			return;
 	}
 
 	if (peak_buffer != nullptr && !peak_buffer->empty()) {
+		assert(length <= peak_buffer->GetAvailable());
+
 		peak_buffer->Consume(length);
 		if (peak_buffer->empty()) {
 			delete peak_buffer;
@@ -55,6 +75,29 @@ PeakBuffer::Consume(std::size_t length) noexcept
 
 		return;
 	}
+
+	assert(length == 0);
+}
+
+std::span<std::byte>
+PeakBuffer::Write() noexcept
+{
+	if (peak_buffer != nullptr && !peak_buffer->empty())
+		return peak_buffer->Write();
+
+	if (normal_buffer == nullptr)
+		normal_buffer = new DynamicFifoBuffer<std::byte>(normal_size);
+
+	return normal_buffer->Write();
+}
+
+void
+PeakBuffer::Append(std::size_t length) noexcept
+{
+	if (peak_buffer != nullptr && !peak_buffer->empty())
+		peak_buffer->Append(length);
+	else
+		normal_buffer->Append(length);
 }
 
 static std::size_t
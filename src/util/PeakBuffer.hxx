@@ -4,6 +4,7 @@
 #ifndef MPD_PEAK_BUFFER_HXX
 #define MPD_PEAK_BUFFER_HXX
 
+#include <array>
 #include <cstddef>
 #include <span>
 
@@ -47,8 +48,33 @@ public:
 	[[gnu::pure]]
 	std::span<std::byte> Read() const noexcept;
 
+	/**
+	 * Like Read(), but return all data in this buffer, e.g. for
+	 * writev().  The first segment contains the older data;
+	 * either may be empty.
+	 */
+	[[gnu::pure]]
+	std::array<std::span<std::byte>, 2> ReadAll() const noexcept;
+
+	/**
+	 * Remove data from the beginning of the buffer.  Unlike
+	 * Read(), the length may exceed the first segment returned
+	 * by ReadAll().
+	 */
 	void Consume(std::size_t length) noexcept;
 
+	/**
+	 * Prepare appending data without copying it: returns a
+	 * writable buffer at the end of this object, which may be
+	 * empty.  After filling it, call Append(std::size_t).
+	 */
+	std::span<std::byte> Write() noexcept;
+
+	/**
+	 * Commit data written to the buffer returned by Write().
+	 */
+	void Append(std::size_t length) noexcept;
+
 	bool Append(std::span<const std::byte> src);
 };
 
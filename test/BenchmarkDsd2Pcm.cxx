@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Measure the speed of the DSD to PCM converter (MultiDsd2Pcm) for
+ * DSD64 to DSD512.  On x86, each one is measured with and without
+ * AVX2.
+ */
+
+#include "pcm/Dsd2Pcm.hxx"
+
+#ifdef __SSE2__
+#include "pcm/X86Cpu.hxx"
+#endif
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+/* 1/10 second of DSD64 */
+static constexpr std::size_t N_FRAMES = 44100 * 64 / 8 / 10;
+
+static constexpr std::chrono::steady_clock::duration MIN_DURATION =
+	std::chrono::milliseconds(500);
+
+static std::vector<std::byte>
+GenerateOctets(std::size_t n)
+{
+	std::vector<std::byte> buffer(n);
+
+	std::mt19937 gen(42);
+	for (auto &i : buffer)
+		i = static_cast<std::byte>(gen());
+
+	return buffer;
+}
+
+/**
+ * Call the function repeatedly and return the number of frames
+ * converted per second.
+ */
+template<typename F>
+static double
+Measure(F &&f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::duration duration;
+	std::size_t n = 0;
+
+	do {
+		f();
+		n += N_FRAMES;
+		duration = std::chrono::steady_clock::now() - start;
+	} while (duration < MIN_DURATION);
+
+	return n / std::chrono::duration<double>(duration).count();
+}
+
+static void
+Benchmark(unsigned channels, const char *variant)
+{
+	const auto src = GenerateOctets(N_FRAMES * channels);
+	std::vector<float> dest_float(src.size());
+	std::vector<int32_t> dest_s24(src.size());
+
+	auto dsd2pcm = std::make_unique<MultiDsd2Pcm>();
+
+	const double float_fps = Measure([&]{
+		dsd2pcm->Translate(channels, N_FRAMES,
+				   src.data(), dest_float.data());
+	});
+
+	dsd2pcm->Reset();
+
+	const double s24_fps = Measure([&]{
+		dsd2pcm->TranslateS24(channels, N_FRAMES,
+				      src.data(), dest_s24.data());
+	});
+
+	/* the speed relative to real time for each DSD rate; one
+	   frame contains 8 DSD samples per channel */
+	for (unsigned factor = 64; factor <= 512; factor *= 2) {
+		const double rate = 44100. * factor / 8;
+		fmt::print("DSD{:<3} {}ch {:<5} float {:7.1f}x, S24 {:7.1f}x real time\n",
+			   factor, channels, variant,
+			   float_fps / rate, s24_fps / rate);
+	}
+}
+
+static void
+Benchmark(unsigned channels)
+{
+#ifdef __SSE2__
+	const bool avx2 = X86PcmIsAvx2Enabled();
+	X86PcmSetAvx2(false);
+	Benchmark(channels, "SSE2");
+
+	if (avx2) {
+		X86PcmSetAvx2(true);
+		Benchmark(channels, "AVX2");
+	}
+#else
+	Benchmark(channels, "");
+#endif
+}
+
+int
+main()
+{
+	Benchmark(2);
+	Benchmark(6);
+	return 0;
+}
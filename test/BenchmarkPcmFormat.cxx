@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Measure the throughput of the sample format converters in
+ * PcmFormat.cxx.  On x86, each conversion is measured with and
+ * without AVX2.
+ */
+
+#include "pcm/PcmFormat.hxx"
+#include "pcm/Buffer.hxx"
+#include "pcm/Dither.hxx"
+#include "pcm/SampleFormat.hxx"
+
+#ifdef __SSE2__
+#include "pcm/X86Convert.hxx"
+#include "pcm/X86Cpu.hxx"
+#endif
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+
+/* one second of 192 kHz stereo */
+static constexpr std::size_t N_SAMPLES = 192000 * 2;
+
+static constexpr std::chrono::steady_clock::duration MIN_DURATION =
+	std::chrono::milliseconds(500);
+
+static std::vector<std::byte>
+GenerateSamples(SampleFormat format)
+{
+	std::vector<std::byte> buffer(N_SAMPLES * sample_format_size(format));
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<float> dis(-1, 1);
+
+	for (std::size_t i = 0; i < N_SAMPLES; ++i) {
+		const float value = dis(gen);
+
+		switch (format) {
+		case SampleFormat::S16:
+			reinterpret_cast<int16_t *>(buffer.data())[i] =
+				int16_t(value * 32767);
+			break;
+
+		case SampleFormat::S24_P32:
+			reinterpret_cast<int32_t *>(buffer.data())[i] =
+				int32_t(value * 8388607);
+			break;
+
+		case SampleFormat::S32:
+			reinterpret_cast<int32_t *>(buffer.data())[i] =
+				int32_t(value * 2147483520.f);
+			break;
+
+		case SampleFormat::FLOAT:
+			reinterpret_cast<float *>(buffer.data())[i] = value;
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	return buffer;
+}
+
+static std::size_t
+Convert(PcmBuffer &buffer, PcmDither &dither,
+	SampleFormat src_format, SampleFormat dest_format,
+	std::span<const std::byte> src) noexcept
+{
+	switch (dest_format) {
+	case SampleFormat::S16:
+		return pcm_convert_to_16(buffer, dither, src_format, src).size();
+
+	case SampleFormat::S24_P32:
+		return pcm_convert_to_24(buffer, src_format, src).size();
+
+	case SampleFormat::S32:
+		return pcm_convert_to_32(buffer, src_format, src).size();
+
+	case SampleFormat::FLOAT:
+		return pcm_convert_to_float(buffer, src_format, src).size();
+
+	default:
+		return 0;
+	}
+}
+
+static void
+Benchmark(SampleFormat src_format, SampleFormat dest_format,
+	  const char *variant)
+{
+	const auto src = GenerateSamples(src_format);
+
+	PcmBuffer buffer;
+	PcmDither dither;
+
+	const auto start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::duration duration;
+	std::size_t n = 0;
+
+	do {
+		n += Convert(buffer, dither, src_format, dest_format, src);
+		duration = std::chrono::steady_clock::now() - start;
+	} while (duration < MIN_DURATION);
+
+	const double seconds = std::chrono::duration<double>(duration).count();
+	fmt::print("{:>7} -> {:<7} {:<8} {:8.1f} Msamples/s\n",
+		   sample_format_to_string(src_format),
+		   sample_format_to_string(dest_format),
+		   variant, n / seconds / 1e6);
+}
+
+static void
+Benchmark(SampleFormat src_format, SampleFormat dest_format)
+{
+#ifdef __SSE2__
+	const bool avx2 = X86PcmIsAvx2Enabled();
+	X86PcmSetAvx2(false);
+	Benchmark(src_format, dest_format, "SSE2");
+
+	if (avx2) {
+		X86PcmSetAvx2(true);
+		Benchmark(src_format, dest_format, "AVX2");
+	}
+#else
+	Benchmark(src_format, dest_format, "");
+#endif
+}
+
+int
+main()
+{
+	static constexpr SampleFormat formats[] = {
+		SampleFormat::S16,
+		SampleFormat::S24_P32,
+		SampleFormat::S32,
+		SampleFormat::FLOAT,
+	};
+
+	for (const auto src_format : formats)
+		for (const auto dest_format : formats)
+			if (src_format != dest_format)
+				Benchmark(src_format, dest_format);
+
+	return 0;
+}
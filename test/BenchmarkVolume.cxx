@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Measure the speed of the software volume (PcmVolume) and of
+ * cross-fade mixing (pcm_mix()) for each sample format.  On x86,
+ * each one is measured with and without AVX2.
+ */
+
+#include "pcm/Volume.hxx"
+#include "pcm/Mix.hxx"
+#include "pcm/Dither.hxx"
+#include "pcm/SampleFormat.hxx"
+
+#ifdef __SSE2__
+#include "pcm/X86Cpu.hxx"
+#endif
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+
+static constexpr unsigned CHANNELS = 2;
+
+/* one second of 48 kHz stereo */
+static constexpr std::size_t N_FRAMES = 48000;
+static constexpr std::size_t N_SAMPLES = N_FRAMES * CHANNELS;
+
+static constexpr std::chrono::steady_clock::duration MIN_DURATION =
+	std::chrono::milliseconds(500);
+
+static std::vector<std::byte>
+GenerateSamples(SampleFormat format)
+{
+	std::vector<std::byte> buffer(N_SAMPLES * sample_format_size(format));
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<float> dis(-1, 1);
+
+	for (std::size_t i = 0; i < N_SAMPLES; ++i) {
+		const float value = dis(gen);
+
+		switch (format) {
+		case SampleFormat::S8:
+			reinterpret_cast<int8_t *>(buffer.data())[i] =
+				int8_t(value * 127);
+			break;
+
+		case SampleFormat::S16:
+			reinterpret_cast<int16_t *>(buffer.data())[i] =
+				int16_t(value * 32767);
+			break;
+
+		case SampleFormat::S24_P32:
+			reinterpret_cast<int32_t *>(buffer.data())[i] =
+				int32_t(value * 8388607);
+			break;
+
+		case SampleFormat::S32:
+			reinterpret_cast<int32_t *>(buffer.data())[i] =
+				int32_t(value * 2147483520.f);
+			break;
+
+		case SampleFormat::FLOAT:
+			reinterpret_cast<float *>(buffer.data())[i] = value;
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	return buffer;
+}
+
+/**
+ * Call the function repeatedly and return the average duration per
+ * frame in nanoseconds.
+ */
+template<typename F>
+static double
+Measure(F &&f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::duration duration;
+	std::size_t n = 0;
+
+	do {
+		f();
+		n += N_FRAMES;
+		duration = std::chrono::steady_clock::now() - start;
+	} while (duration < MIN_DURATION);
+
+	return std::chrono::duration<double, std::nano>(duration).count() / n;
+}
+
+static void
+Benchmark(SampleFormat format, bool convert, const char *variant)
+{
+	const auto src = GenerateSamples(format);
+
+	PcmVolume pv;
+	const auto out_format = pv.Open(format, convert);
+	pv.SetVolume(PCM_VOLUME_1 / 3);
+
+	/* PcmVolume::Apply() is "pure"; use its result so the
+	   compiler doesn't omit the call */
+	volatile std::byte sink;
+	const double volume_ns = Measure([&]{
+		sink = pv.Apply(src).front();
+	});
+	(void)sink;
+
+	pv.Close();
+
+	auto dest = GenerateSamples(format);
+	PcmDither dither;
+
+	const double mix_ns = Measure([&]{
+		[[maybe_unused]] const bool success =
+			pcm_mix(dither, dest.data(), src.data(), dest.size(),
+				format, 0.3);
+	});
+
+	fmt::print("{:>7} -> {:<7} {:<5} volume {:6.2f} ns/frame, mix {:6.2f} ns/frame\n",
+		   sample_format_to_string(format),
+		   sample_format_to_string(out_format),
+		   variant, volume_ns, mix_ns);
+}
+
+static void
+Benchmark(SampleFormat format, bool convert)
+{
+#ifdef __SSE2__
+	const bool avx2 = X86PcmIsAvx2Enabled();
+	X86PcmSetAvx2(false);
+	Benchmark(format, convert, "SSE2");
+
+	if (avx2) {
+		X86PcmSetAvx2(true);
+		Benchmark(format, convert, "AVX2");
+	}
+#else
+	Benchmark(format, convert, "");
+#endif
+}
+
+int
+main()
+{
+	Benchmark(SampleFormat::S8, false);
+	Benchmark(SampleFormat::S16, false);
+	Benchmark(SampleFormat::S16, true);
+	Benchmark(SampleFormat::S24_P32, false);
+	Benchmark(SampleFormat::S32, false);
+	Benchmark(SampleFormat::FLOAT, false);
+	return 0;
+}
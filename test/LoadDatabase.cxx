@@ -3,10 +3,13 @@
 
 #include "config.h"
 #include "db/plugins/simple/DatabaseSave.hxx"
+#include "db/plugins/simple/BinaryDatabase.hxx"
 #include "db/plugins/simple/Directory.hxx"
 #include "lib/zlib/AutoGunzipFileLineReader.hxx"
+#include "io/FileReader.hxx"
 #include "fs/Path.hxx"
 #include "fs/NarrowPath.hxx"
+#include "util/AllocatedArray.hxx"
 #include "util/PrintException.hxx"
 
 int
@@ -20,8 +23,17 @@ try {
 	const FromNarrowPath db_path = argv[1];
 
 	Directory root{{}, nullptr};
-	AutoGunzipFileLineReader line_reader{db_path};
-	db_load_internal(line_reader, root, true);
+
+	if (IsBinaryDatabaseFile(db_path)) {
+		FileReader reader{db_path};
+		AllocatedArray<std::byte> buffer(reader.GetSize());
+		reader.ReadFull(buffer);
+
+		db_load_binary(buffer, root, true);
+	} else {
+		AutoGunzipFileLineReader line_reader{db_path};
+		db_load_internal(line_reader, root, true);
+	}
 
 	return EXIT_SUCCESS;
 } catch (...) {
@@ -0,0 +1,23 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "tag/Tag.hxx"
+
+#include <memory>
+
+/**
+ * Add a new #Song to the given directory.  Caller must lock the
+ * #db_mutex exclusively.
+ */
+inline Song &
+AddSong(Directory &directory, const char *filename, Tag &&tag) noexcept
+{
+	auto song = std::make_unique<Song>(filename, directory);
+	song->tag = std::move(tag);
+
+	Song &result = *song;
+	directory.AddSong(std::move(song));
+	return result;
+}
@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "client/BackgroundCommandPool.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using std::chrono_literals::operator""s;
+
+/**
+ * Shared state of the jobs of one test.
+ */
+struct JobLog {
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * The jobs block in Execute() until this is set.
+	 */
+	bool open = true;
+
+	/**
+	 * The ids of the jobs in the order they were executed.
+	 */
+	std::vector<unsigned> executed;
+
+	/**
+	 * The number of jobs whose OnExecuted() was called.
+	 */
+	unsigned n_finished = 0;
+
+	/**
+	 * The number of jobs which are currently in Execute().
+	 */
+	unsigned n_running = 0;
+
+	void SetOpen(bool _open) noexcept {
+		{
+			const std::scoped_lock lock{mutex};
+			open = _open;
+		}
+
+		cond.notify_all();
+	}
+
+	/**
+	 * Wait until the condition is true (at most a few seconds).
+	 */
+	template<typename P>
+	bool WaitFor(P &&p) {
+		std::unique_lock lock{mutex};
+		return cond.wait_for(lock, 10s, std::forward<P>(p));
+	}
+};
+
+class TestJob final : public BackgroundCommandPool::Job {
+	JobLog &log;
+
+	const unsigned id;
+
+public:
+	TestJob(JobLog &_log, unsigned _id) noexcept
+		:log(_log), id(_id) {}
+
+protected:
+	/* virtual methods from class BackgroundCommandPool::Job */
+	void Execute() noexcept override {
+		std::unique_lock lock{log.mutex};
+		log.executed.push_back(id);
+		++log.n_running;
+		log.cond.notify_all();
+
+		log.cond.wait(lock, [this]{ return log.open; });
+		--log.n_running;
+	}
+
+	void OnExecuted() noexcept override {
+		/* this is called while holding the pool's mutex; it
+		   must not block */
+		{
+			const std::scoped_lock lock{log.mutex};
+			++log.n_finished;
+		}
+
+		log.cond.notify_all();
+	}
+};
+
+/**
+ * Jobs which are submitted while all threads are busy wait in the
+ * queue and are executed in order.
+ */
+TEST(BackgroundCommandPool, Queue)
+{
+	JobLog log;
+	log.open = false;
+
+	TestJob a{log, 1}, b{log, 2}, c{log, 3};
+	BackgroundCommandPool pool{1};
+
+	pool.Submit(a);
+	ASSERT_TRUE(log.WaitFor([&log]{ return log.n_running == 1; }));
+
+	pool.Submit(b);
+	pool.Submit(c);
+
+	auto stats = pool.GetStats();
+	EXPECT_EQ(stats.queued, 2U);
+	EXPECT_EQ(stats.max_queued, 2U);
+	EXPECT_EQ(stats.submitted, 3U);
+
+	log.SetOpen(true);
+	ASSERT_TRUE(log.WaitFor([&log]{ return log.n_finished == 3; }));
+	EXPECT_EQ(log.executed, (std::vector<unsigned>{1, 2, 3}));
+
+	stats = pool.GetStats();
+	EXPECT_EQ(stats.queued, 0U);
+	EXPECT_EQ(stats.max_queued, 2U);
+}
+
+/**
+ * A job which is cancelled (e.g. because its client was closed)
+ * before a thread has picked it up is never executed.
+ */
+TEST(BackgroundCommandPool, CancelQueued)
+{
+	JobLog log;
+	log.open = false;
+
+	TestJob a{log, 1}, b{log, 2}, c{log, 3};
+	BackgroundCommandPool pool{1};
+
+	pool.Submit(a);
+	ASSERT_TRUE(log.WaitFor([&log]{ return log.n_running == 1; }));
+
+	pool.Submit(b);
+	pool.Submit(c);
+	pool.Cancel(b);
+	EXPECT_EQ(pool.GetStats().queued, 1U);
+
+	/* cancelling a job which is not queued anymore is a no-op */
+	pool.Cancel(b);
+
+	log.SetOpen(true);
+	ASSERT_TRUE(log.WaitFor([&log]{ return log.n_finished == 2; }));
+	EXPECT_EQ(log.executed, (std::vector<unsigned>{1, 3}));
+
+	/* the job can be submitted again */
+	pool.Submit(b);
+	ASSERT_TRUE(log.WaitFor([&log]{ return log.n_finished == 3; }));
+	EXPECT_EQ(log.executed, (std::vector<unsigned>{1, 3, 2}));
+}
+
+/**
+ * Cancelling a job which is being executed waits until Execute()
+ * has returned, so the job can be deleted afterwards.
+ */
+TEST(BackgroundCommandPool, CancelRunning)
+{
+	JobLog log;
+	log.open = false;
+
+	TestJob a{log, 1};
+	BackgroundCommandPool pool{2};
+
+	pool.Submit(a);
+	ASSERT_TRUE(log.WaitFor([&log]{ return log.n_running == 1; }));
+
+	std::thread opener{[&log]{
+		std::this_thread::sleep_for(std::chrono::milliseconds{50});
+		log.SetOpen(true);
+	}};
+
+	pool.Cancel(a);
+
+	{
+		const std::scoped_lock lock{log.mutex};
+		EXPECT_EQ(log.n_running, 0U);
+		EXPECT_EQ(log.n_finished, 1U);
+	}
+
+	opener.join();
+}
+
+/**
+ * The destructor waits for the running jobs and stops all threads.
+ */
+TEST(BackgroundCommandPool, Stop)
+{
+	JobLog log;
+
+	std::vector<std::unique_ptr<TestJob>> jobs;
+	for (unsigned i = 0; i < 16; ++i)
+		jobs.emplace_back(std::make_unique<TestJob>(log, i));
+
+	{
+		BackgroundCommandPool pool{4};
+		for (auto &i : jobs)
+			pool.Submit(*i);
+	}
+
+	EXPECT_EQ(log.executed.size(), jobs.size());
+	EXPECT_EQ(log.n_finished, jobs.size());
+}
@@ -0,0 +1,360 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "client/Threads.hxx"
+#include "client/Socket.hxx"
+#include "event/Loop.hxx"
+#include "event/CoarseTimerEvent.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/SpanCast.hxx"
+
+#include <gtest/gtest.h>
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+
+using std::string_view_literals::operator""sv;
+
+/**
+ * The size of the block which is sent by reference in response to
+ * the "big" command.
+ */
+static constexpr std::size_t BIG_SIZE = 64 * 1024;
+
+static const auto big_block =
+	std::make_shared<const std::string>(BIG_SIZE, 'x');
+
+/**
+ * Generate the response of #EchoHandler to the given line.
+ */
+static std::string
+EchoResponse(unsigned n, std::string_view line)
+{
+	if (line == "big"sv)
+		return *big_block + "\n";
+
+	return fmt::format("{}: {}\n", n, line);
+}
+
+/**
+ * A #ClientSocketHandler which implements a simple line based
+ * protocol, similar to #Client.
+ */
+class EchoHandler final : public ClientSocketHandler {
+	EventLoop &loop;
+
+	unsigned &n_open;
+
+	/**
+	 * The number of lines received so far.
+	 */
+	unsigned n_lines = 0;
+
+public:
+	std::unique_ptr<ClientSocket> socket;
+
+	bool closed = false;
+	std::exception_ptr error;
+
+	EchoHandler(EventLoop &_loop, unsigned &_n_open) noexcept
+		:loop(_loop), n_open(_n_open) {
+		++n_open;
+	}
+
+private:
+	void Done() noexcept {
+		assert(n_open > 0);
+
+		/* like Client, close the socket on "close" and after an
+		   error */
+		if (socket->IsDefined())
+			socket->Close();
+
+		/* this is called from an InjectEvent handler, where
+		   Break() would not wake up the EventLoop */
+		if (--n_open == 0)
+			loop.InjectBreak();
+	}
+
+	/**
+	 * @return false if the socket has been closed
+	 */
+	bool HandleLine(std::string_view line) noexcept {
+		if (line == "close"sv) {
+			Done();
+			return false;
+		}
+
+		if (line == "big"sv) {
+			++n_lines;
+			return socket->WriteReference(AsBytes(*big_block),
+						      big_block) &&
+				socket->Write("\n", 1);
+		}
+
+		const unsigned n = n_lines++;
+		return socket->VFmt("{}: {}\n",
+				    fmt::make_format_args(n, line));
+	}
+
+public:
+	/* virtual methods from class ClientSocketHandler */
+	InputResult OnSocketInput(std::span<std::byte> src) noexcept override {
+		std::string_view s = ToStringView(src);
+		std::size_t consumed = 0;
+
+		while (true) {
+			const auto newline = s.find('\n');
+			if (newline == s.npos)
+				break;
+
+			const auto line = s.substr(0, newline);
+			s.remove_prefix(newline + 1);
+
+			if (!HandleLine(line))
+				return InputResult::CLOSED;
+
+			consumed += newline + 1;
+		}
+
+		socket->ConsumeInput(consumed);
+		return InputResult::MORE;
+	}
+
+	void OnSocketError(std::exception_ptr ep) noexcept override {
+		error = std::move(ep);
+		Done();
+	}
+
+	void OnSocketClosed() noexcept override {
+		closed = true;
+		Done();
+	}
+};
+
+/**
+ * The client side of a connection; it runs in its own threads.
+ */
+class Peer {
+	UniqueSocketDescriptor fd;
+
+	std::thread writer, reader;
+
+public:
+	/**
+	 * The response which is expected for the lines sent by this
+	 * peer.
+	 */
+	std::string expected;
+
+	/**
+	 * Everything which was received.
+	 */
+	std::string received;
+
+	explicit Peer(UniqueSocketDescriptor &&_fd) noexcept
+		:fd(std::move(_fd)) {
+		fd.SetBlocking();
+	}
+
+	~Peer() noexcept {
+		Join();
+	}
+
+	void Join() noexcept {
+		/* the reader joins the writer */
+		if (reader.joinable())
+			reader.join();
+	}
+
+	/**
+	 * Send the given lines (concurrently with receiving the
+	 * responses), then "close" and then wait until the connection
+	 * is closed.
+	 */
+	void Start(std::vector<std::string> lines) {
+		std::string request;
+		for (unsigned i = 0; i < lines.size(); ++i) {
+			request += lines[i];
+			request += '\n';
+			expected += EchoResponse(i, lines[i]);
+		}
+
+		const std::size_t response_size = expected.size();
+
+		writer = std::thread([this, request = std::move(request)](){
+			SendAll(request);
+		});
+
+		reader = std::thread([this, response_size](){
+			/* "close" discards unsent output, so send it
+			   only after all responses have arrived */
+			Receive(response_size);
+			writer.join();
+			SendAll("close\n");
+
+			/* nothing more is expected; wait until the
+			   connection is closed */
+			Receive(SIZE_MAX);
+		});
+	}
+
+	/**
+	 * Shut down the connection from this side.  This also wakes
+	 * up the threads if they are blocked.
+	 */
+	void Hangup() noexcept {
+		fd.Shutdown();
+	}
+
+private:
+	void SendAll(std::string_view s) noexcept {
+		/* odd sizes to split lines between two writes */
+		static constexpr std::size_t STEP = 1001;
+
+		while (!s.empty()) {
+			const auto nbytes = fd.Write(AsBytes(s.substr(0, STEP)));
+			if (nbytes <= 0)
+				return;
+
+			s.remove_prefix(nbytes);
+		}
+	}
+
+	/**
+	 * Receive until #received has the given size or until the
+	 * connection is closed.
+	 */
+	void Receive(std::size_t size) noexcept {
+		std::byte buffer[4096];
+
+		while (received.size() < size) {
+			const auto nbytes = fd.Read(buffer);
+			if (nbytes <= 0)
+				return;
+
+			received.append(ToStringView(std::span{buffer}.first(nbytes)));
+		}
+	}
+};
+
+class ClientThreadsTest : public ::testing::Test {
+protected:
+	EventLoop loop;
+
+	CoarseTimerEvent timeout_event{loop, BIND_THIS_METHOD(OnTimeout)};
+
+	bool timed_out = false;
+
+	ClientThreads threads{loop, 2};
+
+	unsigned n_open = 0;
+
+	std::vector<std::unique_ptr<EchoHandler>> handlers;
+	std::vector<std::unique_ptr<Peer>> peers;
+
+	void TearDown() override {
+		/* the peers are closed first, so they do not block
+		   while the handlers are being destroyed */
+		for (auto &i : peers)
+			i->Hangup();
+		peers.clear();
+		handlers.clear();
+	}
+
+	Peer &Connect() {
+		UniqueSocketDescriptor a, b;
+		if (!UniqueSocketDescriptor::CreateSocketPairNonBlock(AF_LOCAL,
+								      SOCK_STREAM, 0,
+								      a, b))
+			throw std::runtime_error("socketpair() failed");
+
+		auto &handler = *handlers.emplace_back(std::make_unique<EchoHandler>(loop, n_open));
+		handler.socket = threads.Connect(std::move(a), 4096,
+						 1024 * 1024, handler);
+		return *peers.emplace_back(std::make_unique<Peer>(std::move(b)));
+	}
+
+	/**
+	 * Run the main loop until all handlers are done.
+	 */
+	void Run() noexcept {
+		timeout_event.Schedule(std::chrono::seconds{30});
+		loop.Run();
+		timeout_event.Cancel();
+		ASSERT_FALSE(timed_out);
+	}
+
+private:
+	void OnTimeout() noexcept {
+		timed_out = true;
+		loop.Break();
+	}
+};
+
+static std::vector<std::string>
+MakeLines(unsigned n, std::string_view prefix)
+{
+	std::vector<std::string> lines;
+	lines.reserve(n);
+
+	for (unsigned i = 0; i < n; ++i) {
+		if (i % 997 == 500)
+			lines.emplace_back("big");
+		else
+			lines.emplace_back(fmt::format("{} {} {}",
+						       prefix, i,
+						       std::string(i % 50, '.')));
+	}
+
+	return lines;
+}
+
+/**
+ * Several connections send many commands; their responses (copied
+ * and referenced) must arrive completely and in order, even though
+ * the input exceeds the channel's input limit.
+ */
+TEST_F(ClientThreadsTest, Echo)
+{
+	static constexpr unsigned N_CONNECTIONS = 5;
+
+	for (unsigned i = 0; i < N_CONNECTIONS; ++i)
+		Connect().Start(MakeLines(3000, fmt::format("client{}", i)));
+
+	Run();
+
+	for (auto &peer : peers) {
+		peer->Join();
+		EXPECT_EQ(peer->received.size(), peer->expected.size());
+		EXPECT_EQ(peer->received, peer->expected);
+	}
+
+	for (const auto &handler : handlers) {
+		EXPECT_FALSE(handler->closed);
+		EXPECT_FALSE(handler->error);
+	}
+}
+
+/**
+ * The main thread is notified when the peer closes the connection.
+ */
+TEST_F(ClientThreadsTest, Hangup)
+{
+	Connect();
+	Connect();
+
+	for (auto &peer : peers)
+		peer->Hangup();
+
+	Run();
+
+	for (const auto &handler : handlers)
+		EXPECT_TRUE(handler->closed || handler->error);
+}
@@ -0,0 +1,196 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "MakeTag.hxx"
+#include "MakeSong.hxx"
+#include "db/plugins/simple/DatabaseJournal.hxx"
+#include "db/plugins/simple/DatabaseSave.hxx"
+#include "db/DatabaseLock.hxx"
+#include "io/BufferedOutputStream.hxx"
+#include "io/LineReader.hxx"
+#include "io/StringOutputStream.hxx"
+#include "lib/icu/Init.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+/**
+ * A #LineReader which reads from a string.
+ */
+class StringLineReader final : public LineReader {
+	std::string buffer;
+	std::size_t position = 0;
+
+public:
+	explicit StringLineReader(std::string_view _buffer) noexcept
+		:buffer(_buffer) {}
+
+	char *ReadLine() override {
+		if (position >= buffer.size())
+			return nullptr;
+
+		char *line = buffer.data() + position;
+		const auto newline = buffer.find('\n', position);
+		if (newline == buffer.npos) {
+			position = buffer.size();
+		} else {
+			buffer[newline] = 0;
+			position = newline + 1;
+		}
+
+		return line;
+	}
+};
+
+static std::string
+Save(const Directory &root)
+{
+	StringOutputStream sos;
+	BufferedOutputStream bos{sos};
+	db_save_internal(bos, root);
+	bos.Flush();
+	return std::move(sos).GetValue();
+}
+
+static constexpr JournalBase base{1234, 5678};
+
+class DatabaseJournalTest : public ::testing::Test {
+protected:
+	Directory root{{}, nullptr};
+
+	/**
+	 * The database file written before the modifications.
+	 */
+	std::string snapshot;
+
+	/**
+	 * The journal with the modifications since #snapshot.
+	 */
+	std::string journal;
+
+	void SetUp() override {
+		/* for Directory::Sort() */
+		IcuInit();
+
+		{
+			const ScopeDatabaseLock protect;
+
+			auto &a = *root.CreateChild("a");
+			AddSong(a, "1.ogg", MakeTag(TAG_TITLE, "One"));
+			AddSong(a, "2.ogg", MakeTag(TAG_TITLE, "Two"));
+
+			auto &b = *root.CreateChild("b");
+			AddSong(b, "3.ogg", MakeTag(TAG_TITLE, "Three"));
+		}
+
+		snapshot = Save(root);
+
+		/* modify the database like an update would, and write
+		   the journal */
+
+		const ScopeDatabaseLock protect;
+
+		auto &a = *root.FindChild("a");
+		AddSong(a, "4.ogg", MakeTag(TAG_TITLE, "Four"));
+		a.dirty = true;
+
+		auto &b = *root.FindChild("b");
+		b.RemoveSong(b.FindSong("3.ogg"));
+		b.dirty = true;
+
+		auto &c = *root.CreateChild("c");
+		AddSong(c, "5.ogg", MakeTag(TAG_TITLE, "Five"));
+		c.dirty = true;
+		root.dirty = true;
+
+		StringOutputStream sos;
+		BufferedOutputStream bos{sos};
+		journal_write_header(bos, base);
+		EXPECT_EQ(journal_save(bos, root), 4U);
+		bos.Flush();
+		journal = std::move(sos).GetValue();
+
+		journal_clear(root);
+	}
+
+	void TearDown() override {
+		IcuFinish();
+	}
+
+	/**
+	 * Simulate a restart: load #snapshot into a new tree and
+	 * replay the given journal.
+	 */
+	bool Replay(Directory &dest, std::string_view _journal,
+		    const JournalBase &_base=base) const {
+		StringLineReader snapshot_reader{snapshot};
+		db_load_internal(snapshot_reader, dest);
+
+		StringLineReader journal_reader{_journal};
+		const ScopeDatabaseLock protect;
+		return journal_load(journal_reader, dest, _base);
+	}
+};
+
+TEST_F(DatabaseJournalTest, Clean)
+{
+	StringOutputStream sos;
+	BufferedOutputStream bos{sos};
+
+	const ScopeDatabaseSharedLock protect;
+	EXPECT_EQ(journal_save(bos, root), 0U);
+}
+
+TEST_F(DatabaseJournalTest, Replay)
+{
+	Directory dest{{}, nullptr};
+	EXPECT_TRUE(Replay(dest, journal));
+	EXPECT_EQ(Save(dest), Save(root));
+}
+
+TEST_F(DatabaseJournalTest, Idempotent)
+{
+	/* a crash after writing the snapshot but before deleting the
+	   journal may replay records which are already part of the
+	   snapshot */
+	snapshot = Save(root);
+
+	Directory dest{{}, nullptr};
+	EXPECT_TRUE(Replay(dest, journal));
+	EXPECT_EQ(Save(dest), Save(root));
+}
+
+TEST_F(DatabaseJournalTest, WrongBase)
+{
+	Directory dest{{}, nullptr};
+	EXPECT_FALSE(Replay(dest, journal, {1234, 5679}));
+
+	/* the snapshot is unmodified */
+	Directory expected{{}, nullptr};
+	StringLineReader reader{snapshot};
+	db_load_internal(reader, expected);
+	EXPECT_EQ(Save(dest), Save(expected));
+}
+
+TEST_F(DatabaseJournalTest, Truncated)
+{
+	/* simulate a crash while the last record ("c") was being
+	   appended */
+	const auto last = journal.rfind("directory: c\n");
+	ASSERT_NE(last, journal.npos);
+	const auto truncated = std::string_view{journal}.substr(0, last + 20);
+
+	Directory dest{{}, nullptr};
+	EXPECT_ANY_THROW(Replay(dest, truncated));
+
+	/* the complete records have been applied */
+	const ScopeDatabaseSharedLock protect;
+	const Directory *a = dest.FindChild("a");
+	ASSERT_NE(a, nullptr);
+	EXPECT_NE(a->FindSong("4.ogg"), nullptr);
+
+	const Directory *b = dest.FindChild("b");
+	ASSERT_NE(b, nullptr);
+	EXPECT_EQ(b->FindSong("3.ogg"), nullptr);
+}
@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "event/FullyBufferedSocket.hxx"
+#include "event/Loop.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/SpanCast.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+
+/**
+ * The size of the normal output buffer; it is very small, so most
+ * writes overflow into the peak buffer.
+ */
+static constexpr std::size_t NORMAL_SIZE = 64;
+static constexpr std::size_t PEAK_SIZE = 256 * 1024;
+
+class TestSocket final : public FullyBufferedSocket {
+public:
+	bool error = false, closed = false;
+
+	TestSocket(SocketDescriptor _fd, EventLoop &_loop) noexcept
+		:FullyBufferedSocket(_fd, _loop, NORMAL_SIZE, PEAK_SIZE) {}
+
+	~TestSocket() noexcept {
+		if (IsDefined())
+			Close();
+	}
+
+	using FullyBufferedSocket::Close;
+	using FullyBufferedSocket::Flush;
+	using FullyBufferedSocket::Write;
+	using FullyBufferedSocket::VFmt;
+	using FullyBufferedSocket::WriteReference;
+
+protected:
+	InputResult OnSocketInput(std::span<std::byte> src) noexcept override {
+		ConsumeInput(src.size());
+		return InputResult::MORE;
+	}
+
+	void OnSocketError(std::exception_ptr) noexcept override {
+		error = true;
+	}
+
+	void OnSocketClosed() noexcept override {
+		closed = true;
+	}
+};
+
+class FullyBufferedSocketTest : public ::testing::Test {
+protected:
+	EventLoop loop;
+
+	UniqueSocketDescriptor peer;
+
+	std::unique_ptr<TestSocket> socket;
+
+	/**
+	 * Everything which was passed to #socket, in order.
+	 */
+	std::string expected;
+
+	/**
+	 * Everything which was received by #peer.
+	 */
+	std::string received;
+
+	void SetUp() override {
+		UniqueSocketDescriptor fd;
+		ASSERT_TRUE(UniqueSocketDescriptor::CreateSocketPairNonBlock(AF_LOCAL, SOCK_STREAM, 0,
+									     fd, peer));
+
+		/* small socket buffers force partial sends */
+		fd.SetIntOption(SOL_SOCKET, SO_SNDBUF, 4096);
+		peer.SetIntOption(SOL_SOCKET, SO_RCVBUF, 4096);
+
+		socket = std::make_unique<TestSocket>(fd.Release(), loop);
+	}
+
+	void Write(std::string_view s) {
+		ASSERT_TRUE(socket->Write(s.data(), s.size()));
+		expected += s;
+	}
+
+	template<typename... Args>
+	void Fmt(fmt::format_string<Args...> format_str, Args&&... args) {
+		ASSERT_TRUE(socket->VFmt(format_str,
+					 fmt::make_format_args(args...)));
+		expected += fmt::format(format_str,
+					std::forward<Args>(args)...);
+	}
+
+	/**
+	 * Pass a block filled with the given character by
+	 * reference.
+	 *
+	 * @return the owner, to check whether the socket has released
+	 * it
+	 */
+	std::weak_ptr<const void> WriteReference(char ch, std::size_t size) {
+		auto block = std::make_shared<std::string>(size, ch);
+		const std::span<const std::byte> data = AsBytes(*block);
+		expected += *block;
+		std::weak_ptr<const void> result = block;
+		EXPECT_TRUE(socket->WriteReference(data, std::move(block)));
+		return result;
+	}
+
+	/**
+	 * Receive up to the given number of bytes from #peer.
+	 */
+	void Receive(std::size_t max_size) {
+		std::vector<std::byte> buffer(max_size);
+		const auto nbytes = peer.Receive(buffer, MSG_DONTWAIT);
+		if (nbytes > 0)
+			received.append(ToStringView(std::span{buffer}.first(nbytes)));
+	}
+
+	/**
+	 * Flush and receive in small steps until everything has
+	 * arrived.
+	 */
+	void FlushAll() {
+		for (unsigned i = 0; received.size() < expected.size(); ++i) {
+			ASSERT_LT(i, 100000U);
+			ASSERT_TRUE(socket->Flush());
+			Receive(777);
+		}
+
+		EXPECT_FALSE(socket->error);
+		EXPECT_FALSE(socket->closed);
+	}
+};
+
+/**
+ * Mix copied, formatted and referenced data across the boundary
+ * between the normal and the peak buffer, and flush it in many
+ * partial sends; the peer must receive everything in order.
+ */
+TEST_F(FullyBufferedSocketTest, Order)
+{
+	/* fits into the normal buffer */
+	Write("0123456789abcdefghijklmnopqrstuvwxyz");
+	Fmt("{}:{}\n", "fmt", 42);
+
+	const auto ref1 = WriteReference('A', 5000);
+
+	/* overflows into the peak buffer */
+	Write(std::string(100, 'b'));
+	Fmt("{:>80}\n", "right");
+
+	/* two adjacent references */
+	const auto ref2 = WriteReference('C', 8000);
+	const auto ref3 = WriteReference('D',
+					 FullyBufferedSocket::MIN_REFERENCE_SIZE);
+
+	/* a small block is copied */
+	WriteReference('e', 100);
+
+	/* more segments than one sendmsg() call accepts */
+	std::vector<std::weak_ptr<const void>> refs;
+	for (unsigned i = 0; i < 12; ++i) {
+		Fmt("[{}]", i);
+		refs.push_back(WriteReference('F' + i, 4096 + i));
+	}
+
+	ASSERT_TRUE(socket->Flush());
+	EXPECT_LT(socket->GetOutputStats().sent, expected.size());
+
+	/* append while a reference has been sent partially */
+	Receive(3000);
+	ASSERT_TRUE(socket->Flush());
+	Write("tail");
+	const auto ref4 = WriteReference('Z', 6000);
+	Fmt("{}\n", "end");
+
+	FlushAll();
+	EXPECT_EQ(received, expected);
+
+	/* all owners have been released */
+	EXPECT_TRUE(ref1.expired());
+	EXPECT_TRUE(ref2.expired());
+	EXPECT_TRUE(ref3.expired());
+	EXPECT_TRUE(ref4.expired());
+	for (const auto &i : refs)
+		EXPECT_TRUE(i.expired());
+
+	const auto &stats = socket->GetOutputStats();
+	EXPECT_EQ(stats.sent, expected.size());
+	EXPECT_EQ(stats.copied + stats.referenced, stats.sent);
+	EXPECT_EQ(stats.referenced, 5000U + 8000U +
+		  FullyBufferedSocket::MIN_REFERENCE_SIZE +
+		  12 * 4096U + 66U + 6000U);
+	EXPECT_GT(stats.writes, 2U);
+}
+
+/**
+ * After the output has drained completely, the positions of new
+ * references must still match the buffered data.
+ */
+TEST_F(FullyBufferedSocketTest, Drain)
+{
+	for (unsigned i = 0; i < 3; ++i) {
+		Fmt("{}\n", i);
+		WriteReference('a' + i, 10000);
+		Write(std::string(200, 'x'));
+		FlushAll();
+		EXPECT_EQ(received, expected);
+	}
+}
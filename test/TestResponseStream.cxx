@@ -0,0 +1,328 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "client/ResponseStream.hxx"
+#include "db/DatabaseLock.hxx"
+#include "util/SpanCast.hxx"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+
+using std::chrono_literals::operator""h;
+using std::chrono_literals::operator""ms;
+using std::chrono_literals::operator""s;
+
+static constexpr std::size_t BLOCK_SIZE = 1024;
+static constexpr std::size_t MAX_BLOCKS = 4;
+static constexpr std::size_t MAX_PENDING = MAX_BLOCKS * BLOCK_SIZE;
+
+/**
+ * Generate the given block of a response.
+ */
+static std::string
+MakeBlock(unsigned i)
+{
+	return std::string(BLOCK_SIZE, 'a' + i % 26);
+}
+
+/**
+ * Wait (at most a few seconds) until the predicate becomes true.
+ */
+template<typename P>
+static bool
+WaitUntil(P &&p)
+{
+	const auto deadline = std::chrono::steady_clock::now() + 10s;
+	while (!p()) {
+		if (std::chrono::steady_clock::now() >= deadline)
+			return false;
+
+		std::this_thread::sleep_for(1ms);
+	}
+
+	return true;
+}
+
+/**
+ * Generates a response in a thread, like a #PoolBackgroundCommand
+ * in a #BackgroundCommandPool thread.
+ */
+class Producer {
+	ResponseStream &stream;
+
+	std::thread thread;
+
+public:
+	/**
+	 * The number of blocks which have been pushed.
+	 */
+	std::atomic_uint n_pushed{0};
+
+	/**
+	 * Set when the thread has finished.
+	 */
+	std::atomic_bool done{false};
+
+	/**
+	 * The message of the exception thrown by
+	 * ResponseStream::Wait() (only valid after #done is set).
+	 */
+	std::string error;
+
+	/**
+	 * @param n the number of blocks to be pushed
+	 * @param db_locked hold the database lock in shared mode,
+	 * like a database visitor
+	 */
+	Producer(ResponseStream &_stream, unsigned n,
+		 bool db_locked=false)
+		:stream(_stream),
+		 thread([this, n, db_locked]{ Run(n, db_locked); }) {}
+
+	~Producer() noexcept {
+		thread.join();
+	}
+
+private:
+	void Run(unsigned n, bool db_locked) noexcept {
+		if (db_locked)
+			db_lock_shared();
+
+		try {
+			for (unsigned i = 0; i < n; ++i) {
+				const bool must_wait = stream.Push(MakeBlock(i));
+				++n_pushed;
+				if (must_wait)
+					stream.Wait();
+			}
+		} catch (const std::exception &e) {
+			error = e.what();
+		}
+
+		if (db_locked)
+			db_unlock_shared();
+
+		done = true;
+	}
+};
+
+/**
+ * Receives the blocks like a #Client; a block is "sent" when it is
+ * released.
+ */
+class Consumer {
+	std::deque<std::shared_ptr<const ResponseStream::Block>> blocks;
+
+public:
+	std::string received;
+
+	/**
+	 * Take all new blocks from the stream.
+	 */
+	void Take(ResponseStream &stream) {
+		for (auto &i : stream.TakeBlocks())
+			blocks.emplace_back(std::move(i));
+	}
+
+	std::size_t GetQueued() const noexcept {
+		return blocks.size();
+	}
+
+	/**
+	 * Send the oldest block.
+	 */
+	bool SendOne() {
+		if (blocks.empty())
+			return false;
+
+		const auto data = blocks.front()->GetData();
+		received.append(ToStringView(data));
+		blocks.pop_front();
+		return true;
+	}
+
+	void SendAll() {
+		while (SendOne()) {}
+	}
+};
+
+static std::string
+MakeResponse(unsigned n)
+{
+	std::string result;
+	for (unsigned i = 0; i < n; ++i)
+		result += MakeBlock(i);
+	return result;
+}
+
+/**
+ * A client which reads slowly, but steadily, receives the whole
+ * response, even though this takes much longer than the stall
+ * timeout; the producer never gets more than #MAX_PENDING ahead.
+ */
+TEST(ResponseStream, BackPressure)
+{
+	static constexpr unsigned N = 40;
+
+	const auto stream = std::make_shared<ResponseStream>(MAX_PENDING, 100ms);
+	Consumer consumer;
+
+	{
+		Producer producer{*stream, N};
+
+		while (!producer.done) {
+			consumer.Take(*stream);
+
+			/* the producer stops after the block which
+			   exceeded the limit */
+			const auto sent = consumer.received.size() / BLOCK_SIZE;
+			EXPECT_LE(producer.n_pushed, sent + MAX_BLOCKS + 1);
+
+			consumer.SendOne();
+			std::this_thread::sleep_for(10ms);
+		}
+
+		EXPECT_EQ(producer.error, "");
+	}
+
+	consumer.Take(*stream);
+	consumer.SendAll();
+	EXPECT_EQ(consumer.received, MakeResponse(N));
+}
+
+/**
+ * The producer gives up if the client does not receive anything.
+ */
+TEST(ResponseStream, TooSlow)
+{
+	const auto stream = std::make_shared<ResponseStream>(MAX_PENDING, 50ms);
+	Consumer consumer;
+
+	{
+		Producer producer{*stream, 100};
+		ASSERT_TRUE(WaitUntil([&producer]{ return producer.done.load(); }));
+		EXPECT_EQ(producer.error, "Client is too slow");
+		EXPECT_EQ(producer.n_pushed, MAX_BLOCKS + 1);
+	}
+
+	/* the blocks which were pushed can still be sent */
+	consumer.Take(*stream);
+	consumer.SendAll();
+	EXPECT_EQ(consumer.received, MakeResponse(MAX_BLOCKS + 1));
+}
+
+/**
+ * Cancel() (e.g. because the client was closed) wakes up the
+ * producer.
+ */
+TEST(ResponseStream, Cancel)
+{
+	const auto stream = std::make_shared<ResponseStream>(MAX_PENDING, 1h);
+	Consumer consumer;
+
+	{
+		Producer producer{*stream, 100};
+		ASSERT_TRUE(WaitUntil([&producer]{ return producer.n_pushed == MAX_BLOCKS + 1; }));
+
+		consumer.Take(*stream);
+		stream->Cancel();
+
+		ASSERT_TRUE(WaitUntil([&producer]{ return producer.done.load(); }));
+		EXPECT_EQ(producer.error, "Cancelled");
+		EXPECT_TRUE(stream->IsCancelled());
+	}
+
+	/* the blocks which were passed to the client may outlive
+	   the command */
+	EXPECT_EQ(consumer.GetQueued(), MAX_BLOCKS + 1);
+}
+
+/**
+ * Try to obtain the database lock in exclusive mode while the
+ * producer is waiting.
+ *
+ * @return true on success; false if the producer did not release
+ * its shared lock
+ */
+static bool
+TryLockDatabase() noexcept
+{
+	return WaitUntil([]{
+		if (!db_mutex.try_lock())
+			return false;
+
+		db_mutex.unlock();
+		return true;
+	});
+}
+
+/**
+ * While waiting for the client, a database visitor releases its
+ * shared lock, so the database can be updated meanwhile.  An update
+ * which does not modify anything does not affect the visitor.
+ */
+TEST(ResponseStream, UnmodifiedDatabase)
+{
+	static constexpr unsigned N = 20;
+
+	const auto stream = std::make_shared<ResponseStream>(MAX_PENDING, 10s);
+	Consumer consumer;
+
+	{
+		Producer producer{*stream, N, true};
+		ASSERT_TRUE(WaitUntil([&producer]{ return producer.n_pushed == MAX_BLOCKS + 1; }));
+
+		ASSERT_TRUE(TryLockDatabase());
+
+		{
+			/* like an update which finds nothing new */
+			const ScopeDatabaseLock protect;
+		}
+
+		while (!producer.done) {
+			consumer.Take(*stream);
+			consumer.SendAll();
+			std::this_thread::sleep_for(1ms);
+		}
+
+		EXPECT_EQ(producer.error, "");
+	}
+
+	consumer.Take(*stream);
+	consumer.SendAll();
+	EXPECT_EQ(consumer.received, MakeResponse(N));
+}
+
+/**
+ * If the database gets modified while the visitor waits, it fails,
+ * because its position in the tree may have become invalid.
+ */
+TEST(ResponseStream, ModifiedDatabase)
+{
+	const auto stream = std::make_shared<ResponseStream>(MAX_PENDING, 10s);
+	Consumer consumer;
+
+	Producer producer{*stream, 100, true};
+	ASSERT_TRUE(WaitUntil([&producer]{ return producer.n_pushed == MAX_BLOCKS + 1; }));
+
+	ASSERT_TRUE(TryLockDatabase());
+
+	{
+		/* like Directory::MarkModified() */
+		const ScopeDatabaseLock protect;
+		db_modified();
+	}
+
+	/* the client makes progress, and the visitor wakes up */
+	consumer.Take(*stream);
+	consumer.SendOne();
+
+	ASSERT_TRUE(WaitUntil([&producer]{ return producer.done.load(); }));
+	EXPECT_EQ(producer.error, "Database was modified");
+}
@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "MakeTag.hxx"
+#include "db/update/ScanCache.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "storage/FileInfo.hxx"
+#include "io/FileOutputStream.hxx"
+#include "fs/FileSystem.hxx"
+#include "util/SpanCast.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <unistd.h>
+
+static StorageFileInfo
+MakeFileInfo(uint64_t size, uint64_t inode, std::time_t mtime) noexcept
+{
+	StorageFileInfo info{StorageFileInfo::Type::REGULAR};
+	info.size = size;
+	info.inode = inode;
+	info.mtime = std::chrono::system_clock::from_time_t(mtime);
+	return info;
+}
+
+class ScanCacheTest : public ::testing::Test {
+protected:
+	Directory root{{}, nullptr};
+
+	AllocatedPath path = nullptr;
+
+	void SetUp() override {
+		const auto *info = ::testing::UnitTest::GetInstance()->current_test_info();
+		path = AllocatedPath::FromFS(::testing::TempDir() +
+					     "mpd_scan_cache_" +
+					     info->name());
+		unlink(path.c_str());
+	}
+
+	void TearDown() override {
+		unlink(path.c_str());
+	}
+
+	void Store(UpdateScanCache &cache, const char *uri,
+		   const StorageFileInfo &info, Tag &&tag) {
+		Song song{uri, root};
+		song.tag = std::move(tag);
+		song.audio_format = AudioFormat{44100, SampleFormat::S16, 2};
+		cache.Store(uri, info, song);
+	}
+
+	/**
+	 * Look up a cache entry.
+	 *
+	 * @return the title of the cached song or an empty string
+	 * on miss
+	 */
+	std::string Lookup(UpdateScanCache &cache, const char *uri,
+			   const StorageFileInfo &info) {
+		Song song{uri, root};
+		if (!cache.Lookup(uri, info, song))
+			return {};
+
+		EXPECT_EQ(song.audio_format,
+			  (AudioFormat{44100, SampleFormat::S16, 2}));
+		EXPECT_EQ(song.mtime, info.mtime);
+
+		const char *title = song.tag.GetValue(TAG_TITLE);
+		return title != nullptr ? title : "?";
+	}
+};
+
+TEST_F(ScanCacheTest, Empty)
+{
+	UpdateScanCache cache{path};
+	EXPECT_EQ(Lookup(cache, "a", MakeFileInfo(1, 2, 3)), "");
+	EXPECT_EQ(cache.GetMisses(), 1U);
+	EXPECT_EQ(cache.GetHits(), 0U);
+
+	/* nothing to write */
+	cache.Flush({});
+	EXPECT_FALSE(FileExists(path));
+}
+
+TEST_F(ScanCacheTest, Persist)
+{
+	{
+		UpdateScanCache cache{path};
+		Store(cache, "a", MakeFileInfo(1, 2, 3), MakeTag(TAG_TITLE, "A"));
+		cache.Flush({});
+	}
+
+	UpdateScanCache cache{path};
+	EXPECT_EQ(Lookup(cache, "a", MakeFileInfo(1, 2, 3)), "A");
+	EXPECT_EQ(cache.GetHits(), 1U);
+
+	/* a modified file needs to be scanned again */
+	EXPECT_EQ(Lookup(cache, "a", MakeFileInfo(9, 2, 3)), "");
+	EXPECT_EQ(Lookup(cache, "a", MakeFileInfo(1, 9, 3)), "");
+	EXPECT_EQ(Lookup(cache, "a", MakeFileInfo(1, 2, 9)), "");
+	EXPECT_EQ(Lookup(cache, "b", MakeFileInfo(1, 2, 3)), "");
+	EXPECT_EQ(cache.GetMisses(), 4U);
+}
+
+TEST_F(ScanCacheTest, Append)
+{
+	{
+		UpdateScanCache cache{path};
+		Store(cache, "a", MakeFileInfo(1, 1, 1), MakeTag(TAG_TITLE, "A"));
+		Store(cache, "b", MakeFileInfo(2, 2, 2), MakeTag(TAG_TITLE, "B"));
+		cache.Flush({});
+	}
+
+	/* without a Lookup(), the file is not loaded, and new
+	   entries are appended; later entries replace earlier
+	   ones */
+	{
+		UpdateScanCache cache{path};
+		Store(cache, "b", MakeFileInfo(3, 3, 3), MakeTag(TAG_TITLE, "B2"));
+		Store(cache, "c", MakeFileInfo(4, 4, 4), MakeTag(TAG_TITLE, "C"));
+		cache.Flush({});
+	}
+
+	UpdateScanCache cache{path};
+	EXPECT_EQ(Lookup(cache, "a", MakeFileInfo(1, 1, 1)), "A");
+	EXPECT_EQ(Lookup(cache, "b", MakeFileInfo(2, 2, 2)), "");
+	EXPECT_EQ(Lookup(cache, "b", MakeFileInfo(3, 3, 3)), "B2");
+	EXPECT_EQ(Lookup(cache, "c", MakeFileInfo(4, 4, 4)), "C");
+}
+
+TEST_F(ScanCacheTest, Prune)
+{
+	{
+		UpdateScanCache cache{path};
+		Store(cache, "dir/a", MakeFileInfo(1, 1, 1), MakeTag(TAG_TITLE, "A"));
+		Store(cache, "dir/b", MakeFileInfo(2, 2, 2), MakeTag(TAG_TITLE, "B"));
+		Store(cache, "other/c", MakeFileInfo(3, 3, 3), MakeTag(TAG_TITLE, "C"));
+		cache.Flush({});
+	}
+
+	/* "dir/" was scanned completely, but "dir/b" was not seen:
+	   it has been deleted */
+	{
+		UpdateScanCache cache{path};
+		EXPECT_EQ(Lookup(cache, "dir/a", MakeFileInfo(1, 1, 1)), "A");
+		cache.Flush("dir/");
+	}
+
+	UpdateScanCache cache{path};
+	EXPECT_EQ(Lookup(cache, "dir/a", MakeFileInfo(1, 1, 1)), "A");
+	EXPECT_EQ(Lookup(cache, "dir/b", MakeFileInfo(2, 2, 2)), "");
+	EXPECT_EQ(Lookup(cache, "other/c", MakeFileInfo(3, 3, 3)), "C");
+}
+
+TEST_F(ScanCacheTest, Obsolete)
+{
+	{
+		FileOutputStream fos{path};
+		fos.Write(AsBytes(std::string_view{"mpd_scan_cache: 0\n"}));
+		fos.Commit();
+	}
+
+	{
+		UpdateScanCache cache{path};
+		EXPECT_EQ(Lookup(cache, "a", MakeFileInfo(1, 1, 1)), "");
+		Store(cache, "a", MakeFileInfo(1, 1, 1), MakeTag(TAG_TITLE, "A"));
+		cache.Flush({});
+	}
+
+	/* the obsolete file has been replaced */
+	UpdateScanCache cache{path};
+	EXPECT_EQ(Lookup(cache, "a", MakeFileInfo(1, 1, 1)), "A");
+}
@@ -0,0 +1,206 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "output/Source.hxx"
+#include "output/SharedConvert.hxx"
+#include "filter/Prepared.hxx"
+#include "filter/plugins/ConvertFilterPlugin.hxx"
+#include "MusicPipe.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicChunk.hxx"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+static constexpr AudioFormat in_audio_format{44100, SampleFormat::S16, 2};
+static constexpr AudioFormat out_audio_format{44100, SampleFormat::S32, 2};
+
+static constexpr std::size_t FRAMES_PER_CHUNK = 16;
+static constexpr std::size_t IN_SIZE = FRAMES_PER_CHUNK * 2 * 2;
+
+/**
+ * The size of the output of a chunk converted by the
+ * #SharedConvertStage.  The outputs' own filter does not convert
+ * anything in this test, which allows telling which chain was
+ * used.
+ */
+static constexpr std::size_t SHARED_SIZE = FRAMES_PER_CHUNK * 2 * 4;
+
+static MusicChunkPtr
+MakeChunk(MusicBuffer &buffer, unsigned value) noexcept
+{
+	auto chunk = buffer.Allocate();
+	auto w = chunk->Write(in_audio_format, SongTime::zero(), 0);
+	auto *p = reinterpret_cast<int16_t *>(w.data());
+	for (std::size_t i = 0; i < FRAMES_PER_CHUNK * 2; ++i)
+		p[i] = static_cast<int16_t>(value * 100 + i);
+	chunk->Expand(in_audio_format, IN_SIZE);
+	return chunk;
+}
+
+/**
+ * An audio output as seen by #AudioOutputControl, without the
+ * thread and the device.
+ */
+struct TestOutput {
+	const char *const name;
+
+	const std::unique_ptr<PreparedFilter> prepared_filter =
+		convert_filter_prepare();
+
+	AudioOutputSource source;
+
+	explicit TestOutput(const char *_name) noexcept
+		:name(_name) {}
+
+	/**
+	 * Open (or reopen) the output like
+	 * AudioOutputControl::InternalOpen() does.
+	 */
+	void Open(const MusicPipe &pipe,
+		  std::shared_ptr<SharedConvertStage> stage) {
+		Leave();
+		source.Open(in_audio_format, pipe, nullptr, nullptr,
+			    *prepared_filter);
+		stage->Join(name, in_audio_format, nullptr, nullptr);
+		source.SetSharedConvert(std::move(stage));
+	}
+
+	void Leave() noexcept {
+		if (const auto stage = source.SetSharedConvert(nullptr))
+			stage->Leave(name);
+	}
+
+	void Close() noexcept {
+		Leave();
+		source.Close();
+	}
+
+	/**
+	 * Read the filtered data of the next chunk.
+	 */
+	std::vector<std::byte> Read(Mutex &mutex) {
+		const std::scoped_lock lock{mutex};
+
+		if (!source.Fill(mutex))
+			return {};
+
+		source.ReadTag();
+
+		const auto data = source.PeekData();
+		std::vector<std::byte> result{data.begin(), data.end()};
+		source.ConsumeData(data.size());
+		return result;
+	}
+};
+
+class SharedConvertTest : public ::testing::Test {
+protected:
+	Mutex mutex;
+
+	MusicBuffer buffer{8 * CHUNK_SIZE};
+	MusicPipe pipe;
+
+	const std::shared_ptr<SharedConvertStage> stage =
+		std::make_shared<SharedConvertStage>(out_audio_format, false);
+
+	void SetUp() override {
+		for (unsigned i = 0; i < 8; ++i)
+			pipe.Push(MakeChunk(buffer, i));
+	}
+
+	void TearDown() override {
+		pipe.Clear();
+	}
+};
+
+/**
+ * Outputs join and leave while a stream is being played; each one
+ * must stick to one filter chain until the stream is cancelled.
+ */
+TEST_F(SharedConvertTest, JoinLeave)
+{
+	TestOutput a{"a"}, b{"b"}, c{"c"};
+
+	/* "a" is alone; it converts by itself */
+	a.Open(pipe, stage);
+	EXPECT_EQ(a.Read(mutex).size(), IN_SIZE);
+
+	/* "b" joins and uses the shared stage */
+	b.Open(pipe, stage);
+	const auto b0 = b.Read(mutex);
+	const auto b1 = b.Read(mutex);
+	EXPECT_EQ(b0.size(), SHARED_SIZE);
+	EXPECT_EQ(b1.size(), SHARED_SIZE);
+
+	/* the shared stage could provide the next chunk for "a", but
+	   "a" must not switch in the middle of the stream */
+	EXPECT_EQ(a.Read(mutex).size(), IN_SIZE);
+	EXPECT_EQ(a.Read(mutex).size(), IN_SIZE);
+
+	/* after a cancel, "a" starts over at the beginning of the
+	   pipe, and this time, it joins the shared stage */
+	a.source.Cancel();
+	EXPECT_EQ(a.Read(mutex), b0);
+	EXPECT_EQ(a.Read(mutex), b1);
+	const auto a2 = a.Read(mutex);
+	EXPECT_EQ(a2.size(), SHARED_SIZE);
+
+	/* "b" leaves in the middle of the stream; "a" keeps using
+	   the shared stage */
+	b.Close();
+	const auto a3 = a.Read(mutex);
+	EXPECT_EQ(a3.size(), SHARED_SIZE);
+
+	/* "c" joins in the middle of the stream; it gets the chunks
+	   which are still in the pipe from the shared stage */
+	c.Open(pipe, stage);
+	EXPECT_EQ(c.Read(mutex), b0);
+	EXPECT_EQ(c.Read(mutex), b1);
+	EXPECT_EQ(c.Read(mutex), a2);
+	EXPECT_EQ(c.Read(mutex), a3);
+	const auto c4 = c.Read(mutex);
+	EXPECT_EQ(c4.size(), SHARED_SIZE);
+	EXPECT_EQ(a.Read(mutex), c4);
+
+	/* "a" leaves; "c" is alone, but it does not switch back to
+	   its own filter */
+	a.Close();
+	EXPECT_EQ(c.Read(mutex).size(), SHARED_SIZE);
+
+	c.Close();
+}
+
+/**
+ * An output which is out of step with the shared stage converts by
+ * itself.
+ */
+TEST_F(SharedConvertTest, OutOfStep)
+{
+	TestOutput a{"a"}, b{"b"};
+
+	/* "b" is alone and plays the first four chunks */
+	b.Open(pipe, stage);
+	for (unsigned i = 0; i < 4; ++i)
+		EXPECT_EQ(b.Read(mutex).size(), IN_SIZE);
+
+	/* "a" starts the shared chain at the beginning of the
+	   pipe */
+	a.Open(pipe, stage);
+	EXPECT_EQ(a.Read(mutex).size(), SHARED_SIZE);
+	EXPECT_EQ(a.Read(mutex).size(), SHARED_SIZE);
+
+	/* "b" is reopened; it continues with chunk 4, which the
+	   shared stage cannot provide */
+	b.Open(pipe, stage);
+	EXPECT_EQ(b.Read(mutex).size(), IN_SIZE);
+	EXPECT_EQ(b.Read(mutex).size(), IN_SIZE);
+
+	EXPECT_EQ(a.Read(mutex).size(), SHARED_SIZE);
+
+	a.Close();
+	b.Close();
+}
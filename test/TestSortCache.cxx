@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "MakeTag.hxx"
+#include "MakeSong.hxx"
+#include "db/plugins/simple/SortCache.hxx"
+#include "db/plugins/simple/DatabaseJournal.hxx"
+#include "db/DatabaseLock.hxx"
+#include "lib/icu/Init.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using Strings = std::vector<std::string>;
+
+class SortCacheTest : public ::testing::Test {
+protected:
+	Directory root{{}, nullptr};
+
+	SortCache cache;
+
+	void SetUp() override {
+		/* for Directory::Sort() */
+		IcuInit();
+
+		const ScopeDatabaseLock protect;
+
+		auto &a = *root.CreateChild("a");
+		AddSong(a, "1.ogg", MakeTag(TAG_ARTIST, "Foo", TAG_TITLE, "C"));
+		AddSong(a, "2.ogg", MakeTag(TAG_ARTIST, "Bar", TAG_TITLE, "B"));
+
+		auto &b = *root.CreateChild("b");
+		AddSong(b, "3.ogg", MakeTag(TAG_ARTIST, "Foo", TAG_TITLE, "A"));
+		AddSong(b, "4.ogg",
+			MakeTag(TAG_ARTIST, "Baz", TAG_TITLE, "D")).in_playlist = true;
+	}
+
+	void TearDown() override {
+		IcuFinish();
+	}
+
+	std::shared_ptr<const SortCache::SongList> Get(TagType sort,
+						       bool descending=false,
+						       bool hide_playlist_targets=false) {
+		const ScopeDatabaseSharedLock protect;
+		return cache.Get(root, hide_playlist_targets, sort, descending);
+	}
+
+	static Strings ToURIs(const SortCache::SongList &songs) {
+		Strings result;
+		for (const Song *song : songs)
+			result.emplace_back(song->GetURI());
+		return result;
+	}
+};
+
+TEST_F(SortCacheTest, Sort)
+{
+	/* songs with the same value remain in the order of
+	   Directory::Walk() */
+	EXPECT_EQ(ToURIs(*Get(TAG_ARTIST)),
+		  (Strings{"a/2.ogg", "b/4.ogg", "a/1.ogg", "b/3.ogg"}));
+	EXPECT_EQ(ToURIs(*Get(TAG_TITLE)),
+		  (Strings{"b/3.ogg", "a/2.ogg", "a/1.ogg", "b/4.ogg"}));
+	EXPECT_EQ(ToURIs(*Get(TAG_TITLE, true)),
+		  (Strings{"b/4.ogg", "a/1.ogg", "a/2.ogg", "b/3.ogg"}));
+}
+
+TEST_F(SortCacheTest, HidePlaylistTargets)
+{
+	EXPECT_EQ(ToURIs(*Get(TAG_TITLE, false, true)),
+		  (Strings{"b/3.ogg", "a/2.ogg", "a/1.ogg"}));
+}
+
+TEST_F(SortCacheTest, Cached)
+{
+	const auto a = Get(TAG_ARTIST);
+	const auto b = Get(TAG_TITLE);
+	EXPECT_NE(a, b);
+	EXPECT_EQ(Get(TAG_ARTIST), a);
+	EXPECT_EQ(Get(TAG_TITLE), b);
+	EXPECT_NE(Get(TAG_TITLE, true), b);
+
+	cache.Clear();
+	EXPECT_NE(Get(TAG_ARTIST), a);
+}
+
+TEST_F(SortCacheTest, Invalidate)
+{
+	const auto a = Get(TAG_ARTIST);
+
+	/* a modification discards the cache */
+	{
+		const ScopeDatabaseLock protect;
+		AddSong(root, "5.ogg", MakeTag(TAG_ARTIST, "Aaa"));
+	}
+
+	const auto b = Get(TAG_ARTIST);
+	EXPECT_NE(b, a);
+	EXPECT_EQ(ToURIs(*b),
+		  (Strings{"5.ogg", "a/2.ogg", "b/4.ogg", "a/1.ogg", "b/3.ogg"}));
+}
+
+TEST_F(SortCacheTest, NotModified)
+{
+	const auto a = Get(TAG_ARTIST);
+
+	/* an exclusive lock which does not modify the tree (like
+	   Save() after an update which found nothing new) keeps the
+	   cache */
+	{
+		const ScopeDatabaseLock protect;
+		root.PruneEmpty();
+		root.Sort();
+		journal_clear(root);
+	}
+
+	EXPECT_EQ(Get(TAG_ARTIST), a);
+
+	/* adding a song discards it */
+	{
+		const ScopeDatabaseLock protect;
+		AddSong(*root.FindChild("a"), "0.ogg",
+			MakeTag(TAG_ARTIST, "Zzz"));
+	}
+
+	EXPECT_NE(Get(TAG_ARTIST), a);
+}
+
+TEST_F(SortCacheTest, Evict)
+{
+	const auto a = Get(TAG_ARTIST);
+
+	/* the least recently used entry is evicted */
+	Get(TAG_TITLE);
+	Get(TAG_ALBUM);
+	Get(TAG_DATE);
+	EXPECT_EQ(Get(TAG_ARTIST), a);
+	Get(TAG_GENRE);
+	Get(TAG_TITLE, true);
+	Get(TAG_ALBUM, true);
+	Get(TAG_DATE, true);
+	EXPECT_NE(Get(TAG_ARTIST), a);
+}
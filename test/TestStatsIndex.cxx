@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "MakeTag.hxx"
+#include "MakeSong.hxx"
+#include "db/plugins/simple/StatsIndex.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/Stats.hxx"
+
+#include <gtest/gtest.h>
+
+template<typename... Args>
+static Tag
+MakeTagWithDuration(unsigned seconds, Args&&... args) noexcept
+{
+	TagBuilder tag;
+	tag.SetDuration(SignedSongTime::FromS(seconds));
+	BuildTag(tag, std::forward<Args>(args)...);
+	return tag.Commit();
+}
+
+static void
+RemoveAll(StatsIndex &index, const Directory &directory) noexcept
+{
+	for (const auto &song : directory.songs)
+		index.Remove(song);
+
+	for (const auto &child : directory.children)
+		RemoveAll(index, child);
+}
+
+class StatsIndexTest : public ::testing::Test {
+protected:
+	Directory root{{}, nullptr};
+
+	StatsIndex index;
+
+	Song *foo, *bar;
+
+	void SetUp() override {
+		const ScopeDatabaseLock protect;
+
+		auto &a = *root.CreateChild("a");
+		foo = &AddSong(a, "1.ogg",
+			       MakeTagWithDuration(10, TAG_ARTIST, "Foo",
+						   TAG_ALBUM, "X"));
+		bar = &AddSong(a, "2.ogg",
+			       MakeTagWithDuration(20, TAG_ARTIST, "Bar",
+						   TAG_ALBUM, "X"));
+		AddSong(a, "x.flac",
+			MakeTagWithDuration(60, TAG_ARTIST, "Baz",
+					    TAG_ALBUM, "Z")).in_playlist = true;
+
+		/* a CUE sheet referring to "x.flac"; the tracks
+		   inherit the tags they do not have */
+		auto &cue = *a.CreateChild("x.cue");
+		cue.device = DEVICE_PLAYLIST;
+		AddSong(cue, "track001",
+			MakeTagWithDuration(30, TAG_TITLE, "One")).target = "../x.flac";
+		AddSong(cue, "track002",
+			MakeTagWithDuration(30, TAG_ARTIST, "Qux")).target = "../x.flac";
+
+		index.Build(root);
+	}
+
+	DatabaseStats Get(bool hide_playlist_targets) const {
+		const ScopeDatabaseSharedLock protect;
+		return index.Get(hide_playlist_targets);
+	}
+};
+
+TEST_F(StatsIndexTest, Build)
+{
+	auto stats = Get(false);
+	EXPECT_EQ(stats.song_count, 5U);
+	EXPECT_EQ(stats.total_duration, std::chrono::seconds{150});
+	EXPECT_EQ(stats.artist_count, 4U); // Foo, Bar, Baz, Qux
+	EXPECT_EQ(stats.album_count, 2U); // X, Z
+
+	EXPECT_GT(index.GetSongMemory(), 0U);
+}
+
+TEST_F(StatsIndexTest, HidePlaylistTargets)
+{
+	/* "x.flac" is hidden, but its artist and album are still
+	   visible through the CUE tracks */
+	auto stats = Get(true);
+	EXPECT_EQ(stats.song_count, 4U);
+	EXPECT_EQ(stats.total_duration, std::chrono::seconds{90});
+	EXPECT_EQ(stats.artist_count, 4U);
+	EXPECT_EQ(stats.album_count, 2U);
+}
+
+TEST_F(StatsIndexTest, Remove)
+{
+	{
+		const ScopeDatabaseLock protect;
+		index.Remove(*bar);
+		bar->parent.RemoveSong(bar);
+	}
+
+	auto stats = Get(false);
+	EXPECT_EQ(stats.song_count, 4U);
+	EXPECT_EQ(stats.total_duration, std::chrono::seconds{130});
+	EXPECT_EQ(stats.artist_count, 3U);
+	EXPECT_EQ(stats.album_count, 2U);
+}
+
+TEST_F(StatsIndexTest, Update)
+{
+	{
+		const ScopeDatabaseLock protect;
+		Tag old_tag = std::move(foo->tag);
+		foo->tag = MakeTagWithDuration(15, TAG_ARTIST, "Baz",
+					       TAG_ALBUM, "W");
+		index.Update(*foo, old_tag);
+	}
+
+	auto stats = Get(false);
+	EXPECT_EQ(stats.song_count, 5U);
+	EXPECT_EQ(stats.total_duration, std::chrono::seconds{155});
+	EXPECT_EQ(stats.artist_count, 3U); // Bar, Baz, Qux
+	EXPECT_EQ(stats.album_count, 3U); // W, X, Z
+}
+
+TEST_F(StatsIndexTest, RemoveAll)
+{
+	{
+		const ScopeDatabaseLock protect;
+		RemoveAll(index, root);
+	}
+
+	auto stats = Get(false);
+	EXPECT_EQ(stats.song_count, 0U);
+	EXPECT_EQ(stats.total_duration, std::chrono::seconds{0});
+	EXPECT_EQ(stats.artist_count, 0U);
+	EXPECT_EQ(stats.album_count, 0U);
+	EXPECT_EQ(index.GetSongMemory(), 0U);
+}
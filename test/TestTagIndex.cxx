@@ -0,0 +1,208 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "MakeTag.hxx"
+#include "MakeSong.hxx"
+#include "db/plugins/simple/TagIndex.hxx"
+#include "db/DatabaseLock.hxx"
+#include "lib/icu/Init.hxx"
+#include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+static SongFilter
+MakeFilter(const char *expression)
+{
+	const char *const args[] = {expression};
+	SongFilter filter;
+	filter.Parse(args);
+	filter.Optimize();
+	return filter;
+}
+
+class TagIndexTest : public ::testing::Test {
+protected:
+	Directory root{{}, nullptr};
+
+	TagIndex index{TagMask{TAG_ARTIST} | TAG_ALBUM | TAG_ALBUM_ARTIST};
+
+	void SetUp() override {
+		/* for case-folding filters */
+		IcuInit();
+
+		const ScopeDatabaseLock protect;
+
+		auto &a = *root.CreateChild("a");
+		AddSong(a, "1.ogg", MakeTag(TAG_ARTIST, "Foo", TAG_ALBUM, "X"));
+		AddSong(a, "2.ogg", MakeTag(TAG_ARTIST, "Bar", TAG_ALBUM, "X"));
+
+		auto &b = *root.CreateChild("b");
+		AddSong(b, "3.ogg", MakeTag(TAG_ARTIST, "Foo", TAG_ALBUM, "Y"));
+		AddSong(b, "4.ogg", MakeTag(TAG_ALBUM, "Y"));
+
+		AddSong(root, "5.ogg", MakeTag(TAG_ARTIST, "Baz"));
+
+		index.Build(root);
+	}
+
+	void TearDown() override {
+		IcuFinish();
+	}
+
+	/**
+	 * Returns the URIs of all matching songs, or a single empty
+	 * string if the index could not be used.
+	 */
+	std::vector<std::string> Find(const char *expression,
+				      const Directory *base=nullptr) const {
+		const auto filter = MakeFilter(expression);
+		std::vector<std::string> result;
+
+		const ScopeDatabaseSharedLock protect;
+		if (!index.Visit(base != nullptr ? *base : root, filter, false,
+				 [&result](const LightSong &song){
+					 result.emplace_back(song.GetURI());
+				 }))
+			result.emplace_back();
+		return result;
+	}
+
+	std::vector<std::string> Unique(TagType type,
+					RangeArg window=RangeArg::All(),
+					const std::string *after=nullptr) const {
+		std::vector<std::string> result;
+
+		const ScopeDatabaseSharedLock protect;
+		index.VisitUniqueValues(type, false, after, window,
+					[&result](std::string_view value){
+						result.emplace_back(value);
+					});
+		return result;
+	}
+};
+
+using Strings = std::vector<std::string>;
+
+TEST_F(TagIndexTest, Equality)
+{
+	EXPECT_EQ(Find("(Artist == 'Foo')"), (Strings{"a/1.ogg", "b/3.ogg"}));
+	EXPECT_EQ(Find("(Artist == 'Baz')"), (Strings{"5.ogg"}));
+	EXPECT_EQ(Find("(Artist == 'Nobody')"), Strings{});
+	EXPECT_EQ(index.GetHits(), 3U);
+	EXPECT_EQ(index.GetMisses(), 0U);
+}
+
+TEST_F(TagIndexTest, Prefix)
+{
+	/* songs are visited in the order of Directory::Walk() */
+	EXPECT_EQ(Find("(Artist starts_with_cs 'Ba')"),
+		  (Strings{"5.ogg", "a/2.ogg"}));
+}
+
+TEST_F(TagIndexTest, Empty)
+{
+	/* an empty value matches songs which do not have the tag */
+	EXPECT_EQ(Find("(Artist == '')"), (Strings{"b/4.ogg"}));
+}
+
+TEST_F(TagIndexTest, Fallback)
+{
+	/* "AlbumArtist" falls back to "Artist", just like
+	   TagSongFilter does */
+	EXPECT_EQ(Find("(AlbumArtist == 'Foo')"),
+		  (Strings{"a/1.ogg", "b/3.ogg"}));
+}
+
+TEST_F(TagIndexTest, Combined)
+{
+	/* the index picks the most selective item; the others are
+	   still applied */
+	EXPECT_EQ(Find("((Artist == 'Foo') AND (Album == 'Y'))"),
+		  (Strings{"b/3.ogg"}));
+}
+
+TEST_F(TagIndexTest, Base)
+{
+	const Directory *b;
+
+	{
+		const ScopeDatabaseSharedLock protect;
+		b = root.FindChild("b");
+	}
+
+	ASSERT_NE(b, nullptr);
+	EXPECT_EQ(Find("(Artist == 'Foo')", b), (Strings{"b/3.ogg"}));
+}
+
+TEST_F(TagIndexTest, NotIndexed)
+{
+	EXPECT_FALSE(index.CanVisit(MakeFilter("(Title == 'Foo')")));
+	EXPECT_FALSE(index.CanVisit(MakeFilter("(Artist contains 'Foo')")));
+	EXPECT_FALSE(index.CanVisit(MakeFilter("(Artist != 'Foo')")));
+
+	/* the keys are not case-folded, so "search" is not
+	   accelerated */
+	EXPECT_FALSE(index.CanVisit(MakeFilter("(Artist eq_ci 'Foo')")));
+	EXPECT_FALSE(index.CanVisit(MakeFilter("(Artist starts_with_ci 'Foo')")));
+
+	EXPECT_TRUE(index.CanVisit(MakeFilter("(Artist == 'Foo')")));
+
+	EXPECT_EQ(Find("(Title == 'Foo')"), Strings{""});
+	EXPECT_EQ(index.GetMisses(), 1U);
+}
+
+TEST_F(TagIndexTest, Modify)
+{
+	Song *song;
+
+	{
+		const ScopeDatabaseLock protect;
+		Directory &a = *root.FindChild("a");
+		index.Add(AddSong(a, "6.ogg", MakeTag(TAG_ARTIST, "Foo")));
+
+		song = a.FindSong("2.ogg");
+		ASSERT_NE(song, nullptr);
+		Tag old_tag = std::move(song->tag);
+		song->tag = MakeTag(TAG_ARTIST, "Foo");
+		index.Update(*song, old_tag);
+	}
+
+	EXPECT_EQ(Find("(Artist == 'Foo')"),
+		  (Strings{"a/1.ogg", "a/2.ogg", "a/6.ogg", "b/3.ogg"}));
+	EXPECT_EQ(Find("(Artist == 'Bar')"), Strings{});
+
+	{
+		const ScopeDatabaseLock protect;
+		index.Remove(*song);
+		song->parent.RemoveSong(song);
+	}
+
+	EXPECT_EQ(Find("(Artist == 'Foo')"),
+		  (Strings{"a/1.ogg", "a/6.ogg", "b/3.ogg"}));
+	EXPECT_EQ(Unique(TAG_ARTIST), (Strings{"", "Baz", "Foo"}));
+}
+
+TEST_F(TagIndexTest, UniqueValues)
+{
+	EXPECT_EQ(Unique(TAG_ARTIST), (Strings{"", "Bar", "Baz", "Foo"}));
+	EXPECT_EQ(Unique(TAG_ARTIST, {1, 3}), (Strings{"Bar", "Baz"}));
+	EXPECT_EQ(Unique(TAG_ALBUM), (Strings{"", "X", "Y"}));
+}
+
+TEST_F(TagIndexTest, UniqueValuesResume)
+{
+	const std::string empty, bar{"Bar"}, bay{"Bay"};
+	EXPECT_EQ(Unique(TAG_ARTIST, RangeArg::All(), &empty),
+		  (Strings{"Bar", "Baz", "Foo"}));
+	EXPECT_EQ(Unique(TAG_ARTIST, RangeArg::All(), &bar),
+		  (Strings{"Baz", "Foo"}));
+	EXPECT_EQ(Unique(TAG_ARTIST, {1, 2}, &bar), (Strings{"Foo"}));
+
+	/* the last value may have been removed meanwhile */
+	EXPECT_EQ(Unique(TAG_ARTIST, RangeArg::All(), &bay),
+		  (Strings{"Baz", "Foo"}));
+}
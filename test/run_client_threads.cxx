@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Measure how much CPU time the main thread spends per command with
+ * and without client I/O threads ("client_threads").  Each client
+ * sends small commands (optionally in pipelined batches); the main
+ * thread answers each with a "status"-like response.
+ */
+
+#include "client/Threads.hxx"
+#include "client/DirectSocket.hxx"
+#include "event/Loop.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/PrintException.hxx"
+#include "util/SpanCast.hxx"
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+
+/**
+ * A response similar to the one of "status".
+ */
+static constexpr std::string_view status_format =
+	"volume: {0}\nrepeat: 0\nrandom: 1\nsingle: 0\nconsume: 0\n"
+	"playlist: {0}\nplaylistlength: {0}\nstate: play\nsong: {0}\n"
+	"songid: {0}\nelapsed: {0}.{0:03}\nbitrate: 320\n"
+	"audio: 44100:16:2\nOK\n";
+
+static bool
+WriteResponse(ClientSocket &socket, unsigned n) noexcept
+{
+	return socket.VFmt(status_format, fmt::make_format_args(n));
+}
+
+static std::size_t
+ResponseSize(unsigned n) noexcept
+{
+	return fmt::vformat(status_format, fmt::make_format_args(n)).size();
+}
+
+class Handler final : public ClientSocketHandler {
+	EventLoop &loop;
+	unsigned &n_open;
+
+	unsigned n_commands = 0;
+
+public:
+	std::unique_ptr<ClientSocket> socket;
+
+	Handler(EventLoop &_loop, unsigned &_n_open) noexcept
+		:loop(_loop), n_open(_n_open) {
+		++n_open;
+	}
+
+private:
+	void Done() noexcept {
+		/* like Client, close the socket after an error */
+		if (socket->IsDefined())
+			socket->Close();
+
+		if (--n_open == 0)
+			loop.InjectBreak();
+	}
+
+public:
+	/* virtual methods from class ClientSocketHandler */
+	InputResult OnSocketInput(std::span<std::byte> src) noexcept override {
+		std::string_view s = ToStringView(src);
+		std::size_t consumed = 0;
+
+		for (auto newline = s.find('\n'); newline != s.npos;
+		     newline = s.find('\n')) {
+			s.remove_prefix(newline + 1);
+			consumed += newline + 1;
+
+			if (!WriteResponse(*socket, n_commands++))
+				return InputResult::CLOSED;
+		}
+
+		socket->ConsumeInput(consumed);
+		return InputResult::MORE;
+	}
+
+	void OnSocketError(std::exception_ptr ep) noexcept override {
+		PrintException(ep);
+		Done();
+	}
+
+	void OnSocketClosed() noexcept override {
+		Done();
+	}
+};
+
+/**
+ * @param batch the number of commands sent before waiting for their
+ * responses
+ */
+static void
+RunPeer(UniqueSocketDescriptor fd, unsigned n_commands,
+	unsigned batch) noexcept
+{
+	fd.SetBlocking();
+
+	std::string request;
+	for (unsigned i = 0; i < batch; ++i)
+		request += "status\n";
+
+	std::byte buffer[16384];
+
+	for (unsigned n = 0; n < n_commands; n += batch) {
+		if (fd.Write(AsBytes(request)) != ssize_t(request.size()))
+			return;
+
+		std::size_t remaining = 0;
+		for (unsigned i = n; i < n + batch; ++i)
+			remaining += ResponseSize(i);
+
+		while (remaining > 0) {
+			const auto nbytes = fd.Read(buffer);
+			if (nbytes <= 0)
+				return;
+
+			remaining -= nbytes;
+		}
+	}
+}
+
+static std::chrono::microseconds
+GetThreadCpuTime() noexcept
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return std::chrono::seconds{ts.tv_sec} +
+		std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds{ts.tv_nsec});
+}
+
+int
+main(int argc, char **argv) noexcept
+try {
+	if (argc < 4 || argc > 5) {
+		fprintf(stderr, "Usage: run_client_threads N_THREADS N_CLIENTS N_COMMANDS [BATCH]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned n_threads = strtoul(argv[1], nullptr, 10);
+	const unsigned n_clients = strtoul(argv[2], nullptr, 10);
+	const unsigned n_commands = strtoul(argv[3], nullptr, 10);
+	const unsigned batch = argc > 4 ? strtoul(argv[4], nullptr, 10) : 1;
+	if (batch == 0)
+		throw std::runtime_error("Invalid batch size");
+
+	EventLoop loop;
+
+	std::unique_ptr<ClientThreads> threads;
+	if (n_threads > 0)
+		threads = std::make_unique<ClientThreads>(loop, n_threads);
+
+	unsigned n_open = 0;
+	std::vector<std::unique_ptr<Handler>> handlers;
+	std::vector<std::thread> peers;
+
+	for (unsigned i = 0; i < n_clients; ++i) {
+		UniqueSocketDescriptor a, b;
+		if (!UniqueSocketDescriptor::CreateSocketPairNonBlock(AF_LOCAL,
+								      SOCK_STREAM, 0,
+								      a, b))
+			throw std::runtime_error("socketpair() failed");
+
+		auto &handler = *handlers.emplace_back(std::make_unique<Handler>(loop, n_open));
+		if (threads)
+			handler.socket = threads->Connect(std::move(a), 16384,
+							  1024 * 1024, handler);
+		else
+			handler.socket = std::make_unique<DirectClientSocket>(a.Release(), loop,
+									      16384, 1024 * 1024,
+									      handler);
+
+		/* the peer closes the connection after the last
+		   response, which ends the handler */
+		peers.emplace_back(RunPeer, std::move(b), n_commands, batch);
+	}
+
+	const auto start_time = std::chrono::steady_clock::now();
+	const auto start_cpu = GetThreadCpuTime();
+
+	loop.Run();
+
+	const auto main_cpu = GetThreadCpuTime() - start_cpu;
+	const auto duration = std::chrono::steady_clock::now() - start_time;
+
+	for (auto &i : peers)
+		i.join();
+
+	std::chrono::microseconds io_cpu{};
+	if (threads)
+		for (const auto &i : threads->GetStats())
+			io_cpu += i.cpu_time;
+
+	const double total = double(n_clients) * n_commands;
+
+	fmt::print("threads={} clients={} commands={} batch={}\n",
+		   n_threads, n_clients, n_commands, batch);
+	fmt::print("wall: {} ms, {:.0f} commands/s\n",
+		   std::chrono::duration_cast<std::chrono::milliseconds>(duration).count(),
+		   total / std::chrono::duration<double>(duration).count());
+	fmt::print("main thread CPU: {} ms, {:.2f} us/command\n",
+		   main_cpu.count() / 1000, main_cpu.count() / total);
+	if (threads)
+		fmt::print("I/O threads CPU: {} ms, {:.2f} us/command\n",
+			   io_cpu.count() / 1000, io_cpu.count() / total);
+
+	handlers.clear();
+	threads.reset();
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,214 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "MusicPipe.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicChunk.hxx"
+#include "pcm/AudioFormat.hxx"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static constexpr AudioFormat audio_format{44100, SampleFormat::S16, 2};
+
+/**
+ * Allocate a chunk and store the given number in its data.
+ */
+static MusicChunkPtr
+MakeChunk(MusicBuffer &buffer, unsigned value) noexcept
+{
+	auto chunk = buffer.Allocate();
+	if (!chunk)
+		return chunk;
+
+	auto w = chunk->Write(audio_format, SongTime::zero(), 0);
+	std::memcpy(w.data(), &value, sizeof(value));
+	chunk->Expand(audio_format, sizeof(value));
+	return chunk;
+}
+
+static unsigned
+GetValue(const MusicChunk &chunk) noexcept
+{
+	unsigned value;
+	std::memcpy(&value, chunk.GetBuffer(), sizeof(value));
+	return value;
+}
+
+TEST(MusicPipe, Basic)
+{
+	MusicBuffer buffer{4 * CHUNK_SIZE};
+	MusicPipe pipe;
+
+	EXPECT_TRUE(pipe.IsEmpty());
+	EXPECT_EQ(pipe.Peek(), nullptr);
+	EXPECT_FALSE(pipe.Shift());
+
+	for (unsigned i = 0; i < 4; ++i)
+		pipe.Push(MakeChunk(buffer, i));
+
+	EXPECT_TRUE(buffer.IsFull());
+	EXPECT_FALSE(buffer.Allocate());
+	EXPECT_EQ(pipe.GetSize(), 4U);
+
+	/* walk the links like SharedPipeConsumer does */
+	unsigned n = 0;
+	for (const auto *i = pipe.Peek(); i != nullptr;
+	     i = i->next.load(std::memory_order_acquire))
+		EXPECT_EQ(GetValue(*i), n++);
+	EXPECT_EQ(n, 4U);
+
+	for (unsigned i = 0; i < 2; ++i) {
+		auto chunk = pipe.Shift();
+		ASSERT_TRUE(chunk);
+		EXPECT_EQ(GetValue(*chunk), i);
+		EXPECT_EQ(chunk->next.load(), nullptr);
+	}
+
+	EXPECT_FALSE(buffer.IsFull());
+
+	/* the freed chunks can be reused */
+	pipe.Push(MakeChunk(buffer, 4));
+	pipe.Push(MakeChunk(buffer, 5));
+	EXPECT_EQ(pipe.GetSize(), 4U);
+
+	for (unsigned i = 2; i < 6; ++i) {
+		auto chunk = pipe.Shift();
+		ASSERT_TRUE(chunk);
+		EXPECT_EQ(GetValue(*chunk), i);
+	}
+
+	EXPECT_TRUE(pipe.IsEmpty());
+	EXPECT_EQ(pipe.Peek(), nullptr);
+
+	/* push again after the pipe has become empty */
+	pipe.Push(MakeChunk(buffer, 6));
+	EXPECT_EQ(GetValue(*pipe.Peek()), 6U);
+
+	pipe.Clear();
+	EXPECT_TRUE(pipe.IsEmpty());
+	EXPECT_TRUE(buffer.IsEmptyUnsafe());
+}
+
+/**
+ * One thread pushes numbered chunks while another one shifts them,
+ * with a buffer so small that the pipe is empty most of the time;
+ * this exercises the race between Push() and removing the last
+ * chunk.
+ */
+TEST(MusicPipe, Threads)
+{
+	static constexpr unsigned N = 200000;
+
+	MusicBuffer buffer{3 * CHUNK_SIZE};
+	MusicPipe pipe;
+
+	std::thread producer([&]{
+		for (unsigned i = 0; i < N;) {
+			auto chunk = MakeChunk(buffer, i);
+			if (!chunk) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			pipe.Push(std::move(chunk));
+			++i;
+		}
+	});
+
+	unsigned expected = 0;
+	while (expected < N) {
+		if (pipe.IsEmpty()) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		const auto *peeked = pipe.Peek();
+		auto chunk = pipe.Shift();
+		ASSERT_TRUE(chunk);
+		ASSERT_EQ(chunk.get(), peeked);
+		ASSERT_EQ(GetValue(*chunk), expected);
+		++expected;
+	}
+
+	producer.join();
+
+	EXPECT_TRUE(pipe.IsEmpty());
+	EXPECT_TRUE(buffer.IsEmptyUnsafe());
+}
+
+/**
+ * Several threads allocate and return chunks concurrently.
+ */
+TEST(MusicBuffer, Threads)
+{
+	static constexpr unsigned N_THREADS = 4, N = 50000;
+
+	MusicBuffer buffer{8 * CHUNK_SIZE};
+
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < N_THREADS; ++t)
+		threads.emplace_back([&buffer, t]{
+			for (unsigned i = 0; i < N; ++i) {
+				auto a = MakeChunk(buffer, t);
+				auto b = MakeChunk(buffer, t + 1);
+
+				/* nobody else may have written into
+				   our chunks */
+				if (a) {
+					EXPECT_EQ(GetValue(*a), t);
+				}
+
+				if (b) {
+					EXPECT_EQ(GetValue(*b), t + 1);
+				}
+			}
+		});
+
+	for (auto &i : threads)
+		i.join();
+
+	EXPECT_TRUE(buffer.IsEmptyUnsafe());
+	EXPECT_FALSE(buffer.IsFull());
+}
+
+TEST(MusicBuffer, Adapt)
+{
+	using namespace std::chrono_literals;
+
+	MusicBuffer buffer{8192 * CHUNK_SIZE, 20ms};
+	EXPECT_EQ(buffer.GetSize(), 8192U);
+	EXPECT_EQ(buffer.GetChunkCapacity(), CHUNK_SIZE - sizeof(MusicChunk));
+
+	/* 20ms of CD audio fit into the smallest chunk */
+	buffer.Adapt(audio_format);
+	EXPECT_EQ(buffer.GetSize(), 8192U);
+
+	/* high-resolution audio gets larger chunks */
+	constexpr AudioFormat hires{384000, SampleFormat::S32, 8};
+	buffer.Adapt(hires);
+	EXPECT_GE(buffer.GetChunkCapacity(), hires.TimeToSize(20ms));
+	EXPECT_EQ(buffer.GetSize(),
+		  8192 * CHUNK_SIZE / (buffer.GetChunkCapacity() + sizeof(MusicChunk)));
+
+	auto chunk = buffer.Allocate();
+	ASSERT_TRUE(chunk);
+	EXPECT_EQ(chunk->capacity, buffer.GetChunkCapacity());
+
+	/* the chunk size cannot change while chunks are in use */
+	buffer.Adapt(audio_format);
+	EXPECT_GE(buffer.GetChunkCapacity(), hires.TimeToSize(20ms));
+
+	chunk.reset();
+	buffer.Adapt(audio_format);
+	EXPECT_EQ(buffer.GetSize(), 8192U);
+
+	/* very large chunks are limited to keep enough of them in
+	   the buffer */
+	MusicBuffer small{128 * CHUNK_SIZE, 1000ms};
+	small.Adapt(hires);
+	EXPECT_EQ(small.GetSize(), 64U);
+}
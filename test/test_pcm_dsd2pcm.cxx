@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "pcm/Features.h" // for ENABLE_DSD
+
+#ifdef ENABLE_DSD
+
+#include "pcm/Dsd2Pcm.hxx"
+
+#ifdef __SSE2__
+#include "pcm/X86Cpu.hxx"
+#endif
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+static constexpr unsigned CHANNELS = 3;
+static constexpr std::size_t N_FRAMES = 4099;
+
+static std::vector<std::byte>
+RandomOctets()
+{
+	std::vector<std::byte> result(N_FRAMES * CHANNELS);
+	for (auto &i : result)
+		i = static_cast<std::byte>(random());
+	return result;
+}
+
+/**
+ * Convert the whole buffer at once.
+ */
+template<typename T>
+static std::vector<T>
+Translate(const std::vector<std::byte> &src)
+{
+	std::vector<T> result(src.size());
+
+	auto dsd2pcm = std::make_unique<MultiDsd2Pcm>();
+	if constexpr (std::is_same_v<T, float>)
+		dsd2pcm->Translate(CHANNELS, N_FRAMES,
+				   src.data(), result.data());
+	else
+		dsd2pcm->TranslateS24(CHANNELS, N_FRAMES,
+				      src.data(), result.data());
+
+	return result;
+}
+
+TEST(PcmTest, Dsd2PcmSilence)
+{
+	const std::vector<std::byte> src(N_FRAMES * CHANNELS,
+					 std::byte{0x69});
+
+	/* once the filter has settled, the silence pattern results
+	   in a small constant DC offset */
+	const std::size_t settled = Dsd2Pcm::HISTORY * CHANNELS;
+
+	const auto f = Translate<float>(src);
+	EXPECT_NEAR(f.back(), 0, 0.01);
+	for (std::size_t i = settled; i < f.size(); ++i)
+		EXPECT_EQ(f[i], f.back());
+
+	const auto s24 = Translate<int32_t>(src);
+	EXPECT_NEAR(s24.back(), f.back() * 0x7fffff, 12);
+	for (std::size_t i = settled; i < s24.size(); ++i)
+		EXPECT_EQ(s24[i], s24.back());
+}
+
+/**
+ * Converting in several pieces of various sizes must produce the
+ * same result as converting all at once.
+ */
+TEST(PcmTest, Dsd2PcmSplit)
+{
+	const auto src = RandomOctets();
+	const auto expected = Translate<float>(src);
+	const auto expected_s24 = Translate<int32_t>(src);
+
+	std::vector<float> result(src.size());
+	std::vector<int32_t> result_s24(src.size());
+
+	auto dsd2pcm = std::make_unique<MultiDsd2Pcm>();
+	auto dsd2pcm_s24 = std::make_unique<MultiDsd2Pcm>();
+
+	for (std::size_t position = 0, n = 1; position < N_FRAMES;) {
+		n = std::min(n, N_FRAMES - position);
+
+		const std::size_t offset = position * CHANNELS;
+		dsd2pcm->Translate(CHANNELS, n, src.data() + offset,
+				   result.data() + offset);
+		dsd2pcm_s24->TranslateS24(CHANNELS, n, src.data() + offset,
+					  result_s24.data() + offset);
+
+		position += n;
+		n = n * 3 + 1;
+	}
+
+	EXPECT_EQ(result, expected);
+	EXPECT_EQ(result_s24, expected_s24);
+}
+
+TEST(PcmTest, Dsd2PcmS24)
+{
+	const auto src = RandomOctets();
+	const auto f = Translate<float>(src);
+	const auto s24 = Translate<int32_t>(src);
+
+	/* each of the 12 table values is rounded separately in the
+	   integer implementation */
+	for (std::size_t i = 0; i < src.size(); ++i)
+		EXPECT_NEAR(s24[i], f[i] * 0x7fffff, 12);
+}
+
+/**
+ * 20 stereo frames of pseudo-random DSD data.
+ */
+static constexpr std::byte golden_src[] = {
+	std::byte{0x41}, std::byte{0x96}, std::byte{0x27}, std::byte{0xc4},
+	std::byte{0xf9}, std::byte{0x95}, std::byte{0xd9}, std::byte{0x9c},
+	std::byte{0xbf}, std::byte{0x0f}, std::byte{0x0a}, std::byte{0x31},
+	std::byte{0x23}, std::byte{0xaf}, std::byte{0x7d}, std::byte{0xc4},
+	std::byte{0xe2}, std::byte{0xd2}, std::byte{0xe2}, std::byte{0xe3},
+	std::byte{0xe9}, std::byte{0x93}, std::byte{0x50}, std::byte{0x28},
+	std::byte{0x2c}, std::byte{0x75}, std::byte{0x42}, std::byte{0xb3},
+	std::byte{0x4d}, std::byte{0xe4}, std::byte{0xf7}, std::byte{0xef},
+	std::byte{0xee}, std::byte{0x56}, std::byte{0xe1}, std::byte{0xca},
+	std::byte{0x31}, std::byte{0xad}, std::byte{0x99}, std::byte{0x69},
+};
+
+/**
+ * The output of the FIFO based converter (MPD 0.24) for
+ * #golden_src, starting from the reset state.
+ */
+static constexpr float golden_float[] = {
+	-0x1.37d234p-8f, -0x1.37b618p-8f, 0x1.f2fbdcp-14f, -0x1.7c4518p-14f,
+	-0x1.cf4ea4p-10f, -0x1.725cfep-14f, 0x1.48a108p-12f, 0x1.a0e258p-10f,
+	0x1.7867bep-5f, -0x1.ad04f4p-8f, -0x1.66ea38p-2f, 0x1.2e254cp-5f,
+	-0x1.98be1p-2f, -0x1.38e89cp-5f, 0x1.1629cap-1f, -0x1.04282ep-2f,
+	0x1.763b48p-2f, 0x1.7d0818p-7f, 0x1.7c03bep-2f, -0x1.7905a6p-3f,
+	0x1.e40d98p-4f, -0x1.8cb5f4p-5f, -0x1.ff6574p-2f, 0x1.72f7bcp-3f,
+	0x1.0ed26ep-2f, 0x1.38cd86p-2f, 0x1.eb9f52p-2f, -0x1.ff4cd8p-4f,
+	-0x1.23eba6p-5f, 0x1.7bcd78p-5f, 0x1.937d94p-4f, 0x1.93a698p-6f,
+	-0x1.5f39d2p-3f, -0x1.b2f842p-3f, -0x1.c2e7c4p-2f, -0x1.100c24p-3f,
+	-0x1.a3ebb6p-2f, 0x1.203e74p-2f, -0x1.6f746ep-2f, 0x1.01373ap-2f,
+};
+
+static constexpr int32_t golden_s24[] = {
+	-39912, -39898, 997, -762, -14827, -739,
+	2630, 13340, 385437, -54914, -2940228, 309396,
+	-3348417, -320420, 4557424, -2131204, 3065707, 97544,
+	3113080, -1544284, 991340, -406227, -4189355, 1519481,
+	2218572, 2562482, 4027370, -1047145, -298926, 388920,
+	826346, 206668, -1438620, -1781636, -3693818, -1114309,
+	-3439990, 2361293, -3010189, 2107111,
+};
+
+static_assert(std::size(golden_float) == std::size(golden_src));
+static_assert(std::size(golden_s24) == std::size(golden_src));
+
+/**
+ * Compare with the output of the old converter, which is the
+ * reference for the table-driven and the AVX2 implementation.
+ */
+TEST(PcmTest, Dsd2PcmGolden)
+{
+	constexpr std::size_t n_frames = std::size(golden_src) / 2;
+
+	float f[std::size(golden_src)];
+	int32_t s24[std::size(golden_src)];
+
+	auto dsd2pcm = std::make_unique<MultiDsd2Pcm>();
+	dsd2pcm->Translate(2, n_frames, golden_src, f);
+	for (std::size_t i = 0; i < std::size(f); ++i)
+		EXPECT_EQ(f[i], golden_float[i]) << "sample " << i;
+
+	dsd2pcm->Reset();
+	dsd2pcm->TranslateS24(2, n_frames, golden_src, s24);
+	for (std::size_t i = 0; i < std::size(s24); ++i)
+		EXPECT_EQ(s24[i], golden_s24[i]) << "sample " << i;
+
+	/* after Reset(), the converter must behave like a new one */
+	dsd2pcm->Reset();
+	dsd2pcm->Translate(2, n_frames, golden_src, f);
+	for (std::size_t i = 0; i < std::size(f); ++i)
+		EXPECT_EQ(f[i], golden_float[i]) << "sample " << i;
+}
+
+#ifdef __SSE2__
+
+TEST(PcmTest, X86Dsd2Pcm)
+{
+	const auto src = RandomOctets();
+
+	const bool old_avx2 = X86PcmIsAvx2Enabled();
+
+	X86PcmSetAvx2(false);
+	const auto expected = Translate<float>(src);
+	const auto expected_s24 = Translate<int32_t>(src);
+
+	X86PcmSetAvx2(true);
+	if (X86PcmIsAvx2Enabled()) {
+		/* the AVX2 implementation must be bit-exact */
+		EXPECT_EQ(Translate<float>(src), expected);
+		EXPECT_EQ(Translate<int32_t>(src), expected_s24);
+	}
+
+	X86PcmSetAvx2(old_avx2);
+}
+
+#endif
+
+#endif
@@ -4,10 +4,17 @@
 #include "pcm/Export.hxx"
 #include "pcm/Features.h" // for ENABLE_DSD
 #include "pcm/Traits.hxx"
+#include "pcm/Order.hxx"
+#include "pcm/Pack.hxx"
+#include "pcm/Buffer.hxx"
 #include "util/ByteOrder.hxx"
+#include "util/ByteReverse.hxx"
 
 #include <gtest/gtest.h>
 
+#include <random>
+#include <vector>
+
 #include <string.h>
 
 TEST(PcmTest, ExportShift8)
@@ -415,3 +422,99 @@ TEST(PcmTest, ExportAlsaChannelOrder)
 	TestAlsaChannelOrder51<SampleFormat::S32>();
 	TestAlsaChannelOrder71<SampleFormat::S32>();
 }
+
+/**
+ * The unfused reference implementation of PcmExport::Export(): one
+ * pass for each step.
+ */
+static std::vector<std::byte>
+ReferenceExport(std::span<const std::byte> src, SampleFormat format,
+		unsigned channels, const PcmExport::Params &params)
+{
+	PcmBuffer order_buffer;
+	if (params.alsa_channel_order)
+		src = ToAlsaChannelOrder(order_buffer, src, format, channels);
+
+	std::vector<std::byte> result(src.begin(), src.end());
+	std::size_t sample_size = sample_format_size(format);
+
+	if (format == SampleFormat::S24_P32 && params.pack24) {
+		std::vector<std::byte> packed(src.size() / 4 * 3);
+		const auto *s = (const int32_t *)result.data();
+		pcm_pack_24((uint8_t *)packed.data(), s, s + result.size() / 4);
+		result = std::move(packed);
+		sample_size = 3;
+	} else if (format == SampleFormat::S24_P32 && params.shift8) {
+		auto *s = (uint32_t *)result.data();
+		for (std::size_t i = 0; i < result.size() / 4; ++i)
+			s[i] <<= 8;
+	}
+
+	if (params.reverse_endian && sample_size > 1) {
+		std::vector<std::byte> reversed(result.size());
+		reverse_bytes((uint8_t *)reversed.data(),
+			      (const uint8_t *)result.data(),
+			      (const uint8_t *)result.data() + result.size(),
+			      sample_size);
+		result = std::move(reversed);
+	}
+
+	return result;
+}
+
+/**
+ * Compare all combinations of channel reordering, 24 bit
+ * packing/shifting and byte reversal (which use the fused
+ * single-pass implementation when more than one is enabled) with
+ * the unfused reference.
+ */
+TEST(PcmTest, ExportFusedMatrix)
+{
+	static constexpr SampleFormat formats[] = {
+		SampleFormat::S16,
+		SampleFormat::S24_P32,
+		SampleFormat::S32,
+		SampleFormat::FLOAT,
+	};
+
+	constexpr std::size_t N_FRAMES = 67;
+
+	std::mt19937 gen(42);
+	std::vector<std::byte> src(N_FRAMES * 8 * 4);
+	for (auto &i : src)
+		i = std::byte(gen());
+
+	for (const auto format : formats) {
+		for (unsigned channels = 1; channels <= 8; ++channels) {
+			const std::span<const std::byte> input{src.data(), N_FRAMES * channels * sample_format_size(format)};
+
+			for (unsigned flags = 0; flags < 16; ++flags) {
+				PcmExport::Params params;
+				params.alsa_channel_order = flags & 1;
+				params.shift8 = flags & 2;
+				params.pack24 = flags & 4;
+				params.reverse_endian = flags & 8;
+
+				if (params.shift8 && params.pack24)
+					continue;
+
+				PcmExport e;
+				e.Open(format, channels, params);
+
+				const auto expected = ReferenceExport(input, format,
+								      channels, params);
+				const auto dest = e.Export(input);
+
+				ASSERT_EQ(dest.size(), expected.size())
+					<< sample_format_to_string(format) << " "
+					<< channels << " " << flags;
+				EXPECT_EQ(memcmp(dest.data(), expected.data(),
+						 dest.size()), 0)
+					<< sample_format_to_string(format) << " "
+					<< channels << " " << flags;
+				EXPECT_EQ(e.GetOutputFrameSize() * N_FRAMES,
+					  dest.size());
+			}
+		}
+	}
+}
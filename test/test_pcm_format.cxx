@@ -3,12 +3,24 @@
 
 #include "test_pcm_util.hxx"
 #include "pcm/PcmFormat.hxx"
+#include "pcm/FormatConverter.hxx"
 #include "pcm/Dither.hxx"
 #include "pcm/Buffer.hxx"
 #include "pcm/SampleFormat.hxx"
+#include "util/SpanCast.hxx"
+
+#ifdef __SSE2__
+#include "pcm/X86Convert.hxx"
+#include "pcm/X86Cpu.hxx"
+#include "pcm/FloatConvert.hxx"
+#include "pcm/ShiftConvert.hxx"
+#endif
 
 #include <gtest/gtest.h>
 
+#include <cmath>
+#include <vector>
+
 TEST(PcmTest, Format8To16)
 {
 	constexpr size_t N = 509;
@@ -98,6 +110,73 @@ TEST(PcmTest, FormatFloat16)
 		EXPECT_EQ(src[i], d[i]);
 }
 
+TEST(PcmTest, FormatFloat16Dither)
+{
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<int16_t, N>();
+
+	PcmBuffer buffer1, buffer2;
+
+	auto f = pcm_convert_to_float(buffer1, SampleFormat::S16, src);
+	EXPECT_EQ(N, f.size());
+
+	/* check if clamping works */
+	auto *writable = const_cast<float *>(f.data());
+	*writable++ = 1.01;
+	*writable++ = 10;
+	*writable++ = -1.01;
+	*writable++ = -10;
+
+	PcmDither dither;
+	auto d = pcm_dither_float_to_16(buffer2, dither, f);
+	EXPECT_EQ(N, d.size());
+
+	EXPECT_GE(int(d[0]), 32766);
+	EXPECT_GE(int(d[1]), 32766);
+	EXPECT_LE(int(d[2]), -32767);
+	EXPECT_LE(int(d[3]), -32767);
+
+	/* dithering and noise shaping add a little noise, but not
+	   more than that */
+	for (size_t i = 4; i < N; ++i)
+		EXPECT_NEAR(int(src[i]), int(d[i]), 4);
+}
+
+/**
+ * PcmFormatConverter uses the (SIMD) pcm_convert_to_16() for
+ * FLOAT->S16 unless dithering was requested.
+ */
+TEST(PcmTest, FormatConverterFloat16)
+{
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<int16_t, N>();
+
+	PcmBuffer buffer1, buffer2;
+	PcmDither dither;
+
+	const auto f = std::as_bytes(pcm_convert_to_float(buffer1,
+							  SampleFormat::S16,
+							  src));
+	const auto expected = pcm_convert_to_16(buffer2, dither,
+						SampleFormat::FLOAT, f);
+
+	PcmFormatConverter plain;
+	plain.Open(SampleFormat::FLOAT, SampleFormat::S16);
+	const auto d1 = FromBytesStrict<const int16_t>(plain.Convert(f));
+	ASSERT_EQ(d1.size(), N);
+	for (size_t i = 0; i < N; ++i)
+		EXPECT_EQ(d1[i], expected[i]);
+	plain.Close();
+
+	PcmFormatConverter dithered;
+	dithered.Open(SampleFormat::FLOAT, SampleFormat::S16, true);
+	const auto d2 = FromBytesStrict<const int16_t>(dithered.Convert(f));
+	ASSERT_EQ(d2.size(), N);
+	for (size_t i = 0; i < N; ++i)
+		EXPECT_NEAR(int(d2[i]), int(src[i]), 4);
+	dithered.Close();
+}
+
 TEST(PcmTest, FormatFloat32)
 {
 	constexpr size_t N = 509;
@@ -143,3 +222,117 @@ TEST(PcmTest, FormatFloat32)
 	for (size_t i = 4; i < N; ++i)
 		EXPECT_NEAR(src[i], d[i], error);
 }
+
+#ifdef __SSE2__
+
+/**
+ * Compare the results of #X86Convert with the portable per-sample
+ * converter C bit by bit, using the SSE2 and (if supported) the AVX2
+ * implementation.
+ */
+template<SampleFormat SF, SampleFormat DF, typename C>
+static void
+CheckX86Convert(std::span<const typename SampleTraits<SF>::value_type> src)
+{
+	using DV = typename SampleTraits<DF>::value_type;
+
+	/* X86Convert ignores the trailing partial block */
+	const size_t n = src.size() - src.size() % X86Convert<SF, DF>::BLOCK_SIZE;
+
+	std::vector<DV> expected(n);
+	for (size_t i = 0; i < n; ++i)
+		expected[i] = C::Convert(src[i]);
+
+	const bool old_avx2 = X86PcmIsAvx2Enabled();
+
+	for (const bool avx2 : {false, true}) {
+		X86PcmSetAvx2(avx2);
+		if (X86PcmIsAvx2Enabled() != avx2)
+			/* not supported by this CPU */
+			continue;
+
+		std::vector<DV> actual(n);
+		X86Convert<SF, DF>{}.Convert(actual.data(), src.data(), n);
+
+		for (size_t i = 0; i < n; ++i)
+			EXPECT_EQ(expected[i], actual[i])
+				<< "avx2=" << avx2 << " i=" << i;
+	}
+
+	X86PcmSetAvx2(old_avx2);
+}
+
+/**
+ * Generate float samples including values which need to be
+ * clamped.
+ */
+static std::vector<float>
+X86TestFloatSamples()
+{
+	constexpr size_t N = 509;
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<float> dis(-1.5, 1.5);
+
+	std::vector<float> v{
+		0, -0.f, 1, -1, 1.5, -1.5, 100, -100,
+		std::nextafter(1.f, 0.f), std::nextafter(-1.f, 0.f),
+		std::nextafter(1.f, 2.f), std::nextafter(-1.f, -2.f),
+		0.5f / 32768, -0.5f / 32768, 1.5f / 32768, -1.5f / 32768,
+	};
+
+	while (v.size() < N)
+		v.push_back(dis(gen));
+
+	return v;
+}
+
+TEST(PcmTest, X86FloatToInteger)
+{
+	const auto src = X86TestFloatSamples();
+
+	CheckX86Convert<SampleFormat::FLOAT, SampleFormat::S16,
+			FloatToIntegerSampleConvert<SampleFormat::S16>>(src);
+	CheckX86Convert<SampleFormat::FLOAT, SampleFormat::S24_P32,
+			FloatToIntegerSampleConvert<SampleFormat::S24_P32>>(src);
+	CheckX86Convert<SampleFormat::FLOAT, SampleFormat::S32,
+			FloatToIntegerSampleConvert<SampleFormat::S32>>(src);
+}
+
+TEST(PcmTest, X86IntegerToFloat)
+{
+	constexpr size_t N = 509;
+	const TestDataBuffer<int16_t, N> src16;
+	const TestDataBuffer<int32_t, N> src24{RandomInt24()};
+	const TestDataBuffer<int32_t, N> src32;
+
+	CheckX86Convert<SampleFormat::S16, SampleFormat::FLOAT,
+			IntegerToFloatSampleConvert<SampleFormat::S16>>(src16);
+	CheckX86Convert<SampleFormat::S24_P32, SampleFormat::FLOAT,
+			IntegerToFloatSampleConvert<SampleFormat::S24_P32>>(src24);
+	CheckX86Convert<SampleFormat::S32, SampleFormat::FLOAT,
+			IntegerToFloatSampleConvert<SampleFormat::S32>>(src32);
+}
+
+TEST(PcmTest, X86Shift)
+{
+	constexpr size_t N = 509;
+	const TestDataBuffer<int16_t, N> src16;
+	const TestDataBuffer<int32_t, N> src24{RandomInt24()};
+	const TestDataBuffer<int32_t, N> src32;
+
+	CheckX86Convert<SampleFormat::S16, SampleFormat::S24_P32,
+			LeftShiftSampleConvert<SampleFormat::S16,
+					       SampleFormat::S24_P32>>(src16);
+	CheckX86Convert<SampleFormat::S16, SampleFormat::S32,
+			LeftShiftSampleConvert<SampleFormat::S16,
+					       SampleFormat::S32>>(src16);
+	CheckX86Convert<SampleFormat::S24_P32, SampleFormat::S32,
+			LeftShiftSampleConvert<SampleFormat::S24_P32,
+					       SampleFormat::S32>>(src24);
+	CheckX86Convert<SampleFormat::S32, SampleFormat::S24_P32,
+			RightShiftSampleConvert<SampleFormat::S32,
+						SampleFormat::S24_P32>>(src32);
+}
+
+#endif
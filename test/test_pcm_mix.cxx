@@ -7,6 +7,8 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 template<typename T, SampleFormat format, typename G=RandomInt<T>>
 static void
 TestPcmMix(G g=G())
@@ -65,3 +67,62 @@ TEST(PcmTest, Mix32)
 {
 	TestPcmMix<int32_t, SampleFormat::S32>();
 }
+
+TEST(PcmTest, MixFloat)
+{
+	constexpr unsigned N = 509;
+	const auto src1 = TestDataBuffer<float, N>(RandomFloat());
+	const auto src2 = TestDataBuffer<float, N>(RandomFloat());
+
+	PcmDither dither;
+
+	auto result = src1;
+	bool success = pcm_mix(dither,
+			       result.begin(), src2.begin(), sizeof(result),
+			       SampleFormat::FLOAT, 1.0);
+	ASSERT_TRUE(success);
+	for (unsigned i = 0; i < N; ++i)
+		EXPECT_EQ(result[i], src1[i]);
+
+	result = src1;
+	success = pcm_mix(dither, result.begin(), src2.begin(), sizeof(result),
+			  SampleFormat::FLOAT, 0.0);
+	ASSERT_TRUE(success);
+	for (unsigned i = 0; i < N; ++i)
+		EXPECT_EQ(result[i], src2[i]);
+
+	result = src1;
+	success = pcm_mix(dither, result.begin(), src2.begin(), sizeof(result),
+			  SampleFormat::FLOAT, 0.5);
+	ASSERT_TRUE(success);
+	for (unsigned i = 0; i < N; ++i)
+		EXPECT_EQ(result[i], src1[i] * 0.5f + src2[i] * 0.5f);
+
+	/* portion1<0 means adding both */
+	result = src1;
+	success = pcm_mix(dither, result.begin(), src2.begin(), sizeof(result),
+			  SampleFormat::FLOAT, -1);
+	ASSERT_TRUE(success);
+	for (unsigned i = 0; i < N; ++i)
+		EXPECT_EQ(result[i], src1[i] + src2[i]);
+}
+
+TEST(PcmTest, Add16)
+{
+	constexpr unsigned N = 509;
+	const auto src1 = TestDataBuffer<int16_t, N>();
+	const auto src2 = TestDataBuffer<int16_t, N>();
+
+	PcmDither dither;
+
+	auto result = src1;
+	bool success = pcm_mix(dither,
+			       result.begin(), src2.begin(), sizeof(result),
+			       SampleFormat::S16, -1);
+	ASSERT_TRUE(success);
+
+	for (unsigned i = 0; i < N; ++i)
+		EXPECT_EQ(result[i],
+			  std::clamp(int(src1[i]) + int(src2[i]),
+				     -32768, 32767));
+}
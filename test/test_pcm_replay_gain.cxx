@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "pcm/ReplayGainAnalyzer.hxx"
+
+#ifdef __SSE2__
+#include "pcm/X86Cpu.hxx"
+#endif
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+using Frame = ReplayGainAnalyzer::Frame;
+
+/**
+ * Generate a few seconds of noisy sine waves with the given
+ * amplitude.
+ */
+static std::vector<Frame>
+GenerateFrames(float amplitude)
+{
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<float> noise(-0.1f, 0.1f);
+
+	std::vector<Frame> frames(ReplayGainAnalyzer::SAMPLE_RATE * 3);
+	for (std::size_t i = 0; i < frames.size(); ++i) {
+		const float x = std::sin(float(i) * 0.05f) *
+			(1.0f + 0.5f * std::sin(float(i) * 1e-4f));
+		frames[i] = {
+			amplitude * (0.6f * x + noise(gen)),
+			amplitude * (0.4f * x + noise(gen)),
+		};
+	}
+
+	return frames;
+}
+
+static std::unique_ptr<WindowReplayGainAnalyzer>
+Analyze(const std::vector<Frame> &frames)
+{
+	auto a = std::make_unique<WindowReplayGainAnalyzer>();
+
+	/* odd block size to exercise the window buffer and the
+	   non-SIMD tails */
+	constexpr std::size_t block = 1001;
+	for (std::size_t i = 0; i < frames.size(); i += block)
+		a->Process({frames.data() + i,
+			    std::min(block, frames.size() - i)});
+
+	a->Flush();
+	return a;
+}
+
+TEST(ReplayGainAnalyzer, Loudness)
+{
+	const auto quiet = Analyze(GenerateFrames(0.25f));
+	const auto loud = Analyze(GenerateFrames(0.5f));
+
+	EXPECT_TRUE(quiet->IsDefined());
+	EXPECT_NEAR(quiet->GetPeak() * 2, loud->GetPeak(), 1e-6);
+
+	/* doubling the amplitude means 6 dB louder */
+	EXPECT_NEAR(quiet->GetGain() - loud->GetGain(), 6.02, 0.05);
+}
+
+TEST(ReplayGainAnalyzer, Merge)
+{
+	const auto a = Analyze(GenerateFrames(0.25f));
+
+	ReplayGainAnalyzer album;
+	EXPECT_FALSE(album.IsDefined());
+
+	album.Merge(*a);
+	EXPECT_TRUE(album.IsDefined());
+	EXPECT_EQ(album.GetGain(), a->GetGain());
+	EXPECT_EQ(album.GetPeak(), a->GetPeak());
+
+	/* the same track twice: same loudness distribution */
+	album.Merge(*a);
+	EXPECT_EQ(album.GetGain(), a->GetGain());
+
+	/* a louder track raises the peak and lowers the gain */
+	const auto b = Analyze(GenerateFrames(0.5f));
+	album.Merge(*b);
+	EXPECT_EQ(album.GetPeak(), b->GetPeak());
+	EXPECT_LT(album.GetGain(), a->GetGain());
+	EXPECT_GT(album.GetGain(), b->GetGain());
+}
+
+#ifdef __SSE2__
+
+TEST(ReplayGainAnalyzer, Avx2)
+{
+	if (!X86PcmIsAvx2Enabled())
+		GTEST_SKIP() << "No AVX2";
+
+	const auto frames = GenerateFrames(0.3f);
+
+	const auto avx2 = Analyze(frames);
+
+	X86PcmSetAvx2(false);
+	const auto sse2 = Analyze(frames);
+	X86PcmSetAvx2(true);
+
+	EXPECT_EQ(avx2->GetPeak(), sse2->GetPeak());
+	EXPECT_NEAR(avx2->GetGain(), sse2->GetGain(), 0.011);
+}
+
+#endif
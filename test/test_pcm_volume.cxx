@@ -102,6 +102,44 @@ TEST(PcmTest, Volume16to32)
 	pv.Close();
 }
 
+TEST(PcmTest, Volume16toFloat)
+{
+	constexpr SampleFormat F = SampleFormat::S16;
+	using value_type = int16_t;
+	RandomInt<value_type> g;
+
+	PcmVolume pv;
+	EXPECT_EQ(pv.Open(F, true, true), SampleFormat::FLOAT);
+
+	constexpr size_t N = 509;
+	static float zero[N];
+	const auto _src = TestDataBuffer<value_type, N>(g);
+	const std::span<const std::byte> src = _src;
+
+	pv.SetVolume(0);
+	auto dest = pv.Apply(src);
+	EXPECT_EQ(src.size() * 2, dest.size());
+	EXPECT_EQ(0, memcmp(dest.data(), zero, sizeof(zero)));
+
+	pv.SetVolume(PCM_VOLUME_1);
+	dest = pv.Apply(src);
+	EXPECT_EQ(src.size() * 2, dest.size());
+	auto d = FromBytesStrict<const float>(dest);
+	for (size_t i = 0; i < N; ++i)
+		EXPECT_FLOAT_EQ(d[i], _src[i] / 32768.f);
+
+	pv.SetVolume(PCM_VOLUME_1 / 2);
+	dest = pv.Apply(src);
+	EXPECT_EQ(src.size() * 2, dest.size());
+
+	/* no precision is lost: this is exactly half of the input */
+	d = FromBytesStrict<const float>(dest);
+	for (size_t i = 0; i < N; ++i)
+		EXPECT_FLOAT_EQ(d[i], _src[i] / 65536.f);
+
+	pv.Close();
+}
+
 TEST(PcmTest, Volume24)
 {
 	TestVolume<SampleFormat::S24_P32>(RandomInt24());
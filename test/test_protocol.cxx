@@ -1,6 +1,7 @@
 #include "protocol/ArgParser.hxx"
 #include "protocol/Ack.hxx"
 #include "protocol/RangeArg.hxx"
+#include "protocol/IdleFlags.hxx"
 
 #include <gtest/gtest.h>
 
@@ -21,3 +22,52 @@ TEST(ArgParser, Range)
 	EXPECT_THROW(range = ParseCommandArgRange("-2"),
 		     ProtocolError);
 }
+
+TEST(IdleFlags, Debounce)
+{
+	using std::chrono::milliseconds;
+
+	const char *const args[] = {"player", "mixer", "debounce", "200"};
+
+	std::span<const char *const> a = args;
+	EXPECT_EQ(idle_parse_debounce(a), milliseconds{200});
+	EXPECT_EQ(a.size(), 2U);
+	EXPECT_EQ(idle_parse_name(a.back()), IDLE_MIXER);
+
+	/* no option: the arguments are left alone */
+	a = std::span{args}.first(2);
+	EXPECT_EQ(idle_parse_debounce(a), milliseconds::zero());
+	EXPECT_EQ(a.size(), 2U);
+
+	a = {};
+	EXPECT_EQ(idle_parse_debounce(a), milliseconds::zero());
+
+	/* without subsystems */
+	a = std::span{args}.subspan(2);
+	EXPECT_EQ(idle_parse_debounce(a), milliseconds{200});
+	EXPECT_TRUE(a.empty());
+
+	/* "debounce" without a value is a subsystem name */
+	a = std::span{args}.first(3);
+	EXPECT_EQ(idle_parse_debounce(a), milliseconds::zero());
+	EXPECT_EQ(a.size(), 3U);
+}
+
+TEST(IdleFlags, DebounceLimit)
+{
+	const char *const max[] = {"debounce", "60000"};
+	std::span<const char *const> a = max;
+	EXPECT_EQ(idle_parse_debounce(a), IDLE_MAX_DEBOUNCE);
+
+	const char *const too_large[] = {"player", "debounce", "60001"};
+	a = too_large;
+	EXPECT_THROW(idle_parse_debounce(a), ProtocolError);
+
+	const char *const negative[] = {"debounce", "-1"};
+	a = negative;
+	EXPECT_THROW(idle_parse_debounce(a), ProtocolError);
+
+	const char *const malformed[] = {"debounce", "soon"};
+	a = malformed;
+	EXPECT_THROW(idle_parse_debounce(a), ProtocolError);
+}
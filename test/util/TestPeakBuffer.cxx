@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "util/PeakBuffer.hxx"
+#include "util/SpanCast.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+using std::string_view_literals::operator""sv;
+
+TEST(PeakBuffer, ReadAll)
+{
+	PeakBuffer b{4, 16};
+
+	EXPECT_TRUE(b.empty());
+	EXPECT_TRUE(b.ReadAll()[0].empty());
+	EXPECT_TRUE(b.ReadAll()[1].empty());
+
+	/* fills the normal buffer and spills into the peak
+	   buffer */
+	EXPECT_TRUE(b.Append(AsBytes("abcdef"sv)));
+
+	auto all = b.ReadAll();
+	EXPECT_EQ(ToStringView(all[0]), "abcd"sv);
+	EXPECT_EQ(ToStringView(all[1]), "ef"sv);
+	EXPECT_EQ(ToStringView(b.Read()), "abcd"sv);
+
+	/* consume across the segment boundary */
+	b.Consume(5);
+	all = b.ReadAll();
+	EXPECT_TRUE(all[0].empty());
+	EXPECT_EQ(ToStringView(all[1]), "f"sv);
+
+	/* while the peak buffer has data, new data is appended
+	   there to preserve the order */
+	EXPECT_TRUE(b.Append(AsBytes("g"sv)));
+	all = b.ReadAll();
+	EXPECT_TRUE(all[0].empty());
+	EXPECT_EQ(ToStringView(all[1]), "fg"sv);
+
+	b.Consume(2);
+	EXPECT_TRUE(b.empty());
+}
+
+TEST(PeakBuffer, DirectWrite)
+{
+	PeakBuffer b{4, 0};
+
+	auto w = b.Write();
+	ASSERT_EQ(w.size(), 4U);
+	std::ranges::copy(AsBytes("xyz"sv), w.begin());
+	b.Append(std::size_t{3});
+	EXPECT_EQ(ToStringView(b.Read()), "xyz"sv);
+
+	w = b.Write();
+	ASSERT_EQ(w.size(), 1U);
+	w[0] = std::byte{'!'};
+	b.Append(std::size_t{1});
+	EXPECT_EQ(ToStringView(b.Read()), "xyz!"sv);
+
+	/* full, and there is no peak buffer */
+	EXPECT_TRUE(b.Write().empty());
+	EXPECT_FALSE(b.Append(AsBytes("?"sv)));
+
+	b.Consume(4);
+	EXPECT_TRUE(b.empty());
+}